@@ -0,0 +1,881 @@
+#include "crypto/checksum.hpp"
+#include "crypto/decrypt.hpp"
+#include "crypto/encrypt.hpp"
+#include "crypto/serialize.hpp"
+#include "file/file.hpp"
+#include "memory/job_arena.hpp"
+#include "pipeline/pipeline.hpp"
+#include "pipeline/segmented.hpp"
+#include "pipeline/verify.hpp"
+#include "video/calibration.hpp"
+#include "video/frame_header.hpp"
+#include "video/metadata.hpp"
+#include "video/pixel.hpp"
+#include "video/video.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <print>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// runs encode, verify and decode end to end over a grid of settings and
+// reports throughput, frames per MB, peak memory and the bit error rate of
+// every combination. with a transcode the video goes through a lossy codec
+// in between, as it would on a video platform
+
+// segment videos the segments layout splits a payload into
+constexpr std::size_t BENCH_SEGMENTS{ 4 };
+
+// the ways ftv encrypt lays a payload out
+enum class layout
+{
+  serialized, // one aead message, without options
+  chunks,     // a chunk stream, as with --dedup or --resume
+  segments    // a chunk stream in BENCH_SEGMENTS videos, as with --segments
+};
+
+// a re-encoding of the finished video, like the one a platform does after
+// an upload
+struct transcode
+{
+  std::string name{};
+  int fourcc{};
+  int quality{ 100 }; // for codecs that take one, such as mjpg
+};
+
+struct bench_config
+{
+  std::size_t size{};
+  ftv::resolution res{};
+  std::size_t fps{};
+  layout format{ layout::serialized };
+  ftv::cipher_id cipher{ ftv::cipher_id::aes_256_gcm };
+  std::optional<transcode> recode{};
+};
+
+// what the child process that ran a configuration reports back through a
+// pipe, so it has to stay trivially copyable
+struct bench_result
+{
+  double encode_seconds{};
+  double verify_seconds{};
+  double decode_seconds{};
+  std::uint64_t frames{};     // written by the encoder, in all videos
+  std::uint64_t bits{};       // of their data areas, compared after transcode
+  std::uint64_t bit_errors{}; // of them, read back wrong
+  bool decoded{};             // decode succeeded, the output is on disk
+  std::array<char, 96> status{}; // the first step that failed and why
+};
+
+struct bench_options
+{
+  std::vector<std::size_t> sizes{ std::size_t{ 1 } << 20,
+                                  std::size_t{ 16 } << 20 };
+  std::vector<ftv::resolution> resolutions{ { 640, 480 }, { 1280, 720 } };
+  std::vector<std::size_t> fps{ 30 };
+  std::vector<layout> layouts{ layout::serialized, layout::chunks,
+                               layout::segments };
+  std::vector<ftv::cipher_id> ciphers{ ftv::cipher_id::aes_256_gcm };
+  // nullopt keeps the video as ftv wrote it
+  std::vector<std::optional<transcode>> transcodes{
+    std::nullopt,
+    transcode{ "MJPG:75", cv::VideoWriter::fourcc ('M', 'J', 'P', 'G'), 75 }
+  };
+  std::filesystem::path dir{ std::filesystem::temp_directory_path ()
+                             / "ftv_bench" };
+  bool csv{ false };
+  bool keep{ false }; // leave the videos of every configuration behind
+};
+
+void
+print_usage ()
+{
+  std::println ("usage: ftv_bench [options]");
+  std::println ("\noptions, lists are comma separated:");
+  std::println ("  -s, --sizes <list>        payload sizes in bytes, k and m "
+                "suffixes allowed (default: 1m,16m)");
+  std::println ("  -r, --resolutions <list>  WxH frame sizes (default: "
+                "640x480,1280x720)");
+  std::println ("  -f, --fps <list>          frame rates (default: 30)");
+  std::println ("  -l, --layouts <list>      serialized, chunks or segments "
+                "(default: all)");
+  std::println ("  -e, --ciphers <list>      aes-256-gcm, chacha20-poly1305 "
+                "or auto (default: aes-256-gcm)");
+  std::println ("  -t, --transcodes <list>   none, or a fourcc with an "
+                "optional :quality such as MJPG:50 or XVID (default: "
+                "none,MJPG:75)");
+  std::println ("  -d, --dir <path>          scratch directory (default: "
+                "the temp directory)");
+  std::println ("  -c, --csv                 print comma separated values");
+  std::println ("  -k, --keep                keep the videos of every "
+                "configuration");
+  std::println ("  -h, --help                show this help message");
+}
+
+std::string_view
+layout_name (layout format)
+{
+  switch (format)
+    {
+    case layout::chunks:
+      {
+        return "chunks";
+      }
+    case layout::segments:
+      {
+        return "segments";
+      }
+    default:
+      {
+        return "serialized";
+      }
+    }
+}
+
+// calls parse on every comma separated item of list, false if it refused
+// one
+template <typename T, typename Parse>
+bool
+parse_list (std::string_view list, std::vector<T> &out, Parse parse)
+{
+  out.clear ();
+  while (!list.empty ())
+    {
+      const auto comma = list.find (',');
+      const auto item = list.substr (0, comma);
+      auto value = parse (item);
+      if (!value)
+        {
+          std::println ("error: invalid list item: {}", item);
+          return false;
+        }
+      out.push_back (std::move (*value));
+      list.remove_prefix (comma == std::string_view::npos ? list.size ()
+                                                          : comma + 1);
+    }
+  return !out.empty ();
+}
+
+std::optional<std::size_t>
+parse_size (std::string_view item)
+{
+  std::size_t scale = 1;
+  if (item.ends_with ('k') || item.ends_with ('m'))
+    {
+      scale = item.back () == 'k' ? std::size_t{ 1 } << 10
+                                  : std::size_t{ 1 } << 20;
+      item.remove_suffix (1);
+    }
+  try
+    {
+      const auto value = std::stoul (std::string{ item });
+      if (value == 0)
+        {
+          return std::nullopt;
+        }
+      return value * scale;
+    }
+  catch (const std::exception &)
+    {
+      return std::nullopt;
+    }
+}
+
+std::optional<ftv::resolution>
+parse_resolution (std::string_view item)
+{
+  const auto x = item.find ('x');
+  if (x == std::string_view::npos)
+    {
+      return std::nullopt;
+    }
+  const auto width = parse_size (item.substr (0, x));
+  const auto height = parse_size (item.substr (x + 1));
+  if (!width || !height)
+    {
+      return std::nullopt;
+    }
+  return ftv::resolution{ *width, *height };
+}
+
+std::optional<layout>
+parse_layout (std::string_view item)
+{
+  for (const auto format :
+       { layout::serialized, layout::chunks, layout::segments })
+    {
+      if (item == layout_name (format))
+        {
+          return format;
+        }
+    }
+  return std::nullopt;
+}
+
+std::optional<ftv::cipher_id>
+parse_cipher (std::string_view item)
+{
+  const auto cipher = ftv::parse_cipher (item);
+  if (!cipher)
+    {
+      return std::nullopt;
+    }
+  return *cipher;
+}
+
+// none, or a fourcc with an optional quality after a colon
+std::optional<std::optional<transcode>>
+parse_transcode (std::string_view item)
+{
+  if (item == "none")
+    {
+      return std::optional<transcode>{};
+    }
+  if (item.size () < 4 || (item.size () > 4 && item[4] != ':'))
+    {
+      return std::nullopt;
+    }
+  transcode recode{ std::string{ item },
+                    cv::VideoWriter::fourcc (item[0], item[1], item[2],
+                                             item[3]),
+                    100 };
+  if (item.size () > 4)
+    {
+      const auto quality = parse_size (item.substr (5));
+      if (!quality || *quality > 100)
+        {
+          return std::nullopt;
+        }
+      recode.quality = static_cast<int> (*quality);
+    }
+  return std::optional<transcode>{ std::move (recode) };
+}
+
+std::optional<bench_options>
+parse_arguments (int argc, char **argv)
+{
+  bench_options options{};
+
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string_view arg = argv[i];
+      const std::string_view value = i + 1 < argc ? argv[i + 1] : "";
+
+      if (arg == "-h" || arg == "--help")
+        {
+          print_usage ();
+          std::exit (0);
+        }
+
+      if (arg == "-c" || arg == "--csv")
+        {
+          options.csv = true;
+          continue;
+        }
+
+      if (arg == "-k" || arg == "--keep")
+        {
+          options.keep = true;
+          continue;
+        }
+
+      ++i;
+      bool parsed = !value.empty ();
+      if (arg == "-s" || arg == "--sizes")
+        {
+          parsed = parsed && parse_list (value, options.sizes, parse_size);
+        }
+      else if (arg == "-r" || arg == "--resolutions")
+        {
+          parsed = parsed
+                   && parse_list (value, options.resolutions,
+                                  parse_resolution);
+        }
+      else if (arg == "-f" || arg == "--fps")
+        {
+          parsed = parsed && parse_list (value, options.fps, parse_size);
+        }
+      else if (arg == "-l" || arg == "--layouts")
+        {
+          parsed = parsed && parse_list (value, options.layouts, parse_layout);
+        }
+      else if (arg == "-e" || arg == "--ciphers")
+        {
+          parsed = parsed && parse_list (value, options.ciphers, parse_cipher);
+        }
+      else if (arg == "-t" || arg == "--transcodes")
+        {
+          parsed = parsed
+                   && parse_list (value, options.transcodes, parse_transcode);
+        }
+      else if (arg == "-d" || arg == "--dir")
+        {
+          options.dir = value;
+        }
+      else
+        {
+          std::println ("error: unknown option: {}", arg);
+          parsed = false;
+        }
+
+      if (!parsed)
+        {
+          print_usage ();
+          return std::nullopt;
+        }
+    }
+
+  return options;
+}
+
+// runs job and stores how long it took in seconds
+template <typename Job>
+auto
+timed (double &seconds, Job &&job)
+{
+  const auto start = std::chrono::steady_clock::now ();
+  auto result = job ();
+  seconds = std::chrono::duration<double> (std::chrono::steady_clock::now ()
+                                           - start)
+                .count ();
+  return result;
+}
+
+// encodes input into output the way ftv encrypt does for config's layout
+std::error_code
+encode (const bench_config &config, const std::filesystem::path &input,
+        const std::filesystem::path &output, const ftv::secure_key &key)
+{
+  const ftv::metadata data{ input.filename ().string (),
+                            0,
+                            0,
+                            config.fps,
+                            config.res,
+                            ftv::payload_format::chunk_stream,
+                            config.cipher };
+  switch (config.format)
+    {
+    case layout::chunks:
+      {
+        return ftv::run_job (ftv::encode_job (input, output, key, data));
+      }
+    case layout::segments:
+      {
+        return ftv::encode_segmented (input, output, key, data,
+                                      BENCH_SEGMENTS);
+      }
+    default:
+      {
+        break;
+      }
+    }
+
+  ftv::job_arena arena{};
+  const auto encrypted
+      = ftv::encrypt_file (input, key, config.cipher, arena.resource ());
+  if (!encrypted)
+    {
+      return encrypted.error ();
+    }
+
+  const auto serialized
+      = ftv::serialize_encrypted_data (*encrypted, arena.resource ());
+  if (!serialized)
+    {
+      return serialized.error ();
+    }
+
+  const ftv::metadata meta{ input.filename ().string (),
+                            serialized->size (),
+                            ftv::hash (serialized->segments ()),
+                            config.fps,
+                            config.res,
+                            ftv::payload_format::serialized,
+                            config.cipher };
+  const ftv::video vid{ output, meta, arena.resource () };
+  return vid.write (serialized->segments ());
+}
+
+// decodes video into output the way ftv decrypt does for config's layout
+std::error_code
+decode (const bench_config &config, const std::filesystem::path &video,
+        const std::filesystem::path &output, const ftv::secure_key &key)
+{
+  switch (config.format)
+    {
+    case layout::chunks:
+      {
+        return ftv::run_job (ftv::decode_job (video, output, key));
+      }
+    case layout::segments:
+      {
+        return ftv::decode_segmented (video, output, key);
+      }
+    default:
+      {
+        break;
+      }
+    }
+
+  ftv::job_arena arena{};
+  ftv::video vid{ video, arena.resource () };
+  const auto pixels = vid.read ();
+  if (!pixels)
+    {
+      return pixels.error ();
+    }
+
+  auto bytes = ftv::pixels_to_bytes (*pixels, arena.resource (),
+                                     ftv::layout_of (vid.get_metadata ()));
+  if (ftv::hash (bytes) != vid.get_metadata ().checksum ())
+    {
+      return std::make_error_code (std::errc::bad_message);
+    }
+
+  auto deserialized = ftv::deserialize_encrypted_data (std::move (bytes));
+  if (!deserialized)
+    {
+      return deserialized.error ();
+    }
+  return ftv::decrypt_to_file (*deserialized, key, output,
+                              vid.get_metadata ().cipher ());
+}
+
+// re-encodes the video at from into to with recode, frame by frame
+std::error_code
+transcode_video (const std::filesystem::path &from,
+                 const std::filesystem::path &to, const transcode &recode,
+                 std::size_t fps)
+{
+  cv::VideoCapture capture{ from.string () };
+  cv::Mat frame{};
+  if (!capture.isOpened () || !capture.read (frame))
+    {
+      return std::make_error_code (std::errc::io_error);
+    }
+
+  cv::VideoWriter writer{};
+  writer.open (to.string (), recode.fourcc, static_cast<double> (fps),
+               frame.size ());
+  if (!writer.isOpened ())
+    {
+      return std::make_error_code (std::errc::not_supported);
+    }
+  writer.set (cv::VIDEOWRITER_PROP_QUALITY, recode.quality);
+
+  do
+    {
+      writer.write (frame);
+    }
+  while (capture.read (frame));
+  writer.release ();
+  return {};
+}
+
+// compares every frame of tested with the frame the encoder meant to
+// write, rendered again from the header and payload of the same frame of
+// encoded. frames are matched in capture order, those that tested lacks
+// are wrong in every bit
+std::error_code
+count_bit_errors (const std::filesystem::path &encoded,
+                  const std::filesystem::path &tested, bench_result &result)
+{
+  cv::VideoCapture original{ encoded.string () };
+  cv::VideoCapture copy{ tested.string () };
+  if (!original.isOpened () || !copy.isOpened ())
+    {
+      return std::make_error_code (std::errc::io_error);
+    }
+
+  cv::Mat frame{};
+  cv::Mat received{};
+  std::vector<std::byte> payload{};
+  while (original.read (frame))
+    {
+      ++result.frames;
+      const auto header = ftv::read_frame (frame, payload);
+      if (!header)
+        {
+          return header.error ();
+        }
+      cv::Mat expected = cv::Mat::zeros (frame.rows, frame.cols, CV_8UC3);
+      ftv::render_frame (expected, header->sequence, header->offset,
+                         payload);
+
+      const auto rows = static_cast<std::size_t> (frame.rows);
+      const auto cols = static_cast<std::size_t> (frame.cols);
+      const auto bits = (rows - ftv::CALIBRATION_ROWS) * cols;
+      result.bits += bits;
+      if (!copy.read (received) || received.size () != frame.size ())
+        {
+          result.bit_errors += bits;
+          continue;
+        }
+
+      const auto threshold = ftv::calibrate (received).threshold;
+      for (auto row = static_cast<int> (ftv::CALIBRATION_ROWS);
+           row < frame.rows; ++row)
+        {
+          const auto *got = received.ptr<cv::Vec3b> (row);
+          const auto *want = expected.ptr<cv::Vec3b> (row);
+          for (int col = 0; col < frame.cols; ++col)
+            {
+              if (ftv::is_white (got[col], threshold)
+                  != ftv::is_white (want[col], ftv::CALIBRATION_GREY))
+                {
+                  ++result.bit_errors;
+                }
+            }
+        }
+    }
+  return {};
+}
+
+// records the first step that failed
+void
+note_failure (bench_result &result, std::string_view step,
+              std::string_view why)
+{
+  if (result.status[0] != '\0')
+    {
+      return;
+    }
+  const auto text = std::format ("{}: {}", step, why);
+  const auto size = std::min (text.size (), result.status.size () - 1);
+  std::copy_n (text.begin (), size, result.status.begin ());
+}
+
+// encodes input into dir, transcodes the videos if config says so and
+// verifies and decodes the result into dir / "output"
+bench_result
+run_config (const bench_config &config, const std::filesystem::path &input,
+            const std::filesystem::path &dir)
+{
+  bench_result result{};
+  const ftv::secure_key key{ "ftv_bench" };
+  const auto encoded = dir / "encoded";
+  const auto tested = config.recode ? dir / "transcoded" : encoded;
+
+  try
+    {
+      std::filesystem::create_directories (encoded);
+      std::filesystem::create_directories (tested);
+
+      const auto video = encoded / "video.avi";
+      const auto encode_result = timed (result.encode_seconds, [&] {
+        return encode (config, input, video, key);
+      });
+      if (encode_result)
+        {
+          note_failure (result, "encode", encode_result.message ());
+          return result;
+        }
+
+      // the video, its parts and its trailer are transcoded alike
+      for (const auto &entry : std::filesystem::directory_iterator{ encoded })
+        {
+          const auto copy = tested / entry.path ().filename ();
+          if (config.recode)
+            {
+              const auto ec = transcode_video (entry.path (), copy,
+                                               *config.recode, config.fps);
+              if (ec)
+                {
+                  note_failure (result, "transcode", ec.message ());
+                  return result;
+                }
+            }
+          const auto ec = count_bit_errors (entry.path (), copy, result);
+          if (ec)
+            {
+              note_failure (result, "compare", ec.message ());
+              return result;
+            }
+        }
+
+      // a video that fails verification may still decode, and the other
+      // way round
+      const auto report = timed (result.verify_seconds, [&] {
+        return ftv::verify_video (tested / video.filename ());
+      });
+      // a failed step has no throughput
+      if (report.error)
+        {
+          note_failure (result, "verify", report.error.message ());
+          result.verify_seconds = 0;
+        }
+
+      const auto decode_result = timed (result.decode_seconds, [&] {
+        return decode (config, tested / video.filename (), dir / "output",
+                       key);
+      });
+      if (decode_result)
+        {
+          note_failure (result, "decode", decode_result.message ());
+          result.decode_seconds = 0;
+          return result;
+        }
+      result.decoded = true;
+    }
+  catch (const std::exception &e)
+    {
+      note_failure (result, "error", e.what ());
+    }
+  return result;
+}
+
+// runs config in a child process of its own, so that its peak resident
+// set is its own and a crash ends only this configuration. peak_kib
+// receives that peak
+std::expected<bench_result, std::error_code>
+measure (const bench_config &config, const std::filesystem::path &input,
+         const std::filesystem::path &dir, long &peak_kib)
+{
+  int fds[2];
+  if (::pipe (fds) != 0)
+    {
+      return std::unexpected (
+          std::error_code{ errno, std::generic_category () });
+    }
+
+  const pid_t child = ::fork ();
+  if (child < 0)
+    {
+      const std::error_code ec{ errno, std::generic_category () };
+      ::close (fds[0]);
+      ::close (fds[1]);
+      return std::unexpected (ec);
+    }
+
+  if (child == 0)
+    {
+      ::close (fds[0]);
+      const auto result = run_config (config, input, dir);
+      const auto ec = ftv::write_stream (
+          fds[1], std::as_bytes (std::span{ &result, 1 }));
+      ::_exit (ec ? 1 : 0);
+    }
+
+  ::close (fds[1]);
+  bench_result result{};
+  const auto got = ftv::read_stream (
+      fds[0], std::as_writable_bytes (std::span{ &result, 1 }));
+  ::close (fds[0]);
+
+  int status = 0;
+  rusage usage{};
+  while (::wait4 (child, &status, 0, &usage) < 0 && errno == EINTR)
+    {
+    }
+  peak_kib = usage.ru_maxrss;
+
+  if (!got)
+    {
+      return std::unexpected (got.error ());
+    }
+  if (*got != sizeof result || !WIFEXITED (status)
+      || WEXITSTATUS (status) != 0)
+    {
+      note_failure (result, "crashed", WIFSIGNALED (status)
+                                           ? ::strsignal (WTERMSIG (status))
+                                           : "no result");
+    }
+  return result;
+}
+
+// whether the files at a and b hold the same bytes
+bool
+same_contents (const std::filesystem::path &a, const std::filesystem::path &b)
+{
+  const auto left = ftv::read (a);
+  const auto right = ftv::read (b);
+  return left && right && std::ranges::equal (*left, *right);
+}
+
+// every combination of the options, sizes outermost so that each input
+// is written once
+std::vector<bench_config>
+make_grid (const bench_options &options)
+{
+  std::vector<bench_config> grid{};
+  for (const auto size : options.sizes)
+    {
+      for (const auto &res : options.resolutions)
+        {
+          for (const auto fps : options.fps)
+            {
+              for (const auto format : options.layouts)
+                {
+                  for (const auto cipher : options.ciphers)
+                    {
+                      for (const auto &recode : options.transcodes)
+                        {
+                          grid.push_back (
+                              { size, res, fps, format, cipher, recode });
+                        }
+                    }
+                }
+            }
+        }
+    }
+  return grid;
+}
+
+// size random bytes, which do not compress, so every layout carries all of
+// them
+std::error_code
+write_input (const std::filesystem::path &path, std::size_t size)
+{
+  std::vector<std::byte> bytes (size);
+  std::mt19937_64 random{ size };
+  std::ranges::generate (
+      bytes, [&random] { return static_cast<std::byte> (random ()); });
+  return ftv::write (bytes, path);
+}
+
+void
+print_header (const bench_options &options)
+{
+  if (options.csv)
+    {
+      std::println ("size,width,height,fps,layout,cipher,transcode,"
+                    "encode_mbps,verify_mbps,decode_mbps,frames_per_mb,"
+                    "peak_rss_kib,bit_error_rate,round_trip,status");
+      return;
+    }
+  std::println ("{:>10} {:>9} {:>3} {:<10} {:<17} {:<9} {:>8} {:>8} {:>8} "
+                "{:>9} {:>8} {:>9} {}",
+                "size", "geometry", "fps", "layout", "cipher", "transcode",
+                "enc MB/s",
+                "ver MB/s", "dec MB/s", "frames/MB", "RSS MiB", "BER",
+                "result");
+}
+
+void
+print_row (const bench_options &options, const bench_config &config,
+           const bench_result &result, long peak_kib, bool round_trip)
+{
+  const double mb = static_cast<double> (config.size) / 1e6;
+  const auto rate = [mb] (double seconds) {
+    return seconds > 0 ? mb / seconds : 0.0;
+  };
+  const double frames_per_mb = static_cast<double> (result.frames) / mb;
+  const double ber = result.bits > 0
+                         ? static_cast<double> (result.bit_errors)
+                               / static_cast<double> (result.bits)
+                         : 0.0;
+  const std::string_view transcode_name
+      = config.recode ? std::string_view{ config.recode->name } : "none";
+  const std::string_view status{ result.status.data () };
+  const std::string_view verdict
+      = round_trip ? "ok" : (status.empty () ? "mismatch" : status);
+
+  if (options.csv)
+    {
+      std::println ("{},{},{},{},{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{},"
+                    "{:.3e},{},\"{}\"",
+                    config.size, config.res.x, config.res.y, config.fps,
+                    layout_name (config.format),
+                    ftv::cipher_name (config.cipher), transcode_name,
+                    rate (result.encode_seconds),
+                    rate (result.verify_seconds),
+                    rate (result.decode_seconds), frames_per_mb, peak_kib,
+                    ber, round_trip, status);
+      return;
+    }
+  std::println ("{:>10} {:>9} {:>3} {:<10} {:<17} {:<9} {:>8.1f} {:>8.1f} "
+                "{:>8.1f} {:>9.2f} {:>8.1f} {:>9.2e} {}",
+                config.size, std::format ("{}x{}", config.res.x, config.res.y),
+                config.fps, layout_name (config.format),
+                ftv::cipher_name (config.cipher), transcode_name,
+                rate (result.encode_seconds), rate (result.verify_seconds),
+                rate (result.decode_seconds), frames_per_mb,
+                static_cast<double> (peak_kib) / 1024.0, ber, verdict);
+}
+
+int
+main (int argc, char **argv)
+{
+  const auto options = parse_arguments (argc, argv);
+  if (!options)
+    {
+      return 1;
+    }
+
+  std::error_code ec{};
+  std::filesystem::create_directories (options->dir, ec);
+  if (ec)
+    {
+      std::println ("error creating {}: {}", options->dir.string (),
+                    ec.message ());
+      return 1;
+    }
+
+  print_header (*options);
+  std::size_t failures = 0;
+  const auto grid = make_grid (*options);
+  std::filesystem::path input{};
+  for (std::size_t run = 0; run < grid.size (); ++run)
+    {
+      const auto &config = grid[run];
+      if (run == 0 || config.size != grid[run - 1].size)
+        {
+          std::filesystem::remove (input, ec);
+          input = options->dir / std::format ("input_{}", config.size);
+          ec = write_input (input, config.size);
+          if (ec)
+            {
+              std::println ("error writing {}: {}", input.string (),
+                            ec.message ());
+              return 1;
+            }
+        }
+
+      const auto dir = options->dir / std::format ("config_{}", run);
+      std::filesystem::remove_all (dir, ec);
+      long peak_kib = 0;
+      const auto result = measure (config, input, dir, peak_kib);
+      if (!result)
+        {
+          std::println ("error running configuration: {}",
+                        result.error ().message ());
+          return 1;
+        }
+
+      const bool round_trip
+          = result->decoded && same_contents (input, dir / "output");
+      failures += round_trip ? 0 : 1;
+      print_row (*options, config, *result, peak_kib, round_trip);
+
+      if (!options->keep)
+        {
+          std::filesystem::remove_all (dir, ec);
+        }
+    }
+  std::filesystem::remove (input, ec);
+
+  // a failed round trip is a finding, not an error of the benchmark
+  if (failures > 0)
+    {
+      std::println ("{} of {} configurations did not round trip", failures,
+                    grid.size ());
+    }
+  return 0;
+}
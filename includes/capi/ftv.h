@@ -0,0 +1,109 @@
+#ifndef FTV_CAPI_FTV_H
+#define FTV_CAPI_FTV_H
+
+/* the c interface of libftv, for embedding ftv in other runtimes without
+ * the cli. data is pushed into an encoder and pulled out of a decoder in
+ * buffers the caller owns. videos are chunk stream videos, the same as
+ * ftv encrypt - writes, and decode with ftv decrypt.
+ *
+ * every function that can fail returns 0 or an errno value, strerror
+ * describes it. ECANCELED from a decoder means a wrong key or a tampered
+ * video. a handle is used by one thread at a time */
+
+#include <stddef.h>
+
+#if defined(FTV_BUILDING_LIBRARY)
+#define FTV_API __attribute__ ((visibility ("default")))
+#else
+#define FTV_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* incremented whenever a declaration here changes incompatibly */
+#define FTV_API_VERSION 1
+
+/* the FTV_API_VERSION the library was built with */
+FTV_API int ftv_api_version (void);
+
+enum ftv_cipher
+{
+  FTV_CIPHER_AES_256_GCM = 0,
+  FTV_CIPHER_CHACHA20_POLY1305 = 1
+};
+
+typedef struct ftv_encoder_options
+{
+  const char *filename; /* recorded in the video, "stream" if NULL */
+  size_t width;         /* 100 to 4096 */
+  size_t height;        /* 100 to 4096 */
+  size_t fps;           /* 1 to 60 */
+  int cipher;           /* an ftv_cipher */
+  /* every erasure_data_frames data frames are followed by
+   * erasure_parity_frames parity frames, 0 parity frames for none */
+  size_t erasure_data_frames;
+  size_t erasure_parity_frames;
+} ftv_encoder_options;
+
+/* fills options with the cli's defaults: 300x300 at 30 fps, aes-256-gcm
+ * and no parity frames */
+FTV_API void ftv_encoder_options_init (ftv_encoder_options *options);
+
+typedef struct ftv_encoder ftv_encoder;
+
+/* starts a video at path, which must not exist yet, sealed with key (at
+ * most 32 bytes, nul terminated). options may be NULL for the defaults */
+FTV_API int ftv_encoder_open (const char *path, const char *key,
+                              const ftv_encoder_options *options,
+                              ftv_encoder **encoder);
+
+/* the same, writing an avi without seeking to fd, a pipe or socket. fd
+ * stays open and the caller's */
+FTV_API int ftv_encoder_open_fd (int fd, const char *key,
+                                 const ftv_encoder_options *options,
+                                 ftv_encoder **encoder);
+
+/* encodes size bytes of data and returns once the encoder is done with
+ * them, data can be reused right away. pushes of a megabyte or more are
+ * read straight from data, smaller ones are gathered first */
+FTV_API int ftv_encoder_push (ftv_encoder *encoder, const void *data,
+                              size_t size);
+
+/* ends the stream, writes the rest of the video and frees encoder. the
+ * video is complete once this returned 0, a video at a path that failed
+ * is removed */
+FTV_API int ftv_encoder_finish (ftv_encoder *encoder);
+
+/* frees encoder without ending the stream. a video at a path is removed */
+FTV_API void ftv_encoder_abort (ftv_encoder *encoder);
+
+typedef struct ftv_decoder ftv_decoder;
+
+/* opens the video at path with key and decodes up to its first data */
+FTV_API int ftv_decoder_open (const char *path, const char *key,
+                              ftv_decoder **decoder);
+
+/* the same, reading an avi front to back from fd, a pipe or socket. fd
+ * stays open and the caller's */
+FTV_API int ftv_decoder_open_fd (int fd, const char *key,
+                                 ftv_decoder **decoder);
+
+/* the filename recorded in the video, valid until the decoder is closed */
+FTV_API const char *ftv_decoder_filename (const ftv_decoder *decoder);
+
+/* fills buffer with up to capacity bytes of plaintext and stores how many
+ * in size. fewer than capacity only at the end, 0 once everything was
+ * pulled and checked against the digest at the end of the stream */
+FTV_API int ftv_decoder_pull (ftv_decoder *decoder, void *buffer,
+                              size_t capacity, size_t *size);
+
+FTV_API void ftv_decoder_close (ftv_decoder *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FTV_CAPI_FTV_H */
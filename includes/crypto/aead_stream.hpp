@@ -0,0 +1,55 @@
+#pragma once
+
+#include "crypto/cipher.hpp"
+#include "crypto/cipher_pool.hpp"
+#include "crypto/secure_key.hpp"
+
+#include <cstddef>
+#include <expected>
+#include <span>
+#include <system_error>
+
+namespace ftv
+{
+
+// one aead message processed in parts, so it can be fed chunk by chunk
+// while i/o for the next chunks is in flight. runs on the calling thread's
+// cached context, so a thread can only have one stream per cipher and
+// direction at a time
+class aead_stream
+{
+public:
+  // starts encrypting, init_vec (12 bytes) receives a fresh random iv
+  [[nodiscard]] static std::expected<aead_stream, std::error_code>
+  seal (const secure_key &key, std::span<std::byte> init_vec,
+        cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
+  // starts decrypting a message that has to authenticate against tag
+  [[nodiscard]] static std::expected<aead_stream, std::error_code>
+  open (const secure_key &key, std::span<const std::byte> init_vec,
+        std::span<const std::byte> tag,
+        cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
+  // authenticates data without encrypting it. only valid before the first
+  // update
+  [[nodiscard]] std::error_code
+  additional_data (std::span<const std::byte> data) noexcept;
+
+  // processes the next part of the message. out has the size of in and may
+  // be the same memory
+  [[nodiscard]] std::error_code update (std::span<const std::byte> in,
+                                        std::span<std::byte> out) noexcept;
+
+  // when sealing, writes the 16 byte tag. when opening, verifies the tag
+  // given to open and tag is ignored
+  [[nodiscard]] std::error_code
+  finish (std::span<std::byte> tag = {}) noexcept;
+
+private:
+  aead_stream (EVP_CIPHER_CTX *ctx, cipher_direction direction);
+
+  EVP_CIPHER_CTX *ctx_;
+  cipher_direction direction_;
+};
+
+} // namespace ftv
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+
+namespace ftv
+{
+
+// blake3, a tree hash. the input is cut into chunks of BLAKE3_CHUNK_SIZE
+// bytes whose chaining values are merged pairwise up to the root, so
+// subtrees that do not depend on each other are hashed on several threads
+// and BLAKE3_LANES chunks at a time, lane by lane in a layout the compiler
+// vectorizes
+inline constexpr std::size_t BLAKE3_CHUNK_SIZE{ 1024 };
+inline constexpr std::size_t BLAKE3_LANES{ 8 };
+
+using blake3_digest = std::array<std::byte, 32>;
+
+// hashes an input that arrives in pieces. large pieces are split into
+// whole subtrees that are hashed on up to threads threads
+class blake3_hasher
+{
+public:
+  explicit blake3_hasher (std::size_t threads = 1) noexcept;
+
+  void update (std::span<const std::byte> data);
+
+  // for an input whose first chunk is only known at the end. called before
+  // update, which then starts with the second chunk, and first_chunk
+  // supplies the first before digest. the subtrees to the right of it wait
+  // on the stack, one per level
+  void defer_first_chunk () noexcept;
+
+  // the first BLAKE3_CHUNK_SIZE bytes of the input after defer_first_chunk
+  void first_chunk (std::span<const std::byte> chunk) noexcept;
+
+  // of everything so far, more can follow. not while the first chunk is
+  // deferred
+  [[nodiscard]] blake3_digest digest () const noexcept;
+
+  using words = std::array<std::uint32_t, 8>;
+
+private:
+  // pushes the chaining value of the subtree whose first chunk is chunk,
+  // after merging the subtrees it completes
+  void push (const words &cv, std::uint64_t chunk) noexcept;
+  // merges subtrees until the stack holds one per set bit of chunks
+  void merge (std::uint64_t chunks) noexcept;
+
+  std::size_t threads_;
+  // the chunk being filled
+  words cv_{};
+  std::uint64_t chunk_{};
+  std::array<std::byte, 64> block_{};
+  std::size_t block_size_{};
+  std::size_t blocks_{}; // compressed into cv_ so far
+  // chaining values of the complete subtrees left of the current chunk,
+  // one per set bit of the chunk count at most, plus the two halves of a
+  // subtree that may still become the root. a deferred first chunk keeps
+  // its place at the bottom, the subtree it starts as one entry per level
+  std::array<words, 130> stack_{};
+  std::size_t stack_size_{};
+  bool deferred_{ false };
+};
+
+// the blake3 of data, on threads threads
+[[nodiscard]] blake3_digest
+blake3 (std::span<const std::byte> data,
+        std::size_t threads = std::thread::hardware_concurrency ());
+
+} // namespace ftv
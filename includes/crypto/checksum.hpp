@@ -1,11 +1,20 @@
 #pragma once
 
+#include "crypto/blake3.hpp"
+
 #include <cstddef>
 #include <span>
 
 namespace ftv
 {
 
-[[nodiscard]] std::size_t hash (std::span<const std::byte> data);
+// the checksum metadata carries: the whole 32 byte blake3 root of data. it
+// finds damage, the aead tag is what authenticates the payload. hashed on
+// every core
+[[nodiscard]] blake3_digest hash (std::span<const std::byte> data);
+
+// whether checksum is the hash of data
+[[nodiscard]] bool checksum_matches (std::span<const std::byte> data,
+                                     const blake3_digest &checksum);
 
 } // namespace ftv
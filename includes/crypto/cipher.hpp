@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <string_view>
+#include <system_error>
+
+namespace ftv
+{
+
+// the aead a payload is sealed with. both take a 32 byte key and a 12 byte
+// iv and give a 16 byte tag, so they share the serialized layout and the
+// chunk record format. the value is stored in metadata
+enum class cipher_id : std::uint8_t
+{
+  aes_256_gcm = 0,
+  chacha20_poly1305 = 1,
+};
+
+[[nodiscard]] bool known_cipher (cipher_id cipher) noexcept;
+
+// the name openssl fetches the cipher by
+[[nodiscard]] std::string_view cipher_algorithm (cipher_id cipher) noexcept;
+
+// the name the command line spells the cipher with
+[[nodiscard]] std::string_view cipher_name (cipher_id cipher) noexcept;
+
+// the cipher name stands for, "auto" is fastest_cipher ()
+[[nodiscard]] std::expected<cipher_id, std::error_code>
+parse_cipher (std::string_view name) noexcept;
+
+// the cipher that seals fastest on this host. aes wins where the cpu has
+// instructions for it, chacha20 everywhere else. the first call times both
+// on a small buffer, later calls return its answer
+[[nodiscard]] cipher_id fastest_cipher () noexcept;
+
+} // namespace ftv
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "crypto/evp_cipher_raii.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <openssl/evp.h>
+
+namespace ftv
+{
+
+enum class cipher_direction
+{
+  encrypt,
+  decrypt
+};
+
+// long lived cipher context. the algorithm is fetched once and the expanded
+// key schedule is kept between messages, so encrypting another message under
+// the same key only costs an iv reset
+class cipher_context
+{
+public:
+  cipher_context (std::string_view algorithm, cipher_direction direction);
+
+  cipher_context (const cipher_context &) = delete;
+  cipher_context &operator= (const cipher_context &) = delete;
+
+  cipher_context (cipher_context &&) noexcept = default;
+  cipher_context &operator= (cipher_context &&) noexcept = default;
+
+  ~cipher_context ();
+
+  // readies the context for a new message under key and init_vec. returns
+  // nullptr if openssl rejects the parameters
+  [[nodiscard]] EVP_CIPHER_CTX *
+  prepare (std::span<const std::byte> key,
+           std::span<const std::byte> init_vec) noexcept;
+
+  [[nodiscard]] std::string_view algorithm () const noexcept;
+  [[nodiscard]] cipher_direction direction () const noexcept;
+
+private:
+  void forget_key () noexcept;
+
+  std::unique_ptr<EVP_CIPHER, decltype (&EVP_CIPHER_free)> cipher_;
+  evp_cipher ctx_{};
+  std::string algorithm_{};
+  cipher_direction direction_{};
+  std::array<std::byte, EVP_MAX_KEY_LENGTH> key_{}; // key of the schedule
+  std::size_t key_size_{ 0 };                       // 0 = no key loaded
+};
+
+// contexts cached per thread, one for each algorithm and direction. returns
+// nullptr if the algorithm is not available
+[[nodiscard]] cipher_context *
+thread_cipher_context (std::string_view algorithm,
+                       cipher_direction direction) noexcept;
+
+} // namespace ftv
@@ -10,9 +10,35 @@ namespace ftv
 using decryption_func = std::function<std::expected<file, std::error_code> (
     const encrypted_data &data, const secure_key &key)>;
 
+// decrypts ciphertext into plaintext, which has the same size and may be the
+// same memory, and verifies tag
+[[nodiscard]] std::error_code
+aead_open (std::span<const std::byte> ciphertext,
+           std::span<std::byte> plaintext,
+           std::span<const std::byte> init_vec,
+           std::span<const std::byte> tag, const secure_key &key,
+           cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
 std::expected<file, std::error_code>
 aes_256_gcm_decrypt (const encrypted_data &encrypted, const secure_key &key);
 
+std::expected<file, std::error_code>
+chacha20_poly1305_decrypt (const encrypted_data &encrypted,
+                           const secure_key &key);
+
+// decrypts encrypted in its own storage. the returned span views the
+// plaintext, which replaced the ciphertext inside encrypted
+[[nodiscard]] std::expected<std::span<const std::byte>, std::error_code>
+decrypt_in_place (encrypted_data &encrypted, const secure_key &key,
+                  cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
+// decrypts encrypted in place and writes the plaintext to path, which must
+// not exist yet. the output is removed again if authentication fails
+[[nodiscard]] std::error_code
+decrypt_to_file (encrypted_data &encrypted, const secure_key &key,
+                 const std::filesystem::path &path,
+                 cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
 [[nodiscard]] std::expected<file, std::error_code>
 decrypt (const encrypted_data &data, const secure_key &key,
          decryption_func fn = aes_256_gcm_decrypt) noexcept;
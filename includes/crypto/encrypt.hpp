@@ -1,11 +1,14 @@
 #pragma once
 
+#include "crypto/blake3.hpp"
+#include "crypto/cipher.hpp"
 #include "crypto/encrypted_data.hpp"
 #include "crypto/secure_key.hpp"
 #include "file/file.hpp"
 
 #include <expected>
 #include <functional>
+#include <memory_resource>
 
 namespace ftv
 {
@@ -14,9 +17,38 @@ using encryption_func
     = std::function<std::expected<encrypted_data, std::error_code> (
         std::span<const std::byte> data, const secure_key &key)>;
 
+// encrypts data into ciphertext, which has the same size and may be the same
+// memory. init_vec (12 bytes) receives a fresh random iv and tag (16 bytes)
+// the authentication tag
+[[nodiscard]] std::error_code
+aead_seal (std::span<const std::byte> data, std::span<std::byte> ciphertext,
+           std::span<std::byte> init_vec, std::span<std::byte> tag,
+           const secure_key &key,
+           cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
 std::expected<encrypted_data, std::error_code>
 aes_256_gcm (std::span<const std::byte> data, const secure_key &key) noexcept;
 
+std::expected<encrypted_data, std::error_code>
+chacha20_poly1305 (std::span<const std::byte> data,
+                   const secure_key &key) noexcept;
+
+// encrypts the file at path while it is being read, without holding a
+// separate plaintext copy. the result is allocated from resource. checksum,
+// if given, receives the checksum of the serialized result (see
+// crypto/checksum.hpp), hashed as the chunks are encrypted
+std::expected<encrypted_data, std::error_code>
+encrypt_file (const std::filesystem::path &path, const secure_key &key,
+              cipher_id cipher = cipher_id::aes_256_gcm,
+              std::pmr::memory_resource *resource
+              = std::pmr::get_default_resource (),
+              blake3_digest *checksum = nullptr) noexcept;
+
+// encrypts data in place, the result takes over its buffer
+std::expected<encrypted_data, std::error_code>
+encrypt_in_place (std::pmr::vector<std::byte> &&data, const secure_key &key,
+                  cipher_id cipher = cipher_id::aes_256_gcm) noexcept;
+
 [[nodiscard]] std::expected<encrypted_data, std::error_code>
 encrypt (const file &source, const secure_key &key,
          encryption_func fn = aes_256_gcm) noexcept;
@@ -4,35 +4,81 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <memory_resource>
+#include <span>
 #include <system_error>
 #include <vector>
 
 namespace ftv
 {
 
+// ciphertext, iv and tag are views. they either point into storage owned by
+// the object or, for borrowed data, into a caller buffer that has to outlive
+// it. owned storage is kept when moving, so moves never copy the payload,
+// unless a move assignment crosses memory resources
 class encrypted_data
 {
 public:
-  explicit encrypted_data (const std::filesystem::path &path);
+  // the contents are allocated from resource
+  explicit encrypted_data (const std::filesystem::path &path,
+                           std::pmr::memory_resource *resource
+                           = std::pmr::get_default_resource ());
 
-  encrypted_data (std::vector<std::byte> ciphertext,
-                  std::vector<std::byte> init_vec, std::vector<std::byte> tag);
+  // takes over ciphertext, iv and tag are copied next to it
+  encrypted_data (std::pmr::vector<std::byte> ciphertext,
+                  std::span<const std::byte> init_vec,
+                  std::span<const std::byte> tag);
+
+  // takes ownership of storage, the three parts must be views into it.
+  // serialized, if not empty, is the whole storage in serialized layout
+  encrypted_data (std::pmr::vector<std::byte> storage,
+                  std::span<const std::byte> ciphertext,
+                  std::span<const std::byte> init_vec,
+                  std::span<const std::byte> tag,
+                  std::span<const std::byte> serialized = {});
+
+  encrypted_data (const encrypted_data &other);
+  encrypted_data &operator= (const encrypted_data &other);
+
+  encrypted_data (encrypted_data &&) noexcept = default;
+  encrypted_data &operator= (encrypted_data &&other);
+
+  ~encrypted_data () = default;
+
+  // borrows the parts without copying
+  [[nodiscard]] static encrypted_data
+  view (std::span<const std::byte> ciphertext,
+        std::span<const std::byte> init_vec, std::span<const std::byte> tag,
+        std::span<const std::byte> serialized = {}) noexcept;
 
   [[nodiscard]] std::expected<file, std::error_code>
   to_file (const std::filesystem::path &path
            = std::filesystem::temp_directory_path ()
              / "encrypted_file") const noexcept;
 
-  [[nodiscard]] const std::vector<std::byte> &ciphertext () const noexcept;
-  [[nodiscard]] const std::vector<std::byte> &init_vec () const noexcept;
-  [[nodiscard]] const std::vector<std::byte> &tag () const noexcept;
+  [[nodiscard]] std::span<const std::byte> ciphertext () const noexcept;
+  [[nodiscard]] std::span<const std::byte> init_vec () const noexcept;
+  [[nodiscard]] std::span<const std::byte> tag () const noexcept;
+
+  // writable ciphertext for in place decryption. empty if the ciphertext is
+  // borrowed
+  [[nodiscard]] std::span<std::byte> mutable_ciphertext () noexcept;
+
+  // the whole object in serialized layout if it is stored that way, empty
+  // otherwise
+  [[nodiscard]] std::span<const std::byte> serialized () const noexcept;
 
   std::error_code save (const std::filesystem::path &path) const noexcept;
 
 private:
-  std::vector<std::byte> ciphertext_{};
-  std::vector<std::byte> init_vec_{}; // generated during encryption
-  std::vector<std::byte> tag_{};      // generated during encryption
+  encrypted_data () = default;
+
+  std::pmr::vector<std::byte> storage_{}; // owned payload, if any
+  std::pmr::vector<std::byte> params_{};  // owned iv followed by tag
+  std::span<const std::byte> ciphertext_{};
+  std::span<const std::byte> init_vec_{}; // generated during encryption
+  std::span<const std::byte> tag_{};      // generated during encryption
+  std::span<const std::byte> serialized_{};
 };
 
 } // namespace ftv
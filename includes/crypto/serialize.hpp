@@ -1,7 +1,10 @@
+#pragma once
+
 #include "crypto/encrypted_data.hpp"
 
 #include <cstddef>
 #include <expected>
+#include <memory_resource>
 #include <span>
 #include <system_error>
 #include <vector>
@@ -12,11 +15,87 @@ namespace ftv
 // serialized encrypted data:
 // [iv size (4 bytes)][iv data][tag size (4 bytes)][tag data][ciphertext]
 
-[[nodiscard]] std::expected<std::vector<std::byte>, std::error_code>
-serialize_encrypted_data (const encrypted_data &data) noexcept;
+// byte offsets of the fields inside a serialized buffer
+struct serialized_layout
+{
+  std::size_t init_vec_offset{};
+  std::size_t tag_offset{};
+  std::size_t ciphertext_offset{};
+};
+
+[[nodiscard]] constexpr serialized_layout
+make_serialized_layout (std::size_t iv_size, std::size_t tag_size) noexcept
+{
+  return { 4, 4 + iv_size + 4, 4 + iv_size + 4 + tag_size };
+}
+
+// serialized form as a gather list. segments view the encrypted_data they
+// were built from, which has to outlive this object, plus a small owned
+// header when the data is not already stored in serialized layout
+class serialized_data
+{
+public:
+  serialized_data () = default;
+
+  explicit serialized_data (std::pmr::memory_resource *resource);
+
+  serialized_data (const serialized_data &) = delete;
+  serialized_data &operator= (const serialized_data &) = delete;
+
+  serialized_data (serialized_data &&) noexcept = default;
+  serialized_data &operator= (serialized_data &&) noexcept = default;
+
+  ~serialized_data () = default;
+
+  [[nodiscard]] std::span<const std::span<const std::byte>>
+  segments () const noexcept;
 
+  [[nodiscard]] std::size_t size () const noexcept;
+
+  // gathers the segments into one buffer
+  [[nodiscard]] std::pmr::vector<std::byte>
+  to_vec (std::pmr::memory_resource *resource
+          = std::pmr::get_default_resource ()) const;
+
+private:
+  friend std::expected<serialized_data, std::error_code>
+  serialize_encrypted_data (const encrypted_data &data,
+                            std::pmr::memory_resource *resource) noexcept;
+
+  std::pmr::vector<std::byte> header_{};
+  std::pmr::vector<std::span<const std::byte>> segments_{};
+};
+
+// the header and gather list are allocated from resource
+[[nodiscard]] std::expected<serialized_data, std::error_code>
+serialize_encrypted_data (const encrypted_data &data,
+                          std::pmr::memory_resource *resource
+                          = std::pmr::get_default_resource ()) noexcept;
+
+// allocates a buffer in serialized layout with the size fields filled in,
+// for producers that write iv, tag and ciphertext in place
+[[nodiscard]] std::pmr::vector<std::byte>
+make_serialized_buffer (std::size_t iv_size, std::size_t tag_size,
+                        std::size_t ciphertext_size,
+                        std::pmr::memory_resource *resource
+                        = std::pmr::get_default_resource ());
+
+// copies serialized_data into storage allocated from resource and owned by
+// the result
 [[nodiscard]]
 std::expected<encrypted_data, std::error_code> deserialize_encrypted_data (
-    std::span<const std::byte> serialized_data) noexcept;
+    std::span<const std::byte> serialized_data,
+    std::pmr::memory_resource *resource
+    = std::pmr::get_default_resource ()) noexcept;
+
+// takes ownership of serialized_data without copying
+[[nodiscard]]
+std::expected<encrypted_data, std::error_code> deserialize_encrypted_data (
+    std::pmr::vector<std::byte> &&serialized_data) noexcept;
+
+// borrows serialized_data, which has to outlive the result
+[[nodiscard]]
+std::expected<encrypted_data, std::error_code>
+view_encrypted_data (std::span<const std::byte> serialized_data) noexcept;
 
 } // namespace ftv
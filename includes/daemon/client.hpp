@@ -0,0 +1,55 @@
+#pragma once
+
+#include "daemon/protocol.hpp"
+
+#include <expected>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace ftv
+{
+
+// the answer to one request: the job lines of a status listing, and the
+// ok or error line that ends every answer
+struct reply
+{
+  std::vector<message> jobs{};
+  message result{};
+
+  [[nodiscard]] bool
+  ok () const noexcept
+  {
+    return this->result.verb == "ok";
+  }
+};
+
+// a connection to ftv serve, requests are answered in order
+class daemon_client
+{
+public:
+  // connects to the server listening at socket
+  [[nodiscard]] static std::expected<daemon_client, std::error_code>
+  connect (const std::filesystem::path &socket) noexcept;
+
+  daemon_client (const daemon_client &) = delete;
+  daemon_client &operator= (const daemon_client &) = delete;
+
+  daemon_client (daemon_client &&other) noexcept;
+  daemon_client &operator= (daemon_client &&other) noexcept;
+
+  ~daemon_client ();
+
+  // sends request and reads its answer. a wait returns once the job is
+  // finished
+  [[nodiscard]] std::expected<reply, std::error_code>
+  call (const message &request);
+
+private:
+  explicit daemon_client (int fd) noexcept;
+
+  int fd_{ -1 };
+  line_reader reader_;
+};
+
+} // namespace ftv
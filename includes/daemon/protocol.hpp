@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace ftv
+{
+
+// ftv serve and its clients talk in lines of tab separated fields over a
+// unix socket. a request is a verb followed by name=value fields:
+//
+//   encode  input= output= key= [cwd= priority= width= height= fps=
+//           cipher= erasure=<d>:<p> dedup=1]
+//   decode  input= key= [output= cwd= priority=]
+//   status  [id=]
+//   wait    id=
+//   shutdown
+//
+// every request is answered with an ok or an error line, status first
+// sends one job line per job. tabs, newlines and backslashes in values are
+// escaped with a backslash
+//
+// nothing is authenticated or encrypted: keys travel in the clear and
+// relative paths are opened in the client's absolute cwd as the server's
+// user. that is safe only because the socket is owner only, a server
+// listening where other users can connect would hand them both
+inline constexpr std::size_t PROTOCOL_MAX_LINE{ std::size_t{ 64 } << 10 };
+
+struct message
+{
+  std::string verb{};
+  std::map<std::string, std::string, std::less<>> fields{};
+
+  // the value of the field name, nullopt if there is none
+  [[nodiscard]] std::optional<std::string>
+  field (std::string_view name) const;
+};
+
+// one line without its newline
+[[nodiscard]] std::string format_message (const message &msg);
+
+// invalid_argument for an empty line or a field without =
+[[nodiscard]] std::expected<message, std::error_code>
+parse_message (std::string_view line);
+
+// reads the lines of a socket one at a time
+class line_reader
+{
+public:
+  explicit line_reader (int fd) noexcept;
+
+  // the next line without its newline. message_size for a line longer than
+  // PROTOCOL_MAX_LINE, connection_aborted once the peer closed
+  [[nodiscard]] std::expected<std::string, std::error_code> next ();
+
+private:
+  int fd_{ -1 };
+  std::string buffer_{}; // read past the last line
+};
+
+// writes line and a newline to fd, all of it or an error
+[[nodiscard]] std::error_code write_line (int fd,
+                                          std::string_view line) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "daemon/protocol.hpp"
+#include "pipeline/executor.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace ftv
+{
+
+// finished jobs a server remembers for status queries, older ones are
+// forgotten
+inline constexpr std::size_t SERVER_JOB_HISTORY{ 1024 };
+
+// $XDG_RUNTIME_DIR/ftv.sock, or one in the temporary directory named after
+// the user
+[[nodiscard]] std::filesystem::path default_socket_path ();
+
+struct server_options
+{
+  std::filesystem::path socket{ default_socket_path () };
+  std::size_t threads{ std::thread::hardware_concurrency () };
+};
+
+enum class job_state
+{
+  queued,
+  running,
+  done,
+  failed
+};
+
+[[nodiscard]] std::string_view job_state_name (job_state state) noexcept;
+
+// what a server knows about one of its jobs
+struct job_status
+{
+  std::uint64_t id{};
+  std::string kind{}; // encode or decode
+  std::filesystem::path input{};
+  std::filesystem::path output{};
+  int priority{};
+  job_state state{ job_state::queued };
+  std::size_t progress{}; // frames written by an encode, bytes by a decode
+  std::error_code error{};
+};
+
+// the ftv daemon. jobs that arrive over a unix socket (see protocol.hpp)
+// run as chunk stream pipelines on one executor whose workers live as long
+// as the server, so their per thread cipher contexts stay keyed and warm
+// from one job to the next. higher priorities take every step they can,
+// equal ones share the workers round robin. the socket is created
+// accessible to its owner only, which is what makes the clear text keys and
+// client named paths of requests safe
+class server
+{
+public:
+  explicit server (server_options options = {});
+
+  server (const server &) = delete;
+  server &operator= (const server &) = delete;
+
+  // stops and waits for every job
+  ~server ();
+
+  // listens on the socket until stop, then waits for the jobs it accepted
+  // and removes the socket again. address_in_use if another server answers
+  // there, a socket nobody answers on is replaced
+  [[nodiscard]] std::error_code run () noexcept;
+
+  // makes run return, from any thread
+  void stop () noexcept;
+
+private:
+  struct connection;
+
+  void serve (connection &client) noexcept;
+  [[nodiscard]] message handle (const message &request, int fd);
+  [[nodiscard]] message submit (const message &request, bool encode);
+  [[nodiscard]] message status (const message &request, int fd);
+  [[nodiscard]] message wait (const message &request);
+
+  void finished (std::uint64_t id, std::error_code ec) noexcept;
+  void progressed (std::uint64_t id, std::size_t units) noexcept;
+  void reap () noexcept;
+
+  server_options options_;
+  pipeline_executor executor_;
+
+  std::mutex mutex_{};
+  std::condition_variable changed_{};
+  std::map<std::uint64_t, job_status> jobs_{};
+  std::deque<std::uint64_t> finished_{}; // oldest first
+  std::uint64_t next_id_{ 1 };
+  bool stopping_{ false };
+  int listener_{ -1 };
+  std::vector<std::unique_ptr<connection>> connections_{};
+};
+
+} // namespace ftv
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace ftv
+{
+
+// default shape of streamed file i/o: chunks of ASYNC_CHUNK_SIZE bytes with
+// up to ASYNC_QUEUE_DEPTH of them in flight
+inline constexpr std::size_t ASYNC_CHUNK_SIZE{ std::size_t{ 4 } << 20 };
+inline constexpr std::size_t ASYNC_QUEUE_DEPTH{ 8 };
+
+enum class io_mode
+{
+  read,
+  write, // creates or truncates
+  update // writes into the existing contents, for resumed output
+};
+
+struct io_completion
+{
+  std::uint64_t tag{};   // as given on submission
+  std::size_t bytes{};   // transferred, short only at end of file
+  std::error_code error{};
+};
+
+// positional reads or writes on one file with several requests in flight.
+// uses io_uring when the kernel allows it and falls back to blocking
+// pread/pwrite otherwise, in which case a request completes on submission
+class async_file
+{
+public:
+  async_file (const std::filesystem::path &path, io_mode mode,
+              std::size_t queue_depth = ASYNC_QUEUE_DEPTH);
+
+  async_file (const async_file &) = delete;
+  async_file &operator= (const async_file &) = delete;
+
+  async_file (async_file &&other) noexcept;
+  async_file &operator= (async_file &&other) noexcept;
+
+  ~async_file ();
+
+  [[nodiscard]] bool uses_uring () const noexcept;
+  [[nodiscard]] std::size_t in_flight () const noexcept;
+  [[nodiscard]] std::size_t queue_depth () const noexcept;
+
+  // pins buffers in the kernel so requests inside them skip the per request
+  // page mapping. optional, requests outside them still work
+  std::error_code
+  register_buffers (std::span<const std::span<std::byte>> buffers) noexcept;
+
+  // requests are retried internally until complete, the buffer has to stay
+  // alive until its completion was returned by wait
+  [[nodiscard]] std::error_code submit_read (std::span<std::byte> buffer,
+                                             std::uint64_t offset,
+                                             std::uint64_t tag) noexcept;
+  [[nodiscard]] std::error_code
+  submit_write (std::span<const std::byte> buffer, std::uint64_t offset,
+                std::uint64_t tag) noexcept;
+
+  // blocks until the next request completes
+  [[nodiscard]] std::expected<io_completion, std::error_code> wait () noexcept;
+
+  // truncates or extends the file, for writers that know the final size
+  std::error_code resize (std::uint64_t size) noexcept;
+
+  // flushes completed writes to the disk
+  std::error_code sync () noexcept;
+
+private:
+  struct uring;
+  struct request
+  {
+    std::byte *data{};
+    std::size_t size{};
+    std::size_t done{};
+    std::uint64_t offset{};
+    std::uint64_t tag{};
+    bool active{};
+  };
+
+  [[nodiscard]] std::error_code submit (std::byte *data, std::size_t size,
+                                        std::uint64_t offset,
+                                        std::uint64_t tag) noexcept;
+  [[nodiscard]] std::error_code enqueue (std::size_t slot) noexcept;
+  void close () noexcept;
+
+  int fd_{ -1 };
+  io_mode mode_{};
+  std::unique_ptr<uring> uring_{};
+  std::vector<request> requests_{};
+  std::deque<io_completion> ready_{}; // blocking fallback completions
+  std::size_t in_flight_{ 0 };
+};
+
+} // namespace ftv
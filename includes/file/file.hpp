@@ -3,6 +3,9 @@
 #include <cstddef>
 #include <expected>
 #include <filesystem>
+#include <functional>
+#include <memory_resource>
+#include <span>
 #include <system_error>
 #include <vector>
 
@@ -12,16 +15,19 @@ namespace ftv
 class file
 {
 public:
-  explicit file (const std::filesystem::path &path);
-  file (const std::filesystem::path &path, std::vector<std::byte> data);
+  // the contents are allocated from resource
+  explicit file (const std::filesystem::path &path,
+                 std::pmr::memory_resource *resource
+                 = std::pmr::get_default_resource ());
+  file (const std::filesystem::path &path, std::pmr::vector<std::byte> data);
 
   [[nodiscard]] const std::filesystem::path &path () const noexcept;
-  [[nodiscard]] const std::vector<std::byte> &data () const noexcept;
+  [[nodiscard]] const std::pmr::vector<std::byte> &data () const noexcept;
   [[nodiscard]] std::size_t size () const noexcept;
 
 private:
   std::filesystem::path path_;
-  std::vector<std::byte> data_{};
+  std::pmr::vector<std::byte> data_{};
 };
 
 [[nodiscard]] std::error_code write (const file &f,
@@ -32,7 +38,46 @@ private:
 
 [[nodiscard]] std::error_code write (const file &f);
 
-[[nodiscard]] std::expected<std::vector<std::byte>, std::error_code>
-read (const std::filesystem::path &path) noexcept;
+[[nodiscard]] std::expected<std::pmr::vector<std::byte>, std::error_code>
+read (const std::filesystem::path &path,
+      std::pmr::memory_resource *resource
+      = std::pmr::get_default_resource ()) noexcept;
+
+// called once per chunk of streamed i/o, in file order. a non zero result
+// aborts the transfer
+using chunk_callback = std::function<std::error_code (std::span<std::byte>)>;
+
+// reads the first buffer.size () bytes of path into buffer with several
+// chunks in flight. on_chunk sees each chunk as soon as it and all chunks
+// before it landed, so it overlaps with the reads still pending
+[[nodiscard]] std::error_code
+read_into (const std::filesystem::path &path, std::span<std::byte> buffer,
+           const chunk_callback &on_chunk = {}) noexcept;
+
+// writes buffer to path (replacing it) with several chunks in flight.
+// before_write runs on each chunk right before it is submitted, so it can
+// transform the chunk in place while earlier chunks are being written
+[[nodiscard]] std::error_code
+write_from (std::span<std::byte> buffer, const std::filesystem::path &path,
+            const chunk_callback &before_write = {}) noexcept;
+
+// flushes a file written by someone else, such as a video writer, to the
+// disk
+[[nodiscard]] std::error_code
+sync_file (const std::filesystem::path &path) noexcept;
+
+// reads from fd, a pipe or terminal that can not seek, until buffer is
+// full or the stream ends. returns how much it read
+[[nodiscard]] std::expected<std::size_t, std::error_code>
+read_stream (int fd, std::span<std::byte> buffer) noexcept;
+
+// writes all of data to fd, a pipe or terminal that can not seek
+[[nodiscard]] std::error_code
+write_stream (int fd, std::span<const std::byte> data) noexcept;
+
+// writes the concatenation of segments to path, replacing it
+[[nodiscard]] std::error_code
+write_segments (std::span<const std::span<const std::byte>> segments,
+                const std::filesystem::path &path) noexcept;
 
 } // namsepace ftv
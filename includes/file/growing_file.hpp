@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <system_error>
+
+namespace ftv
+{
+
+// a file that one thread fills front to back while others already read
+// the part that is there. readers block until the bytes they want arrived
+// or the writer stopped
+class growing_file
+{
+public:
+  growing_file () = default;
+
+  growing_file (const growing_file &) = delete;
+  growing_file &operator= (const growing_file &) = delete;
+
+  // writer side: the first prefix bytes are on disk
+  void advance (std::uint64_t prefix) noexcept;
+  // writer side: no more bytes come, ec says why if the file is incomplete
+  void finish (std::error_code ec = {}) noexcept;
+  // writer side: whether a reader asked the writer to stop
+  [[nodiscard]] bool cancelled () const noexcept;
+
+  // blocks until the first end bytes are there. false if the file was
+  // finished shorter, the writer's error if it stopped early
+  [[nodiscard]] std::expected<bool, std::error_code>
+  wait_for (std::uint64_t end) const noexcept;
+  // asks the writer to stop, for a reader that needs no more bytes
+  void cancel () noexcept;
+
+private:
+  mutable std::mutex mutex_{};
+  mutable std::condition_variable changed_{};
+  std::uint64_t prefix_{};
+  bool finished_{};
+  bool cancelled_{};
+  std::error_code error_{};
+};
+
+} // namespace ftv
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace ftv
+{
+
+// size of the first block an arena maps, later blocks grow geometrically
+inline constexpr std::size_t JOB_ARENA_BLOCK{ std::size_t{ 2 } << 20 };
+
+enum class arena_pages
+{
+  normal,
+  huge // explicit huge pages if reserved, transparent ones otherwise
+};
+
+// memory for everything one encode or decode job allocates. allocations
+// are bumped out of large mapped blocks and never freed one by one, the
+// blocks go back to the system all at once when the arena is destroyed.
+// not thread safe, use one arena per job
+class job_arena
+{
+public:
+  explicit job_arena (std::size_t initial_size = JOB_ARENA_BLOCK,
+                      arena_pages pages = arena_pages::normal);
+
+  job_arena (const job_arena &) = delete;
+  job_arena &operator= (const job_arena &) = delete;
+
+  ~job_arena () = default;
+
+  [[nodiscard]] std::pmr::memory_resource *resource () noexcept;
+
+  // bytes currently mapped for this arena
+  [[nodiscard]] std::size_t mapped () const noexcept;
+
+  // frees every allocation at once, the arena can be reused afterwards
+  void release () noexcept;
+
+private:
+  // hands out whole blocks with mmap, so released blocks leave the process
+  // instead of staying in the malloc heap
+  class mapped_resource final : public std::pmr::memory_resource
+  {
+  public:
+    explicit mapped_resource (arena_pages pages) noexcept;
+
+    [[nodiscard]] std::size_t
+    mapped () const noexcept
+    {
+      return this->mapped_;
+    }
+
+  private:
+    void *do_allocate (std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate (void *block, std::size_t bytes,
+                        std::size_t alignment) override;
+    [[nodiscard]] bool do_is_equal (
+        const std::pmr::memory_resource &other) const noexcept override;
+
+    arena_pages pages_;
+    std::size_t mapped_{ 0 };
+  };
+
+  mapped_resource upstream_;
+  std::pmr::monotonic_buffer_resource arena_;
+};
+
+} // namespace ftv
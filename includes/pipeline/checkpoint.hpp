@@ -0,0 +1,68 @@
+#pragma once
+
+#include "crypto/secure_key.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <system_error>
+
+namespace ftv
+{
+
+// resumable jobs split the video into parts, each a complete video of its
+// own that ends with a CHUNK_PART_END record. once a part is on disk the job
+// records how far it got, and a restarted job continues with the next part
+// instead of frame 0. a part is written in full or not at all
+inline constexpr std::uint64_t CHECKPOINT_INTERVAL{ std::uint64_t{ 64 }
+                                                    << 20 };
+
+enum class checkpoint_kind : std::uint64_t
+{
+  encode = 1,
+  decode = 2
+};
+
+struct checkpoint
+{
+  checkpoint_kind kind{};
+  std::uint64_t source_size{};   // a changed input can not be resumed
+  std::array<std::byte, 32> key_id{}; // neither can another key
+  std::uint64_t parts{};         // finished parts
+  std::uint64_t record_index{};  // index of the next chunk record
+  std::uint64_t input_offset{};  // encode: plaintext bytes consumed
+  std::uint64_t output_offset{}; // decode: plaintext bytes written
+};
+
+// no_such_file_or_directory if there is no checkpoint at path
+[[nodiscard]] std::expected<checkpoint, std::error_code>
+load_checkpoint (const std::filesystem::path &path) noexcept;
+
+// replaces the checkpoint at path atomically, it is on disk on return
+[[nodiscard]] std::error_code
+save_checkpoint (const checkpoint &state,
+                 const std::filesystem::path &path) noexcept;
+
+// sha-256 of the key, so a resumed job can tell it got the same key
+[[nodiscard]] std::array<std::byte, 32>
+checkpoint_key_id (const secure_key &key) noexcept;
+
+// part 0 is video itself, part n is <stem>.part<n><extension> next to it
+[[nodiscard]] std::filesystem::path
+part_path (const std::filesystem::path &video, std::uint64_t part);
+
+struct part_name
+{
+  std::filesystem::path video{};
+  std::uint64_t part{};
+};
+
+// the video and part number part_path made path from, nullopt for a path
+// that is not named like part 1 or later
+[[nodiscard]] std::optional<part_name>
+parse_part_path (const std::filesystem::path &path);
+
+} // namespace ftv
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ftv
+{
+
+// a chunk stream is a sequence of independently sealed records:
+//
+//   [ciphertext size 4][flags 1][iv 12][tag 16][ciphertext]
+//
+// every record authenticates its index and flags as additional data, so
+// records cannot be reordered, and the stream ends with an empty record
+// flagged last, so it cannot be truncated unnoticed
+inline constexpr std::size_t CHUNK_INIT_VEC_SIZE{ 12 };
+inline constexpr std::size_t CHUNK_TAG_SIZE{ 16 };
+inline constexpr std::size_t CHUNK_RECORD_HEADER{
+  sizeof (std::uint32_t) + 1 + CHUNK_INIT_VEC_SIZE + CHUNK_TAG_SIZE
+};
+
+// upper bound for the ciphertext of one record, larger sizes are corruption
+inline constexpr std::size_t CHUNK_RECORD_MAX{ std::size_t{ 64 } << 20 };
+
+enum chunk_flags : std::uint8_t
+{
+  CHUNK_LAST = 1,
+  // payload is [original size 4][deflate stream]
+  CHUNK_COMPRESSED = 2,
+  // ends one part of a video split for checkpoints, the stream continues
+  // in the next part
+  CHUNK_PART_END = 4,
+  // payload is a chunk_reference to plaintext that was stored before
+  CHUNK_REFERENCE = 8,
+  // payload is the segment index of an appendable video, see
+  // segment_index.hpp. never part of the stream itself
+  CHUNK_TRAILER = 16,
+  // payload of the last record is the stream_digest of the plaintext, see
+  // stream_digest.hpp
+  CHUNK_DIGEST = 32
+};
+
+struct chunk_record_header
+{
+  std::uint32_t size{};
+  std::uint8_t flags{};
+  std::array<std::byte, CHUNK_INIT_VEC_SIZE> init_vec{};
+  std::array<std::byte, CHUNK_TAG_SIZE> tag{};
+};
+
+void
+write_chunk_header (const chunk_record_header &header,
+                    std::span<std::byte, CHUNK_RECORD_HEADER> out) noexcept;
+
+[[nodiscard]] chunk_record_header read_chunk_header (
+    std::span<const std::byte, CHUNK_RECORD_HEADER> in) noexcept;
+
+// additional data authenticated with the record at index
+[[nodiscard]] std::array<std::byte, sizeof (std::uint64_t) + 1>
+chunk_additional_data (std::uint64_t index, std::uint8_t flags) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <unordered_map>
+
+namespace ftv
+{
+
+// content defined chunking in the style of fastcdc. a gear hash rolls over
+// the data and a chunk ends where its top bits are zero, so a boundary only
+// depends on the bytes just before it and an insertion early in a file
+// moves the chunks after it instead of changing all of them. below the
+// average size the test is harder than above it, which keeps the sizes
+// close to the average
+struct cdc_params
+{
+  std::size_t min_size{ std::size_t{ 16 } << 10 };
+  std::size_t avg_size{ std::size_t{ 64 } << 10 }; // a power of two
+  std::size_t max_size{ std::size_t{ 256 } << 10 };
+};
+
+// length of the chunk at the start of data, all of data if it is shorter
+// than params.max_size and has no boundary
+[[nodiscard]] std::size_t cdc_cut (std::span<const std::byte> data,
+                                   const cdc_params &params) noexcept;
+
+using chunk_digest = std::array<std::byte, 32>;
+
+// sha-256, collisions are not a practical concern
+[[nodiscard]] chunk_digest
+chunk_digest_of (std::span<const std::byte> data) noexcept;
+
+enum class chunk_source : std::uint8_t
+{
+  output = 0, // earlier in the same plaintext
+  base = 1    // in the base file the stream was encoded against
+};
+
+// payload of a CHUNK_REFERENCE record. the digest lets the decoder check
+// that it copied the right bytes, from the right base
+struct chunk_reference
+{
+  chunk_source source{};
+  std::uint64_t offset{};
+  std::uint32_t length{};
+  chunk_digest digest{};
+};
+
+inline constexpr std::size_t CHUNK_REFERENCE_SIZE{
+  1 + sizeof (std::uint64_t) + sizeof (std::uint32_t) + sizeof (chunk_digest)
+};
+
+void write_chunk_reference (
+    const chunk_reference &reference,
+    std::span<std::byte, CHUNK_REFERENCE_SIZE> out) noexcept;
+
+// bad_message if in is not a reference
+[[nodiscard]] std::expected<chunk_reference, std::error_code>
+read_chunk_reference (std::span<const std::byte> in) noexcept;
+
+// where every distinct chunk seen so far was first stored
+class chunk_index
+{
+public:
+  // keeps the first location of a chunk that is seen again
+  void insert (const chunk_reference &reference);
+
+  [[nodiscard]] std::optional<chunk_reference>
+  find (const chunk_digest &digest) const noexcept;
+
+  [[nodiscard]] std::size_t size () const noexcept;
+
+private:
+  struct digest_hash
+  {
+    // the digest is uniform already, any eight bytes of it will do
+    [[nodiscard]] std::size_t
+    operator() (const chunk_digest &digest) const noexcept;
+  };
+
+  std::unordered_map<chunk_digest, chunk_reference, digest_hash> chunks_{};
+};
+
+} // namespace ftv
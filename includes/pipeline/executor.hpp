@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pipeline/pipeline.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace ftv
+{
+
+// runs many pipeline jobs on a few threads. a worker advances a job by one
+// step, one chunk or frame through its sink, and puts it back at the end of
+// the queue, so jobs share the threads round robin and none holds more than
+// its own stage buffers. jobs of a higher priority get every step while
+// they have one to take. i/o inside a step blocks its worker
+class pipeline_executor
+{
+public:
+  using completion = std::function<void (std::error_code)>;
+  // gets what the job yielded after each of its steps
+  using progress = std::function<void (std::size_t)>;
+
+  explicit pipeline_executor (
+      std::size_t threads = std::thread::hardware_concurrency ());
+
+  pipeline_executor (const pipeline_executor &) = delete;
+  pipeline_executor &operator= (const pipeline_executor &) = delete;
+
+  // waits for all jobs
+  ~pipeline_executor ();
+
+  // done runs on a worker once the job finished or failed, and progress
+  // after every step. neither may throw
+  void submit (progress_stream job, completion done = {}, int priority = 0,
+               progress on_progress = {});
+
+  // blocks until every submitted job is done
+  void wait ();
+
+private:
+  struct job;
+
+  void work () noexcept;
+
+  std::mutex mutex_{};
+  std::condition_variable ready_{};
+  std::condition_variable idle_{};
+  // puts next behind the last job of its priority or a higher one
+  void enqueue (std::unique_ptr<job> next);
+
+  // jobs waiting for their next step, highest priority first
+  std::deque<std::unique_ptr<job>> queue_{};
+  std::size_t unfinished_{ 0 };
+  bool stopping_{ false };
+  std::vector<std::jthread> workers_{};
+};
+
+} // namespace ftv
@@ -0,0 +1,285 @@
+#pragma once
+
+#include "crypto/secure_key.hpp"
+#include "file/growing_file.hpp"
+#include "pipeline/checkpoint.hpp"
+#include "pipeline/chunk_record.hpp"
+#include "pipeline/dedup.hpp"
+#include "pipeline/segment_index.hpp"
+#include "pipeline/stream_digest.hpp"
+#include "video/erasure.hpp"
+#include "video/metadata.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <generator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <system_error>
+
+#include <opencv2/core/mat.hpp>
+
+namespace ftv
+{
+
+// streaming encode and decode built from composable stages. every stage is
+// a generator that pulls from the one before it only when its consumer asks
+// for the next element, so a job holds at most a few chunks and one frame in
+// memory no matter how large the file is, and a stalled sink stops the
+// whole chain. yielded spans and frames are only valid until the next pull.
+// stages report errors by throwing std::system_error, run_job and
+// pipeline_executor turn them back into error codes
+inline constexpr std::size_t PIPELINE_CHUNK_SIZE{ std::size_t{ 1 } << 20 };
+
+struct chunk
+{
+  std::span<const std::byte> bytes{};
+  bool compressed{ false };
+  bool reference{ false }; // bytes are a chunk_reference
+};
+
+// position in a stream of chunk records. a job that drives a stage over
+// one part of a stream passes it in and reads it back afterwards, it has to
+// outlive the stage
+struct stream_cursor
+{
+  std::uint64_t record_index{ 0 }; // of the next record
+  bool finished{ false };          // the record flagged last was opened
+  std::optional<stream_digest> digest{}; // carried by the last record
+};
+
+using chunk_stream = std::generator<chunk>;
+using byte_stream = std::generator<std::span<const std::byte>>;
+using frame_stream = std::generator<const cv::Mat &>;
+using data_frame_stream = std::generator<const data_frame &>;
+// yields the number of units (frames or bytes) a sink has finished so far
+using progress_stream = std::generator<std::size_t>;
+
+// encode stages
+
+// reads length bytes of path from offset on in chunks of chunk_size, the
+// next read is in flight while the current chunk is processed downstream
+[[nodiscard]] chunk_stream
+file_chunks (std::filesystem::path path,
+             std::size_t chunk_size = PIPELINE_CHUNK_SIZE,
+             std::uint64_t offset = 0,
+             std::uint64_t length
+             = std::numeric_limits<std::uint64_t>::max ());
+
+// reads fd, a pipe or terminal, to its end in chunks of chunk_size
+[[nodiscard]] chunk_stream
+descriptor_chunks (int fd, std::size_t chunk_size = PIPELINE_CHUNK_SIZE);
+
+// adds every chunk of plaintext to hasher on its way through
+[[nodiscard]] chunk_stream digest_chunks (chunk_stream chunks,
+                                          stream_hasher &hasher);
+
+// cuts the plaintext anew at content defined boundaries, so equal content
+// ends up in equal chunks wherever it is in the file
+[[nodiscard]] chunk_stream cdc_chunks (chunk_stream chunks,
+                                       cdc_params params = {});
+
+// replaces every chunk index already has with a reference to it and adds
+// the others as output chunks. offset is the position of the first chunk
+// in the plaintext
+[[nodiscard]] chunk_stream dedup_chunks (chunk_stream chunks,
+                                         chunk_index &index,
+                                         std::uint64_t offset = 0);
+
+// deflates every chunk, chunks that do not shrink pass through unchanged
+[[nodiscard]] chunk_stream compress_chunks (chunk_stream chunks);
+
+// seals every chunk with cipher into one chunk record and ends with an
+// empty record flagged final_flags, CHUNK_LAST or CHUNK_PART_END. numbering
+// continues from cursor if given. with digest, the last record carries
+// what digest summed up by then and is flagged CHUNK_DIGEST as well
+[[nodiscard]] byte_stream seal_chunks (chunk_stream chunks, secure_key key,
+                                       cipher_id cipher,
+                                       stream_cursor *cursor = nullptr,
+                                       std::uint8_t final_flags = CHUNK_LAST,
+                                       const stream_hasher *digest = nullptr);
+
+// lays meta and then bytes out as frames of meta.res (), each starting with
+// the calibration strip and a frame header (see frame_header.hpp). the last
+// frame is padded with black. with erasure enabled, every group of data
+// frames is followed by its parity frames (see erasure.hpp)
+[[nodiscard]] frame_stream render_frames (byte_stream bytes, metadata meta,
+                                          erasure_params erasure = {});
+
+// writes frames to a video at path, yields the frame count after each frame
+[[nodiscard]] progress_stream
+frame_sink (frame_stream frames, std::filesystem::path path, metadata meta);
+
+// writes frames to fd as a mjpg avi, without seeking: the riff and the
+// movi list have no size and there is no index. yields the frame count
+// after each frame
+[[nodiscard]] progress_stream avi_sink (frame_stream frames, int fd,
+                                        metadata meta);
+
+// decode stages
+
+// the payload of the video at path, one frame's worth of bytes at a time.
+// meta is the video's metadata, its bytes are skipped. repeated frames are
+// skipped, a dropped or corrupted frame that parity frames can not rebuild
+// fails with bad_message. videos without frame headers are read as one bit
+// stream, those from before the calibration strip fail with
+// invalid_argument
+[[nodiscard]] byte_stream video_bytes (std::filesystem::path path,
+                                       metadata meta);
+
+// the compressed image of every frame of the mjpg avi at path, read
+// straight from its chunks front to back without the index at its end.
+// with growing every read waits for its bytes, so the video can be read
+// while it is being downloaded
+[[nodiscard]] byte_stream avi_images (std::filesystem::path path,
+                                      const growing_file *growing = nullptr);
+
+// the frames of avi_images, decoded
+[[nodiscard]] frame_stream avi_frames (std::filesystem::path path,
+                                       const growing_file *growing = nullptr);
+
+// a frame from one of those images, bad_message if it does not decode
+[[nodiscard]] cv::Mat decode_image (std::span<const std::byte> image);
+
+// the frames of the mjpg avi read front to back from fd, a pipe or
+// terminal. a riff without a size runs to the end of the stream
+[[nodiscard]] frame_stream descriptor_frames (int fd);
+
+// the data frames of frames in sequence order, with repeats skipped and
+// dropped or corrupted ones rebuilt from their group (see frame_recovery).
+// bad_message for a gap that can not be closed
+[[nodiscard]] data_frame_stream recovered_frames (frame_stream frames);
+
+// the payload of frames with frame headers, without the first skip bytes
+// of the stream. the same checks as video_bytes, but frames without a
+// header fail with invalid_argument
+[[nodiscard]] byte_stream frame_payload (frame_stream frames,
+                                         std::size_t skip);
+
+// parses and opens chunk records sealed with cipher until the last one or
+// the end of the part, padding after it is never pulled. numbering
+// continues from cursor if given
+[[nodiscard]] chunk_stream open_chunks (byte_stream bytes, secure_key key,
+                                        cipher_id cipher,
+                                        stream_cursor *cursor = nullptr);
+
+// inflates compressed chunks, others pass through
+[[nodiscard]] chunk_stream decompress_chunks (chunk_stream chunks);
+
+// passes chunks through and fails with bad_message if the last record
+// opened by the stage before carries a digest the plaintext does not
+// match. cursor is the one that stage updates
+[[nodiscard]] chunk_stream verified_chunks (chunk_stream chunks,
+                                            const stream_cursor &cursor);
+
+// writes chunks to fd, a pipe or terminal, yields the byte count after
+// each chunk. references can not be read back from fd and fail with
+// operation_not_supported
+[[nodiscard]] progress_stream descriptor_sink (chunk_stream chunks, int fd);
+
+// writes chunks to a new file at path, yields the byte count after each
+// chunk. refuses to overwrite path and removes it again when the stream
+// fails. with resume_at, path is cut to that size and continued instead,
+// and kept on failure. references are copied from earlier in path or from
+// base. the file is on disk once the sink is done
+[[nodiscard]] progress_stream
+file_sink (chunk_stream chunks, std::filesystem::path path,
+           std::optional<std::uint64_t> resume_at = std::nullopt,
+           std::filesystem::path base = {});
+
+struct encode_options
+{
+  // with a checkpoint path the video is split into parts of interval input
+  // bytes and the job continues from the checkpoint if there is one
+  std::filesystem::path checkpoint_path{};
+  std::uint64_t interval{ CHECKPOINT_INTERVAL };
+  // repeated chunks are stored once and referenced afterwards
+  bool dedup{ false };
+  // an earlier version of the input, chunks it has are only referenced.
+  // implies dedup, and decoding needs the same base again
+  std::filesystem::path base{};
+  // parity frames after every group of data frames
+  erasure_params erasure{};
+};
+
+struct decode_options
+{
+  // every finished part is recorded here and the job continues from the
+  // checkpoint if there is one
+  std::filesystem::path checkpoint_path{};
+  // the base the video was encoded against, if any
+  std::filesystem::path base{};
+};
+
+// whole jobs, composed from the stages above. meta gives the filename, fps
+// and resolution of the video, its format is set to chunk_stream
+[[nodiscard]] progress_stream
+encode_job (std::filesystem::path input, std::filesystem::path output,
+            secure_key key, metadata meta, encode_options options = {});
+
+// the frames of a chunk stream video of plaintext, a stream whose length
+// does not have to be known up front: the last record carries the length
+// and sha-256 of the plaintext. meta gives the filename, fps and
+// resolution of the video
+[[nodiscard]] frame_stream stream_frames (chunk_stream plaintext,
+                                          secure_key key, metadata meta,
+                                          erasure_params erasure = {});
+
+// writes chunks into the existing file at path from offset on, for one of
+// several sinks filling a file of known size at once. fails unless exactly
+// length bytes arrive, the caller syncs the file once all are done
+[[nodiscard]] progress_stream file_range_sink (chunk_stream chunks,
+                                               std::filesystem::path path,
+                                               std::uint64_t offset,
+                                               std::uint64_t length);
+
+// the segment index in the trailer video at path
+[[nodiscard]] segment_index read_trailer (const std::filesystem::path &path,
+                                          const secure_key &key);
+
+// replaces the trailer video at path with one holding index, rendered as
+// meta says. a crash leaves the old or the new trailer
+void write_trailer (const segment_index &index,
+                    const std::filesystem::path &path, const secure_key &key,
+                    const metadata &meta, const erasure_params &erasure = {});
+
+// appends the bytes of input past the end of what the appendable video at
+// output already holds, as one new segment, and replaces its trailer index.
+// earlier segments are neither read nor rewritten. creates the video if
+// there is none, refuses videos that were not created by append_job
+[[nodiscard]] progress_stream append_job (std::filesystem::path input,
+                                          std::filesystem::path output,
+                                          secure_key key, metadata meta,
+                                          erasure_params erasure = {});
+
+// decodes the chunk stream video at input, and its parts or segments, into
+// output
+[[nodiscard]] progress_stream
+decode_job (std::filesystem::path input, std::filesystem::path output,
+            secure_key key, decode_options options = {});
+
+// writes the plaintext of a video with the given metadata somewhere
+using chunk_sink = std::function<progress_stream (chunk_stream chunks,
+                                                  const metadata &meta)>;
+
+// decodes the chunk stream video in frames as they arrive, in a single
+// pass, into the sink chosen after its metadata. videos without frame
+// headers or in another format fail with invalid_argument before sink is
+// called, they need the whole file. the stream has to end in the video,
+// parts and trailers are not followed
+[[nodiscard]] progress_stream stream_decode_job (frame_stream frames,
+                                                 secure_key key,
+                                                 chunk_sink sink);
+
+// runs a job to completion on the calling thread
+[[nodiscard]] std::error_code run_job (progress_stream job) noexcept;
+
+// the error code for an exception thrown out of a stage
+[[nodiscard]] std::error_code
+pipeline_error_code (std::exception_ptr error) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace ftv
+{
+
+// an appendable video is a chunk stream split into segments, one part file
+// (see checkpoint.hpp) per append, each ending with a CHUNK_PART_END
+// record. the trailer index lists where every segment ends and lives in a
+// small video of its own that every append replaces, so appending never
+// touches the frames of earlier segments. it is sealed as one record with
+// the flags CHUNK_LAST | CHUNK_TRAILER and the index below, which no
+// record of the stream itself can have
+inline constexpr std::uint64_t TRAILER_RECORD_INDEX{
+  std::numeric_limits<std::uint64_t>::max ()
+};
+
+struct segment_entry
+{
+  std::uint64_t record_end{}; // index of the record after the segment
+  std::uint64_t byte_end{};   // plaintext bytes up to the segment's end
+};
+
+using segment_index = std::vector<segment_entry>;
+
+[[nodiscard]] std::vector<std::byte>
+write_segment_index (const segment_index &index);
+
+// bad_message if in is not an index of ascending segments
+[[nodiscard]] std::expected<segment_index, std::error_code>
+read_segment_index (std::span<const std::byte> in);
+
+// the trailer index of the video at path, <stem>.index<extension>
+[[nodiscard]] std::filesystem::path
+index_path (const std::filesystem::path &video);
+
+} // namespace ftv
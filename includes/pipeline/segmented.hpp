@@ -0,0 +1,52 @@
+#pragma once
+
+#include "crypto/secure_key.hpp"
+#include "video/erasure.hpp"
+#include "video/metadata.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+namespace ftv
+{
+
+// one payload split into segment videos that are encoded and decoded on
+// several threads at once. the result is laid out like an appendable video
+// (see segment_index.hpp): segment k is part k and the trailer index is the
+// manifest. a segment holds whole pipeline chunks and every chunk is one
+// record, so the record numbers of all segments follow from the input size
+// alone and no segment waits for the ones before it. with the manifest any
+// segment decodes on its own into its range of the output
+
+// splits input into at most segments segment videos of output, meta gives
+// the filename, fps and resolution. every segment and the manifest get
+// erasure's parity frames
+[[nodiscard]] std::error_code
+encode_segmented (const std::filesystem::path &input,
+                  const std::filesystem::path &output, const secure_key &key,
+                  const metadata &meta, std::size_t segments,
+                  const erasure_params &erasure = {},
+                  std::size_t threads
+                  = std::thread::hardware_concurrency ()) noexcept;
+
+// decodes the segments of the video at input into output concurrently.
+// works for every video with a trailer index, appended ones too
+[[nodiscard]] std::error_code
+decode_segmented (const std::filesystem::path &input,
+                  const std::filesystem::path &output, const secure_key &key,
+                  std::size_t threads
+                  = std::thread::hardware_concurrency ()) noexcept;
+
+// decodes only segment part of the video at input into a new file at
+// output and returns where its bytes start in the whole payload.
+// invalid_argument for a part the manifest does not list
+[[nodiscard]] std::expected<std::uint64_t, std::error_code>
+decode_segment (const std::filesystem::path &input, std::size_t part,
+                const std::filesystem::path &output,
+                const secure_key &key) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <system_error>
+
+#include <openssl/evp.h>
+
+namespace ftv
+{
+
+// the length and sha-256 of a whole plaintext. a stream whose length was
+// not known when it started carries it as the payload of its last record,
+// flagged CHUNK_DIGEST, so the decoder can tell that it got all of it
+struct stream_digest
+{
+  std::uint64_t size{};
+  std::array<std::byte, 32> sha256{};
+
+  friend bool operator== (const stream_digest &, const stream_digest &)
+      = default;
+};
+
+inline constexpr std::size_t STREAM_DIGEST_SIZE{ sizeof (std::uint64_t)
+                                                 + 32 };
+
+void
+write_stream_digest (const stream_digest &digest,
+                     std::span<std::byte, STREAM_DIGEST_SIZE> out) noexcept;
+
+// bad_message if in is not a digest
+[[nodiscard]] std::expected<stream_digest, std::error_code>
+read_stream_digest (std::span<const std::byte> in) noexcept;
+
+// sums up a plaintext that arrives in pieces
+class stream_hasher
+{
+public:
+  stream_hasher ();
+
+  stream_hasher (const stream_hasher &) = delete;
+  stream_hasher &operator= (const stream_hasher &) = delete;
+
+  ~stream_hasher ();
+
+  void update (std::span<const std::byte> data) noexcept;
+
+  // of everything so far, more can follow
+  [[nodiscard]] stream_digest digest () const;
+
+private:
+  EVP_MD_CTX *ctx_;
+  std::uint64_t size_{};
+};
+
+} // namespace ftv
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "video/metadata.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+namespace ftv
+{
+
+// what verify_video found. videos are checked without their key, so the
+// records of a chunk stream are checked for their layout and not opened
+struct verify_report
+{
+  metadata meta{};               // of the video itself
+  std::size_t videos{};          // the video, its parts and its trailer
+  std::size_t frames{};          // frames with a header that were checked
+  std::size_t duplicates{};      // of them, repeats that were skipped
+  std::size_t rebuilt{};         // data frames rebuilt from parity frames
+  std::uint64_t payload_bytes{}; // after the metadata
+  std::uint64_t records{};       // chunk records
+  // the first problem, in which file and at which of its data frames, by
+  // sequence number. a dropped frame is named, not the one after it
+  std::error_code error{};
+  std::filesystem::path failed_path{};
+  std::size_t failed_frame{};
+};
+
+// checks the video at path and the parts and trailer that belong to it:
+// every frame header and its checksum, that every frame is there or can be
+// rebuilt from the parity frames of its group, and that the payload is
+// complete and laid out as its format says. a serialized payload is
+// checked against the checksum in its metadata. frames are decoded on
+// threads threads at once, nothing is written
+[[nodiscard]] verify_report verify_video (
+    const std::filesystem::path &path,
+    std::size_t threads = std::thread::hardware_concurrency ()) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/core/mat.hpp>
+
+namespace ftv
+{
+
+// the first row of every frame is a calibration strip of repeating black,
+// white and grey cells. the decoder measures what the codec made of these
+// known levels and derives a per frame threshold from them instead of
+// assuming the source levels survived
+inline constexpr std::size_t CALIBRATION_ROWS{ 1 };
+inline constexpr std::size_t CALIBRATION_CELL{ 8 }; // pixels per cell
+
+inline constexpr std::uint8_t CALIBRATION_BLACK{ 0 };
+inline constexpr std::uint8_t CALIBRATION_WHITE{ 255 };
+inline constexpr std::uint8_t CALIBRATION_GREY{ 128 };
+
+// measured levels of one frame, as channel averages
+struct frame_levels
+{
+  std::uint8_t black{ CALIBRATION_BLACK };
+  std::uint8_t white{ CALIBRATION_WHITE };
+  std::uint8_t grey{ CALIBRATION_GREY };
+  std::uint8_t threshold{ CALIBRATION_GREY }; // pixels above it are white
+};
+
+void draw_calibration (cv::Mat &frame) noexcept;
+
+// whether frame starts with a calibration strip. its cells are the format
+// marker: videos from before the strip have data in the first row, which
+// does not repeat black, grey and white cells across the frame
+[[nodiscard]] bool has_calibration (const cv::Mat &frame) noexcept;
+
+// reads the calibration strip and picks the threshold with otsu's method
+// over the histogram of the data area. falls back to the measured grey level
+// when the histogram does not separate into two classes near the measured
+// black and white
+[[nodiscard]] frame_levels calibrate (const cv::Mat &frame) noexcept;
+
+[[nodiscard]] inline bool
+is_white (const cv::Vec3b &px, std::uint8_t threshold) noexcept
+{
+  return px[0] + px[1] + px[2] > 3 * threshold;
+}
+
+} // namespace ftv
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "video/frame_header.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <map>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace ftv
+{
+
+// erasure coding across frames. the data frames of a video are cut into
+// groups of data_frames frames, from sequence 0 on, and every group is
+// followed by parity_frames parity frames (see parity_header). byte i of
+// every parity frame is a reed-solomon code over gf(256) of byte i of the
+// group's payloads, so a group survives any parity_frames of its frames
+// being dropped or damaged beyond their checksum. videos without parity
+// frames decode as before
+
+// data and parity frames of one group at most
+inline constexpr std::size_t ERASURE_MAX_FRAMES{ 255 };
+
+struct erasure_params
+{
+  std::size_t data_frames{ 0 };
+  std::size_t parity_frames{ 0 }; // 0 writes no parity frames
+
+  [[nodiscard]] bool
+  enabled () const noexcept
+  {
+    return this->parity_frames > 0;
+  }
+
+  // whether the groups fit the code
+  [[nodiscard]] bool
+  valid () const noexcept
+  {
+    return !this->enabled ()
+           || (this->data_frames > 0
+               && this->data_frames + this->parity_frames
+                      <= ERASURE_MAX_FRAMES);
+  }
+};
+
+// sums up the payloads of data frames as they are rendered, and renders
+// the parity frames of every group once it is complete
+class parity_encoder
+{
+public:
+  // stride is the payload of a full data frame
+  parity_encoder (erasure_params params, std::size_t stride);
+
+  // adds the payload of the next data frame. true if it completed a group
+  // whose parity frames are due now
+  [[nodiscard]] bool add (std::uint32_t sequence,
+                          std::span<const std::byte> payload) noexcept;
+
+  // completes the last group if it is short, true if its parity frames
+  // are due
+  [[nodiscard]] bool finish () noexcept;
+
+  [[nodiscard]] std::size_t
+  parity_frames () const noexcept
+  {
+    return this->parity_.size ();
+  }
+
+  // renders parity frame index of the group that was just completed
+  void render (cv::Mat &frame, std::size_t index) const noexcept;
+
+private:
+  erasure_params params_;
+  std::uint32_t stride_;
+  std::uint32_t first_{};
+  std::uint32_t count_{};
+  std::uint32_t bytes_{};
+  bool complete_{ false };
+  std::vector<std::vector<std::byte>> parity_;
+};
+
+// a data frame as read_any_frame gave it, or as it was rebuilt
+struct data_frame
+{
+  frame_header header{};
+  std::vector<std::byte> payload{};
+};
+
+// puts the frames of a video back in sequence order as they are captured.
+// repeats are skipped, and data frames that were dropped or damaged are
+// rebuilt from the rest of their group once enough of its parity frames
+// arrived. rebuilding splits the payload across threads threads. data
+// frames after a gap wait for it to be closed, a gap that no parity frame
+// can close any more is bad_message
+class frame_recovery
+{
+public:
+  explicit frame_recovery (std::size_t threads
+                           = std::thread::hardware_concurrency ());
+
+  // reads frame and adds it. a frame with neither header or a checksum
+  // that does not match is taken as dropped
+  [[nodiscard]] std::error_code add (const cv::Mat &frame);
+
+  // adds a data or parity frame that was read already
+  [[nodiscard]] std::error_code add (const frame_header &header,
+                                     std::span<const std::byte> payload);
+  [[nodiscard]] std::error_code add (const parity_header &header,
+                                     std::span<const std::byte> parity);
+
+  // the next data frame in sequence order, nullptr until it is there. it
+  // stays valid until the next add
+  [[nodiscard]] std::expected<const data_frame *, std::error_code> next ();
+
+  // the video ended, bad_message if a gap is left
+  [[nodiscard]] std::error_code finish () const noexcept;
+
+  // the sequence number next hands out next. once add, next or finish
+  // failed, the first data frame that is missing or does not follow
+  [[nodiscard]] std::uint32_t
+  next_sequence () const noexcept
+  {
+    return this->next_;
+  }
+
+  // repeated frames that were skipped
+  [[nodiscard]] std::size_t
+  repeats () const noexcept
+  {
+    return this->repeats_;
+  }
+
+  // data frames that were rebuilt from parity
+  [[nodiscard]] std::size_t
+  rebuilt () const noexcept
+  {
+    return this->rebuilt_;
+  }
+
+private:
+  struct parity_group
+  {
+    parity_header header{};
+    std::map<std::uint8_t, std::vector<std::byte>> parity{};
+  };
+
+  // rebuilds the missing data frames of the group starting at first if
+  // enough of its parity is there
+  void recover (std::uint32_t first);
+  // drops frames and groups that no gap can need any more
+  void prune ();
+  [[nodiscard]] bool hopeless () const noexcept;
+
+  std::size_t threads_;
+  frame_sequence sequence_{};
+  std::uint32_t next_{}; // sequence next () hands out next
+  std::map<std::uint32_t, data_frame> frames_{};
+  std::map<std::uint32_t, parity_group> groups_{};
+  // data frames of a full group, known from the first parity frame
+  std::optional<std::uint32_t> group_size_{};
+  std::size_t repeats_{};
+  std::size_t rebuilt_{};
+  std::vector<std::byte> scratch_{};
+};
+
+} // namespace ftv
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "video/resolution.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace ftv
+{
+
+// the data area of every frame, below the calibration strip, starts with a
+// header that places the frame's payload in the byte stream of its video:
+//
+//   [magic 4][sequence 4][offset 8][length 4][checksum 4][payload]
+//
+// the stream is the metadata followed by the payload of the video, cut
+// into frame_payload_size () pieces. every frame decodes on its own, and a
+// frame that a re-encoding platform dropped or duplicated shows up as a gap
+// or a repeat in the sequence numbers instead of shifting all later bytes.
+// videos written before the header have no magic in their first frame
+inline constexpr std::array<std::byte, 4> FRAME_MAGIC{
+  std::byte{ 'f' }, std::byte{ 't' }, std::byte{ 'v' }, std::byte{ 0x01 }
+};
+inline constexpr std::size_t FRAME_HEADER_SIZE{
+  FRAME_MAGIC.size () + sizeof (std::uint32_t) + sizeof (std::uint64_t)
+  + sizeof (std::uint32_t) + sizeof (std::uint32_t)
+};
+
+struct frame_header
+{
+  std::uint32_t sequence{}; // of the frame in its video, from 0
+  std::uint64_t offset{};   // of the payload in the byte stream
+  std::uint32_t length{};   // of the payload, the rest is padding
+  std::uint32_t checksum{}; // crc32 of the fields above and the payload
+};
+
+// payload bytes one frame of res carries, 0 if the header does not fit
+[[nodiscard]] std::size_t frame_payload_size (const resolution &res) noexcept;
+
+// clears frame and draws the calibration strip, the header and payload,
+// which has to fit in frame_payload_size ()
+void render_frame (cv::Mat &frame, std::uint32_t sequence,
+                   std::uint64_t offset,
+                   std::span<const std::byte> payload) noexcept;
+
+// parity frames (see erasure.hpp) carry a header of the same size in the
+// same place:
+//
+//   [magic 4][first 4][group bytes 4][stride 4][data 1][parity 1][index 1]
+//   [zero 1][checksum 4][parity]
+//
+// the parity is as long as the longest data frame of the group
+inline constexpr std::array<std::byte, 4> PARITY_MAGIC{
+  std::byte{ 'f' }, std::byte{ 't' }, std::byte{ 'v' }, std::byte{ 0x02 }
+};
+
+struct parity_header
+{
+  std::uint32_t first{};        // sequence of the group's first data frame
+  std::uint32_t group_bytes{};  // payload of the group's data frames
+  std::uint32_t stride{};       // payload of every data frame but the last
+  std::uint8_t data_frames{};   // in the group
+  std::uint8_t parity_frames{}; // in the group
+  std::uint8_t index{};         // of this parity frame in the group
+  std::uint32_t checksum{};     // crc32 of the fields above and the parity
+};
+
+// bytes of parity every parity frame of the group header describes has
+[[nodiscard]] std::size_t
+parity_size (const parity_header &header) noexcept;
+
+// clears frame and draws the calibration strip, header and parity, which
+// has to be parity_size (header) long
+void render_parity_frame (cv::Mat &frame, const parity_header &header,
+                          std::span<const std::byte> parity) noexcept;
+
+// the header of a data or a parity frame
+using any_header = std::variant<frame_header, parity_header>;
+
+// whether frame starts with a frame or a parity header
+[[nodiscard]] bool has_any_header (const cv::Mat &frame) noexcept;
+
+// decodes the header of a data or parity frame and its payload or parity.
+// the frame is calibrated once, for the magic and everything after it.
+// invalid_argument if it starts with neither header, bad_message if the
+// fields of a parity header do not describe a group or the checksum does
+// not match
+[[nodiscard]] std::expected<any_header, std::error_code>
+read_any_frame (const cv::Mat &frame,
+                std::vector<std::byte> &payload) noexcept;
+
+// checks the headers of a video's frames in capture order
+class frame_sequence
+{
+public:
+  // true if header is the next frame, false if it repeats one already
+  // accepted and is skipped. bad_message for a gap or a payload that does
+  // not continue the stream
+  [[nodiscard]] std::expected<bool, std::error_code>
+  accept (const frame_header &header) noexcept;
+
+private:
+  std::uint32_t next_{};
+  std::uint64_t offset_{};
+};
+
+} // namespace ftv
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "video/spsc_ring.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace ftv
+{
+
+// frames circulating between the two threads of video::write and
+// video::read, enough for one in each stage and one queued each way
+inline constexpr std::size_t FRAME_POOL_SIZE{ 4 };
+inline constexpr std::size_t FRAME_RING_SIZE{ 8 };
+
+// index of a frame in a frame_pool, FRAME_END marks the end of a stream
+using frame_index = std::uint32_t;
+inline constexpr frame_index FRAME_END{
+  std::numeric_limits<frame_index>::max ()
+};
+
+// the rings hold every frame of the pool plus FRAME_END, so pushing never
+// has to wait and only running out of frames blocks a stage
+using frame_ring = spsc_ring<frame_index, FRAME_RING_SIZE>;
+
+// fixed set of bgr frames allocated once, cache line aligned, in a single
+// block. the frames are cv::Mat headers over that block, so opencv reuses
+// them instead of allocating as long as the size and type stay the same
+class frame_pool
+{
+public:
+  frame_pool (std::size_t rows, std::size_t cols,
+              std::size_t count = FRAME_POOL_SIZE);
+
+  [[nodiscard]] cv::Mat &
+  operator[] (frame_index index) noexcept
+  {
+    return this->frames_[index];
+  }
+
+  [[nodiscard]] std::size_t
+  size () const noexcept
+  {
+    return this->frames_.size ();
+  }
+
+  // pushes every frame of the pool, for the ring of free frames
+  void fill (frame_ring &ring) const noexcept;
+
+private:
+  struct aligned_delete
+  {
+    void operator() (std::byte *block) const noexcept;
+  };
+
+  std::unique_ptr<std::byte, aligned_delete> block_;
+  std::vector<cv::Mat> frames_;
+};
+
+} // namespace ftv
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "crypto/blake3.hpp"
+#include "crypto/cipher.hpp"
+#include "video/pixel_layout.hpp"
 #include "video/resolution.hpp"
 
 #include <cstddef>
 #include <expected>
 #include <filesystem>
+#include <memory_resource>
 #include <span>
 #include <string>
 #include <vector>
@@ -12,43 +16,105 @@
 namespace ftv
 {
 
+// how the payload after the metadata is laid out
+enum class payload_format : std::size_t
+{
+  serialized = 0,  // one serialized encrypted_data, see crypto/serialize.hpp
+  chunk_stream = 1 // sealed chunk records, see pipeline/chunk_record.hpp
+};
+
+// serialized size of metadata whose filename is filename_size bytes long
+[[nodiscard]] constexpr std::size_t
+metadata_size (std::size_t filename_size) noexcept
+{
+  return sizeof (std::size_t) +   // filename_size (8 bytes)
+         filename_size +          // filename
+         sizeof (std::size_t) +   // file_size (8 bytes)
+         sizeof (blake3_digest) + // checksum (32 bytes)
+         sizeof (std::size_t) +   // fps (8 bytes)
+         sizeof (resolution) +    // resolution(16 bytes)
+         sizeof (std::size_t);    // payload format, cipher, layout (8 bytes)
+}
+
+// the same for videos from before the calibration strip, which had an 8
+// byte checksum and no payload format field
+[[nodiscard]] constexpr std::size_t
+legacy_metadata_size (std::size_t filename_size) noexcept
+{
+  return sizeof (std::size_t) + // filename_size (8 bytes)
+         filename_size +        // filename
+         sizeof (std::size_t) + // file_size (8 bytes)
+         sizeof (std::size_t) + // checksum (8 bytes)
+         sizeof (std::size_t) + // fps (8 bytes)
+         sizeof (resolution);   // resolution(16 bytes)
+}
+
 class metadata
 {
 public:
   metadata () = default;
 
   explicit metadata (std::span<const std::byte>);
-  metadata (std::string fname, std::size_t fsize, std::size_t checksum,
-            std::size_t fps, const resolution &res);
+  metadata (std::string fname, std::size_t fsize,
+            const blake3_digest &checksum, std::size_t fps,
+            const resolution &res,
+            payload_format format = payload_format::serialized,
+            cipher_id cipher = cipher_id::aes_256_gcm,
+            layout_id layout = layout_id::mono);
   explicit metadata (const std::filesystem::path &video_path);
 
+  // metadata in the layout of videos from before the calibration strip: a
+  // serialized aes-256-gcm payload with a std::hash checksum, which
+  // legacy_checksum returns
+  [[nodiscard]] static metadata parse_legacy (std::span<const std::byte>);
+
   [[nodiscard]] std::size_t filename_size () const noexcept;
   [[nodiscard]] std::string filename () const noexcept;
   [[nodiscard]] std::size_t file_size () const noexcept;
-  [[nodiscard]] std::size_t checksum () const noexcept;
+  // the blake3 root of the payload, see crypto/checksum.hpp
+  [[nodiscard]] blake3_digest checksum () const noexcept;
+  [[nodiscard]] std::size_t legacy_checksum () const noexcept;
   [[nodiscard]] std::size_t fps () const noexcept;
   [[nodiscard]] resolution res () const noexcept;
+  [[nodiscard]] payload_format format () const noexcept;
+  // what the payload is sealed with
+  [[nodiscard]] cipher_id cipher () const noexcept;
+  // how the pixels of the payload carry its bits
+  [[nodiscard]] layout_id layout () const noexcept;
+  // whether the video predates the calibration strip and has to be read
+  // the way it was written
+  [[nodiscard]] bool legacy () const noexcept;
 
   [[nodiscard]] constexpr std::size_t
   size () const noexcept
   {
-    return sizeof (std::size_t) +    // filename_size (8 bytes)
-           this->filename_.size () + // filename
-           sizeof (std::size_t) +    // file_size (8 bytes)
-           sizeof (std::size_t) +    // checksum (8 bytes)
-           sizeof (std::size_t) +    // fps (8 bytes)
-           sizeof (resolution);      // resolution(16 bytes)
+    return this->legacy_ ? legacy_metadata_size (this->filename_.size ())
+                         : metadata_size (this->filename_.size ());
   }
 
-  [[nodiscard]] std::vector<std::byte> to_vec () const noexcept;
+  [[nodiscard]] std::pmr::vector<std::byte>
+  to_vec (std::pmr::memory_resource *resource
+          = std::pmr::get_default_resource ()) const noexcept;
 
 private:
   std::size_t filename_size_{ 0 };
   std::string filename_{ 0 };
   std::size_t file_size_{ 0 };
-  std::size_t checksum_{ 0 };
+  blake3_digest checksum_{};
+  std::size_t legacy_checksum_{ 0 };
   std::size_t fps_{ 0 };
   resolution res_{ 0 };
+  payload_format format_{ payload_format::serialized };
+  cipher_id cipher_{ cipher_id::aes_256_gcm };
+  layout_id layout_{ layout_id::mono };
+  bool legacy_{ false };
 };
 
+// the layout the payload of the video meta describes is drawn in
+[[nodiscard]] inline layout_id
+layout_of (const metadata &meta) noexcept
+{
+  return meta.layout ();
+}
+
 } // namespace ftv
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "video/pixel_layout.hpp"
+
 #include <cstdint>
+#include <memory_resource>
 #include <span>
 #include <vector>
 namespace ftv
@@ -13,10 +16,23 @@ struct pixel
   std::uint8_t b{};
 };
 
-[[nodiscard]] std::vector<pixel>
-bytes_to_pixels (std::span<const std::byte> bytes) noexcept;
+// the conversions below run the kernel instantiated for layout
+
+[[nodiscard]] std::pmr::vector<pixel>
+bytes_to_pixels (std::span<const std::byte> bytes,
+                 std::pmr::memory_resource *resource
+                 = std::pmr::get_default_resource (),
+                 layout_id layout = layout_id::mono) noexcept;
+
+// appends the pixels of bytes to pixels instead of allocating a new vector
+void append_pixels (std::span<const std::byte> bytes,
+                    std::pmr::vector<pixel> &pixels,
+                    layout_id layout = layout_id::mono);
 
-[[nodiscard]] std::vector<std::byte>
-pixels_to_bytes (std::span<const pixel> bytes) noexcept;
+[[nodiscard]] std::pmr::vector<std::byte>
+pixels_to_bytes (std::span<const pixel> bytes,
+                 std::pmr::memory_resource *resource
+                 = std::pmr::get_default_resource (),
+                 layout_id layout = layout_id::mono) noexcept;
 
 } // namespace ftv
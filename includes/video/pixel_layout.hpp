@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace ftv
+{
+
+// how the pixels of a frame's data area carry bits. a layout is a compile
+// time constant: the kernels that draw and read payloads are templates
+// over it, so their inner loops see a fixed symbol count per byte and
+// unroll without a branch per pixel. with_layout picks the instantiation
+// for a video once, outside those loops
+struct pixel_layout
+{
+  std::size_t bits_per_symbol{ 1 }; // bits one pixel carries
+  std::size_t channels{ 3 };        // channels that are set to its level
+
+  // pixels one byte is drawn as, most significant bits first
+  [[nodiscard]] constexpr std::size_t
+  symbols_per_byte () const noexcept
+  {
+    return 8 / this->bits_per_symbol;
+  }
+
+  [[nodiscard]] constexpr unsigned
+  symbol_mask () const noexcept
+  {
+    return (1u << this->bits_per_symbol) - 1;
+  }
+
+  // the channel level symbol is drawn with, black to white
+  [[nodiscard]] constexpr std::uint8_t
+  level (unsigned symbol) const noexcept
+  {
+    return static_cast<std::uint8_t> (symbol * (255 / this->symbol_mask ()));
+  }
+
+  [[nodiscard]] constexpr bool
+  valid () const noexcept
+  {
+    return (this->bits_per_symbol == 1 || this->bits_per_symbol == 2
+            || this->bits_per_symbol == 4 || this->bits_per_symbol == 8)
+           && this->channels >= 1 && this->channels <= 3;
+  }
+};
+
+// black and white pixels of one bit, the layout frame headers are drawn in
+// and the one videos have unless their metadata names another
+inline constexpr pixel_layout MONO_LAYOUT{ 1, 3 };
+// grey pixels of four and sixteen levels
+inline constexpr pixel_layout TWO_BIT_LAYOUT{ 2, 3 };
+inline constexpr pixel_layout FOUR_BIT_LAYOUT{ 4, 3 };
+
+static_assert (MONO_LAYOUT.valid () && TWO_BIT_LAYOUT.valid ()
+               && FOUR_BIT_LAYOUT.valid ());
+
+// the layouts a video's metadata can name, see metadata::layout
+enum class layout_id : std::uint8_t
+{
+  mono = 0,
+  two_bit = 1,
+  four_bit = 2,
+};
+
+[[nodiscard]] constexpr bool
+known_layout (layout_id id) noexcept
+{
+  return id == layout_id::mono || id == layout_id::two_bit
+         || id == layout_id::four_bit;
+}
+
+// calls fn.template operator ()<layout> () with the layout id stands for,
+// an unknown id is mono
+template <typename F>
+decltype (auto)
+with_layout (layout_id id, F &&fn)
+{
+  switch (id)
+    {
+    case layout_id::two_bit:
+      {
+        return std::forward<F> (fn).template operator ()<TWO_BIT_LAYOUT> ();
+      }
+    case layout_id::four_bit:
+      {
+        return std::forward<F> (fn).template operator ()<FOUR_BIT_LAYOUT> ();
+      }
+    case layout_id::mono:
+    default:
+      {
+        return std::forward<F> (fn).template operator ()<MONO_LAYOUT> ();
+      }
+    }
+}
+
+// calls fn (std::integral_constant<std::size_t, i> {}) for i from 0 to
+// count, unrolled
+template <std::size_t count, typename F>
+constexpr void
+unrolled (F &&fn)
+{
+  [&]<std::size_t... i> (std::index_sequence<i...>) {
+    (fn (std::integral_constant<std::size_t, i>{}), ...);
+  }(std::make_index_sequence<count>{});
+}
+
+} // namespace ftv
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "video/resolution.hpp"
+
+#include <cstddef>
+
+namespace ftv
+{
+
+// smallest and largest side the planner picks. mjpg codes 16x16 macro
+// blocks, a side that is not a multiple of PLAN_STEP pays for a partial
+// block it cannot use
+inline constexpr std::size_t PLAN_MIN_SIDE{ 112 };
+inline constexpr std::size_t PLAN_MAX_SIDE{ MAX_RESOLUTION };
+inline constexpr std::size_t PLAN_STEP{ 16 };
+
+// rough cost of writing one frame with the mjpg writer at quality 100 on
+// one core: a fixed part for the call, the calibration strip and the
+// container, and a part for every pixel rendered and compressed
+inline constexpr std::size_t PLAN_FRAME_NANOS{ 150'000 };
+inline constexpr std::size_t PLAN_PIXEL_NANOS{ 4 };
+
+struct geometry_plan
+{
+  resolution res{};
+  std::size_t fps{};
+  std::size_t frames{};
+  std::size_t bytes{};        // laid out, metadata included
+  std::size_t padding{};      // unused bytes of the last frame
+  std::size_t encode_nanos{}; // predicted, see PLAN_FRAME_NANOS
+  double duration_seconds{};  // of the video at fps
+};
+
+// frames and cost of laying bytes out at res and fps
+[[nodiscard]] geometry_plan evaluate_geometry (std::size_t bytes,
+                                               const resolution &res,
+                                               std::size_t fps) noexcept;
+
+// the frame size with the lowest predicted cost for bytes, and the least
+// padding among equally cheap ones. few large frames beat many small ones
+// until the last frame would be mostly padding, then a size is picked that
+// fills the frames the payload needs anyway
+[[nodiscard]] geometry_plan plan_geometry (std::size_t bytes,
+                                           std::size_t fps = MAX_FPS) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace ftv
+{
+
+// bounded lock-free queue between exactly one producer and one consumer
+// thread. head and tail live on their own 64 byte cache lines so the two
+// sides do not invalidate each other, and a side that cannot proceed sleeps
+// on the other side's index instead of spinning
+template <typename T, std::size_t Capacity> class spsc_ring
+{
+  static_assert (Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                 "capacity must be a power of two");
+
+public:
+  // producer side, blocks while the ring is full
+  void
+  push (const T &value) noexcept
+  {
+    const std::size_t tail = this->tail_.load (std::memory_order_relaxed);
+    std::size_t head = this->head_.load (std::memory_order_acquire);
+    while (tail - head == Capacity)
+      {
+        this->head_.wait (head, std::memory_order_acquire);
+        head = this->head_.load (std::memory_order_acquire);
+      }
+    this->slots_[tail & (Capacity - 1)] = value;
+    this->tail_.store (tail + 1, std::memory_order_release);
+    this->tail_.notify_one ();
+  }
+
+  // consumer side, blocks while the ring is empty
+  [[nodiscard]] T
+  pop () noexcept
+  {
+    const std::size_t head = this->head_.load (std::memory_order_relaxed);
+    std::size_t tail = this->tail_.load (std::memory_order_acquire);
+    while (tail == head)
+      {
+        this->tail_.wait (tail, std::memory_order_acquire);
+        tail = this->tail_.load (std::memory_order_acquire);
+      }
+    T value = this->slots_[head & (Capacity - 1)];
+    this->head_.store (head + 1, std::memory_order_release);
+    this->head_.notify_one ();
+    return value;
+  }
+
+private:
+  alignas (64) std::atomic<std::size_t> head_{ 0 };
+  alignas (64) std::atomic<std::size_t> tail_{ 0 };
+  std::array<T, Capacity> slots_{};
+};
+
+} // namespace ftv
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "video/erasure.hpp"
+#include "video/frame_pool.hpp"
 #include "video/metadata.hpp"
 #include "video/pixel.hpp"
 
+#include <cstdint>
 #include <expected>
 #include <filesystem>
+#include <memory_resource>
 #include <opencv2/core/mat.hpp>
+#include <optional>
 #include <span>
 #include <system_error>
 
@@ -15,36 +20,88 @@ namespace ftv
 class video
 {
 public:
-  explicit video (const std::filesystem::path &path);
+  // buffers of whole payloads, pixels and bytes, are allocated from
+  // resource, which has to outlive the video
+  explicit video (const std::filesystem::path &path,
+                  std::pmr::memory_resource *resource
+                  = std::pmr::get_default_resource ());
 
-  video (const std::filesystem::path &path, const metadata &meta);
+  video (const std::filesystem::path &path, const metadata &meta,
+         std::pmr::memory_resource *resource
+         = std::pmr::get_default_resource ());
+
+  // copies share the resource, which the video does not own
+  video (const video &) = default;
+  video &operator= (const video &) = default;
+  video (video &&) noexcept = default;
+  video &operator= (video &&) noexcept = default;
+
+  ~video () = default;
 
   [[nodiscard]] std::error_code
   write (std::span<const std::byte> bytes) const noexcept;
   [[nodiscard]] std::error_code
   write (std::span<const pixel> pixels) const noexcept;
+  // writes the concatenation of segments without gathering them first
+  [[nodiscard]] std::error_code
+  write (std::span<const std::span<const std::byte>> segments) const noexcept;
 
-  [[nodiscard]] std::expected<std::vector<pixel>, std::error_code>
+  // the payload after the metadata. bad_message if it does not match the
+  // metadata checksum, which is computed as the frames are read
+  [[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
   read () noexcept;
+  // the sequence number of the first data frame the last read found
+  // missing or damaged, nullopt if it failed elsewhere or did not fail
+  [[nodiscard]] std::optional<std::uint32_t> failed_frame () const noexcept;
 
   void set_metadata (std::span<const std::byte> bytes);
   void set_metadata (const metadata &data);
+  // parity frames write adds after every group of data frames
+  void set_erasure (const erasure_params &erasure) noexcept;
 
   [[nodiscard]] metadata get_metadata () const noexcept;
+  // the metadata at the start of a video's first frame, for frames that
+  // do not come from a video file. throws runtime_error if there is none
+  [[nodiscard]] static metadata parse_metadata (const cv::Mat &frame);
+  // the same from the payload of the first data frame
+  [[nodiscard]] static metadata
+  parse_metadata (std::span<const std::byte> payload);
   [[nodiscard]] std::filesystem::path get_path () const noexcept;
 
 private:
   void init_metadata ();
 
-  [[nodiscard]] std::size_t read_size_t (const cv::Mat &frame,
-                                         std::size_t start_pos) const;
+  // renders the concatenation of stream, metadata included, into frames
+  // and writes them while the next ones are rendered
+  [[nodiscard]] std::error_code
+  write_stream (std::span<const std::span<const std::byte>> stream)
+      const noexcept;
+
+  // turns captured frames into pixels, returning every frame it is done with
+  [[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
+  extract_pixels (frame_pool &pool, frame_ring &free_frames,
+                  frame_ring &captured_frames);
+  // extract_pixels for videos with frame headers, from the captured frame
+  // at index on
+  [[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
+  extract_framed (frame_pool &pool, frame_ring &free_frames,
+                  frame_ring &captured_frames, frame_index index);
+  // extract_pixels for videos from before the calibration strip, from the
+  // captured frame at index on
+  [[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
+  extract_legacy (frame_pool &pool, frame_ring &free_frames,
+                  frame_ring &captured_frames, frame_index index);
 
-  [[nodiscard]] std::string read_filename (const cv::Mat &frame,
-                                           std::size_t start_pos,
-                                           std::size_t filename_size) const;
+  // decodes count bytes starting at bit start_pos of the frame's data area
+  [[nodiscard]] static std::vector<std::byte>
+  read_bytes (const cv::Mat &frame, std::size_t start_pos, std::size_t count,
+              std::uint8_t threshold);
 
   metadata metadata_;
   std::filesystem::path path_;
+  std::pmr::memory_resource *resource_;
+  erasure_params erasure_{};
+  std::optional<std::uint32_t> failed_frame_{};
 };
 
 } // namespace ftv
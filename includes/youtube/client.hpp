@@ -1,5 +1,15 @@
 #pragma once
 
+#include "file/growing_file.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -7,10 +17,40 @@
 namespace ftv
 {
 
+// the servers the client talks to, a local stub server in tests. the data
+// api does not hand uploaded files back, media is a server that serves
+// them as <media>/<video id> with range support, such as a mirror. without
+// one downloads are not supported
+struct youtube_endpoints
+{
+  std::string api{ "https://www.googleapis.com" };
+  std::string token{ "https://oauth2.googleapis.com/token" };
+  std::string media{};
+};
+
+// uploads go out in requests of UPLOAD_CHUNK_SIZE bytes. the resumable
+// protocol wants every request but the last to be a multiple of
+// UPLOAD_CHUNK_ALIGN
+inline constexpr std::size_t UPLOAD_CHUNK_ALIGN{ std::size_t{ 256 } << 10 };
+inline constexpr std::size_t UPLOAD_CHUNK_SIZE{ 32 * UPLOAD_CHUNK_ALIGN };
+
+// failed requests in a row before an upload gives up. the wait before a
+// retry starts at UPLOAD_RETRY_DELAY and doubles with every failure
+inline constexpr std::size_t UPLOAD_MAX_RETRIES{ 8 };
+inline constexpr std::chrono::milliseconds UPLOAD_RETRY_DELAY{ 500 };
+
+// fills buffer with the video's bytes from offset on and returns how many
+// it wrote, fewer than buffer.size () only at the end of the video. offset
+// goes back to bytes read before when the server lost them
+using upload_source
+    = std::function<std::expected<std::size_t, std::error_code> (
+        std::uint64_t offset, std::span<std::byte> buffer)>;
+
 class youtube_client
 {
 public:
-  youtube_client (std::string client_id, std::string client_secret);
+  youtube_client (std::string client_id, std::string client_secret,
+                  youtube_endpoints endpoints = {});
 
   youtube_client (const youtube_client &) = delete;
   youtube_client &operator= (const youtube_client &) = delete;
@@ -20,15 +60,44 @@ public:
 
   ~youtube_client ();
 
-  std::error_code upload (std::string_view title, std::string_view description,
-                          std::string_view privacy = "private") const noexcept;
+  // trades a refresh token for the access token every request carries
+  [[nodiscard]] std::error_code
+  authorize (std::string_view refresh_token) noexcept;
+
+  // uploads the video at path with the resumable protocol, streaming it
+  // from disk a chunk at a time. a failed request is retried from the
+  // offset the server reports. returns the id of the new video
+  [[nodiscard]] std::expected<std::string, std::error_code>
+  upload (const std::filesystem::path &path, std::string_view title,
+          std::string_view description,
+          std::string_view privacy = "private") const noexcept;
 
-  std::error_code download (std::string_view video_id) const noexcept;
+  // uploads the video source reads. without a size the length is declared
+  // with the last chunk, so source can hand out a video that is still
+  // being produced
+  [[nodiscard]] std::expected<std::string, std::error_code>
+  upload (const upload_source &source, std::optional<std::uint64_t> size,
+          std::string_view title, std::string_view description,
+          std::string_view privacy = "private") const noexcept;
+
+  // downloads the video into output over several connections at once, see
+  // ranged_download. progress learns how much of output is there, so the
+  // video can be decoded while it arrives
+  [[nodiscard]] std::error_code
+  download (std::string_view video_id, const std::filesystem::path &output,
+            growing_file *progress = nullptr) const noexcept;
 
 private:
   std::string client_id_{};
   std::string client_secret_{};
+  youtube_endpoints endpoints_{};
   std::string access_token_{};
 };
 
+// a client for the credentials in the json file at path, authorized with
+// them: client_id, client_secret and refresh_token, and optionally api_url,
+// token_url and media_url to replace the endpoints
+[[nodiscard]] std::expected<youtube_client, std::error_code>
+load_youtube_client (const std::filesystem::path &path) noexcept;
+
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "file/growing_file.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace ftv
+{
+
+struct http_request
+{
+  std::string method{ "GET" };
+  std::string url{};
+  std::vector<std::string> headers{};
+  std::span<const std::byte> body{};
+};
+
+struct http_response
+{
+  long status{};
+  std::string body{};
+  std::string location{}; // the upload session of a resumable upload
+  std::string range{};    // what the session holds, "bytes=0-<last>"
+};
+
+// sends request and waits for the whole response. only failures without
+// an http status are errors
+[[nodiscard]] std::expected<http_response, std::error_code>
+http_perform (const http_request &request) noexcept;
+
+// the error for a request the server answered with status
+[[nodiscard]] std::error_code http_status_error (long status) noexcept;
+
+// whether a request that got status is worth sending again: server errors
+// and rate limits
+[[nodiscard]] bool http_retryable (long status) noexcept;
+
+// downloads are split into ranges of DOWNLOAD_RANGE_SIZE bytes that are
+// fetched over up to DOWNLOAD_CONNECTIONS connections at once, the lowest
+// missing range first. a failed range continues where it stopped after
+// DOWNLOAD_RETRY_DELAY, doubled with every failure, up to
+// DOWNLOAD_MAX_RETRIES times in a row
+inline constexpr std::size_t DOWNLOAD_RANGE_SIZE{ std::size_t{ 8 } << 20 };
+inline constexpr std::size_t DOWNLOAD_CONNECTIONS{ 4 };
+inline constexpr std::size_t DOWNLOAD_MAX_RETRIES{ 8 };
+inline constexpr std::chrono::milliseconds DOWNLOAD_RETRY_DELAY{ 500 };
+
+// downloads url into output with concurrent range requests. progress, if
+// given, learns about every byte of the prefix that is on disk, and is
+// finished when the download ends either way. a server without range
+// support is read in one go
+[[nodiscard]] std::error_code
+ranged_download (const std::string &url,
+                 std::span<const std::string> headers,
+                 const std::filesystem::path &output,
+                 growing_file *progress = nullptr,
+                 std::size_t connections = DOWNLOAD_CONNECTIONS) noexcept;
+
+} // namespace ftv
@@ -0,0 +1,515 @@
+#include "capi/ftv.h"
+
+#include "crypto/cipher.hpp"
+#include "crypto/secure_key.hpp"
+#include "pipeline/pipeline.hpp"
+#include "video/erasure.hpp"
+#include "video/metadata.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// the pipeline runs on a thread of the encoder, fed by ftv_encoder_push:
+// a push hands its buffer over and waits until the source stage has cut it
+// into chunks and the stages after it are done with them
+struct ftv_encoder
+{
+  std::mutex mutex{};
+  std::condition_variable changed{};
+  std::span<const std::byte> offered{};
+  bool offering{ false };
+  bool finishing{ false };
+  bool aborting{ false };
+  bool ended{ false };
+  std::error_code error{};
+  std::filesystem::path path{}; // empty when writing to a descriptor
+  std::vector<std::byte> staging{}; // small pushes, on the pipeline thread
+  std::jthread thread{};
+};
+
+// the decoder is driven by ftv_decoder_pull on the caller's thread, every
+// step of the job leaves the next chunk of plaintext in pending
+struct ftv_decoder
+{
+  std::span<const std::byte> pending{};
+  std::string filename{};
+  std::optional<ftv::progress_stream> job{};
+  std::optional<std::ranges::iterator_t<ftv::progress_stream>> position{};
+  bool finished{ false };
+  std::error_code error{};
+};
+
+namespace
+{
+
+[[noreturn]] void
+fail (std::errc error)
+{
+  throw std::system_error (std::make_error_code (error));
+}
+
+int
+error_value (std::error_code ec) noexcept
+{
+  return ec ? ec.value () : 0;
+}
+
+int
+current_error () noexcept
+{
+  return error_value (ftv::pipeline_error_code (std::current_exception ()));
+}
+
+bool
+valid_key (const char *key) noexcept
+{
+  return key != nullptr && std::strlen (key) <= 32;
+}
+
+// the buffers of ftv_encoder_push as chunks of PIPELINE_CHUNK_SIZE bytes.
+// whole chunks of a large push are yielded straight from the caller's
+// buffer, the rest is gathered in staging
+ftv::chunk_stream
+pushed_chunks (ftv_encoder &encoder)
+{
+  encoder.staging.reserve (ftv::PIPELINE_CHUNK_SIZE);
+  while (true)
+    {
+      std::span<const std::byte> data{};
+      {
+        std::unique_lock lock{ encoder.mutex };
+        encoder.changed.wait (lock, [&] {
+          return encoder.offering || encoder.finishing || encoder.aborting;
+        });
+        if (encoder.aborting)
+          {
+            fail (std::errc::operation_canceled);
+          }
+        if (!encoder.offering)
+          {
+            break;
+          }
+        data = encoder.offered;
+      }
+
+      while (!data.empty ())
+        {
+          if (encoder.staging.empty ()
+              && data.size () >= ftv::PIPELINE_CHUNK_SIZE)
+            {
+              co_yield ftv::chunk{ data.first (ftv::PIPELINE_CHUNK_SIZE) };
+              data = data.subspan (ftv::PIPELINE_CHUNK_SIZE);
+              continue;
+            }
+          const auto room
+              = ftv::PIPELINE_CHUNK_SIZE - encoder.staging.size ();
+          const auto taken = data.first (std::min (data.size (), room));
+          encoder.staging.insert (encoder.staging.end (), taken.begin (),
+                                  taken.end ());
+          data = data.subspan (taken.size ());
+          if (encoder.staging.size () == ftv::PIPELINE_CHUNK_SIZE)
+            {
+              co_yield ftv::chunk{ encoder.staging };
+              encoder.staging.clear ();
+            }
+        }
+
+      // the stages after this one are done with the buffer once they pull
+      // again
+      {
+        const std::lock_guard lock{ encoder.mutex };
+        encoder.offering = false;
+      }
+      encoder.changed.notify_all ();
+    }
+
+  if (!encoder.staging.empty ())
+    {
+      co_yield ftv::chunk{ encoder.staging };
+    }
+}
+
+// hands every chunk to ftv_decoder_pull through pending
+ftv::progress_stream
+pull_sink (ftv::chunk_stream chunks, std::span<const std::byte> &pending)
+{
+  std::size_t written = 0;
+  for (const ftv::chunk input : chunks)
+    {
+      // nothing to reference earlier plaintext in
+      if (input.reference)
+        {
+          fail (std::errc::operation_not_supported);
+        }
+      pending = input.bytes;
+      written += input.bytes.size ();
+      co_yield written;
+    }
+  pending = {};
+}
+
+// the encoder's metadata, nullopt for options out of range
+std::optional<std::pair<ftv::metadata, ftv::erasure_params>>
+encoder_setup (const ftv_encoder_options *given)
+{
+  ftv_encoder_options options{};
+  ftv_encoder_options_init (&options);
+  if (given != nullptr)
+    {
+      options = *given;
+    }
+
+  const ftv::erasure_params erasure{ options.erasure_data_frames,
+                                     options.erasure_parity_frames };
+  if (options.width < 100 || options.width > 4096 || options.height < 100
+      || options.height > 4096 || options.fps < 1 || options.fps > 60
+      || options.cipher < 0 || options.cipher > 0xff
+      || !ftv::known_cipher (static_cast<ftv::cipher_id> (options.cipher))
+      || !erasure.valid ())
+    {
+      return std::nullopt;
+    }
+
+  const std::string filename
+      = options.filename != nullptr && *options.filename != '\0'
+            ? options.filename
+            : "stream";
+  return std::pair{ ftv::metadata{ filename,
+                                   0,
+                                   {},
+                                   options.fps,
+                                   { options.width, options.height },
+                                   ftv::payload_format::chunk_stream,
+                                   static_cast<ftv::cipher_id> (
+                                       options.cipher) },
+                    erasure };
+}
+
+// starts the encoder's thread on the job sink makes of the frames
+template <typename Sink>
+int
+open_encoder (const char *key, const ftv_encoder_options *options,
+              std::filesystem::path path, ftv_encoder **encoder, Sink sink)
+{
+  if (encoder == nullptr || !valid_key (key))
+    {
+      return EINVAL;
+    }
+  *encoder = nullptr;
+  try
+    {
+      const auto setup = encoder_setup (options);
+      if (!setup)
+        {
+          return EINVAL;
+        }
+      if (!path.empty () && std::filesystem::exists (path))
+        {
+          return EEXIST;
+        }
+
+      auto opened = std::make_unique<ftv_encoder> ();
+      opened->path = std::move (path);
+      auto frames
+          = ftv::stream_frames (pushed_chunks (*opened),
+                                ftv::secure_key{ key }, setup->first,
+                                setup->second);
+      opened->thread = std::jthread{
+        [state = opened.get (),
+         job = sink (std::move (frames), setup->first)] () mutable {
+          const auto ec = ftv::run_job (std::move (job));
+          {
+            const std::lock_guard lock{ state->mutex };
+            state->ended = true;
+            state->error = ec;
+          }
+          state->changed.notify_all ();
+        }
+      };
+      *encoder = opened.release ();
+      return 0;
+    }
+  catch (...)
+    {
+      return current_error ();
+    }
+}
+
+// steps the decoder's job to its first chunk
+int
+start_decoder (ftv_decoder &decoder) noexcept
+{
+  try
+    {
+      decoder.position.emplace (decoder.job->begin ());
+      decoder.finished = *decoder.position == decoder.job->end ();
+      return 0;
+    }
+  catch (...)
+    {
+      return current_error ();
+    }
+}
+
+template <typename Frames>
+int
+open_decoder (const char *key, ftv_decoder **decoder, Frames frames)
+{
+  if (decoder == nullptr || !valid_key (key))
+    {
+      return EINVAL;
+    }
+  *decoder = nullptr;
+  try
+    {
+      auto opened = std::make_unique<ftv_decoder> ();
+      opened->job.emplace (ftv::stream_decode_job (
+          frames (), ftv::secure_key{ key },
+          [state = opened.get ()] (ftv::chunk_stream chunks,
+                                   const ftv::metadata &meta) {
+            state->filename = meta.filename ();
+            return pull_sink (std::move (chunks), state->pending);
+          }));
+      if (const int error = start_decoder (*opened))
+        {
+          return error;
+        }
+      *decoder = opened.release ();
+      return 0;
+    }
+  catch (...)
+    {
+      return current_error ();
+    }
+}
+
+} // namespace
+
+extern "C"
+{
+
+  int
+  ftv_api_version (void)
+  {
+    return FTV_API_VERSION;
+  }
+
+  void
+  ftv_encoder_options_init (ftv_encoder_options *options)
+  {
+    if (options == nullptr)
+      {
+        return;
+      }
+    *options = { nullptr, 300, 300, 30, FTV_CIPHER_AES_256_GCM, 0, 0 };
+  }
+
+  int
+  ftv_encoder_open (const char *path, const char *key,
+                    const ftv_encoder_options *options,
+                    ftv_encoder **encoder)
+  {
+    if (path == nullptr || *path == '\0')
+      {
+        return EINVAL;
+      }
+    return open_encoder (
+        key, options, path, encoder,
+        [output = std::filesystem::path{ path }] (ftv::frame_stream frames,
+                                                  const ftv::metadata &meta) {
+          return ftv::frame_sink (std::move (frames), output, meta);
+        });
+  }
+
+  int
+  ftv_encoder_open_fd (int fd, const char *key,
+                       const ftv_encoder_options *options,
+                       ftv_encoder **encoder)
+  {
+    if (fd < 0)
+      {
+        return EBADF;
+      }
+    return open_encoder (key, options, {}, encoder,
+                         [fd] (ftv::frame_stream frames,
+                               const ftv::metadata &meta) {
+                           return ftv::avi_sink (std::move (frames), fd,
+                                                 meta);
+                         });
+  }
+
+  int
+  ftv_encoder_push (ftv_encoder *encoder, const void *data, size_t size)
+  {
+    if (encoder == nullptr || (data == nullptr && size > 0))
+      {
+        return EINVAL;
+      }
+    if (size == 0)
+      {
+        return 0;
+      }
+
+    std::unique_lock lock{ encoder->mutex };
+    if (encoder->ended)
+      {
+        return encoder->error ? error_value (encoder->error) : EPIPE;
+      }
+    encoder->offered
+        = { static_cast<const std::byte *> (data), std::size_t{ size } };
+    encoder->offering = true;
+    encoder->changed.notify_all ();
+    encoder->changed.wait (
+        lock, [&] { return !encoder->offering || encoder->ended; });
+    if (encoder->offering)
+      {
+        // the pipeline failed before it was done with data
+        encoder->offering = false;
+        return encoder->error ? error_value (encoder->error) : EPIPE;
+      }
+    return 0;
+  }
+
+  int
+  ftv_encoder_finish (ftv_encoder *encoder)
+  {
+    if (encoder == nullptr)
+      {
+        return EINVAL;
+      }
+    {
+      const std::lock_guard lock{ encoder->mutex };
+      encoder->finishing = true;
+    }
+    encoder->changed.notify_all ();
+    encoder->thread.join ();
+    const int error = error_value (encoder->error);
+    // a failed video is left behind no more than an aborted one
+    if (error != 0 && !encoder->path.empty ())
+      {
+        std::error_code ignored{};
+        std::filesystem::remove (encoder->path, ignored);
+      }
+    delete encoder;
+    return error;
+  }
+
+  void
+  ftv_encoder_abort (ftv_encoder *encoder)
+  {
+    if (encoder == nullptr)
+      {
+        return;
+      }
+    {
+      const std::lock_guard lock{ encoder->mutex };
+      encoder->aborting = true;
+    }
+    encoder->changed.notify_all ();
+    encoder->thread.join ();
+    if (!encoder->path.empty ())
+      {
+        std::error_code ignored{};
+        std::filesystem::remove (encoder->path, ignored);
+      }
+    delete encoder;
+  }
+
+  int
+  ftv_decoder_open (const char *path, const char *key, ftv_decoder **decoder)
+  {
+    if (path == nullptr || *path == '\0')
+      {
+        return EINVAL;
+      }
+    return open_decoder (key, decoder, [input = std::string{ path }] {
+      return ftv::avi_frames (input);
+    });
+  }
+
+  int
+  ftv_decoder_open_fd (int fd, const char *key, ftv_decoder **decoder)
+  {
+    if (fd < 0)
+      {
+        return EBADF;
+      }
+    return open_decoder (key, decoder,
+                         [fd] { return ftv::descriptor_frames (fd); });
+  }
+
+  const char *
+  ftv_decoder_filename (const ftv_decoder *decoder)
+  {
+    return decoder == nullptr ? nullptr : decoder->filename.c_str ();
+  }
+
+  int
+  ftv_decoder_pull (ftv_decoder *decoder, void *buffer, size_t capacity,
+                    size_t *size)
+  {
+    if (decoder == nullptr || size == nullptr
+        || (buffer == nullptr && capacity > 0))
+      {
+        return EINVAL;
+      }
+    *size = 0;
+    if (decoder->error)
+      {
+        return error_value (decoder->error);
+      }
+
+    auto *out = static_cast<std::byte *> (buffer);
+    while (*size < capacity)
+      {
+        if (!decoder->pending.empty ())
+          {
+            const auto taken
+                = std::min (decoder->pending.size (), capacity - *size);
+            std::memcpy (out + *size, decoder->pending.data (), taken);
+            decoder->pending = decoder->pending.subspan (taken);
+            *size += taken;
+            continue;
+          }
+        if (decoder->finished)
+          {
+            break;
+          }
+        try
+          {
+            ++*decoder->position;
+            decoder->finished = *decoder->position == decoder->job->end ();
+          }
+        catch (...)
+          {
+            // what was copied already is dropped with the failed stream
+            decoder->error
+                = ftv::pipeline_error_code (std::current_exception ());
+            *size = 0;
+            return error_value (decoder->error);
+          }
+      }
+    return 0;
+  }
+
+  void
+  ftv_decoder_close (ftv_decoder *decoder)
+  {
+    delete decoder;
+  }
+
+} // extern "C"
@@ -0,0 +1,159 @@
+#include "crypto/aead_stream.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <openssl/rand.h>
+
+namespace ftv
+{
+
+aead_stream::aead_stream (EVP_CIPHER_CTX *ctx, cipher_direction direction)
+    : ctx_ (ctx), direction_ (direction)
+{
+}
+
+[[nodiscard]] std::expected<aead_stream, std::error_code>
+aead_stream::seal (const secure_key &key, std::span<std::byte> init_vec,
+                   cipher_id cipher) noexcept
+{
+  if (key.size () != 32 || init_vec.size () != 12 || !known_cipher (cipher))
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
+    }
+
+  // generate random iv (12 bytes for either cipher)
+  if (RAND_bytes (reinterpret_cast<unsigned char *> (init_vec.data ()),
+                  static_cast<std::int32_t> (init_vec.size ()))
+      != 1)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::operation_canceled));
+    }
+
+  // reuses this thread's context and key schedule when the key is unchanged
+  auto *context = thread_cipher_context (cipher_algorithm (cipher),
+                                         cipher_direction::encrypt);
+  EVP_CIPHER_CTX *ctx
+      = context ? context->prepare (key.get (), init_vec) : nullptr;
+  if (!ctx)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::operation_canceled));
+    }
+  return aead_stream{ ctx, cipher_direction::encrypt };
+}
+
+[[nodiscard]] std::expected<aead_stream, std::error_code>
+aead_stream::open (const secure_key &key, std::span<const std::byte> init_vec,
+                   std::span<const std::byte> tag, cipher_id cipher) noexcept
+{
+  if (key.size () != 32 || init_vec.size () != 12 || tag.size () != 16
+      || !known_cipher (cipher))
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
+    }
+
+  auto *context = thread_cipher_context (cipher_algorithm (cipher),
+                                         cipher_direction::decrypt);
+  EVP_CIPHER_CTX *ctx
+      = context ? context->prepare (key.get (), init_vec) : nullptr;
+  if (!ctx)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::operation_canceled));
+    }
+
+  // set expected tag
+  if (!EVP_CIPHER_CTX_ctrl (
+          ctx, EVP_CTRL_AEAD_SET_TAG, 16,
+          const_cast<unsigned char *> (
+              reinterpret_cast<const unsigned char *> (tag.data ()))))
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::operation_canceled));
+    }
+  return aead_stream{ ctx, cipher_direction::decrypt };
+}
+
+[[nodiscard]] std::error_code
+aead_stream::additional_data (std::span<const std::byte> data) noexcept
+{
+  std::int32_t outlen = 0;
+  const auto *in = reinterpret_cast<const unsigned char *> (data.data ());
+  const auto length = static_cast<std::int32_t> (data.size ());
+  const int result
+      = this->direction_ == cipher_direction::encrypt
+            ? EVP_EncryptUpdate (this->ctx_, nullptr, &outlen, in, length)
+            : EVP_DecryptUpdate (this->ctx_, nullptr, &outlen, in, length);
+  return result ? std::error_code{}
+                : std::make_error_code (std::errc::operation_canceled);
+}
+
+[[nodiscard]] std::error_code
+aead_stream::update (std::span<const std::byte> in,
+                            std::span<std::byte> out) noexcept
+{
+  if (out.size () != in.size ())
+    {
+      return std::make_error_code (std::errc::invalid_argument);
+    }
+
+  // both ciphers are stream modes, output length equals input length.
+  // updates are capped to stay within openssl's int lengths
+  constexpr std::size_t max_update = std::size_t{ 1 } << 30;
+  std::size_t written = 0;
+  for (std::size_t offset = 0; offset < in.size (); offset += max_update)
+    {
+      const auto length = std::min (max_update, in.size () - offset);
+      auto *out_ptr
+          = reinterpret_cast<unsigned char *> (out.data () + written);
+      const auto *in_ptr
+          = reinterpret_cast<const unsigned char *> (in.data () + offset);
+      std::int32_t outlen = 0;
+      const int result
+          = this->direction_ == cipher_direction::encrypt
+                ? EVP_EncryptUpdate (this->ctx_, out_ptr, &outlen, in_ptr,
+                                     static_cast<std::int32_t> (length))
+                : EVP_DecryptUpdate (this->ctx_, out_ptr, &outlen, in_ptr,
+                                     static_cast<std::int32_t> (length));
+      if (!result)
+        {
+          return std::make_error_code (std::errc::operation_canceled);
+        }
+      written += static_cast<std::size_t> (outlen);
+    }
+  return {};
+}
+
+[[nodiscard]] std::error_code
+aead_stream::finish (std::span<std::byte> tag) noexcept
+{
+  // neither cipher buffers anything, final never produces output
+  unsigned char unused[EVP_MAX_BLOCK_LENGTH];
+  std::int32_t final_len = 0;
+
+  if (this->direction_ == cipher_direction::decrypt)
+    {
+      // authentication failed or decryption error
+      return EVP_DecryptFinal_ex (this->ctx_, unused, &final_len)
+                 ? std::error_code{}
+                 : std::make_error_code (std::errc::operation_canceled);
+    }
+
+  if (tag.size () != 16)
+    {
+      return std::make_error_code (std::errc::invalid_argument);
+    }
+  if (!EVP_EncryptFinal_ex (this->ctx_, unused, &final_len)
+      || !EVP_CIPHER_CTX_ctrl (this->ctx_, EVP_CTRL_AEAD_GET_TAG, 16,
+                               reinterpret_cast<unsigned char *> (tag.data ())))
+    {
+      return std::make_error_code (std::errc::operation_canceled);
+    }
+  return {};
+}
+
+} // namespace ftv
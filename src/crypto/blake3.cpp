@@ -0,0 +1,547 @@
+#include "crypto/blake3.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace ftv
+{
+
+namespace
+{
+
+using words = blake3_hasher::words;
+
+template <std::size_t count> using lanes = std::array<std::uint32_t, count>;
+
+inline constexpr words IV{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                           0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+// the order the message words are used in by the next round
+inline constexpr std::array<std::size_t, 16> PERMUTATION{
+  2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8
+};
+
+inline constexpr std::size_t BLOCK_SIZE{ 64 };
+inline constexpr std::size_t CHUNK_BLOCKS{ BLAKE3_CHUNK_SIZE / BLOCK_SIZE };
+
+inline constexpr std::uint32_t CHUNK_START{ 1 };
+inline constexpr std::uint32_t CHUNK_END{ 2 };
+inline constexpr std::uint32_t PARENT{ 4 };
+inline constexpr std::uint32_t ROOT{ 8 };
+
+// subtrees below this size are hashed by the thread that has them, a
+// thread costs more than they take
+inline constexpr std::size_t PARALLEL_MIN{ std::size_t{ 256 } << 10 };
+
+// the g function. every step is its own loop over the lanes, which the
+// compiler turns into a few vector instructions
+template <std::size_t count>
+void
+mix (std::array<lanes<count>, 16> &v, std::size_t a, std::size_t b,
+     std::size_t c, std::size_t d, const lanes<count> &x,
+     const lanes<count> &y) noexcept
+{
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[a][i] += v[b][i] + x[i];
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[d][i] = std::rotr (v[d][i] ^ v[a][i], 16);
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[c][i] += v[d][i];
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[b][i] = std::rotr (v[b][i] ^ v[c][i], 12);
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[a][i] += v[b][i] + y[i];
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[d][i] = std::rotr (v[d][i] ^ v[a][i], 8);
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[c][i] += v[d][i];
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[b][i] = std::rotr (v[b][i] ^ v[c][i], 7);
+    }
+}
+
+// the compression function on count inputs at once, lane i of every word
+// belongs to input i. cv becomes the first half of the output
+template <std::size_t count>
+void
+compress (std::array<lanes<count>, 8> &cv,
+          std::array<lanes<count>, 16> message,
+          const std::array<std::uint64_t, count> &counter,
+          std::uint32_t block_size,
+          const lanes<count> &flags) noexcept
+{
+  std::array<lanes<count>, 16> v{};
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      v[word] = cv[word];
+      v[word + 8].fill (IV[word]);
+    }
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      v[12][i] = static_cast<std::uint32_t> (counter[i]);
+      v[13][i] = static_cast<std::uint32_t> (counter[i] >> 32);
+      v[14][i] = block_size;
+      v[15][i] = flags[i];
+    }
+
+  for (std::size_t round = 0; round < 7; ++round)
+    {
+      mix (v, 0, 4, 8, 12, message[0], message[1]);
+      mix (v, 1, 5, 9, 13, message[2], message[3]);
+      mix (v, 2, 6, 10, 14, message[4], message[5]);
+      mix (v, 3, 7, 11, 15, message[6], message[7]);
+      mix (v, 0, 5, 10, 15, message[8], message[9]);
+      mix (v, 1, 6, 11, 12, message[10], message[11]);
+      mix (v, 2, 7, 8, 13, message[12], message[13]);
+      mix (v, 3, 4, 9, 14, message[14], message[15]);
+
+      const auto used = message;
+      for (std::size_t word = 0; word < 16; ++word)
+        {
+          message[word] = used[PERMUTATION[word]];
+        }
+    }
+
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      for (std::size_t i = 0; i < count; ++i)
+        {
+          cv[word][i] = v[word][i] ^ v[word + 8][i];
+        }
+    }
+}
+
+// the little endian message words of a block, zero padded
+[[nodiscard]] std::array<lanes<1>, 16>
+load_block (std::span<const std::byte> block) noexcept
+{
+  std::array<std::byte, BLOCK_SIZE> padded{};
+  std::ranges::copy (block, padded.begin ());
+  std::array<lanes<1>, 16> message{};
+  for (std::size_t word = 0; word < 16; ++word)
+    {
+      std::memcpy (&message[word][0], padded.data () + word * 4, 4);
+      if constexpr (std::endian::native == std::endian::big)
+        {
+          message[word][0] = std::byteswap (message[word][0]);
+        }
+    }
+  return message;
+}
+
+// compresses one block into cv
+void
+compress_one (words &cv, std::span<const std::byte> block,
+              std::uint64_t counter, std::uint32_t flags) noexcept
+{
+  std::array<lanes<1>, 8> state{};
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      state[word][0] = cv[word];
+    }
+  compress<1> (state, load_block (block), { counter },
+               static_cast<std::uint32_t> (block.size ()), { flags });
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      cv[word] = state[word][0];
+    }
+}
+
+[[nodiscard]] words
+parent_cv (const words &left, const words &right,
+           std::uint32_t flags = 0) noexcept
+{
+  std::array<std::byte, BLOCK_SIZE> block{};
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      const std::uint32_t l = std::endian::native == std::endian::big
+                                  ? std::byteswap (left[word])
+                                  : left[word];
+      const std::uint32_t r = std::endian::native == std::endian::big
+                                  ? std::byteswap (right[word])
+                                  : right[word];
+      std::memcpy (block.data () + word * 4, &l, 4);
+      std::memcpy (block.data () + 32 + word * 4, &r, 4);
+    }
+  words cv = IV;
+  compress_one (cv, block, 0, PARENT | flags);
+  return cv;
+}
+
+// the chaining value of chunk counter, 1 to BLAKE3_CHUNK_SIZE bytes.
+// extra flags its last block
+[[nodiscard]] words
+chunk_cv (std::span<const std::byte> chunk, std::uint64_t counter,
+          std::uint32_t extra = 0) noexcept
+{
+  words cv = IV;
+  const std::size_t blocks
+      = std::max<std::size_t> ((chunk.size () + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                               1);
+  for (std::size_t block = 0; block < blocks; ++block)
+    {
+      const std::uint32_t flags
+          = (block == 0 ? CHUNK_START : 0)
+            | (block + 1 == blocks ? CHUNK_END | extra : 0);
+      const auto rest = chunk.subspan (block * BLOCK_SIZE);
+      compress_one (cv, rest.first (std::min (BLOCK_SIZE, rest.size ())),
+                    counter, flags);
+    }
+  return cv;
+}
+
+// the chaining values of count whole chunks from counter on, lane by lane
+template <std::size_t count>
+void
+full_chunk_cvs (const std::byte *input, std::uint64_t counter,
+                words *out) noexcept
+{
+  std::array<lanes<count>, 8> cv{};
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      cv[word].fill (IV[word]);
+    }
+  std::array<std::uint64_t, count> counters{};
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      counters[i] = counter + i;
+    }
+
+  for (std::size_t block = 0; block < CHUNK_BLOCKS; ++block)
+    {
+      std::array<lanes<count>, 16> message{};
+      for (std::size_t i = 0; i < count; ++i)
+        {
+          const auto words_of = load_block (std::span (
+              input + i * BLAKE3_CHUNK_SIZE + block * BLOCK_SIZE,
+              BLOCK_SIZE));
+          for (std::size_t word = 0; word < 16; ++word)
+            {
+              message[word][i] = words_of[word][0];
+            }
+        }
+      lanes<count> flags{};
+      flags.fill ((block == 0 ? CHUNK_START : 0)
+                  | (block + 1 == CHUNK_BLOCKS ? CHUNK_END : 0));
+      compress<count> (cv, message, counters,
+                       static_cast<std::uint32_t> (BLOCK_SIZE), flags);
+    }
+
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      for (std::size_t word = 0; word < 8; ++word)
+        {
+          out[i][word] = cv[word][i];
+        }
+    }
+}
+
+// chunks in the left subtree of a tree over chunks chunks
+[[nodiscard]] std::size_t
+left_chunks (std::size_t chunks) noexcept
+{
+  return std::bit_floor (chunks - 1);
+}
+
+// merges the chaining values of the chunks of one subtree into its own
+[[nodiscard]] words
+merge_cvs (std::span<const words> cvs) noexcept
+{
+  if (cvs.size () == 1)
+    {
+      return cvs.front ();
+    }
+  const std::size_t left = left_chunks (cvs.size ());
+  return parent_cv (merge_cvs (cvs.first (left)),
+                    merge_cvs (cvs.subspan (left)));
+}
+
+// the chaining value of the subtree over input, which starts with chunk
+// counter and is not the whole input, on threads threads
+[[nodiscard]] words
+subtree_cv (std::span<const std::byte> input, std::uint64_t counter,
+            std::size_t threads)
+{
+  const std::size_t chunks
+      = (input.size () + BLAKE3_CHUNK_SIZE - 1) / BLAKE3_CHUNK_SIZE;
+  if (chunks <= BLAKE3_LANES)
+    {
+      std::array<words, BLAKE3_LANES> cvs{};
+      const std::size_t full = input.size () / BLAKE3_CHUNK_SIZE;
+      if (full == BLAKE3_LANES)
+        {
+          full_chunk_cvs<BLAKE3_LANES> (input.data (), counter, cvs.data ());
+        }
+      else
+        {
+          for (std::size_t chunk = 0; chunk < full; ++chunk)
+            {
+              full_chunk_cvs<1> (input.data () + chunk * BLAKE3_CHUNK_SIZE,
+                                 counter + chunk, &cvs[chunk]);
+            }
+        }
+      if (full < chunks)
+        {
+          cvs[full] = chunk_cv (input.subspan (full * BLAKE3_CHUNK_SIZE),
+                                counter + full);
+        }
+      return merge_cvs (std::span (cvs).first (chunks));
+    }
+
+  const std::size_t left = left_chunks (chunks) * BLAKE3_CHUNK_SIZE;
+  const auto left_input = input.first (left);
+  const auto right_input = input.subspan (left);
+  const std::uint64_t right_counter = counter + left / BLAKE3_CHUNK_SIZE;
+  if (threads < 2 || input.size () < PARALLEL_MIN)
+    {
+      return parent_cv (subtree_cv (left_input, counter, 1),
+                        subtree_cv (right_input, right_counter, 1));
+    }
+
+  words left_cv{};
+  words right_cv{};
+  {
+    const std::jthread worker{ [&] {
+      left_cv = subtree_cv (left_input, counter, threads / 2);
+    } };
+    right_cv = subtree_cv (right_input, right_counter,
+                           threads - threads / 2);
+  }
+  return parent_cv (left_cv, right_cv);
+}
+
+[[nodiscard]] blake3_digest
+to_digest (const words &cv) noexcept
+{
+  blake3_digest digest{};
+  for (std::size_t word = 0; word < 8; ++word)
+    {
+      const std::uint32_t value = std::endian::native == std::endian::big
+                                      ? std::byteswap (cv[word])
+                                      : cv[word];
+      std::memcpy (digest.data () + word * 4, &value, 4);
+    }
+  return digest;
+}
+
+} // namespace
+
+blake3_hasher::blake3_hasher (std::size_t threads) noexcept
+    : threads_{ std::max<std::size_t> (threads, 1) }, cv_{ IV }
+{
+}
+
+void
+blake3_hasher::update (std::span<const std::byte> data)
+{
+  // the chunk being filled takes what it still has room for. a full chunk
+  // stays open until more input shows it is not the last one
+  const auto fill = [this] (std::span<const std::byte> &input) {
+    while (!input.empty ()
+           && (this->blocks_ < CHUNK_BLOCKS - 1
+               || this->block_size_ < BLOCK_SIZE))
+      {
+        if (this->block_size_ == BLOCK_SIZE)
+          {
+            compress_one (this->cv_, this->block_, this->chunk_,
+                          this->blocks_ == 0 ? CHUNK_START : 0);
+            ++this->blocks_;
+            this->block_size_ = 0;
+          }
+        const std::size_t take
+            = std::min (BLOCK_SIZE - this->block_size_, input.size ());
+        std::memcpy (this->block_.data () + this->block_size_,
+                     input.data (), take);
+        this->block_size_ += take;
+        input = input.subspan (take);
+      }
+  };
+
+  const auto filled = [this] {
+    return this->blocks_ * BLOCK_SIZE + this->block_size_;
+  };
+
+  if (filled () > 0)
+    {
+      fill (data);
+      if (data.empty ())
+        {
+          return;
+        }
+      // the chunk is full and not the last
+      auto last = this->cv_;
+      compress_one (last, this->block_, this->chunk_,
+                    CHUNK_END | (this->blocks_ == 0 ? CHUNK_START : 0));
+      this->push (last, this->chunk_);
+      this->cv_ = IV;
+      ++this->chunk_;
+      this->blocks_ = 0;
+      this->block_size_ = 0;
+    }
+
+  // whole subtrees that line up with the chunks before them are hashed at
+  // once. one that takes the rest of the input may still be the root, so
+  // it goes on the stack as its two halves
+  while (data.size () > BLAKE3_CHUNK_SIZE)
+    {
+      std::size_t size = std::bit_floor (data.size ());
+      const std::uint64_t before = this->chunk_ * BLAKE3_CHUNK_SIZE;
+      while (((size - 1) & before) != 0)
+        {
+          size /= 2;
+        }
+      const std::uint64_t chunks = size / BLAKE3_CHUNK_SIZE;
+      if (chunks <= 1)
+        {
+          this->push (chunk_cv (data.first (size), this->chunk_),
+                      this->chunk_);
+        }
+      else
+        {
+          const std::size_t half = size / 2;
+          this->push (subtree_cv (data.first (half), this->chunk_,
+                                  this->threads_),
+                      this->chunk_);
+          this->push (subtree_cv (data.subspan (half, half),
+                                  this->chunk_ + chunks / 2, this->threads_),
+                      this->chunk_ + chunks / 2);
+        }
+      this->chunk_ += chunks;
+      data = data.subspan (size);
+    }
+
+  if (!data.empty ())
+    {
+      fill (data);
+      this->merge (this->chunk_);
+    }
+}
+
+void
+blake3_hasher::defer_first_chunk () noexcept
+{
+  this->deferred_ = true;
+  this->chunk_ = 1;
+  this->stack_size_ = 1;
+}
+
+void
+blake3_hasher::first_chunk (std::span<const std::byte> chunk) noexcept
+{
+  // nothing followed, the first chunk is the whole input
+  if (this->chunk_ == 1 && this->blocks_ == 0 && this->block_size_ == 0)
+    {
+      this->deferred_ = false;
+      this->chunk_ = 0;
+      this->stack_size_ = 0;
+      this->update (chunk);
+      return;
+    }
+
+  // the entries of the subtree the first chunk starts, from the bottom of
+  // the stack, become one. if that subtree is all there is, its last level
+  // stays apart, the merge with it is the root
+  this->merge (this->chunk_);
+  this->deferred_ = false;
+  const auto levels = static_cast<std::size_t> (std::bit_width (this->chunk_));
+  const bool open = this->blocks_ > 0 || this->block_size_ > 0;
+  const std::size_t merged
+      = open || this->stack_size_ > levels ? levels : levels - 1;
+  words left = chunk_cv (chunk, 0);
+  for (std::size_t level = 1; level < merged; ++level)
+    {
+      left = parent_cv (left, this->stack_[level]);
+    }
+  this->stack_[0] = left;
+  std::copy (this->stack_.begin () + static_cast<std::ptrdiff_t> (merged),
+             this->stack_.begin ()
+                 + static_cast<std::ptrdiff_t> (this->stack_size_),
+             this->stack_.begin () + 1);
+  this->stack_size_ -= merged - 1;
+}
+
+[[nodiscard]] blake3_digest
+blake3_hasher::digest () const noexcept
+{
+  const bool open = this->blocks_ > 0 || this->block_size_ > 0;
+  if (this->stack_size_ == 0)
+    {
+      auto root = this->cv_;
+      compress_one (root,
+                    std::span (this->block_).first (this->block_size_), 0,
+                    CHUNK_END | ROOT
+                        | (this->blocks_ == 0 ? CHUNK_START : 0));
+      return to_digest (root);
+    }
+
+  // the open chunk, or the last subtree on the stack, is merged with every
+  // subtree left of it. the last merge is the root
+  std::size_t remaining = this->stack_size_;
+  words right{};
+  if (open)
+    {
+      right = this->cv_;
+      compress_one (right,
+                    std::span (this->block_).first (this->block_size_),
+                    this->chunk_,
+                    CHUNK_END | (this->blocks_ == 0 ? CHUNK_START : 0));
+    }
+  else
+    {
+      right = this->stack_[--remaining];
+    }
+  while (remaining > 1)
+    {
+      right = parent_cv (this->stack_[--remaining], right);
+    }
+  return to_digest (parent_cv (this->stack_[0], right, ROOT));
+}
+
+void
+blake3_hasher::push (const words &cv, std::uint64_t chunk) noexcept
+{
+  this->merge (chunk);
+  this->stack_[this->stack_size_++] = cv;
+}
+
+void
+blake3_hasher::merge (std::uint64_t chunks) noexcept
+{
+  auto keep = static_cast<std::size_t> (std::popcount (chunks));
+  if (this->deferred_)
+    {
+      keep += static_cast<std::size_t> (std::bit_width (chunks)) - 1;
+    }
+  while (this->stack_size_ > keep)
+    {
+      const auto right = this->stack_[--this->stack_size_];
+      const auto left = this->stack_[--this->stack_size_];
+      this->stack_[this->stack_size_++] = parent_cv (left, right);
+    }
+}
+
+[[nodiscard]] blake3_digest
+blake3 (std::span<const std::byte> data, std::size_t threads)
+{
+  blake3_hasher hasher{ threads };
+  hasher.update (data);
+  return hasher.digest ();
+}
+
+} // namespace ftv
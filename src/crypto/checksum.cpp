@@ -1,16 +1,19 @@
 #include "crypto/checksum.hpp"
 
-#include <functional>
-#include <string_view>
-
 namespace ftv
 {
 
-[[nodiscard]] std::size_t
+[[nodiscard]] blake3_digest
 hash (std::span<const std::byte> data)
 {
-  return std::hash<std::string_view>{}(std::string_view (
-      reinterpret_cast<const char *> (data.data ()), data.size ()));
+  return blake3 (data);
+}
+
+[[nodiscard]] bool
+checksum_matches (std::span<const std::byte> data,
+                  const blake3_digest &checksum)
+{
+  return hash (data) == checksum;
 }
 
 } // namespace ftv
@@ -0,0 +1,119 @@
+#include "crypto/cipher_pool.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <openssl/crypto.h>
+
+namespace ftv
+{
+
+cipher_context::cipher_context (std::string_view algorithm,
+                                cipher_direction direction)
+    : cipher_{ EVP_CIPHER_fetch (nullptr, std::string (algorithm).c_str (),
+                                 nullptr),
+               &EVP_CIPHER_free },
+      algorithm_ (algorithm), direction_ (direction)
+{
+  if (!this->cipher_)
+    {
+      throw std::runtime_error (
+          std::format ("failed to fetch cipher: {}", algorithm));
+    }
+}
+
+cipher_context::~cipher_context () { this->forget_key (); }
+
+[[nodiscard]] EVP_CIPHER_CTX *
+cipher_context::prepare (std::span<const std::byte> key,
+                         std::span<const std::byte> init_vec) noexcept
+{
+  if (key.size () > this->key_.size ())
+    {
+      return nullptr;
+    }
+
+  const bool same_key
+      = this->key_size_ == key.size ()
+        && CRYPTO_memcmp (this->key_.data (), key.data (), key.size ()) == 0;
+
+  // passing a null cipher and key keeps the current key schedule and only
+  // resets the iv and the message state
+  const EVP_CIPHER *cipher = same_key ? nullptr : this->cipher_.get ();
+  const auto *key_ptr
+      = same_key ? nullptr
+                 : reinterpret_cast<const unsigned char *> (key.data ());
+  const auto *iv_ptr
+      = reinterpret_cast<const unsigned char *> (init_vec.data ());
+
+  const int result
+      = this->direction_ == cipher_direction::encrypt
+            ? EVP_EncryptInit_ex2 (this->ctx_, cipher, key_ptr, iv_ptr,
+                                   nullptr)
+            : EVP_DecryptInit_ex2 (this->ctx_, cipher, key_ptr, iv_ptr,
+                                   nullptr);
+  if (!result)
+    {
+      this->forget_key ();
+      return nullptr;
+    }
+
+  if (!same_key)
+    {
+      std::ranges::copy (key, this->key_.begin ());
+      this->key_size_ = key.size ();
+    }
+  return this->ctx_;
+}
+
+[[nodiscard]] std::string_view
+cipher_context::algorithm () const noexcept
+{
+  return this->algorithm_;
+}
+
+[[nodiscard]] cipher_direction
+cipher_context::direction () const noexcept
+{
+  return this->direction_;
+}
+
+void
+cipher_context::forget_key () noexcept
+{
+  OPENSSL_cleanse (this->key_.data (), this->key_.size ());
+  this->key_size_ = 0;
+}
+
+[[nodiscard]] cipher_context *
+thread_cipher_context (std::string_view algorithm,
+                       cipher_direction direction) noexcept
+{
+  // unique_ptr keeps handed out references stable while the cache grows
+  thread_local std::vector<std::unique_ptr<cipher_context>> cache{};
+
+  for (const auto &context : cache)
+    {
+      if (context->algorithm () == algorithm
+          && context->direction () == direction)
+        {
+          return context.get ();
+        }
+    }
+
+  try
+    {
+      cache.push_back (
+          std::make_unique<cipher_context> (algorithm, direction));
+      return cache.back ().get ();
+    }
+  catch (...)
+    {
+      return nullptr;
+    }
+}
+
+} // namespace ftv
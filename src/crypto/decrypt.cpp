@@ -1,5 +1,5 @@
 #include "crypto/decrypt.hpp"
-#include "crypto/evp_cipher_raii.hpp"
+#include "crypto/aead_stream.hpp"
 #include <cstdint>
 #include <functional>
 #include <utility>
@@ -7,78 +7,137 @@
 namespace ftv
 {
 
+namespace
+{
+
+// decrypts encrypted with cipher into a new buffer
 std::expected<file, std::error_code>
-aes_256_gcm_decrypt (const encrypted_data &encrypted, const secure_key &key)
+open_copy (const encrypted_data &encrypted, const secure_key &key,
+           cipher_id cipher)
 {
-  if (key.size () != 32)
+  std::pmr::vector<std::byte> plaintext (encrypted.ciphertext ().size ());
+
+  if (const auto ec
+      = aead_open (encrypted.ciphertext (), plaintext, encrypted.init_vec (),
+                   encrypted.tag (), key, cipher))
     {
-      return std::expected<file, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::invalid_argument)) };
+      return std::expected<file, std::error_code>{ std::unexpected (ec) };
     }
 
-  if (encrypted.init_vec ().size () != 12 || encrypted.tag ().size () != 16)
+  const std::filesystem::path temp_path
+      = std::filesystem::temp_directory_path () / "decrypted_temp";
+
+  // create file object, handing over the plaintext buffer
+  return std::expected<file, std::error_code>{ file (temp_path,
+                                                     std::move (plaintext)) };
+}
+
+} // namespace
+
+[[nodiscard]] std::error_code
+aead_open (std::span<const std::byte> ciphertext,
+           std::span<std::byte> plaintext,
+           std::span<const std::byte> init_vec,
+           std::span<const std::byte> tag, const secure_key &key,
+           cipher_id cipher) noexcept
+{
+  if (plaintext.size () != ciphertext.size ())
     {
-      return std::expected<file, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::invalid_argument)) };
+      return std::make_error_code (std::errc::invalid_argument);
     }
 
-  evp_cipher ctx{};
-  std::vector<std::byte> plaintext (encrypted.ciphertext ().size ());
-  std::int32_t outlen = 0;
-  std::int32_t final_len = 0;
-
-  // initialize decryption
-  if (!EVP_DecryptInit_ex (
-          ctx, EVP_aes_256_gcm (), nullptr,
-          reinterpret_cast<const unsigned char *> (key.get ().data ()),
-          reinterpret_cast<const unsigned char *> (
-              encrypted.init_vec ().data ())))
+  auto stream = aead_stream::open (key, init_vec, tag, cipher);
+  if (!stream)
     {
-      return std::expected<file, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+      return stream.error ();
+    }
+  // plaintext may alias ciphertext for in place operation
+  if (const auto ec = stream->update (ciphertext, plaintext))
+    {
+      return ec;
     }
+  // verify authentication tag
+  return stream->finish ();
+}
 
-  // set expected tag
-  if (!EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_TAG, 16,
-                            const_cast<unsigned char *> (
-                                reinterpret_cast<const unsigned char *> (
-                                    encrypted.tag ().data ()))))
+std::expected<file, std::error_code>
+aes_256_gcm_decrypt (const encrypted_data &encrypted, const secure_key &key)
+{
+  return open_copy (encrypted, key, cipher_id::aes_256_gcm);
+}
+
+std::expected<file, std::error_code>
+chacha20_poly1305_decrypt (const encrypted_data &encrypted,
+                           const secure_key &key)
+{
+  return open_copy (encrypted, key, cipher_id::chacha20_poly1305);
+}
+
+[[nodiscard]] std::expected<std::span<const std::byte>, std::error_code>
+decrypt_in_place (encrypted_data &encrypted, const secure_key &key,
+                  cipher_id cipher) noexcept
+{
+  const auto ciphertext = encrypted.mutable_ciphertext ();
+  if (ciphertext.empty () && !encrypted.ciphertext ().empty ())
     {
-      return std::expected<file, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+      // borrowed ciphertext can not be overwritten
+      return std::unexpected (
+          std::make_error_code (std::errc::operation_not_permitted));
     }
 
-  // decrypt ciphertext
-  if (!EVP_DecryptUpdate (
-          ctx, reinterpret_cast<unsigned char *> (plaintext.data ()), &outlen,
-          reinterpret_cast<const unsigned char *> (
-              encrypted.ciphertext ().data ()),
-          static_cast<int> (encrypted.ciphertext ().size ())))
+  if (const auto ec = aead_open (ciphertext, ciphertext,
+                                 encrypted.init_vec (), encrypted.tag (),
+                                 key, cipher))
     {
-      return std::expected<file, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+      return std::unexpected (ec);
     }
 
-  // finalize decryption and verify authentication tag
-  if (!EVP_DecryptFinal_ex (
-          ctx, reinterpret_cast<unsigned char *> (plaintext.data () + outlen),
-          &final_len))
+  return std::span<const std::byte>{ ciphertext };
+}
+
+[[nodiscard]] std::error_code
+decrypt_to_file (encrypted_data &encrypted, const secure_key &key,
+                 const std::filesystem::path &path, cipher_id cipher) noexcept
+{
+  if (path.empty ())
     {
-      // authentication failed or decryption error
-      return std::expected<file, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+      return std::make_error_code (std::errc::invalid_argument);
+    }
+  if (std::filesystem::exists (path))
+    {
+      return std::make_error_code (std::errc::file_exists);
     }
 
-  // resize to actual decrypted size
-  plaintext.resize (static_cast<size_t> (outlen + final_len));
+  const auto ciphertext = encrypted.mutable_ciphertext ();
+  if (ciphertext.empty () && !encrypted.ciphertext ().empty ())
+    {
+      return std::make_error_code (std::errc::operation_not_permitted);
+    }
 
-  const std::filesystem::path temp_path
-      = std::filesystem::temp_directory_path () / "decrypted_temp";
+  auto stream = aead_stream::open (key, encrypted.init_vec (),
+                                  encrypted.tag (), cipher);
+  if (!stream)
+    {
+      return stream.error ();
+    }
 
-  // create file object
-  const file decrypted_file (temp_path, plaintext);
+  // each chunk is decrypted in place right before it is queued for writing,
+  // overlapping with the writes of the chunks before it
+  auto ec = write_from (ciphertext, path, [&] (std::span<std::byte> chunk) {
+    return stream->update (chunk, chunk);
+  });
+  if (!ec)
+    {
+      ec = stream->finish ();
+    }
 
-  return std::expected<file, std::error_code>{ std::move (decrypted_file) };
+  if (ec)
+    {
+      // never leave unauthenticated plaintext behind
+      std::error_code ignored{};
+      std::filesystem::remove (path, ignored);
+    }
+  return ec;
 }
 
 [[nodiscard]] std::expected<file, std::error_code>
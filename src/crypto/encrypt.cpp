@@ -1,82 +1,214 @@
 #include "crypto/encrypt.hpp"
-#include "crypto/evp_cipher_raii.hpp"
+#include "crypto/aead_stream.hpp"
+#include "crypto/checksum.hpp"
+#include "crypto/serialize.hpp"
 
+#include <algorithm>
+#include <array>
 #include <expected>
+#include <thread>
 #include <utility>
 
-#include <openssl/evp.h>
-#include <openssl/rand.h>
 
 namespace ftv
 {
 
+namespace
+{
+
+// seals data with cipher straight into a buffer in serialized layout, so
+// serializing the result does not copy the ciphertext again
 std::expected<encrypted_data, std::error_code>
-aes_256_gcm (std::span<const std::byte> data, const secure_key &key) noexcept
+seal_serialized (std::span<const std::byte> data, const secure_key &key,
+                 cipher_id cipher) noexcept
 {
-  if (key.size () != 32)
+  try
     {
-      return std::expected<encrypted_data, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::invalid_argument)) };
+      constexpr std::size_t iv_size = 12;
+      constexpr std::size_t tag_size = 16;
+      constexpr auto layout = make_serialized_layout (iv_size, tag_size);
+
+      auto buffer = make_serialized_buffer (iv_size, tag_size, data.size ());
+      const std::span<std::byte> bytes{ buffer };
+
+      if (const auto ec = aead_seal (
+              data, bytes.subspan (layout.ciphertext_offset),
+              bytes.subspan (layout.init_vec_offset, iv_size),
+              bytes.subspan (layout.tag_offset, tag_size), key, cipher))
+        {
+          return std::expected<encrypted_data, std::error_code>{
+            std::unexpected (ec)
+          };
+        }
+
+      return deserialize_encrypted_data (std::move (buffer));
     }
-
-  // generate random iv (12 bytes for GCM)
-  std::vector<std::byte> init_vec (12);
-  if (RAND_bytes (reinterpret_cast<unsigned char *> (init_vec.data ()),
-                  static_cast<std::int32_t> (init_vec.size ()))
-      != 1)
+  catch (const std::exception &)
     {
       return std::expected<encrypted_data, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+          std::make_error_code (std::errc::not_enough_memory)) };
     }
+}
 
-  evp_cipher ctx{};
-  std::vector<std::byte> ciphertext (data.size () + EVP_MAX_BLOCK_LENGTH);
-  std::vector<std::byte> tag (16);
-  std::int32_t outlen{};
+} // namespace
 
-  std::span<const unsigned char> key_span{
-    reinterpret_cast<const unsigned char *> (key.get ().data ()), key.size ()
-  };
+[[nodiscard]] std::error_code
+aead_seal (std::span<const std::byte> data, std::span<std::byte> ciphertext,
+           std::span<std::byte> init_vec, std::span<std::byte> tag,
+           const secure_key &key, cipher_id cipher) noexcept
+{
+  if (ciphertext.size () != data.size ())
+    {
+      return std::make_error_code (std::errc::invalid_argument);
+    }
 
-  if (!EVP_EncryptInit_ex (
-          ctx, EVP_aes_256_gcm (), nullptr, key_span.data (),
-          reinterpret_cast<unsigned char *> (init_vec.data ())))
+  auto stream = aead_stream::seal (key, init_vec, cipher);
+  if (!stream)
     {
-      return std::expected<encrypted_data, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+      return stream.error ();
     }
+  if (const auto ec = stream->update (data, ciphertext))
+    {
+      return ec;
+    }
+  return stream->finish (tag);
+}
+
+std::expected<encrypted_data, std::error_code>
+aes_256_gcm (std::span<const std::byte> data, const secure_key &key) noexcept
+{
+  return seal_serialized (data, key, cipher_id::aes_256_gcm);
+}
+
+std::expected<encrypted_data, std::error_code>
+chacha20_poly1305 (std::span<const std::byte> data,
+                   const secure_key &key) noexcept
+{
+  return seal_serialized (data, key, cipher_id::chacha20_poly1305);
+}
 
-  if (!EVP_EncryptUpdate (
-          ctx, reinterpret_cast<unsigned char *> (ciphertext.data ()), &outlen,
-          reinterpret_cast<const unsigned char *> (data.data ()),
-          static_cast<std::int32_t> (data.size ())))
+std::expected<encrypted_data, std::error_code>
+encrypt_in_place (std::pmr::vector<std::byte> &&data, const secure_key &key,
+                  cipher_id cipher) noexcept
+{
+  try
+    {
+      std::array<std::byte, 12> init_vec{};
+      std::array<std::byte, 16> tag{};
+      if (const auto ec
+          = aead_seal (data, data, init_vec, tag, key, cipher))
+        {
+          return std::expected<encrypted_data, std::error_code>{
+            std::unexpected (ec)
+          };
+        }
+
+      return std::expected<encrypted_data, std::error_code>{ encrypted_data{
+          std::move (data), init_vec, tag } };
+    }
+  catch (const std::exception &)
     {
       return std::expected<encrypted_data, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+          std::make_error_code (std::errc::not_enough_memory)) };
     }
+}
 
-  std::int32_t final_len;
-  if (!EVP_EncryptFinal_ex (
-          ctx, reinterpret_cast<unsigned char *> (ciphertext.data () + outlen),
-          &final_len))
+std::expected<encrypted_data, std::error_code>
+encrypt_file (const std::filesystem::path &path, const secure_key &key,
+              cipher_id cipher, std::pmr::memory_resource *resource,
+              blake3_digest *checksum) noexcept
+{
+  try
+    {
+      constexpr std::size_t iv_size = 12;
+      constexpr std::size_t tag_size = 16;
+      constexpr auto layout = make_serialized_layout (iv_size, tag_size);
+
+      const auto file_size = std::filesystem::file_size (path);
+      if (file_size == 0)
+        {
+          return std::expected<encrypted_data, std::error_code>{
+            std::unexpected (std::make_error_code (std::errc::invalid_argument))
+          };
+        }
+
+      auto buffer
+          = make_serialized_buffer (iv_size, tag_size, file_size, resource);
+      const std::span<std::byte> bytes{ buffer };
+
+      auto stream = aead_stream::seal (
+          key, bytes.subspan (layout.init_vec_offset, iv_size), cipher);
+      if (!stream)
+        {
+          return std::expected<encrypted_data, std::error_code>{
+            std::unexpected (stream.error ())
+          };
+        }
+
+      // the checksum takes each chunk right after it is encrypted. the
+      // first blake3 chunk holds the iv and tag, which are known last
+      blake3_hasher hasher{ std::thread::hardware_concurrency () };
+      const bool deferred = bytes.size () > BLAKE3_CHUNK_SIZE;
+      if (deferred)
+        {
+          hasher.defer_first_chunk ();
+        }
+      std::size_t hashed = BLAKE3_CHUNK_SIZE;
+
+      // the file lands straight in the ciphertext area and every chunk is
+      // encrypted in place while the following chunks are still being read
+      if (const auto ec = read_into (
+              path, bytes.subspan (layout.ciphertext_offset),
+              [&] (std::span<std::byte> chunk) {
+                if (const auto sealed = stream->update (chunk, chunk))
+                  {
+                    return sealed;
+                  }
+                const auto end = static_cast<std::size_t> (
+                    chunk.data () + chunk.size () - bytes.data ());
+                if (checksum && deferred && end > hashed)
+                  {
+                    hasher.update (bytes.subspan (hashed, end - hashed));
+                    hashed = end;
+                  }
+                return std::error_code{};
+              }))
+        {
+          return std::expected<encrypted_data, std::error_code>{
+            std::unexpected (ec)
+          };
+        }
+
+      if (const auto ec
+          = stream->finish (bytes.subspan (layout.tag_offset, tag_size)))
+        {
+          return std::expected<encrypted_data, std::error_code>{
+            std::unexpected (ec)
+          };
+        }
+
+      if (checksum && deferred)
+        {
+          hasher.first_chunk (bytes.first (BLAKE3_CHUNK_SIZE));
+          *checksum = hasher.digest ();
+        }
+      else if (checksum)
+        {
+          *checksum = hash (bytes);
+        }
+
+      return deserialize_encrypted_data (std::move (buffer));
+    }
+  catch (const std::filesystem::filesystem_error &e)
     {
       return std::expected<encrypted_data, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+          e.code ()) };
     }
-
-  if (!EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_GET_TAG, 16,
-                            reinterpret_cast<unsigned char *> (tag.data ())))
+  catch (const std::exception &)
     {
       return std::expected<encrypted_data, std::error_code>{ std::unexpected (
-          std::make_error_code (std::errc::operation_canceled)) };
+          std::make_error_code (std::errc::not_enough_memory)) };
     }
-
-  ciphertext.resize (static_cast<std::size_t> (outlen + final_len));
-
-  return
-
-      std::expected<encrypted_data, std::error_code>{ ftv::encrypted_data{
-          std::move (ciphertext), std::move (init_vec), std::move (tag) } };
 }
 
 [[nodiscard]] std::expected<encrypted_data, std::error_code>
@@ -2,24 +2,24 @@
 #include "crypto/serialize.hpp"
 #include "file/file.hpp"
 
-#include <fstream>
 #include <utility>
 
 namespace ftv
 {
 
-encrypted_data::encrypted_data (const std::filesystem::path &path)
+encrypted_data::encrypted_data (const std::filesystem::path &path,
+                                std::pmr::memory_resource *resource)
+    : storage_ (resource), params_ (resource)
 {
-  if (const auto data = read (path))
+  if (auto data = read (path, resource))
     {
-      auto deserialized = deserialize_encrypted_data (*data);
+      // adopt the read buffer instead of copying the fields out of it
+      auto deserialized = deserialize_encrypted_data (std::move (*data));
       if (!deserialized)
         {
           throw std::runtime_error ("Failed to deserialize data");
         }
-      ciphertext_ = std::move (deserialized->ciphertext ());
-      init_vec_ = std::move (deserialized->init_vec ());
-      tag_ = std::move (deserialized->tag ());
+      *this = std::move (*deserialized);
     }
   else
     {
@@ -46,12 +46,114 @@ encrypted_data::encrypted_data (const std::filesystem::path &path)
     }
 }
 
-encrypted_data::encrypted_data (std::vector<std::byte> ciphertext,
-                                std::vector<std::byte> init_vec,
-                                std::vector<std::byte> tag)
-    : ciphertext_ (std::move (ciphertext)), init_vec_ (std::move (init_vec)),
-      tag_ (std::move (tag))
+encrypted_data::encrypted_data (std::pmr::vector<std::byte> ciphertext,
+                                std::span<const std::byte> init_vec,
+                                std::span<const std::byte> tag)
+    : storage_ (std::move (ciphertext)),
+      params_ (this->storage_.get_allocator ())
 {
+  this->params_.reserve (init_vec.size () + tag.size ());
+  this->params_.insert (this->params_.end (), init_vec.begin (),
+                        init_vec.end ());
+  this->params_.insert (this->params_.end (), tag.begin (), tag.end ());
+
+  const std::span<const std::byte> params{ this->params_ };
+  this->ciphertext_ = this->storage_;
+  this->init_vec_ = params.first (init_vec.size ());
+  this->tag_ = params.subspan (init_vec.size ());
+}
+
+encrypted_data::encrypted_data (std::pmr::vector<std::byte> storage,
+                                std::span<const std::byte> ciphertext,
+                                std::span<const std::byte> init_vec,
+                                std::span<const std::byte> tag,
+                                std::span<const std::byte> serialized)
+    : storage_ (std::move (storage)), ciphertext_ (ciphertext),
+      init_vec_ (init_vec), tag_ (tag), serialized_ (serialized)
+{
+}
+
+namespace
+{
+
+// re-points view from one buffer to the same offset in another
+[[nodiscard]] std::span<const std::byte>
+rebase (std::span<const std::byte> view, std::span<const std::byte> from,
+        std::span<const std::byte> to) noexcept
+{
+  const auto *begin = from.data ();
+  if (view.empty () || view.data () < begin
+      || view.data () + view.size () > begin + from.size ())
+    {
+      return view;
+    }
+  return to.subspan (static_cast<std::size_t> (view.data () - begin),
+                    view.size ());
+}
+
+} // namespace
+
+encrypted_data::encrypted_data (const encrypted_data &other)
+    : storage_ (other.storage_), params_ (other.params_)
+{
+  const auto rebase_owned = [&] (std::span<const std::byte> view) {
+    return rebase (rebase (view, other.storage_, this->storage_),
+                   other.params_, this->params_);
+  };
+  this->ciphertext_ = rebase_owned (other.ciphertext_);
+  this->init_vec_ = rebase_owned (other.init_vec_);
+  this->tag_ = rebase_owned (other.tag_);
+  this->serialized_ = rebase_owned (other.serialized_);
+}
+
+encrypted_data &
+encrypted_data::operator= (const encrypted_data &other)
+{
+  if (this != &other)
+    {
+      *this = encrypted_data (other);
+    }
+  return *this;
+}
+
+encrypted_data &
+encrypted_data::operator= (encrypted_data &&other)
+{
+  if (this == &other)
+    {
+      return *this;
+    }
+
+  // polymorphic allocators do not propagate on move assignment, storage
+  // from another memory resource is copied and the views have to follow
+  const std::span<const std::byte> old_storage{ other.storage_ };
+  const std::span<const std::byte> old_params{ other.params_ };
+  this->storage_ = std::move (other.storage_);
+  this->params_ = std::move (other.params_);
+
+  const auto rebase_owned = [&] (std::span<const std::byte> view) {
+    return rebase (rebase (view, old_storage, this->storage_), old_params,
+                   this->params_);
+  };
+  this->ciphertext_ = rebase_owned (other.ciphertext_);
+  this->init_vec_ = rebase_owned (other.init_vec_);
+  this->tag_ = rebase_owned (other.tag_);
+  this->serialized_ = rebase_owned (other.serialized_);
+  return *this;
+}
+
+[[nodiscard]] encrypted_data
+encrypted_data::view (std::span<const std::byte> ciphertext,
+                      std::span<const std::byte> init_vec,
+                      std::span<const std::byte> tag,
+                      std::span<const std::byte> serialized) noexcept
+{
+  encrypted_data data{};
+  data.ciphertext_ = ciphertext;
+  data.init_vec_ = init_vec;
+  data.tag_ = tag;
+  data.serialized_ = serialized;
+  return data;
 }
 
 [[nodiscard]] std::expected<file, std::error_code>
@@ -63,54 +165,66 @@ encrypted_data::to_file (const std::filesystem::path &path) const noexcept
       return std::expected<file, std::error_code>{ std::unexpected (
           serialized.error ()) };
     }
-  return std::expected<file, std::error_code>{ file{ path, *serialized } };
+  try
+    {
+      return std::expected<file, std::error_code>{ file{
+          path, serialized->to_vec () } };
+    }
+  catch (const std::exception &)
+    {
+      return std::expected<file, std::error_code>{ std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory)) };
+    }
 }
 
-[[nodiscard]] const std::vector<std::byte> &
+[[nodiscard]] std::span<const std::byte>
 encrypted_data::ciphertext () const noexcept
 {
   return this->ciphertext_;
 }
 
-[[nodiscard]] const std::vector<std::byte> &
+[[nodiscard]] std::span<const std::byte>
 encrypted_data::init_vec () const noexcept
 {
   return this->init_vec_;
 }
 
-[[nodiscard]] const std::vector<std::byte> &
+[[nodiscard]] std::span<const std::byte>
 encrypted_data::tag () const noexcept
 {
   return this->tag_;
 }
 
-std::error_code
-encrypted_data::save (const std::filesystem::path &path) const noexcept
+[[nodiscard]] std::span<std::byte>
+encrypted_data::mutable_ciphertext () noexcept
 {
-  try
+  const auto *begin = this->storage_.data ();
+  if (this->ciphertext_.empty () || this->ciphertext_.data () < begin
+      || this->ciphertext_.data () + this->ciphertext_.size ()
+             > begin + this->storage_.size ())
     {
-      const auto serialized_data = serialize_encrypted_data (*this);
-
-      std::ofstream file (path, std::ios::binary);
-      if (!file)
-        {
-          return std::make_error_code (std::errc::no_such_file_or_directory);
-        }
-
-      file.write (reinterpret_cast<const char *> (serialized_data->data ()),
-                  static_cast<std::streamsize> (serialized_data->size ()));
-
-      if (!file)
-        {
-          return std::make_error_code (std::errc::io_error);
-        }
-
       return {};
     }
-  catch (...)
+  return std::span{ this->storage_ }.subspan (
+      static_cast<std::size_t> (this->ciphertext_.data () - begin),
+      this->ciphertext_.size ());
+}
+
+[[nodiscard]] std::span<const std::byte>
+encrypted_data::serialized () const noexcept
+{
+  return this->serialized_;
+}
+
+std::error_code
+encrypted_data::save (const std::filesystem::path &path) const noexcept
+{
+  const auto serialized_data = serialize_encrypted_data (*this);
+  if (!serialized_data)
     {
-      return std::make_error_code (std::errc::io_error);
+      return serialized_data.error ();
     }
+  return write_segments (serialized_data->segments (), path);
 }
 
 } // namespace ftv
@@ -8,124 +8,178 @@
 namespace ftv
 {
 
-[[nodiscard]] std::expected<std::vector<std::byte>, std::error_code>
-serialize_encrypted_data (const encrypted_data &data) noexcept
+namespace
 {
-  if (data.init_vec ().empty () || data.tag ().empty ())
+
+// validated positions of the fields inside a serialized buffer
+struct parsed_layout
+{
+  serialized_layout offsets{};
+  std::size_t iv_size{};
+  std::size_t tag_size{};
+};
+
+[[nodiscard]] std::expected<parsed_layout, std::error_code>
+parse_layout (std::span<const std::byte> serialized_data) noexcept
+{
+  // need at least 8 bytes for the size fields
+  if (serialized_data.size () < 8)
     {
-      return std::expected<std::vector<std::byte>, std::error_code> (
-          std::unexpected (
-              std::make_error_code (std::errc::invalid_argument)));
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
     }
 
-  try
+  std::size_t offset = 0;
+
+  // read iv size
+  std::uint32_t iv_size;
+  std::memcpy (&iv_size, serialized_data.data () + offset, sizeof (iv_size));
+  offset += sizeof (iv_size);
+
+  // validate iv size and remaining data
+  if (iv_size == 0
+      || serialized_data.size () < offset + iv_size + sizeof (std::uint32_t))
     {
-      const size_t total_size = 4 +                         // iv size field
-                                data.init_vec ().size () +  // iv data
-                                4 +                         // tag size field
-                                data.tag ().size () +       // tag data
-                                data.ciphertext ().size (); // ciphertext
-
-      std::vector<std::byte> serialized{};
-      serialized.reserve (total_size);
-
-      // add iv size
-      const auto iv_size
-          = static_cast<std::uint32_t> (data.init_vec ().size ());
-      std::ranges::copy (
-          std::span{ reinterpret_cast<const std::byte *> (&iv_size), 4 },
-          std::back_inserter (serialized));
-
-      // add iv data
-      std::ranges::copy (data.init_vec (), std::back_inserter (serialized));
-
-      // add tag size
-      const auto tag_size = static_cast<std::uint32_t> (data.tag ().size ());
-      std::ranges::copy (
-          std::span{ reinterpret_cast<const std::byte *> (&tag_size), 4 },
-          std::back_inserter (serialized));
-
-      // add tag data
-      std::ranges::copy (data.tag (), std::back_inserter (serialized));
-
-      // add ciphertext
-      std::ranges::copy (data.ciphertext (), std::back_inserter (serialized));
-
-      return std::expected<std::vector<std::byte>, std::error_code> (
-          std::move (serialized));
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
     }
-  catch (const std::exception &)
+  offset += iv_size;
+
+  // read tag size
+  std::uint32_t tag_size;
+  std::memcpy (&tag_size, serialized_data.data () + offset, sizeof (tag_size));
+  offset += sizeof (tag_size);
+
+  // validate tag size and remaining data
+  if (tag_size == 0 || serialized_data.size () < offset + tag_size)
     {
-      return std::expected<std::vector<std::byte>, std::error_code> (
-          std::unexpected (
-              std::make_error_code (std::errc::not_enough_memory)));
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
     }
+
+  return parsed_layout{ make_serialized_layout (iv_size, tag_size), iv_size,
+                        tag_size };
 }
 
-[[nodiscard]]
-std::expected<encrypted_data, std::error_code>
-deserialize_encrypted_data (
-    std::span<const std::byte> serialized_data) noexcept
+void
+write_size_field (std::span<std::byte> out, std::size_t size) noexcept
 {
-  // need at least 8 bytes for the size fields
-  if (serialized_data.size () < 8)
+  const auto field = static_cast<std::uint32_t> (size);
+  std::memcpy (out.data (), &field, sizeof (field));
+}
+
+} // namespace
+
+serialized_data::serialized_data (std::pmr::memory_resource *resource)
+    : header_ (resource), segments_ (resource)
+{
+}
+
+[[nodiscard]] std::span<const std::span<const std::byte>>
+serialized_data::segments () const noexcept
+{
+  return this->segments_;
+}
+
+[[nodiscard]] std::size_t
+serialized_data::size () const noexcept
+{
+  std::size_t total = 0;
+  for (const auto &segment : this->segments_)
     {
-      return std::expected<encrypted_data, std::error_code> (std::unexpected (
+      total += segment.size ();
+    }
+  return total;
+}
+
+[[nodiscard]] std::pmr::vector<std::byte>
+serialized_data::to_vec (std::pmr::memory_resource *resource) const
+{
+  std::pmr::vector<std::byte> bytes (this->size (), resource);
+  auto out = bytes.begin ();
+  for (const auto &segment : this->segments_)
+    {
+      out = std::ranges::copy (segment, out).out;
+    }
+  return bytes;
+}
+
+[[nodiscard]] std::expected<serialized_data, std::error_code>
+serialize_encrypted_data (const encrypted_data &data,
+                          std::pmr::memory_resource *resource) noexcept
+{
+  if (data.init_vec ().empty () || data.tag ().empty ())
+    {
+      return std::expected<serialized_data, std::error_code> (std::unexpected (
           std::make_error_code (std::errc::invalid_argument)));
     }
 
   try
     {
-      size_t offset = 0;
-
-      // read iv size
-      std::uint32_t iv_size;
-      std::memcpy (&iv_size, serialized_data.data () + offset,
-                   sizeof (iv_size));
-      offset += sizeof (iv_size);
-
-      // validate iv size and remaining data
-      if (iv_size == 0
-          || serialized_data.size ()
-                 < offset + iv_size + sizeof (std::uint32_t))
+      serialized_data serialized{ resource };
+
+      // already laid out for the wire, nothing to gather
+      if (!data.serialized ().empty ())
         {
-          return std::unexpected (
-              std::make_error_code (std::errc::invalid_argument));
+          serialized.segments_.push_back (data.serialized ());
+          return std::expected<serialized_data, std::error_code> (
+              std::move (serialized));
         }
 
-      // extract iv data
-      std::vector<std::byte> init_vec (
-          serialized_data.begin () + static_cast<ssize_t> (offset),
-          serialized_data.begin () + static_cast<ssize_t> (offset) + iv_size);
-      offset += iv_size;
+      const auto layout = make_serialized_layout (data.init_vec ().size (),
+                                                  data.tag ().size ());
+      serialized.header_.resize (layout.ciphertext_offset);
+      const std::span<std::byte> header{ serialized.header_ };
 
-      // read tag size
-      std::uint32_t tag_size;
-      std::memcpy (&tag_size, serialized_data.data () + offset,
-                   sizeof (tag_size));
-      offset += sizeof (tag_size);
+      write_size_field (header, data.init_vec ().size ());
+      std::ranges::copy (data.init_vec (),
+                         header.begin ()
+                             + static_cast<std::ptrdiff_t> (
+                                 layout.init_vec_offset));
 
-      // validate tag size and remaining data
-      if (tag_size == 0 || serialized_data.size () < offset + tag_size)
-        {
-          return std::expected<encrypted_data, std::error_code> (
-              std::unexpected (
-                  std::make_error_code (std::errc::invalid_argument)));
-        }
+      write_size_field (header.subspan (layout.tag_offset - 4),
+                        data.tag ().size ());
+      std::ranges::copy (data.tag (),
+                         header.begin ()
+                             + static_cast<std::ptrdiff_t> (layout.tag_offset));
 
-      // extract tag data
-      std::vector<std::byte> tag (
-          serialized_data.begin () + static_cast<ssize_t> (offset),
-          serialized_data.begin () + static_cast<ssize_t> (offset) + tag_size);
-      offset += tag_size;
+      // the ciphertext is referenced, not copied
+      serialized.segments_.push_back (serialized.header_);
+      serialized.segments_.push_back (data.ciphertext ());
 
-      // extract remaining data as ciphertext
-      std::vector<std::byte> ciphertext (serialized_data.begin ()
-                                             + static_cast<ssize_t> (offset),
-                                         serialized_data.end ());
+      return std::expected<serialized_data, std::error_code> (
+          std::move (serialized));
+    }
+  catch (const std::exception &)
+    {
+      return std::expected<serialized_data, std::error_code> (std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory)));
+    }
+}
 
-      return std::expected<encrypted_data, std::error_code>{ encrypted_data (
-          std::move (ciphertext), std::move (init_vec), std::move (tag)) };
+[[nodiscard]] std::pmr::vector<std::byte>
+make_serialized_buffer (std::size_t iv_size, std::size_t tag_size,
+                        std::size_t ciphertext_size,
+                        std::pmr::memory_resource *resource)
+{
+  const auto layout = make_serialized_layout (iv_size, tag_size);
+  std::pmr::vector<std::byte> buffer (
+      layout.ciphertext_offset + ciphertext_size, resource);
+  write_size_field (buffer, iv_size);
+  write_size_field (std::span{ buffer }.subspan (layout.tag_offset - 4),
+                    tag_size);
+  return buffer;
+}
+
+[[nodiscard]]
+std::expected<encrypted_data, std::error_code>
+deserialize_encrypted_data (std::span<const std::byte> serialized_data,
+                            std::pmr::memory_resource *resource) noexcept
+{
+  try
+    {
+      return deserialize_encrypted_data (std::pmr::vector<std::byte> (
+          serialized_data.begin (), serialized_data.end (), resource));
     }
   catch (const std::exception &)
     {
@@ -134,4 +188,45 @@ deserialize_encrypted_data (
     }
 }
 
+[[nodiscard]]
+std::expected<encrypted_data, std::error_code>
+deserialize_encrypted_data (
+    std::pmr::vector<std::byte> &&serialized_data) noexcept
+{
+  const auto layout = parse_layout (serialized_data);
+  if (!layout)
+    {
+      return std::expected<encrypted_data, std::error_code> (
+          std::unexpected (layout.error ()));
+    }
+
+  // the views stay valid because moving a vector keeps its buffer
+  const std::span<const std::byte> bytes{ serialized_data };
+  const auto &offsets = layout->offsets;
+  return std::expected<encrypted_data, std::error_code>{ encrypted_data (
+      std::move (serialized_data),
+      bytes.subspan (offsets.ciphertext_offset),
+      bytes.subspan (offsets.init_vec_offset, layout->iv_size),
+      bytes.subspan (offsets.tag_offset, layout->tag_size), bytes) };
+}
+
+[[nodiscard]]
+std::expected<encrypted_data, std::error_code>
+view_encrypted_data (std::span<const std::byte> serialized_data) noexcept
+{
+  const auto layout = parse_layout (serialized_data);
+  if (!layout)
+    {
+      return std::expected<encrypted_data, std::error_code> (
+          std::unexpected (layout.error ()));
+    }
+
+  const auto &offsets = layout->offsets;
+  return std::expected<encrypted_data, std::error_code>{ encrypted_data::view (
+      serialized_data.subspan (offsets.ciphertext_offset),
+      serialized_data.subspan (offsets.init_vec_offset, layout->iv_size),
+      serialized_data.subspan (offsets.tag_offset, layout->tag_size),
+      serialized_data) };
+}
+
 } // namespace ftv
@@ -0,0 +1,107 @@
+#include "daemon/client.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ftv
+{
+
+daemon_client::daemon_client (int fd) noexcept : fd_ (fd), reader_ (fd) {}
+
+daemon_client::daemon_client (daemon_client &&other) noexcept
+    : fd_ (std::exchange (other.fd_, -1)),
+      reader_ (std::move (other.reader_))
+{
+}
+
+daemon_client &
+daemon_client::operator= (daemon_client &&other) noexcept
+{
+  if (this != &other)
+    {
+      if (this->fd_ >= 0)
+        {
+          ::close (this->fd_);
+        }
+      this->fd_ = std::exchange (other.fd_, -1);
+      this->reader_ = std::move (other.reader_);
+    }
+  return *this;
+}
+
+daemon_client::~daemon_client ()
+{
+  if (this->fd_ >= 0)
+    {
+      ::close (this->fd_);
+    }
+}
+
+std::expected<daemon_client, std::error_code>
+daemon_client::connect (const std::filesystem::path &socket) noexcept
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string path = socket.string ();
+  if (path.empty () || path.size () >= sizeof (address.sun_path))
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::filename_too_long));
+    }
+  std::memcpy (address.sun_path, path.c_str (), path.size () + 1);
+
+  const int fd = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    {
+      return std::unexpected (std::error_code{ errno,
+                                               std::system_category () });
+    }
+  if (::connect (fd, reinterpret_cast<const sockaddr *> (&address),
+                 sizeof (address))
+      != 0)
+    {
+      const std::error_code ec{ errno, std::system_category () };
+      ::close (fd);
+      return std::unexpected (ec);
+    }
+  return daemon_client{ fd };
+}
+
+std::expected<reply, std::error_code>
+daemon_client::call (const message &request)
+{
+  if (const auto ec = write_line (this->fd_, format_message (request)))
+    {
+      return std::unexpected (ec);
+    }
+
+  reply answer{};
+  while (true)
+    {
+      const auto line = this->reader_.next ();
+      if (!line)
+        {
+          return std::unexpected (line.error ());
+        }
+      auto parsed = parse_message (*line);
+      if (!parsed)
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::bad_message));
+        }
+      if (parsed->verb != "job")
+        {
+          answer.result = std::move (*parsed);
+          return answer;
+        }
+      answer.jobs.push_back (std::move (*parsed));
+    }
+}
+
+} // namespace ftv
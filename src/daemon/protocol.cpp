@@ -0,0 +1,221 @@
+#include "daemon/protocol.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+void
+append_escaped (std::string &out, std::string_view value)
+{
+  for (const char c : value)
+    {
+      switch (c)
+        {
+        case '\t':
+          out += "\\t";
+          break;
+        case '\n':
+          out += "\\n";
+          break;
+        case '\\':
+          out += "\\\\";
+          break;
+        default:
+          out += c;
+        }
+    }
+}
+
+std::expected<std::string, std::error_code>
+unescape (std::string_view value)
+{
+  std::string out{};
+  out.reserve (value.size ());
+  for (std::size_t i = 0; i < value.size (); ++i)
+    {
+      if (value[i] != '\\')
+        {
+          out += value[i];
+          continue;
+        }
+      if (++i == value.size ())
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::invalid_argument));
+        }
+      switch (value[i])
+        {
+        case 't':
+          out += '\t';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case '\\':
+          out += '\\';
+          break;
+        default:
+          return std::unexpected (
+              std::make_error_code (std::errc::invalid_argument));
+        }
+    }
+  return out;
+}
+
+} // namespace
+
+std::optional<std::string>
+message::field (std::string_view name) const
+{
+  const auto found = this->fields.find (name);
+  if (found == this->fields.end ())
+    {
+      return std::nullopt;
+    }
+  return found->second;
+}
+
+std::string
+format_message (const message &msg)
+{
+  std::string line{};
+  append_escaped (line, msg.verb);
+  for (const auto &[name, value] : msg.fields)
+    {
+      line += '\t';
+      append_escaped (line, name);
+      line += '=';
+      append_escaped (line, value);
+    }
+  return line;
+}
+
+std::expected<message, std::error_code>
+parse_message (std::string_view line)
+{
+  message msg{};
+  std::size_t start = 0;
+  bool first = true;
+  while (start <= line.size ())
+    {
+      const auto end = std::min (line.find ('\t', start), line.size ());
+      const auto field = line.substr (start, end - start);
+      start = end + 1;
+
+      if (first)
+        {
+          auto verb = unescape (field);
+          if (!verb || verb->empty ())
+            {
+              return std::unexpected (
+                  std::make_error_code (std::errc::invalid_argument));
+            }
+          msg.verb = std::move (*verb);
+          first = false;
+          continue;
+        }
+
+      // an escaped = can not occur, so the first one ends the name
+      const auto equals = field.find ('=');
+      if (equals == std::string_view::npos)
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::invalid_argument));
+        }
+      auto name = unescape (field.substr (0, equals));
+      auto value = unescape (field.substr (equals + 1));
+      if (!name || !value)
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::invalid_argument));
+        }
+      msg.fields.insert_or_assign (std::move (*name), std::move (*value));
+    }
+  return msg;
+}
+
+line_reader::line_reader (int fd) noexcept : fd_ (fd) {}
+
+std::expected<std::string, std::error_code>
+line_reader::next ()
+{
+  std::size_t searched = 0;
+  while (true)
+    {
+      const auto newline = this->buffer_.find ('\n', searched);
+      if (newline != std::string::npos)
+        {
+          std::string line = this->buffer_.substr (0, newline);
+          this->buffer_.erase (0, newline + 1);
+          return line;
+        }
+      searched = this->buffer_.size ();
+      if (searched > PROTOCOL_MAX_LINE)
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::message_size));
+        }
+
+      char block[4096];
+      const auto got = ::read (this->fd_, block, sizeof (block));
+      if (got < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (got < 0)
+        {
+          return std::unexpected (std::error_code{ errno,
+                                                   std::system_category () });
+        }
+      if (got == 0)
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::connection_aborted));
+        }
+      this->buffer_.append (block, static_cast<std::size_t> (got));
+    }
+}
+
+std::error_code
+write_line (int fd, std::string_view line) noexcept
+{
+  std::string out{};
+  try
+    {
+      out.reserve (line.size () + 1);
+      out.append (line);
+      out += '\n';
+    }
+  catch (...)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
+
+  // a peer that went away fails the send instead of raising sigpipe
+  std::size_t sent = 0;
+  while (sent < out.size ())
+    {
+      const auto n = ::send (fd, out.data () + sent, out.size () - sent,
+                             MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n < 0)
+        {
+          return { errno, std::system_category () };
+        }
+      sent += static_cast<std::size_t> (n);
+    }
+  return {};
+}
+
+} // namespace ftv
@@ -0,0 +1,590 @@
+#include "daemon/server.hpp"
+
+#include "crypto/cipher.hpp"
+#include "crypto/secure_key.hpp"
+#include "pipeline/pipeline.hpp"
+#include "video/metadata.hpp"
+#include "video/video.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ftv
+{
+
+struct server::connection
+{
+  int fd{ -1 };
+  std::atomic<bool> done{ false };
+  std::jthread thread{};
+
+  explicit connection (int socket) noexcept : fd (socket) {}
+
+  connection (const connection &) = delete;
+  connection &operator= (const connection &) = delete;
+
+  ~connection ()
+  {
+    if (this->thread.joinable ())
+      {
+        this->thread.join ();
+      }
+    ::close (this->fd);
+  }
+};
+
+namespace
+{
+
+std::error_code
+last_error () noexcept
+{
+  return { errno, std::system_category () };
+}
+
+message
+error_reply (std::string_view text)
+{
+  return { "error", { { "message", std::string{ text } } } };
+}
+
+// text as a number, nullopt if it is not one
+template <typename T>
+std::optional<T>
+parse_number (std::string_view text)
+{
+  T parsed{};
+  const auto end = text.data () + text.size ();
+  const auto [last, ec] = std::from_chars (text.data (), end, parsed);
+  if (text.empty () || ec != std::errc{} || last != end)
+    {
+      return std::nullopt;
+    }
+  return parsed;
+}
+
+// the value of field name as a number, fallback if there is none
+template <typename T>
+std::optional<T>
+number_field (const message &request, std::string_view name, T fallback)
+{
+  const auto value = request.field (name);
+  return value ? parse_number<T> (*value) : fallback;
+}
+
+std::map<std::string, std::string, std::less<>>
+job_fields (const job_status &job)
+{
+  std::map<std::string, std::string, std::less<>> fields{
+    { "id", std::to_string (job.id) },
+    { "kind", job.kind },
+    { "state", std::string{ job_state_name (job.state) } },
+    { "input", job.input.string () },
+    { "output", job.output.string () },
+    { "priority", std::to_string (job.priority) },
+    { "progress", std::to_string (job.progress) },
+  };
+  if (job.error)
+    {
+      fields.emplace ("message", job.error.message ());
+    }
+  return fields;
+}
+
+// connects to the socket at path, whether a server answers there
+bool
+answers (const sockaddr_un &address) noexcept
+{
+  const int probe = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probe < 0)
+    {
+      return false;
+    }
+  const bool connected
+      = ::connect (probe, reinterpret_cast<const sockaddr *> (&address),
+                   sizeof (address))
+        == 0;
+  ::close (probe);
+  return connected;
+}
+
+} // namespace
+
+std::filesystem::path
+default_socket_path ()
+{
+  if (const char *runtime = std::getenv ("XDG_RUNTIME_DIR");
+      runtime != nullptr && *runtime != '\0')
+    {
+      return std::filesystem::path{ runtime } / "ftv.sock";
+    }
+  return std::filesystem::temp_directory_path ()
+         / ("ftv-" + std::to_string (::getuid ()) + ".sock");
+}
+
+std::string_view
+job_state_name (job_state state) noexcept
+{
+  switch (state)
+    {
+    case job_state::queued:
+      return "queued";
+    case job_state::running:
+      return "running";
+    case job_state::done:
+      return "done";
+    case job_state::failed:
+      return "failed";
+    }
+  return "unknown";
+}
+
+server::server (server_options options)
+    : options_ (std::move (options)), executor_ (this->options_.threads)
+{
+}
+
+server::~server ()
+{
+  this->stop ();
+  this->executor_.wait ();
+  this->connections_.clear ();
+}
+
+std::error_code
+server::run () noexcept
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string path = this->options_.socket.string ();
+  if (path.empty () || path.size () >= sizeof (address.sun_path))
+    {
+      return std::make_error_code (std::errc::filename_too_long);
+    }
+  std::memcpy (address.sun_path, path.c_str (), path.size () + 1);
+
+  // a socket left behind by a server that died is taken over
+  if (answers (address))
+    {
+      return std::make_error_code (std::errc::address_in_use);
+    }
+  ::unlink (path.c_str ());
+
+  const int listener = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0)
+    {
+      return last_error ();
+    }
+  // the socket is created owner only, with no moment where anyone else
+  // could connect. that is all that keeps other users from reading keys
+  // out of requests or having files opened in a cwd they name
+  const mode_t mask = ::umask (S_IXUSR | S_IRWXG | S_IRWXO);
+  const int bound
+      = ::bind (listener, reinterpret_cast<const sockaddr *> (&address),
+                sizeof (address));
+  ::umask (mask);
+  if (bound != 0 || ::listen (listener, SOMAXCONN) != 0)
+    {
+      const auto ec = last_error ();
+      ::close (listener);
+      ::unlink (path.c_str ());
+      return ec;
+    }
+
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->listener_ = listener;
+    // stopped before it listened
+    if (this->stopping_)
+      {
+        ::shutdown (listener, SHUT_RDWR);
+      }
+  }
+
+  std::error_code result{};
+  while (true)
+    {
+      const int fd = ::accept4 (listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0)
+        {
+          const auto ec = last_error ();
+          {
+            const std::lock_guard lock{ this->mutex_ };
+            if (this->stopping_)
+              {
+                break;
+              }
+          }
+          if (ec.value () == EINTR || ec.value () == ECONNABORTED)
+            {
+              continue;
+            }
+          result = ec;
+          break;
+        }
+
+      this->reap ();
+      try
+        {
+          auto client = std::make_unique<connection> (fd);
+          auto &accepted = *client;
+          const std::lock_guard lock{ this->mutex_ };
+          this->connections_.push_back (std::move (client));
+          accepted.thread
+              = std::jthread{ [this, &accepted] { serve (accepted); } };
+        }
+      catch (...)
+        {
+          ::close (fd);
+        }
+    }
+
+  // jobs that were accepted still run, and clients waiting for them get
+  // their answer before the connections are cut
+  this->executor_.wait ();
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->stopping_ = true;
+    for (const auto &client : this->connections_)
+      {
+        ::shutdown (client->fd, SHUT_RDWR);
+      }
+    this->listener_ = -1;
+  }
+  this->connections_.clear ();
+  ::close (listener);
+  ::unlink (path.c_str ());
+  return result;
+}
+
+void
+server::stop () noexcept
+{
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->stopping_ = true;
+    if (this->listener_ >= 0)
+      {
+        ::shutdown (this->listener_, SHUT_RDWR);
+      }
+  }
+  this->changed_.notify_all ();
+}
+
+void
+server::serve (connection &client) noexcept
+{
+  line_reader reader{ client.fd };
+  while (true)
+    {
+      const auto line = reader.next ();
+      if (!line)
+        {
+          break;
+        }
+
+      message reply{};
+      try
+        {
+          const auto request = parse_message (*line);
+          reply = request ? this->handle (*request, client.fd)
+                          : error_reply ("malformed request");
+        }
+      catch (const std::exception &e)
+        {
+          reply = error_reply (e.what ());
+        }
+
+      if (write_line (client.fd, format_message (reply)))
+        {
+          break;
+        }
+    }
+  client.done = true;
+}
+
+message
+server::handle (const message &request, int fd)
+{
+  if (request.verb == "encode" || request.verb == "decode")
+    {
+      return this->submit (request, request.verb == "encode");
+    }
+  if (request.verb == "status")
+    {
+      return this->status (request, fd);
+    }
+  if (request.verb == "wait")
+    {
+      return this->wait (request);
+    }
+  if (request.verb == "shutdown")
+    {
+      this->stop ();
+      return { "ok", {} };
+    }
+  return error_reply ("unknown request: " + request.verb);
+}
+
+message
+server::submit (const message &request, bool encode)
+{
+  const auto input = request.field ("input");
+  const auto key = request.field ("key");
+  if (!input || input->empty () || !key)
+    {
+      return error_reply ("input and key are required");
+    }
+  if (key->size () > 32)
+    {
+      return error_reply ("encryption key must be smaller than 32 "
+                          "characters");
+    }
+  const auto priority = number_field (request, "priority", 0);
+  if (!priority)
+    {
+      return error_reply ("priority must be a number");
+    }
+
+  // relative paths are the client's. only the socket's owner can send
+  // requests, so the cwd is trusted as theirs
+  const std::filesystem::path cwd = request.field ("cwd").value_or ("");
+  if (!cwd.empty () && !cwd.is_absolute ())
+    {
+      return error_reply ("cwd must be an absolute path");
+    }
+  const auto resolve = [&] (const std::filesystem::path &path) {
+    return path.is_absolute () || cwd.empty () ? path : cwd / path;
+  };
+
+  job_status job{};
+  job.kind = request.verb;
+  job.input = resolve (*input);
+  job.priority = *priority;
+  if (!std::filesystem::exists (job.input))
+    {
+      return error_reply ("input file does not exist");
+    }
+
+  std::optional<progress_stream> steps{};
+  if (encode)
+    {
+      const auto output = request.field ("output");
+      const auto width = number_field<std::size_t> (request, "width", 300);
+      const auto height = number_field<std::size_t> (request, "height", 300);
+      const auto fps = number_field<std::size_t> (request, "fps", 30);
+      const auto cipher
+          = parse_cipher (request.field ("cipher").value_or ("aes-256-gcm"));
+      if (!output || output->empty ())
+        {
+          return error_reply ("output file path is required for encryption");
+        }
+      if (!width || *width < 100 || *width > 4096)
+        {
+          return error_reply ("width must be between 100 and 4096");
+        }
+      if (!height || *height < 100 || *height > 4096)
+        {
+          return error_reply ("height must be between 100 and 4096");
+        }
+      if (!fps || *fps < 1 || *fps > 60)
+        {
+          return error_reply ("fps must be between 1 and 60");
+        }
+      if (!cipher)
+        {
+          return error_reply ("cipher must be aes-256-gcm, "
+                              "chacha20-poly1305 or auto");
+        }
+
+      encode_options options{};
+      options.dedup = request.field ("dedup") == "1";
+      if (const auto erasure = request.field ("erasure"))
+        {
+          // <d>:<p>, or <d> for one parity frame
+          const std::string_view groups{ *erasure };
+          const auto colon = groups.find (':');
+          const auto data
+              = parse_number<std::size_t> (groups.substr (0, colon));
+          const auto parity
+              = colon == std::string_view::npos
+                    ? std::optional<std::size_t>{ 1 }
+                    : parse_number<std::size_t> (groups.substr (colon + 1));
+          options.erasure = { data.value_or (0), parity.value_or (0) };
+          if (!data || !parity || !options.erasure.valid ())
+            {
+              return error_reply ("erasure needs at least 1 data frame, "
+                                  "and at most 255 data and parity frames "
+                                  "together");
+            }
+        }
+
+      // the metadata names the input as the client did, decrypting puts
+      // the plaintext next to where that name points
+      job.output = resolve (*output);
+      const metadata meta{ *input,
+                           0,
+                           {},
+                           *fps,
+                           { *width, *height },
+                           payload_format::chunk_stream,
+                           *cipher };
+      steps.emplace (encode_job (job.input, job.output, secure_key{ *key },
+                                 meta, options));
+    }
+  else
+    {
+      const video vid{ job.input };
+      const auto meta = vid.get_metadata ();
+      if (meta.format () != payload_format::chunk_stream)
+        {
+          return error_reply ("only chunk stream videos can be decoded by "
+                              "the server");
+        }
+      const auto output = request.field ("output");
+      job.output = output ? resolve (*output)
+                          : resolve (meta.filename () + "_decrypted");
+      steps.emplace (
+          decode_job (job.input, job.output, secure_key{ *key }));
+    }
+
+  std::uint64_t id = 0;
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    if (this->stopping_)
+      {
+        return error_reply ("server is stopping");
+      }
+    id = this->next_id_++;
+    job.id = id;
+    this->jobs_.emplace (id, std::move (job));
+  }
+  this->executor_.submit (
+      std::move (*steps),
+      [this, id] (std::error_code ec) { finished (id, ec); }, *priority,
+      [this, id] (std::size_t units) { progressed (id, units); });
+  return { "ok", { { "id", std::to_string (id) } } };
+}
+
+message
+server::status (const message &request, int fd)
+{
+  std::vector<message> lines{};
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    if (request.field ("id"))
+      {
+        const auto id = number_field<std::uint64_t> (request, "id", 0);
+        const auto found = id ? this->jobs_.find (*id) : this->jobs_.end ();
+        if (found == this->jobs_.end ())
+          {
+            return error_reply ("no such job");
+          }
+        return { "ok", job_fields (found->second) };
+      }
+    lines.reserve (this->jobs_.size ());
+    for (const auto &[id, job] : this->jobs_)
+      {
+        lines.push_back ({ "job", job_fields (job) });
+      }
+  }
+
+  // written without the lock, a slow client does not hold up the jobs
+  for (const auto &line : lines)
+    {
+      if (const auto ec = write_line (fd, format_message (line)))
+        {
+          throw std::system_error (ec);
+        }
+    }
+  return { "ok", { { "jobs", std::to_string (lines.size ()) } } };
+}
+
+message
+server::wait (const message &request)
+{
+  const auto id = number_field<std::uint64_t> (request, "id", 0);
+  if (!id || !request.field ("id"))
+    {
+      return error_reply ("wait needs the id of a job");
+    }
+
+  std::unique_lock lock{ this->mutex_ };
+  this->changed_.wait (lock, [&] {
+    const auto found = this->jobs_.find (*id);
+    return found == this->jobs_.end ()
+           || found->second.state == job_state::done
+           || found->second.state == job_state::failed;
+  });
+  const auto found = this->jobs_.find (*id);
+  if (found == this->jobs_.end ())
+    {
+      return error_reply ("no such job");
+    }
+  return { found->second.state == job_state::done ? "ok" : "error",
+           job_fields (found->second) };
+}
+
+void
+server::finished (std::uint64_t id, std::error_code ec) noexcept
+{
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    const auto found = this->jobs_.find (id);
+    if (found != this->jobs_.end ())
+      {
+        found->second.state = ec ? job_state::failed : job_state::done;
+        found->second.error = ec;
+      }
+    try
+      {
+        this->finished_.push_back (id);
+      }
+    catch (...)
+      {
+        this->jobs_.erase (id);
+      }
+    while (this->finished_.size () > SERVER_JOB_HISTORY)
+      {
+        this->jobs_.erase (this->finished_.front ());
+        this->finished_.pop_front ();
+      }
+  }
+  this->changed_.notify_all ();
+}
+
+void
+server::progressed (std::uint64_t id, std::size_t units) noexcept
+{
+  const std::lock_guard lock{ this->mutex_ };
+  const auto found = this->jobs_.find (id);
+  if (found != this->jobs_.end ())
+    {
+      found->second.state = job_state::running;
+      found->second.progress = units;
+    }
+}
+
+void
+server::reap () noexcept
+{
+  // a connection is done as the last thing its thread does, so joining it
+  // does not wait
+  const std::lock_guard lock{ this->mutex_ };
+  std::erase_if (this->connections_,
+                 [] (const auto &client) { return client->done.load (); });
+}
+
+} // namespace ftv
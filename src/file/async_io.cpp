@@ -0,0 +1,514 @@
+#include "file/async_io.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+// liburing is not a dependency, the three system calls are used directly
+[[nodiscard]] int
+uring_setup (unsigned entries, io_uring_params *params) noexcept
+{
+  return static_cast<int> (syscall (__NR_io_uring_setup, entries, params));
+}
+
+[[nodiscard]] int
+uring_enter (int fd, unsigned to_submit, unsigned min_complete,
+             unsigned flags) noexcept
+{
+  return static_cast<int> (syscall (__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+[[nodiscard]] int
+uring_register (int fd, unsigned opcode, const void *arg,
+                unsigned nr_args) noexcept
+{
+  return static_cast<int> (
+      syscall (__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+[[nodiscard]] std::error_code
+errno_code (int error) noexcept
+{
+  return { error, std::generic_category () };
+}
+
+template <typename T>
+[[nodiscard]] T *
+ring_field (void *ring, std::uint32_t offset) noexcept
+{
+  return reinterpret_cast<T *> (static_cast<std::byte *> (ring) + offset);
+}
+
+} // namespace
+
+struct async_file::uring
+{
+  uring () = default;
+  uring (const uring &) = delete;
+  uring &operator= (const uring &) = delete;
+
+  ~uring ()
+  {
+    if (this->sqes != MAP_FAILED)
+      {
+        munmap (this->sqes, this->sqes_size);
+      }
+    if (this->cq_ring != MAP_FAILED && this->cq_ring != this->sq_ring)
+      {
+        munmap (this->cq_ring, this->cq_ring_size);
+      }
+    if (this->sq_ring != MAP_FAILED)
+      {
+        munmap (this->sq_ring, this->sq_ring_size);
+      }
+    if (this->fd >= 0)
+      {
+        ::close (this->fd);
+      }
+  }
+
+  // returns nullptr when io_uring is unavailable (old kernel, seccomp, ...)
+  [[nodiscard]] static std::unique_ptr<uring>
+  create (unsigned entries) noexcept
+  {
+    auto ring = std::unique_ptr<uring> (new (std::nothrow) uring ());
+    if (!ring)
+      {
+        return nullptr;
+      }
+
+    io_uring_params params{};
+    ring->fd = uring_setup (entries, &params);
+    if (ring->fd < 0)
+      {
+        return nullptr;
+      }
+
+    ring->sq_ring_size
+        = params.sq_off.array + params.sq_entries * sizeof (std::uint32_t);
+    ring->cq_ring_size
+        = params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+      {
+        ring->sq_ring_size = ring->cq_ring_size
+            = std::max (ring->sq_ring_size, ring->cq_ring_size);
+      }
+
+    ring->sq_ring = mmap (nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd,
+                          IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+      {
+        return nullptr;
+      }
+    ring->cq_ring
+        = single_mmap
+              ? ring->sq_ring
+              : mmap (nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+      {
+        return nullptr;
+      }
+
+    ring->sqes_size = params.sq_entries * sizeof (io_uring_sqe);
+    void *sqes = mmap (nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      {
+        return nullptr;
+      }
+    ring->sqes = static_cast<io_uring_sqe *> (sqes);
+
+    ring->sq_tail = ring_field<std::uint32_t> (ring->sq_ring,
+                                               params.sq_off.tail);
+    ring->sq_mask = *ring_field<std::uint32_t> (ring->sq_ring,
+                                                params.sq_off.ring_mask);
+    ring->sq_array = ring_field<std::uint32_t> (ring->sq_ring,
+                                                params.sq_off.array);
+    ring->cq_head = ring_field<std::uint32_t> (ring->cq_ring,
+                                               params.cq_off.head);
+    ring->cq_tail = ring_field<std::uint32_t> (ring->cq_ring,
+                                               params.cq_off.tail);
+    ring->cq_mask = *ring_field<std::uint32_t> (ring->cq_ring,
+                                                params.cq_off.ring_mask);
+    ring->cqes = ring_field<io_uring_cqe> (ring->cq_ring, params.cq_off.cqes);
+    return ring;
+  }
+
+  int fd{ -1 };
+  void *sq_ring{ MAP_FAILED };
+  std::size_t sq_ring_size{};
+  void *cq_ring{ MAP_FAILED };
+  std::size_t cq_ring_size{};
+  io_uring_sqe *sqes{ static_cast<io_uring_sqe *> (MAP_FAILED) };
+  std::size_t sqes_size{};
+
+  std::uint32_t *sq_tail{};
+  std::uint32_t sq_mask{};
+  std::uint32_t *sq_array{};
+  std::uint32_t *cq_head{};
+  std::uint32_t *cq_tail{};
+  std::uint32_t cq_mask{};
+  io_uring_cqe *cqes{};
+
+  std::vector<std::span<std::byte>> registered{};
+};
+
+async_file::async_file (const std::filesystem::path &path, io_mode mode,
+                        std::size_t queue_depth)
+    : mode_ (mode), requests_ (std::max<std::size_t> (queue_depth, 1))
+{
+  const int flags
+      = mode == io_mode::read    ? O_RDONLY | O_CLOEXEC
+        : mode == io_mode::write ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC
+                                 : O_WRONLY | O_CREAT | O_CLOEXEC;
+  this->fd_ = ::open (path.c_str (), flags, 0644);
+  if (this->fd_ < 0)
+    {
+      throw std::system_error (errno_code (errno), path.string ());
+    }
+  this->uring_
+      = uring::create (static_cast<unsigned> (this->requests_.size ()));
+}
+
+async_file::async_file (async_file &&other) noexcept
+    : fd_ (std::exchange (other.fd_, -1)), mode_ (other.mode_),
+      uring_ (std::move (other.uring_)),
+      requests_ (std::move (other.requests_)),
+      ready_ (std::move (other.ready_)),
+      in_flight_ (std::exchange (other.in_flight_, 0))
+{
+}
+
+async_file &
+async_file::operator= (async_file &&other) noexcept
+{
+  if (this != &other)
+    {
+      this->close ();
+      this->fd_ = std::exchange (other.fd_, -1);
+      this->mode_ = other.mode_;
+      this->uring_ = std::move (other.uring_);
+      this->requests_ = std::move (other.requests_);
+      this->ready_ = std::move (other.ready_);
+      this->in_flight_ = std::exchange (other.in_flight_, 0);
+    }
+  return *this;
+}
+
+async_file::~async_file () { this->close (); }
+
+void
+async_file::close () noexcept
+{
+  // the kernel may still be writing into caller buffers, drain first
+  while (this->in_flight_ > 0 && this->wait ())
+    {
+    }
+  this->uring_.reset ();
+  if (this->fd_ >= 0)
+    {
+      ::close (this->fd_);
+      this->fd_ = -1;
+    }
+}
+
+[[nodiscard]] bool
+async_file::uses_uring () const noexcept
+{
+  return this->uring_ != nullptr;
+}
+
+[[nodiscard]] std::size_t
+async_file::in_flight () const noexcept
+{
+  return this->in_flight_;
+}
+
+[[nodiscard]] std::size_t
+async_file::queue_depth () const noexcept
+{
+  return this->requests_.size ();
+}
+
+std::error_code
+async_file::register_buffers (
+    std::span<const std::span<std::byte>> buffers) noexcept
+{
+  if (!this->uring_)
+    {
+      return std::make_error_code (std::errc::operation_not_supported);
+    }
+
+  try
+    {
+      if (!this->uring_->registered.empty ())
+        {
+          (void)uring_register (this->uring_->fd, IORING_UNREGISTER_BUFFERS,
+                                nullptr, 0);
+          this->uring_->registered.clear ();
+        }
+
+      std::vector<iovec> vecs{};
+      vecs.reserve (buffers.size ());
+      for (const auto &buffer : buffers)
+        {
+          vecs.push_back ({ buffer.data (), buffer.size () });
+        }
+      if (uring_register (this->uring_->fd, IORING_REGISTER_BUFFERS,
+                          vecs.data (), static_cast<unsigned> (vecs.size ()))
+          < 0)
+        {
+          return errno_code (errno);
+        }
+      this->uring_->registered.assign (buffers.begin (), buffers.end ());
+      return {};
+    }
+  catch (const std::exception &)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
+}
+
+[[nodiscard]] std::error_code
+async_file::submit_read (std::span<std::byte> buffer, std::uint64_t offset,
+                         std::uint64_t tag) noexcept
+{
+  if (this->mode_ != io_mode::read)
+    {
+      return std::make_error_code (std::errc::bad_file_descriptor);
+    }
+  return this->submit (buffer.data (), buffer.size (), offset, tag);
+}
+
+[[nodiscard]] std::error_code
+async_file::submit_write (std::span<const std::byte> buffer,
+                          std::uint64_t offset, std::uint64_t tag) noexcept
+{
+  if (this->mode_ == io_mode::read)
+    {
+      return std::make_error_code (std::errc::bad_file_descriptor);
+    }
+  // the kernel only reads from the buffer
+  return this->submit (const_cast<std::byte *> (buffer.data ()),
+                       buffer.size (), offset, tag);
+}
+
+[[nodiscard]] std::error_code
+async_file::submit (std::byte *data, std::size_t size, std::uint64_t offset,
+                    std::uint64_t tag) noexcept
+{
+  if (!this->uring_)
+    {
+      // blocking fallback, the request is done before it is queued
+      io_completion completion{ tag, 0, {} };
+      while (completion.bytes < size)
+        {
+          const auto position
+              = static_cast<off_t> (offset + completion.bytes);
+          const auto result
+              = this->mode_ == io_mode::read
+                    ? ::pread (this->fd_, data + completion.bytes,
+                               size - completion.bytes, position)
+                    : ::pwrite (this->fd_, data + completion.bytes,
+                                size - completion.bytes, position);
+          if (result < 0 && errno == EINTR)
+            {
+              continue;
+            }
+          if (result < 0)
+            {
+              completion.error = errno_code (errno);
+              break;
+            }
+          if (result == 0)
+            {
+              break; // end of file
+            }
+          completion.bytes += static_cast<std::size_t> (result);
+        }
+      try
+        {
+          this->ready_.push_back (completion);
+        }
+      catch (const std::exception &)
+        {
+          return std::make_error_code (std::errc::not_enough_memory);
+        }
+      this->in_flight_++;
+      return {};
+    }
+
+  for (std::size_t slot = 0; slot < this->requests_.size (); ++slot)
+    {
+      auto &entry = this->requests_[slot];
+      if (entry.active)
+        {
+          continue;
+        }
+      entry = request{ data, size, 0, offset, tag, true };
+      if (const auto ec = this->enqueue (slot))
+        {
+          entry.active = false;
+          return ec;
+        }
+      this->in_flight_++;
+      return {};
+    }
+  return std::make_error_code (std::errc::resource_unavailable_try_again);
+}
+
+[[nodiscard]] std::error_code
+async_file::enqueue (std::size_t slot) noexcept
+{
+  auto &ring = *this->uring_;
+  const auto &entry = this->requests_[slot];
+
+  std::atomic_ref<std::uint32_t> tail{ *ring.sq_tail };
+  const std::uint32_t position = tail.load (std::memory_order_relaxed);
+  const std::uint32_t index = position & ring.sq_mask;
+
+  io_uring_sqe &sqe = ring.sqes[index];
+  std::memset (&sqe, 0, sizeof (sqe));
+  sqe.fd = this->fd_;
+  sqe.addr = reinterpret_cast<std::uint64_t> (entry.data + entry.done);
+  sqe.len = static_cast<std::uint32_t> (entry.size - entry.done);
+  sqe.off = entry.offset + entry.done;
+  sqe.user_data = slot;
+  sqe.opcode = this->mode_ == io_mode::read ? IORING_OP_READ : IORING_OP_WRITE;
+
+  // requests inside a registered buffer use the pre-pinned pages
+  for (std::size_t i = 0; i < ring.registered.size (); ++i)
+    {
+      const auto &buffer = ring.registered[i];
+      if (entry.data >= buffer.data ()
+          && entry.data + entry.size <= buffer.data () + buffer.size ())
+        {
+          sqe.opcode = this->mode_ == io_mode::read ? IORING_OP_READ_FIXED
+                                                    : IORING_OP_WRITE_FIXED;
+          sqe.buf_index = static_cast<std::uint16_t> (i);
+          break;
+        }
+    }
+
+  ring.sq_array[index] = index;
+  tail.store (position + 1, std::memory_order_release);
+
+  while (uring_enter (ring.fd, 1, 0, 0) < 0)
+    {
+      if (errno != EINTR)
+        {
+          return errno_code (errno);
+        }
+    }
+  return {};
+}
+
+[[nodiscard]] std::expected<io_completion, std::error_code>
+async_file::wait () noexcept
+{
+  if (this->in_flight_ == 0)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::no_message_available));
+    }
+
+  if (!this->uring_)
+    {
+      const auto completion = this->ready_.front ();
+      this->ready_.pop_front ();
+      this->in_flight_--;
+      return completion;
+    }
+
+  auto &ring = *this->uring_;
+  while (true)
+    {
+      std::atomic_ref<std::uint32_t> head{ *ring.cq_head };
+      const std::uint32_t position = head.load (std::memory_order_relaxed);
+      if (position
+          == std::atomic_ref<std::uint32_t>{ *ring.cq_tail }.load (
+              std::memory_order_acquire))
+        {
+          if (uring_enter (ring.fd, 0, 1, IORING_ENTER_GETEVENTS) < 0
+              && errno != EINTR)
+            {
+              return std::unexpected (errno_code (errno));
+            }
+          continue;
+        }
+
+      const io_uring_cqe cqe = ring.cqes[position & ring.cq_mask];
+      head.store (position + 1, std::memory_order_release);
+
+      auto &entry = this->requests_[cqe.user_data];
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN
+          || (cqe.res > 0
+              && entry.done + static_cast<std::size_t> (cqe.res)
+                     < entry.size))
+        {
+          // interrupted or short, continue where the kernel stopped
+          entry.done += static_cast<std::size_t> (std::max (cqe.res, 0));
+          if (const auto ec = this->enqueue (cqe.user_data))
+            {
+              entry.active = false;
+              this->in_flight_--;
+              return io_completion{ entry.tag, entry.done, ec };
+            }
+          continue;
+        }
+
+      io_completion completion{ entry.tag, entry.done, {} };
+      if (cqe.res < 0)
+        {
+          completion.error = errno_code (-cqe.res);
+        }
+      else
+        {
+          completion.bytes += static_cast<std::size_t> (cqe.res);
+        }
+      entry.active = false;
+      this->in_flight_--;
+      return completion;
+    }
+}
+
+std::error_code
+async_file::resize (std::uint64_t size) noexcept
+{
+  if (::ftruncate (this->fd_, static_cast<off_t> (size)) < 0)
+    {
+      return errno_code (errno);
+    }
+  return {};
+}
+
+std::error_code
+async_file::sync () noexcept
+{
+  if (::fdatasync (this->fd_) < 0)
+    {
+      return errno_code (errno);
+    }
+  return {};
+}
+
+} // namespace ftv
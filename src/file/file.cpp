@@ -1,15 +1,22 @@
 #include "file/file.hpp"
+#include "file/async_io.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <format>
-#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace ftv
 {
 
-file::file (const std::filesystem::path &path) : path_{ path }
+file::file (const std::filesystem::path &path,
+            std::pmr::memory_resource *resource)
+    : path_{ path }
 {
-  if (const auto data = read (path))
+  if (auto data = read (path, resource))
     {
-      this->data_ = data.value ();
+      this->data_ = std::move (*data);
     }
   else
     {
@@ -36,7 +43,8 @@ file::file (const std::filesystem::path &path) : path_{ path }
     }
 }
 
-file::file (const std::filesystem::path &path, std::vector<std::byte> data)
+file::file (const std::filesystem::path &path,
+            std::pmr::vector<std::byte> data)
     : path_ (path), data_ (std::move (data))
 {
 }
@@ -47,7 +55,7 @@ file::path () const noexcept
   return this->path_;
 }
 
-[[nodiscard]] const std::vector<std::byte> &
+[[nodiscard]] const std::pmr::vector<std::byte> &
 file::data () const noexcept
 {
   return this->data_;
@@ -59,6 +67,85 @@ file::size () const noexcept
   return this->data_.size ();
 }
 
+namespace
+{
+
+// io_uring rejects registered buffers above 1 GiB
+inline constexpr std::size_t MAX_REGISTERED_BUFFER{ std::size_t{ 1 } << 30 };
+
+// offsets and sizes refer to the concatenated output
+using prepare_func
+    = std::function<std::error_code (std::size_t offset, std::size_t size)>;
+
+void
+try_register (async_file &io, std::span<std::byte> buffer) noexcept
+{
+  // best effort, pinning can fail under a low RLIMIT_MEMLOCK
+  if (io.uses_uring () && !buffer.empty ()
+      && buffer.size () <= MAX_REGISTERED_BUFFER)
+    {
+      const std::span<std::byte> buffers[]{ buffer };
+      (void)io.register_buffers (buffers);
+    }
+}
+
+[[nodiscard]] std::error_code
+reap (async_file &io) noexcept
+{
+  const auto done = io.wait ();
+  if (!done)
+    {
+      return done.error ();
+    }
+  return done->error;
+}
+
+[[nodiscard]] std::error_code
+write_chunks (async_file &out,
+              std::span<const std::span<const std::byte>> segments,
+              const prepare_func &prepare) noexcept
+{
+  std::size_t offset = 0;
+  for (const auto &segment : segments)
+    {
+      for (std::size_t pos = 0; pos < segment.size (); pos += ASYNC_CHUNK_SIZE)
+        {
+          const auto chunk = segment.subspan (
+              pos, std::min (ASYNC_CHUNK_SIZE, segment.size () - pos));
+          if (prepare)
+            {
+              if (const auto ec = prepare (offset, chunk.size ()))
+                {
+                  return ec;
+                }
+            }
+          if (out.in_flight () == out.queue_depth ())
+            {
+              if (const auto ec = reap (out))
+                {
+                  return ec;
+                }
+            }
+          if (const auto ec = out.submit_write (chunk, offset, offset))
+            {
+              return ec;
+            }
+          offset += chunk.size ();
+        }
+    }
+
+  while (out.in_flight () > 0)
+    {
+      if (const auto ec = reap (out))
+        {
+          return ec;
+        }
+    }
+  return {};
+}
+
+} // namespace
+
 [[nodiscard]] std::error_code
 write (std::span<const std::byte> data, const std::filesystem::path &path)
 {
@@ -70,29 +157,121 @@ write (std::span<const std::byte> data, const std::filesystem::path &path)
     {
       return make_error_code (std::errc::invalid_argument);
     }
-  std::ofstream file_stream (path, std::ios::binary);
 
-  if (!file_stream.is_open ())
+  const std::span<const std::byte> segments[]{ data };
+  return write_segments (segments, path);
+}
+
+[[nodiscard]] std::error_code
+sync_file (const std::filesystem::path &path) noexcept
+{
+  const int fd = ::open (path.c_str (), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
     {
-      return std::make_error_code (std::errc::no_such_file_or_directory);
+      return { errno, std::generic_category () };
     }
+  const int result = ::fsync (fd);
+  const int error = errno;
+  ::close (fd);
+  return result < 0 ? std::error_code{ error, std::generic_category () }
+                    : std::error_code{};
+}
 
-  file_stream.write (reinterpret_cast<const char *> (data.data ()),
-                     static_cast<std::streamsize> (data.size ()));
+[[nodiscard]] std::expected<std::size_t, std::error_code>
+read_stream (int fd, std::span<std::byte> buffer) noexcept
+{
+  std::size_t done = 0;
+  while (done < buffer.size ())
+    {
+      const auto got
+          = ::read (fd, buffer.data () + done, buffer.size () - done);
+      if (got < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (got < 0)
+        {
+          return std::unexpected (
+              std::error_code{ errno, std::generic_category () });
+        }
+      if (got == 0)
+        {
+          break;
+        }
+      done += static_cast<std::size_t> (got);
+    }
+  return done;
+}
+
+[[nodiscard]] std::error_code
+write_stream (int fd, std::span<const std::byte> data) noexcept
+{
+  while (!data.empty ())
+    {
+      const auto put = ::write (fd, data.data (), data.size ());
+      if (put < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (put < 0)
+        {
+          return { errno, std::generic_category () };
+        }
+      data = data.subspan (static_cast<std::size_t> (put));
+    }
+  return {};
+}
 
-  if (!file_stream)
+[[nodiscard]] std::error_code
+write_segments (std::span<const std::span<const std::byte>> segments,
+                const std::filesystem::path &path) noexcept
+{
+  try
+    {
+      async_file out{ path, io_mode::write };
+      return write_chunks (out, segments, {});
+    }
+  catch (const std::system_error &e)
+    {
+      return e.code ();
+    }
+  catch (const std::exception &)
     {
       return std::make_error_code (std::errc::io_error);
     }
+}
 
-  return {};
+[[nodiscard]] std::error_code
+write_from (std::span<std::byte> buffer, const std::filesystem::path &path,
+            const chunk_callback &before_write) noexcept
+{
+  try
+    {
+      async_file out{ path, io_mode::write };
+      try_register (out, buffer);
+
+      const std::span<const std::byte> segments[]{ buffer };
+      return write_chunks (out, segments,
+                           [&] (std::size_t offset, std::size_t size) {
+                             return before_write ? before_write (
+                                        buffer.subspan (offset, size))
+                                                 : std::error_code{};
+                           });
+    }
+  catch (const std::system_error &e)
+    {
+      return e.code ();
+    }
+  catch (const std::exception &)
+    {
+      return std::make_error_code (std::errc::io_error);
+    }
 }
 
 [[nodiscard]] std::error_code
 write (const file &f, const std::filesystem::path &path)
 {
-  const auto data = f.data ();
-  return write (data, path);
+  return write (f.data (), path);
 }
 
 [[nodiscard]] std::error_code
@@ -101,43 +280,121 @@ write (const file &f)
   return write (f, f.path ());
 }
 
-[[nodiscard]] std::expected<std::vector<std::byte>, std::error_code>
-read (const std::filesystem::path &path) noexcept
+[[nodiscard]] std::error_code
+read_into (const std::filesystem::path &path, std::span<std::byte> buffer,
+           const chunk_callback &on_chunk) noexcept
+{
+  try
+    {
+      async_file in{ path, io_mode::read };
+      try_register (in, buffer);
+
+      const std::size_t chunks
+          = (buffer.size () + ASYNC_CHUNK_SIZE - 1) / ASYNC_CHUNK_SIZE;
+      const auto chunk_at = [&] (std::size_t index) {
+        const std::size_t offset = index * ASYNC_CHUNK_SIZE;
+        return buffer.subspan (
+            offset, std::min (ASYNC_CHUNK_SIZE, buffer.size () - offset));
+      };
+
+      // chunks may complete out of order but are handed out in order
+      std::vector<bool> landed (chunks, false);
+      std::size_t submitted = 0;
+      std::size_t delivered = 0;
+      while (delivered < chunks)
+        {
+          while (submitted < chunks && in.in_flight () < in.queue_depth ())
+            {
+              if (const auto ec
+                  = in.submit_read (chunk_at (submitted),
+                                    submitted * ASYNC_CHUNK_SIZE, submitted))
+                {
+                  return ec;
+                }
+              submitted++;
+            }
+
+          const auto done = in.wait ();
+          if (!done)
+            {
+              return done.error ();
+            }
+          if (done->error)
+            {
+              return done->error;
+            }
+          const auto index = static_cast<std::size_t> (done->tag);
+          if (done->bytes != chunk_at (index).size ())
+            {
+              return std::make_error_code (std::errc::io_error); // shrank
+            }
+          landed[index] = true;
+
+          for (; delivered < chunks && landed[delivered]; ++delivered)
+            {
+              if (on_chunk)
+                {
+                  if (const auto ec = on_chunk (chunk_at (delivered)))
+                    {
+                      return ec;
+                    }
+                }
+            }
+        }
+      return {};
+    }
+  catch (const std::system_error &e)
+    {
+      return e.code ();
+    }
+  catch (const std::exception &)
+    {
+      return std::make_error_code (std::errc::io_error);
+    }
+}
+
+[[nodiscard]] std::expected<std::pmr::vector<std::byte>, std::error_code>
+read (const std::filesystem::path &path,
+      std::pmr::memory_resource *resource) noexcept
 {
   if (!std::filesystem::exists (path))
     {
-      return std::expected<std::vector<std::byte>, std::error_code> (
+      return std::expected<std::pmr::vector<std::byte>, std::error_code> (
           std::unexpected (
               std::make_error_code (std::errc::no_such_file_or_directory)));
     }
 
-  std::ifstream file_stream (path, std::ios::binary);
-  if (!file_stream.is_open ())
+  std::error_code size_error{};
+  const auto file_size = std::filesystem::file_size (path, size_error);
+  if (size_error)
     {
-      return std::expected<std::vector<std::byte>, std::error_code> (
+      return std::expected<std::pmr::vector<std::byte>, std::error_code> (
           std::unexpected (std::make_error_code (std::errc::io_error)));
     }
 
-  auto file_size = std::filesystem::file_size (path);
-
   if (file_size > std::numeric_limits<std::size_t>::max ())
     {
-      return std::expected<std::vector<std::byte>, std::error_code> (
+      return std::expected<std::pmr::vector<std::byte>, std::error_code> (
           std::unexpected (std::make_error_code (std::errc::file_too_large)));
     }
 
-  std::vector<std::byte> data (file_size);
-  file_stream.read (reinterpret_cast<char *> (data.data ()),
-                    static_cast<std::streamsize> (file_size));
+  try
+    {
+      std::pmr::vector<std::byte> data (file_size, resource);
+      if (const auto ec = read_into (path, data))
+        {
+          return std::expected<std::pmr::vector<std::byte>, std::error_code> (
+              std::unexpected (std::make_error_code (std::errc::io_error)));
+        }
 
-  if (!file_stream)
+      return std::expected<std::pmr::vector<std::byte>, std::error_code> (
+          std::move (data));
+    }
+  catch (const std::exception &)
     {
-      return std::expected<std::vector<std::byte>, std::error_code> (
-          std::unexpected (std::make_error_code (std::errc::io_error)));
+      return std::expected<std::pmr::vector<std::byte>, std::error_code> (
+          std::unexpected (std::make_error_code (std::errc::file_too_large)));
     }
-
-  return std::expected<std::vector<std::byte>, std::error_code> (
-      std::move (data));
 }
 
 } // namsepace ftv
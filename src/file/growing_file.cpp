@@ -0,0 +1,61 @@
+#include "file/growing_file.hpp"
+
+#include <algorithm>
+
+namespace ftv
+{
+
+void
+growing_file::advance (std::uint64_t prefix) noexcept
+{
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->prefix_ = std::max (this->prefix_, prefix);
+  }
+  this->changed_.notify_all ();
+}
+
+void
+growing_file::finish (std::error_code ec) noexcept
+{
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->finished_ = true;
+    this->error_ = ec;
+  }
+  this->changed_.notify_all ();
+}
+
+[[nodiscard]] bool
+growing_file::cancelled () const noexcept
+{
+  const std::lock_guard lock{ this->mutex_ };
+  return this->cancelled_;
+}
+
+[[nodiscard]] std::expected<bool, std::error_code>
+growing_file::wait_for (std::uint64_t end) const noexcept
+{
+  std::unique_lock lock{ this->mutex_ };
+  this->changed_.wait (lock, [&] {
+    return this->prefix_ >= end || this->finished_;
+  });
+  if (this->prefix_ >= end)
+    {
+      return true;
+    }
+  if (this->error_)
+    {
+      return std::unexpected (this->error_);
+    }
+  return false;
+}
+
+void
+growing_file::cancel () noexcept
+{
+  const std::lock_guard lock{ this->mutex_ };
+  this->cancelled_ = true;
+}
+
+} // namespace ftv
@@ -1,16 +1,40 @@
-#include "crypto/checksum.hpp"
 #include "crypto/decrypt.hpp"
 #include "crypto/encrypt.hpp"
 #include "crypto/serialize.hpp"
+#include "daemon/client.hpp"
+#include "daemon/server.hpp"
+#include "memory/job_arena.hpp"
+#include "pipeline/pipeline.hpp"
+#include "pipeline/segmented.hpp"
+#include "pipeline/verify.hpp"
 #include "video/metadata.hpp"
 #include "video/pixel.hpp"
+#include "video/planner.hpp"
 #include "video/video.hpp"
+#include "youtube/client.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
 #include <filesystem>
+#include <optional>
 #include <print>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+#include <unistd.h>
+
+// one video of an encode, 0 for the width, height or fps of -w, -h and -f
+struct rendition
+{
+  std::string path{};
+  std::size_t width = 0;
+  std::size_t height = 0;
+  std::size_t fps = 0;
+};
+
 struct parameters
 {
   std::string input_file{};
@@ -20,6 +44,32 @@ struct parameters
   std::size_t height = 300;
   std::size_t fps = 30;
   bool encrypt = false; // false = decrypt
+  bool verify = false;  // only check the video, needs no key
+  bool resume = false;  // checkpoint and continue from the last checkpoint
+  bool dedup = false;   // store repeated chunks once
+  std::string base{};   // earlier version to deduplicate against
+  bool append = false;  // add what input gained to an appendable video
+  std::size_t segments = 0; // split into this many videos, 0 for one
+  std::optional<std::size_t> segment{}; // the only segment to decrypt
+  bool auto_geometry = false; // planner picks width and height
+  bool auto_fps = false;      // planner picks fps
+  bool plan = false;          // print the plan instead of encoding
+  std::string upload{};       // credentials to upload the video with
+  std::string download{}; // credentials to download the input video with
+  ftv::erasure_params erasure{}; // parity frames per group of data frames
+  // what the payload is sealed with, an error for a name that is none
+  std::expected<ftv::cipher_id, std::error_code> cipher{
+    ftv::cipher_id::aes_256_gcm
+  };
+  bool serve = false;  // run the daemon
+  bool status = false; // list the daemon's jobs
+  std::string queue{}; // socket of the daemon, empty for the default
+  bool queued = false; // hand the job to the daemon instead of running it
+  int priority = 0;    // of a queued job
+  std::size_t threads = std::thread::hardware_concurrency (); // of serve
+  // every -o of encrypt, output_file is the first. several of them share
+  // one read, encryption and serialization of the input
+  std::vector<rendition> renditions{};
 };
 
 void
@@ -29,22 +79,61 @@ print_usage ()
   std::println ("encrypt: ftv encrypt <input_file> -o <output_file> -k "
                 "<key> [options]");
   std::println ("decrypt: ftv decrypt <input_file> -k <key>");
+  std::println ("         ftv decrypt <video_id> -g <file> -k <key>");
+  std::println ("verify:  ftv verify <input_file>");
+  std::println ("serve:   ftv serve [-q <socket>] [-t <threads>]");
+  std::println ("status:  ftv status [<job_id>] [-q <socket>]");
+  std::println ("a - for the input or output file reads stdin or writes "
+                "stdout, -o - also decrypts to stdout");
   std::println ("\noptions:");
   std::println ("  -o, --output <file>    output video file path (required "
                 "for encrypt only)");
+  std::println ("  -o <file>:<w>x<h>[@<fps>] an output with its own geometry, "
+                "several -o encrypt the input once for all of them");
   std::println (
       "  -k, --key <key>        encryption/decryption key (max 32 chars)");
   std::println (
-      "  -w, --width <pixels>   video width (100-4096, default: 300)");
+      "  -w, --width <pixels>   video width (100-4096 or auto, default: 300)");
   std::println (
-      "  -h, --height <pixels>  video height (100-4096, default: 300)");
-  std::println (
-      "  -f, --fps <number>     frames per second (1-60, default: 30)");
+      "  -h, --height <pixels>  video height (100-4096 or auto, default: "
+      "300)");
+  std::println ("  -f, --fps <number>     frames per second (1-60 or auto, "
+                "default: 30)");
+  std::println ("  -r, --resume           write checkpoints and continue an "
+                "interrupted run from the last one");
+  std::println ("  -d, --dedup            store repeated chunks of the input "
+                "only once");
+  std::println ("  -b, --base <file>      earlier version of the input to "
+                "reference chunks from, needed again to decrypt");
+  std::println ("  -a, --append           add what the input gained since "
+                "the last append to the video");
+  std::println ("  -s, --segments <n>     split into n videos encoded and "
+                "decoded in parallel");
+  std::println ("  --segment <n>          decrypt only segment n of a "
+                "segmented or appended video, 0 is the video itself");
+  std::println ("  -e, --erasure <d>[:<p>] follow every d data frames with p "
+                "parity frames (default 1), any p of them can be lost");
+  std::println ("  -c, --cipher <name>    aes-256-gcm, chacha20-poly1305 or "
+                "auto for the faster one here (default: aes-256-gcm)");
+  std::println ("  -p, --plan             print the predicted frames, bytes "
+                "and throughput without encoding");
+  std::println ("  -u, --upload <file>    upload the video to youtube with "
+                "the credentials in the json file");
+  std::println ("  -g, --download <file>  download the video with the "
+                "credentials in the json file and decrypt it as it arrives, "
+                "-o names the local copy");
+  std::println ("  -q, --queue <socket>   hand the job to ftv serve on the "
+                "socket and wait for it, or default for its default socket");
+  std::println ("  --priority <n>         of a queued job, higher runs first "
+                "(default: 0)");
+  std::println ("  -t, --threads <n>      workers of ftv serve (default: one "
+                "per core)");
   std::println ("  -h, --help                 show this help message");
   std::println ("\nexample:");
   std::println (
       "  ftv encrypt file.txt -o video.avi -k mypassword -w 640 -h 480 -f 30");
   std::println ("  ftv decrypt video.avi -k mypassword");
+  std::println ("  pg_dump db | ftv encrypt - -o video.avi -k mypassword");
 }
 
 enum class validation_error
@@ -56,7 +145,15 @@ enum class validation_error
   input_not_found = 4,
   invalid_width = 5,
   invalid_height = 6,
-  invalid_fps = 7
+  invalid_fps = 7,
+  conflicting_options = 8,
+  conflicting_upload = 9,
+  conflicting_stream = 10,
+  invalid_erasure = 11,
+  invalid_cipher = 12,
+  conflicting_queue = 13,
+  conflicting_fanout = 14,
+  conflicting_segment = 15
 };
 
 std::string
@@ -92,6 +189,47 @@ validation_error_to_string (validation_error error)
       {
         return "fps must be between 1 and 60";
       }
+    case validation_error::conflicting_options:
+      {
+        return "append and segments can not be combined with each other "
+               "or with resume, dedup or base";
+      }
+    case validation_error::conflicting_upload:
+      {
+        return "upload needs a single video, it can not be combined with "
+               "resume, append or segments";
+      }
+    case validation_error::conflicting_stream:
+      {
+        return "stdin and stdout can not be combined with resume, dedup, "
+               "base, append, segments, plan, auto, upload or download";
+      }
+    case validation_error::invalid_erasure:
+      {
+        return "erasure needs at least 1 data frame, and at most 255 data "
+               "and parity frames together";
+      }
+    case validation_error::invalid_cipher:
+      {
+        return "cipher must be aes-256-gcm, chacha20-poly1305 or auto";
+      }
+    case validation_error::conflicting_queue:
+      {
+        return "a queued job can not be combined with stdin or stdout, "
+               "resume, base, append, segments, plan, auto, upload or "
+               "download";
+      }
+    case validation_error::conflicting_fanout:
+      {
+        return "several outputs can not be combined with stdin or stdout, "
+               "resume, dedup, base, append, segments, plan, auto, upload "
+               "or queue";
+      }
+    case validation_error::conflicting_segment:
+      {
+        return "segment only decrypts, it can not be combined with stdin "
+               "or stdout, resume, download or queue";
+      }
     default:
       {
         return "unknown validation error";
@@ -117,29 +255,204 @@ validate_parameters (const parameters &params)
       return validation_error::key_too_long;
     }
 
-  if (!std::filesystem::exists (params.input_file))
+  // a downloaded video is named by its id
+  if (params.download.empty () && params.input_file != "-"
+      && !std::filesystem::exists (params.input_file))
     {
       return validation_error::input_not_found;
     }
 
-  if (params.width < 100 || params.width > 4096)
+  if (!params.auto_geometry && (params.width < 100 || params.width > 4096))
     {
       return validation_error::invalid_width;
     }
 
-  if (params.height < 100 || params.height > 4096)
+  if (!params.auto_geometry
+      && (params.height < 100 || params.height > 4096))
     {
       return validation_error::invalid_height;
     }
 
-  if (params.fps < 1 || params.fps > 60)
+  if (!params.auto_fps && (params.fps < 1 || params.fps > 60))
     {
       return validation_error::invalid_fps;
     }
 
+  for (const auto &output : params.renditions)
+    {
+      if (output.path.empty ())
+        {
+          return validation_error::missing_output;
+        }
+      if (output.width < 100 || output.width > 4096)
+        {
+          return validation_error::invalid_width;
+        }
+      if (output.height < 100 || output.height > 4096)
+        {
+          return validation_error::invalid_height;
+        }
+      if (output.fps < 1 || output.fps > 60)
+        {
+          return validation_error::invalid_fps;
+        }
+    }
+
+  if (!params.erasure.valid ())
+    {
+      return validation_error::invalid_erasure;
+    }
+
+  if (!params.cipher)
+    {
+      return validation_error::invalid_cipher;
+    }
+
+  const bool chunked = params.resume || params.dedup || !params.base.empty ();
+  if ((params.append && (chunked || params.segments > 0))
+      || (params.segments > 0 && chunked))
+    {
+      return validation_error::conflicting_options;
+    }
+
+  if (!params.upload.empty ()
+      && (params.resume || params.append || params.segments > 0))
+    {
+      return validation_error::conflicting_upload;
+    }
+
+  // a stream can neither be read twice nor seeked in
+  if ((params.input_file == "-" || params.output_file == "-")
+      && (chunked || params.append || params.segments > 0 || params.plan
+          || params.auto_geometry || params.auto_fps
+          || !params.upload.empty () || !params.download.empty ()))
+    {
+      return validation_error::conflicting_stream;
+    }
+
+  // the outputs share one serialized payload
+  if (params.renditions.size () > 1
+      && (params.input_file == "-" || chunked || params.append
+          || params.segments > 0 || params.plan || params.auto_geometry
+          || params.auto_fps || !params.upload.empty () || params.queued
+          || std::ranges::any_of (params.renditions, [] (const auto &output) {
+               return output.path == "-";
+             })))
+    {
+      return validation_error::conflicting_fanout;
+    }
+
+  // the daemon runs plain chunk stream jobs
+  if (params.queued
+      && (params.input_file == "-" || params.output_file == "-"
+          || params.resume || !params.base.empty () || params.append
+          || params.segments > 0 || params.plan || params.auto_geometry
+          || params.auto_fps || !params.upload.empty ()
+          || !params.download.empty ()))
+    {
+      return validation_error::conflicting_queue;
+    }
+
+  if (params.segment
+      && (params.encrypt || params.input_file == "-"
+          || params.output_file == "-" || params.resume
+          || !params.download.empty () || params.queued))
+    {
+      return validation_error::conflicting_segment;
+    }
+
   return validation_error::success;
 }
 
+// bytes one video carries for input_size bytes of input, metadata and
+// parity frames included. for the chunk stream this is an upper bound,
+// compression and dedup only make it smaller
+std::size_t
+planned_bytes (const parameters &params, std::size_t input_size)
+{
+  const std::size_t meta = ftv::metadata_size (params.input_file.size ());
+  if (params.segments > 0)
+    {
+      input_size = (input_size + params.segments - 1) / params.segments;
+    }
+  std::size_t bytes = 0;
+  if (params.resume || params.dedup || !params.base.empty () || params.append
+      || params.segments > 0)
+    {
+      const std::size_t records
+          = (input_size + ftv::PIPELINE_CHUNK_SIZE - 1)
+                / ftv::PIPELINE_CHUNK_SIZE
+            + 1;
+      bytes = meta + input_size + records * ftv::CHUNK_RECORD_HEADER;
+    }
+  else
+    {
+      // gcm iv and tag in front of the ciphertext
+      bytes = meta + ftv::make_serialized_layout (12, 16).ciphertext_offset
+              + input_size;
+    }
+  // a parity frame is as large as a data frame
+  if (params.erasure.enabled ())
+    {
+      bytes += (bytes * params.erasure.parity_frames
+                + params.erasure.data_frames - 1)
+               / params.erasure.data_frames;
+    }
+  return bytes;
+}
+
+void
+print_plan (const parameters &params, const ftv::geometry_plan &plan)
+{
+  const double seconds = static_cast<double> (plan.encode_nanos) / 1e9;
+  std::println ("plan for {}{}:", params.input_file,
+                params.segments > 0 ? ", per segment" : "");
+  std::println ("  geometry   {}x{} at {} fps", plan.res.x, plan.res.y,
+                plan.fps);
+  std::println ("  frames     {} ({:.1f} s of video)", plan.frames,
+                plan.duration_seconds);
+  std::println ("  bytes      {} laid out, {} of them padding", plan.bytes,
+                plan.padding);
+  std::println ("  predicted  {:.2f} s to encode, {:.1f} MB/s", seconds,
+                seconds > 0 ? static_cast<double> (plan.bytes) / seconds / 1e6
+                            : 0.0);
+}
+
+// <file>[:<width>x<height>[@<fps>]]. what follows the last colon is only
+// the geometry if it reads as one, other paths with colons are kept whole
+rendition
+parse_rendition (std::string_view spec)
+{
+  const auto number = [] (std::string_view text, std::size_t &value) {
+    const auto end = text.data () + text.size ();
+    const auto [last, ec] = std::from_chars (text.data (), end, value);
+    return !text.empty () && ec == std::errc{} && last == end;
+  };
+
+  rendition output{ std::string{ spec } };
+  const auto colon = spec.rfind (':');
+  if (colon == std::string_view::npos)
+    {
+      return output;
+    }
+  const auto geometry = spec.substr (colon + 1);
+  const auto x = geometry.find ('x');
+  const auto at = geometry.find ('@');
+  rendition parsed{ std::string{ spec.substr (0, colon) } };
+  if (x == std::string_view::npos
+      || !number (geometry.substr (0, x), parsed.width)
+      || !number (geometry.substr (x + 1, at == std::string_view::npos
+                                              ? std::string_view::npos
+                                              : at - x - 1),
+                  parsed.height)
+      || (at != std::string_view::npos
+          && !number (geometry.substr (at + 1), parsed.fps)))
+    {
+      return output;
+    }
+  return parsed;
+}
+
 parameters
 parse_arguments (int argc, char **argv)
 {
@@ -163,13 +476,22 @@ parse_arguments (int argc, char **argv)
 
   std::string_view command = argv[1];
   params.encrypt = (command == "encrypt");
+  params.verify = (command == "verify");
+  params.serve = (command == "serve");
+  params.status = (command == "status");
 
-  if (argc > 2)
+  // serve takes no input and status an optional job id
+  int first_option = 3;
+  if ((params.serve || params.status) && (argc < 3 || argv[2][0] == '-'))
+    {
+      first_option = 2;
+    }
+  else if (argc > 2)
     {
       params.input_file = argv[2];
     }
 
-  for (int i = 3; i < argc; ++i)
+  for (int i = first_option; i < argc; ++i)
     {
       std::string_view arg = argv[i];
 
@@ -181,7 +503,12 @@ parse_arguments (int argc, char **argv)
 
       if (arg == "-o" || arg == "--output")
         {
-          if (++i < argc)
+          if (++i < argc && params.encrypt)
+            {
+              params.renditions.push_back (parse_rendition (argv[i]));
+              params.output_file = params.renditions.front ().path;
+            }
+          else if (i < argc)
             {
               params.output_file = argv[i];
             }
@@ -197,11 +524,19 @@ parse_arguments (int argc, char **argv)
           continue;
         }
 
+      // auto for either side lets the planner pick both
       if (arg == "-w" || arg == "--width")
         {
           if (++i < argc)
             {
-              params.width = std::stoul (argv[i]);
+              if (std::string_view{ argv[i] } == "auto")
+                {
+                  params.auto_geometry = true;
+                }
+              else
+                {
+                  params.width = std::stoul (argv[i]);
+                }
             }
           continue;
         }
@@ -210,7 +545,14 @@ parse_arguments (int argc, char **argv)
         {
           if (++i < argc)
             {
-              params.height = std::stoul (argv[i]);
+              if (std::string_view{ argv[i] } == "auto")
+                {
+                  params.auto_geometry = true;
+                }
+              else
+                {
+                  params.height = std::stoul (argv[i]);
+                }
             }
           continue;
         }
@@ -219,42 +561,747 @@ parse_arguments (int argc, char **argv)
         {
           if (++i < argc)
             {
-              params.fps = std::stoul (argv[i]);
+              if (std::string_view{ argv[i] } == "auto")
+                {
+                  params.auto_fps = true;
+                }
+              else
+                {
+                  params.fps = std::stoul (argv[i]);
+                }
             }
           continue;
         }
+
+      if (arg == "-p" || arg == "--plan")
+        {
+          params.plan = true;
+          continue;
+        }
+
+      if (arg == "-r" || arg == "--resume")
+        {
+          params.resume = true;
+          continue;
+        }
+
+      if (arg == "-s" || arg == "--segments")
+        {
+          if (++i < argc)
+            {
+              params.segments = std::stoul (argv[i]);
+            }
+          continue;
+        }
+
+      if (arg == "--segment")
+        {
+          if (++i < argc)
+            {
+              params.segment = std::stoul (argv[i]);
+            }
+          continue;
+        }
+
+      // data frames and optionally parity frames per group, 8:2
+      if (arg == "-e" || arg == "--erasure")
+        {
+          if (++i < argc)
+            {
+              const std::string value = argv[i];
+              const auto colon = value.find (':');
+              params.erasure.data_frames
+                  = std::stoul (value.substr (0, colon));
+              params.erasure.parity_frames
+                  = colon == std::string::npos
+                        ? 1
+                        : std::stoul (value.substr (colon + 1));
+            }
+          continue;
+        }
+
+      // auto times both ciphers once, here
+      if (arg == "-c" || arg == "--cipher")
+        {
+          if (++i < argc)
+            {
+              params.cipher = ftv::parse_cipher (argv[i]);
+            }
+          continue;
+        }
+
+      if (arg == "-a" || arg == "--append")
+        {
+          params.append = true;
+          continue;
+        }
+
+      if (arg == "-d" || arg == "--dedup")
+        {
+          params.dedup = true;
+          continue;
+        }
+
+      if (arg == "-b" || arg == "--base")
+        {
+          if (++i < argc)
+            {
+              params.base = argv[i];
+            }
+          continue;
+        }
+
+      if (arg == "-u" || arg == "--upload")
+        {
+          if (++i < argc)
+            {
+              params.upload = argv[i];
+            }
+          continue;
+        }
+
+      if (arg == "-g" || arg == "--download")
+        {
+          if (++i < argc)
+            {
+              params.download = argv[i];
+            }
+          continue;
+        }
+
+      if (arg == "-q" || arg == "--queue")
+        {
+          if (++i < argc)
+            {
+              params.queued = true;
+              if (std::string_view{ argv[i] } != "default")
+                {
+                  params.queue = argv[i];
+                }
+            }
+          continue;
+        }
+
+      if (arg == "--priority")
+        {
+          if (++i < argc)
+            {
+              params.priority = std::stoi (argv[i]);
+            }
+          continue;
+        }
+
+      if (arg == "-t" || arg == "--threads")
+        {
+          if (++i < argc)
+            {
+              params.threads = std::stoul (argv[i]);
+            }
+          continue;
+        }
+    }
+
+  // -w, -h and -f may come after -o. a single output's own geometry is the
+  // geometry of the whole encode
+  for (auto &output : params.renditions)
+    {
+      output.width = output.width > 0 ? output.width : params.width;
+      output.height = output.height > 0 ? output.height : params.height;
+      output.fps = output.fps > 0 ? output.fps : params.fps;
+    }
+  if (params.renditions.size () == 1)
+    {
+      params.width = params.renditions.front ().width;
+      params.height = params.renditions.front ().height;
+      params.fps = params.renditions.front ().fps;
     }
 
   return params;
 }
 
+// downloads the video with the id params.input_file and decodes it while it
+// arrives. a video that is not a chunk stream is only decoded once it is
+// complete: the download then replaces params.input_file and nullopt is
+// returned, otherwise the exit code
+std::optional<int>
+download_and_decode (parameters &params, const ftv::secure_key &key)
+{
+  const auto client = ftv::load_youtube_client (params.download);
+  if (!client)
+    {
+      std::println ("error authorizing download: {}",
+                    client.error ().message ());
+      return 1;
+    }
+
+  const std::filesystem::path local = params.output_file.empty ()
+                                          ? params.input_file + ".avi"
+                                          : params.output_file;
+  ftv::growing_file growing{};
+  std::error_code download_result{};
+  std::jthread downloader{ [&] {
+    download_result = client->download (params.input_file, local, &growing);
+  } };
+
+  std::string output_path{};
+  const auto decode_result = ftv::run_job (ftv::stream_decode_job (
+      ftv::avi_frames (local, &growing), key,
+      [&] (ftv::chunk_stream chunks, const ftv::metadata &meta) {
+        output_path = meta.filename () + "_decrypted";
+        return ftv::file_sink (std::move (chunks), output_path,
+                               std::nullopt, params.base);
+      }));
+  // a failed decode needs no more bytes, a video that has to be decoded
+  // whole needs all of them
+  const bool decode_failed
+      = decode_result && decode_result != std::errc::invalid_argument;
+  if (decode_failed)
+    {
+      growing.cancel ();
+    }
+  downloader.join ();
+
+  // a download the decode cancelled did not fail
+  if (download_result && download_result != std::errc::operation_canceled)
+    {
+      std::println ("error downloading video {}: {}", params.input_file,
+                    download_result.message ());
+      return 1;
+    }
+  if (decode_result == std::errc::operation_canceled)
+    {
+      std::println ("error decrypting data");
+      return 1;
+    }
+  if (decode_failed)
+    {
+      std::println ("error decoding video file: {}", local.string ());
+      return 1;
+    }
+  if (decode_result == std::errc::invalid_argument)
+    {
+      params.input_file = local.string ();
+      return std::nullopt;
+    }
+
+  std::println ("successfully decrypted {} to {}", params.input_file,
+                output_path);
+  return 0;
+}
+
+// decrypts one segment of a segmented or appended video on its own, with
+// the manifest of the whole video. params.input_file is the whole video
+// with params.segment, or one of its part files
+int
+decrypt_segment (const parameters &params, const ftv::secure_key &key)
+{
+  const auto named = ftv::parse_part_path (params.input_file);
+  const std::filesystem::path video
+      = params.segment || !named ? std::filesystem::path{ params.input_file }
+                                 : named->video;
+  const std::size_t part = params.segment ? *params.segment : named->part;
+
+  // parts of a resumed encode have no manifest and only decode together
+  if (!std::filesystem::exists (ftv::index_path (video)))
+    {
+      if (params.segment)
+        {
+          std::println ("error decoding video file: {} has no segments",
+                        params.input_file);
+        }
+      else
+        {
+          std::println ("error decoding video file: {} is part {} of {}, "
+                        "decrypt that instead",
+                        params.input_file, part, video.string ());
+        }
+      return 1;
+    }
+
+  const ftv::video vid{ video };
+  const auto output_path = std::format (
+      "{}_decrypted.part{}", vid.get_metadata ().filename (), part);
+  const auto offset = ftv::decode_segment (video, part, output_path, key);
+  if (!offset && offset.error () == std::errc::invalid_argument)
+    {
+      std::println ("error decoding video file: {} has no segment {}",
+                    video.string (), part);
+      return 1;
+    }
+  if (!offset && offset.error () == std::errc::file_exists)
+    {
+      std::println ("error writing decrypted file: {} already exists",
+                    output_path);
+      return 1;
+    }
+  if (!offset && offset.error () == std::errc::operation_canceled)
+    {
+      std::println ("error decrypting data");
+      return 1;
+    }
+  if (!offset)
+    {
+      std::println ("error decoding video file: {}",
+                    ftv::part_path (video, part).string ());
+      return 1;
+    }
+
+  std::println ("successfully decrypted segment {} of {} to {}, bytes "
+                "from {} of the file",
+                part, video.string (), output_path, *offset);
+  return 0;
+}
+
+// checks the video at params.input_file and everything that belongs to it,
+// decoding frames on every core
+int
+verify (const parameters &params)
+{
+  const auto report = ftv::verify_video (params.input_file);
+  if (report.error)
+    {
+      std::println ("error verifying video file: {}: frame {}: {}",
+                    report.failed_path.string (), report.failed_frame,
+                    report.error.message ());
+      return 1;
+    }
+
+  std::println ("successfully verified {}: {} videos, {} frames ({} "
+                "repeated, {} rebuilt), {} payload bytes, {} records",
+                params.input_file, report.videos, report.frames,
+                report.duplicates, report.rebuilt, report.payload_bytes,
+                report.records);
+  return 0;
+}
+
+// encrypts or decrypts with - for stdin or stdout. a job that writes to
+// stdout reports on stderr, so nothing but the data ends up in the pipe
+int
+stream_job (const parameters &params, const ftv::secure_key &key)
+{
+  const bool from_stdin = params.input_file == "-";
+  const bool to_stdout = params.output_file == "-";
+  const std::string input = from_stdin ? "stdin" : params.input_file;
+  const std::string output = to_stdout ? "stdout" : params.output_file;
+
+  if (params.encrypt)
+    {
+      const ftv::metadata data{ input,
+                                0,
+                                {},
+                                params.fps,
+                                { params.width, params.height },
+                                ftv::payload_format::chunk_stream,
+                                *params.cipher };
+      auto frames = ftv::stream_frames (
+          from_stdin ? ftv::descriptor_chunks (STDIN_FILENO)
+                     : ftv::file_chunks (params.input_file),
+          key, data, params.erasure);
+      const auto ec = ftv::run_job (
+          to_stdout
+              ? ftv::avi_sink (std::move (frames), STDOUT_FILENO, data)
+              : ftv::frame_sink (std::move (frames), params.output_file,
+                                 data));
+      if (ec)
+        {
+          std::println (stderr, "error encrypting file: {}: {}", input,
+                        ec.message ());
+          return 1;
+        }
+
+      std::println (stderr, "successfully encrypted {} to {}", input,
+                    output);
+      return 0;
+    }
+
+  std::string output_path = output;
+  const auto ec = ftv::run_job (ftv::stream_decode_job (
+      from_stdin ? ftv::descriptor_frames (STDIN_FILENO)
+                 : ftv::avi_frames (params.input_file),
+      key, [&] (ftv::chunk_stream chunks, const ftv::metadata &meta) {
+        if (to_stdout)
+          {
+            return ftv::descriptor_sink (std::move (chunks), STDOUT_FILENO);
+          }
+        output_path = meta.filename () + "_decrypted";
+        return ftv::file_sink (std::move (chunks), output_path);
+      }));
+  if (ec == std::errc::invalid_argument)
+    {
+      std::println (stderr, "error decoding video file: {}: only chunk "
+                            "stream videos can be streamed",
+                    input);
+      return 1;
+    }
+  if (ec == std::errc::operation_canceled)
+    {
+      std::println (stderr, "error decrypting data");
+      return 1;
+    }
+  if (ec)
+    {
+      std::println (stderr, "error decoding video file: {}: {}", input,
+                    ec.message ());
+      return 1;
+    }
+
+  std::println (stderr, "successfully decrypted {} to {}", input,
+                output_path);
+  return 0;
+}
+
+// runs the daemon until a client shuts it down or it gets sigint or sigterm
+int
+serve (const parameters &params)
+{
+  ftv::server_options options{};
+  if (!params.queue.empty ())
+    {
+      options.socket = params.queue;
+    }
+  options.threads = params.threads;
+
+  // the signals go to a thread of their own, they are blocked before the
+  // workers start so every thread inherits the mask
+  sigset_t signals{};
+  sigemptyset (&signals);
+  sigaddset (&signals, SIGINT);
+  sigaddset (&signals, SIGTERM);
+  pthread_sigmask (SIG_BLOCK, &signals, nullptr);
+
+  ftv::server daemon{ options };
+  const std::jthread stopper{ [&] (std::stop_token token) {
+    const timespec poll{ 0, 200'000'000 };
+    while (!token.stop_requested ())
+      {
+        if (sigtimedwait (&signals, nullptr, &poll) > 0)
+          {
+            daemon.stop ();
+            return;
+          }
+      }
+  } };
+
+  std::println ("serving on {} with {} workers", options.socket.string (),
+                options.threads);
+  const auto ec = daemon.run ();
+  if (ec)
+    {
+      std::println ("error serving on {}: {}", options.socket.string (),
+                    ec.message ());
+      return 1;
+    }
+
+  std::println ("stopped serving on {}", options.socket.string ());
+  return 0;
+}
+
+// connects to the daemon at params.queue, errors are printed
+std::optional<ftv::daemon_client>
+connect_daemon (const parameters &params)
+{
+  const auto socket = params.queue.empty ()
+                          ? ftv::default_socket_path ()
+                          : std::filesystem::path{ params.queue };
+  auto client = ftv::daemon_client::connect (socket);
+  if (!client)
+    {
+      std::println ("error connecting to ftv serve on {}: {}",
+                    socket.string (), client.error ().message ());
+      return std::nullopt;
+    }
+  return std::move (*client);
+}
+
+// lists the jobs of the daemon, or the one with the id params.input_file
+int
+status (const parameters &params)
+{
+  auto client = connect_daemon (params);
+  if (!client)
+    {
+      return 1;
+    }
+
+  ftv::message request{ "status", {} };
+  if (!params.input_file.empty ())
+    {
+      request.fields.emplace ("id", params.input_file);
+    }
+  const auto answer = client->call (request);
+  if (!answer)
+    {
+      std::println ("error talking to ftv serve: {}",
+                    answer.error ().message ());
+      return 1;
+    }
+  if (!answer->ok ())
+    {
+      std::println ("error: {}",
+                    answer->result.field ("message").value_or ("unknown"));
+      return 1;
+    }
+
+  const auto print_job = [] (const ftv::message &job) {
+    const auto error = job.field ("message");
+    std::println ("{:>6} {} {:<7} {:>3} {:>12} {} -> {}{}",
+                  job.field ("id").value_or (""),
+                  job.field ("kind").value_or (""),
+                  job.field ("state").value_or (""),
+                  job.field ("priority").value_or (""),
+                  job.field ("progress").value_or (""),
+                  job.field ("input").value_or (""),
+                  job.field ("output").value_or (""),
+                  error ? ": " + *error : "");
+  };
+  if (!params.input_file.empty ())
+    {
+      print_job (answer->result);
+      return 0;
+    }
+  for (const auto &job : answer->jobs)
+    {
+      print_job (job);
+    }
+  return 0;
+}
+
+// hands the job to the daemon and waits for it, the daemon reads and
+// writes the files relative to the working directory here
+int
+queue_job (const parameters &params)
+{
+  auto client = connect_daemon (params);
+  if (!client)
+    {
+      return 1;
+    }
+
+  ftv::message request{
+    params.encrypt ? "encode" : "decode",
+    { { "input", params.input_file },
+      { "key", params.key },
+      { "cwd", std::filesystem::current_path ().string () },
+      { "priority", std::to_string (params.priority) } }
+  };
+  if (params.encrypt)
+    {
+      request.fields.emplace ("output", params.output_file);
+      request.fields.emplace ("width", std::to_string (params.width));
+      request.fields.emplace ("height", std::to_string (params.height));
+      request.fields.emplace ("fps", std::to_string (params.fps));
+      request.fields.emplace ("cipher",
+                              ftv::cipher_name (*params.cipher));
+      if (params.erasure.enabled ())
+        {
+          request.fields.emplace (
+              "erasure", std::format ("{}:{}", params.erasure.data_frames,
+                                      params.erasure.parity_frames));
+        }
+      if (params.dedup)
+        {
+          request.fields.emplace ("dedup", "1");
+        }
+    }
+
+  const auto queued = client->call (request);
+  if (!queued)
+    {
+      std::println ("error talking to ftv serve: {}",
+                    queued.error ().message ());
+      return 1;
+    }
+  if (!queued->ok ())
+    {
+      std::println ("error queueing {}: {}", params.input_file,
+                    queued->result.field ("message").value_or ("unknown"));
+      return 1;
+    }
+  const auto id = queued->result.field ("id").value_or ("");
+  std::println ("queued {} as job {}", params.input_file, id);
+
+  const auto finished = client->call ({ "wait", { { "id", id } } });
+  if (!finished)
+    {
+      std::println ("error talking to ftv serve: {}",
+                    finished.error ().message ());
+      return 1;
+    }
+  const auto output = finished->result.field ("output").value_or ("");
+  if (!finished->ok ())
+    {
+      std::println ("error {} file: {}: {}",
+                    params.encrypt ? "encrypting" : "decoding video",
+                    params.input_file,
+                    finished->result.field ("message").value_or ("unknown"));
+      return 1;
+    }
+
+  std::println ("successfully {} {} to {}",
+                params.encrypt ? "encrypted" : "decrypted", params.input_file,
+                output);
+  return 0;
+}
+
 int
 main (int argc, char **argv)
 {
   auto params = parse_arguments (argc, argv);
 
+  if (params.serve)
+    {
+      return serve (params);
+    }
+  if (params.status)
+    {
+      return status (params);
+    }
+
   auto validation_result = validate_parameters (params);
   if (validation_result != validation_error::success)
     {
-      std::println ("error: {}",
+      // nothing but data goes to stdout when it is the output
+      std::println (params.output_file == "-" ? stderr : stdout,
+                    "error: {}",
                     validation_error_to_string (validation_result));
       return 1;
     }
 
+  if (params.verify)
+    {
+      return verify (params);
+    }
+
+  if (params.queued)
+    {
+      return queue_job (params);
+    }
+
+  if (params.encrypt
+      && (params.auto_geometry || params.auto_fps || params.plan))
+    {
+      const auto bytes = planned_bytes (
+          params, std::filesystem::file_size (params.input_file));
+      const auto fps = params.auto_fps ? ftv::MAX_FPS : params.fps;
+      const auto plan
+          = params.auto_geometry
+                ? ftv::plan_geometry (bytes, fps)
+                : ftv::evaluate_geometry (
+                      bytes, { params.width, params.height }, fps);
+      params.width = plan.res.x;
+      params.height = plan.res.y;
+      params.fps = plan.fps;
+
+      if (params.plan)
+        {
+          print_plan (params, plan);
+          return 0;
+        }
+    }
+
   using namespace std::string_view_literals;
   ftv::secure_key key{ params.key };
 
-  if (params.encrypt)
+  if (params.input_file == "-" || params.output_file == "-")
     {
-      ftv::file f{ params.input_file };
-      const auto encrypted = ftv::encrypt (f, key, ftv::aes_256_gcm);
+      return stream_job (params, key);
+    }
+
+  // every buffer of the job comes from one arena and is released at once
+  ftv::job_arena arena{};
+
+  if (params.encrypt && params.append)
+    {
+      // earlier segments stay as they are, only the new bytes are encoded
+      const ftv::metadata data{ params.input_file,
+                                0,
+                                {},
+                                params.fps,
+                                { params.width, params.height },
+                                ftv::payload_format::chunk_stream,
+                                *params.cipher };
+      const auto ec = ftv::run_job (ftv::append_job (
+          params.input_file, params.output_file, key, data, params.erasure));
+      if (ec)
+        {
+          std::println ("error appending file: {}: {}", params.input_file,
+                        ec.message ());
+          return 1;
+        }
+
+      std::println ("successfully appended {} to {}", params.input_file,
+                    params.output_file);
+    }
+  else if (params.encrypt && params.segments > 0)
+    {
+      // every segment is encoded on its own thread
+      const ftv::metadata data{ params.input_file,
+                                0,
+                                {},
+                                params.fps,
+                                { params.width, params.height },
+                                ftv::payload_format::chunk_stream,
+                                *params.cipher };
+      const auto ec
+          = ftv::encode_segmented (params.input_file, params.output_file, key,
+                                   data, params.segments, params.erasure);
+      if (ec)
+        {
+          std::println ("error encrypting file: {}: {}", params.input_file,
+                        ec.message ());
+          return 1;
+        }
+
+      std::println ("successfully encrypted {} to {}", params.input_file,
+                    params.output_file);
+    }
+  else if (params.encrypt
+           && (params.resume || params.dedup || !params.base.empty ()))
+    {
+      // the chunk stream can be split into parts that are finished one by
+      // one and can reference earlier chunks, a single aead message can not
+      const ftv::metadata data{ params.input_file,
+                                0,
+                                {},
+                                params.fps,
+                                { params.width, params.height },
+                                ftv::payload_format::chunk_stream,
+                                *params.cipher };
+      ftv::encode_options options{};
+      if (params.resume)
+        {
+          options.checkpoint_path = params.output_file + ".ckpt";
+        }
+      options.dedup = params.dedup;
+      options.base = params.base;
+      options.erasure = params.erasure;
+      const auto ec = ftv::run_job (ftv::encode_job (
+          params.input_file, params.output_file, key, data, options));
+      if (ec)
+        {
+          std::println ("error encrypting file: {}: {}", params.input_file,
+                        ec.message ());
+          return 1;
+        }
+
+      std::println ("successfully encrypted {} to {}", params.input_file,
+                    params.output_file);
+    }
+  else if (params.encrypt)
+    {
+      // reading the input overlaps with encrypting and hashing it
+      ftv::blake3_digest checksum{};
+      const auto encrypted
+          = ftv::encrypt_file (params.input_file, key, *params.cipher,
+                               arena.resource (), &checksum);
       if (!encrypted)
         {
           std::println ("error encrypting file: {}", params.input_file);
           return 1;
         }
 
-      const auto serialized = ftv::serialize_encrypted_data (*encrypted);
+      const auto serialized
+          = ftv::serialize_encrypted_data (*encrypted, arena.resource ());
       if (!serialized)
         {
           std::println ("error serializing encrypted data: {}",
@@ -262,60 +1309,166 @@ main (int argc, char **argv)
           return 1;
         }
 
-      ftv::metadata data{ params.input_file,
-                          serialized->size (),
-                          ftv::hash (*serialized),
-                          params.fps,
-                          { params.width, params.height } };
+      // every output renders and writes the one serialized payload on a
+      // thread of its own, with buffers from an arena of its own. frames
+      // are cut from the shared segments as they are rendered, so an
+      // output holds only its frame pool
+      std::vector<std::error_code> results (params.renditions.size ());
+      {
+        std::vector<std::jthread> writers{};
+        writers.reserve (params.renditions.size ());
+        for (std::size_t i = 0; i < params.renditions.size (); ++i)
+          {
+            writers.emplace_back ([&, i] {
+              const auto &output = params.renditions[i];
+              const ftv::metadata data{ params.input_file,
+                                        serialized->size (),
+                                        checksum,
+                                        output.fps,
+                                        { output.width, output.height },
+                                        ftv::payload_format::serialized,
+                                        *params.cipher };
+              ftv::job_arena output_arena{};
+              ftv::video vid{ output.path, data, output_arena.resource () };
+              vid.set_erasure (params.erasure);
+              results[i] = vid.write (serialized->segments ());
+            });
+          }
+      }
 
-      ftv::video vid{ params.output_file, data };
-      auto ec = vid.write (*serialized);
-      if (ec.value () != 0)
+      bool failed = false;
+      for (std::size_t i = 0; i < params.renditions.size (); ++i)
+        {
+          const auto &output = params.renditions[i];
+          if (results[i])
+            {
+              std::println ("error writing video file: {}", output.path);
+              failed = true;
+              continue;
+            }
+          std::println ("successfully encrypted {} to {}", params.input_file,
+                        output.path);
+        }
+      if (failed)
         {
-          std::println ("error writing video file: {}", params.output_file);
           return 1;
         }
-
-      std::println ("successfully encrypted {} to {}", params.input_file,
-                    params.output_file);
     }
   else
     {
-      ftv::video vid{ params.input_file };
-      const auto pixels = vid.read ();
-      if (!pixels)
+      if (!params.download.empty ())
         {
-          std::println ("error reading video file: {}", params.input_file);
-          return 1;
+          if (const auto code = download_and_decode (params, key))
+            {
+              return *code;
+            }
         }
 
-      const auto bytes_from_vid = ftv::pixels_to_bytes (*pixels);
+      // a part file names the video it belongs to. a name that only looks
+      // like one, with no such video next to it, is decoded as it is
+      const auto named = ftv::parse_part_path (params.input_file);
+      if (params.segment
+          || (named && std::filesystem::exists (named->video)))
+        {
+          return decrypt_segment (params, key);
+        }
 
-      if (ftv::hash (bytes_from_vid) != vid.get_metadata ().checksum ())
+      ftv::video vid{ params.input_file, arena.resource () };
+
+      // videos from the pipeline api are decoded record by record
+      if (vid.get_metadata ().format () == ftv::payload_format::chunk_stream)
+        {
+          auto output_path
+              = vid.get_metadata ().filename ().append ("_decrypted");
+          // segments listed in a trailer decode in parallel, but only a
+          // sequential decode keeps checkpoints
+          std::error_code decode_result{};
+          if (!params.resume
+              && std::filesystem::exists (ftv::index_path (params.input_file)))
+            {
+              decode_result = ftv::decode_segmented (params.input_file,
+                                                     output_path, key);
+            }
+          else
+            {
+              ftv::decode_options options{};
+              if (params.resume)
+                {
+                  options.checkpoint_path = output_path + ".ckpt";
+                }
+              options.base = params.base;
+              decode_result = ftv::run_job (ftv::decode_job (
+                  params.input_file, output_path, key, options));
+            }
+          if (decode_result && named)
+            {
+              std::println ("error decoding video file: {} looks like part "
+                            "{} of {}, which is missing",
+                            params.input_file, named->part,
+                            named->video.string ());
+              return 1;
+            }
+          if (decode_result == std::errc::operation_canceled)
+            {
+              std::println ("error decrypting data");
+              return 1;
+            }
+          if (decode_result)
+            {
+              std::println ("error decoding video file: {}",
+                            params.input_file);
+              return 1;
+            }
+
+          std::println ("successfully decrypted {} to {}", params.input_file,
+                        output_path);
+          return 0;
+        }
+
+      // the checksum is checked as the frames are read
+      const auto pixels = vid.read ();
+      if (!pixels && vid.failed_frame ())
+        {
+          std::println ("error reading video file: {}: frame {}: {}",
+                        params.input_file, *vid.failed_frame (),
+                        pixels.error ().message ());
+          return 1;
+        }
+      if (!pixels && pixels.error () == std::errc::bad_message)
         {
           std::println ("data corruption on video file: {}",
                         params.input_file);
           return 1;
         }
+      if (!pixels)
+        {
+          std::println ("error reading video file: {}", params.input_file);
+          return 1;
+        }
+
+      auto bytes_from_vid
+          = ftv::pixels_to_bytes (*pixels, arena.resource (),
+                                  ftv::layout_of (vid.get_metadata ()));
 
-      const auto deserialized
-          = ftv::deserialize_encrypted_data (bytes_from_vid);
+      // the decoded buffer is adopted and decrypted in place
+      auto deserialized
+          = ftv::deserialize_encrypted_data (std::move (bytes_from_vid));
       if (!deserialized)
         {
           std::println ("error deserializing video data");
           return 1;
         }
 
-      const auto file = ftv::decrypt (*deserialized, key);
-      if (!file)
+      // decrypting overlaps with writing the plaintext out
+      auto output_path = vid.get_metadata ().filename ().append ("_decrypted");
+      const auto decrypt_result = ftv::decrypt_to_file (
+          *deserialized, key, output_path, vid.get_metadata ().cipher ());
+      if (decrypt_result == std::errc::operation_canceled)
         {
           std::println ("error decrypting data");
           return 1;
         }
-
-      auto output_path = vid.get_metadata ().filename ().append ("_decrypted");
-      auto write_result = ftv::write (*file, output_path);
-      if (write_result.value () != 0)
+      if (decrypt_result)
         {
           std::println ("error writing decrypted file: {}", output_path);
           return 1;
@@ -325,5 +1478,31 @@ main (int argc, char **argv)
                     output_path);
     }
 
+  // the finished video is streamed from disk, resuming after failures
+  if (params.encrypt && !params.upload.empty ())
+    {
+      const auto client = ftv::load_youtube_client (params.upload);
+      if (!client)
+        {
+          std::println ("error authorizing upload: {}",
+                        client.error ().message ());
+          return 1;
+        }
+
+      const auto id = client->upload (
+          params.output_file,
+          std::filesystem::path{ params.input_file }.filename ().string (),
+          "");
+      if (!id)
+        {
+          std::println ("error uploading video file: {}: {}",
+                        params.output_file, id.error ().message ());
+          return 1;
+        }
+
+      std::println ("successfully uploaded {} as {}", params.output_file,
+                    *id);
+    }
+
   return 0;
 }
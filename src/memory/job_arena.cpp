@@ -0,0 +1,115 @@
+#include "memory/job_arena.hpp"
+
+#include <new>
+
+#include <sys/mman.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+inline constexpr std::size_t HUGE_PAGE_SIZE{ std::size_t{ 2 } << 20 };
+
+[[nodiscard]] std::size_t
+round_up (std::size_t bytes, std::size_t multiple) noexcept
+{
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+job_arena::mapped_resource::mapped_resource (arena_pages pages) noexcept
+    : pages_{ pages }
+{
+}
+
+void *
+job_arena::mapped_resource::do_allocate (std::size_t bytes,
+                                         std::size_t alignment)
+{
+  // mappings are page aligned, which covers every alignment the arena asks
+  // for
+  if (alignment > HUGE_PAGE_SIZE)
+    {
+      throw std::bad_alloc ();
+    }
+
+  void *block = MAP_FAILED;
+  if (this->pages_ == arena_pages::huge)
+    {
+      block = ::mmap (nullptr, round_up (bytes, HUGE_PAGE_SIZE),
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (block == MAP_FAILED)
+        {
+          // no huge pages reserved, ask for transparent ones instead
+          block = ::mmap (nullptr, round_up (bytes, HUGE_PAGE_SIZE),
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if (block != MAP_FAILED)
+            {
+              ::madvise (block, round_up (bytes, HUGE_PAGE_SIZE),
+                         MADV_HUGEPAGE);
+            }
+        }
+      bytes = round_up (bytes, HUGE_PAGE_SIZE);
+    }
+  else
+    {
+      block = ::mmap (nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+  if (block == MAP_FAILED)
+    {
+      throw std::bad_alloc ();
+    }
+  this->mapped_ += bytes;
+  return block;
+}
+
+void
+job_arena::mapped_resource::do_deallocate (void *block, std::size_t bytes,
+                                           std::size_t /* alignment */)
+{
+  if (this->pages_ == arena_pages::huge)
+    {
+      bytes = round_up (bytes, HUGE_PAGE_SIZE);
+    }
+  ::munmap (block, bytes);
+  this->mapped_ -= bytes;
+}
+
+[[nodiscard]] bool
+job_arena::mapped_resource::do_is_equal (
+    const std::pmr::memory_resource &other) const noexcept
+{
+  return this == &other;
+}
+
+job_arena::job_arena (std::size_t initial_size, arena_pages pages)
+    : upstream_{ pages }, arena_{ initial_size, &this->upstream_ }
+{
+}
+
+[[nodiscard]] std::pmr::memory_resource *
+job_arena::resource () noexcept
+{
+  return &this->arena_;
+}
+
+[[nodiscard]] std::size_t
+job_arena::mapped () const noexcept
+{
+  return this->upstream_.mapped ();
+}
+
+void
+job_arena::release () noexcept
+{
+  this->arena_.release ();
+}
+
+} // namespace ftv
@@ -0,0 +1,154 @@
+#include "pipeline/checkpoint.hpp"
+#include "file/file.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+inline constexpr std::array<char, 8> CHECKPOINT_MAGIC{ 'f', 't', 'v', 'c',
+                                                       'k', 'p', 't', '1' };
+inline constexpr std::size_t CHECKPOINT_SIZE{
+  CHECKPOINT_MAGIC.size () + 6 * sizeof (std::uint64_t) + 32
+};
+
+void
+put (std::span<std::byte> out, std::size_t &pos, const void *value,
+     std::size_t size) noexcept
+{
+  std::memcpy (out.data () + pos, value, size);
+  pos += size;
+}
+
+void
+get (std::span<const std::byte> in, std::size_t &pos, void *value,
+     std::size_t size) noexcept
+{
+  std::memcpy (value, in.data () + pos, size);
+  pos += size;
+}
+
+} // namespace
+
+[[nodiscard]] std::expected<checkpoint, std::error_code>
+load_checkpoint (const std::filesystem::path &path) noexcept
+{
+  const auto bytes = read (path);
+  if (!bytes)
+    {
+      return std::unexpected (bytes.error ());
+    }
+  if (bytes->size () != CHECKPOINT_SIZE
+      || std::memcmp (bytes->data (), CHECKPOINT_MAGIC.data (),
+                      CHECKPOINT_MAGIC.size ())
+             != 0)
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+
+  checkpoint state{};
+  std::size_t pos = CHECKPOINT_MAGIC.size ();
+  get (*bytes, pos, &state.kind, sizeof (state.kind));
+  get (*bytes, pos, &state.source_size, sizeof (state.source_size));
+  get (*bytes, pos, state.key_id.data (), state.key_id.size ());
+  get (*bytes, pos, &state.parts, sizeof (state.parts));
+  get (*bytes, pos, &state.record_index, sizeof (state.record_index));
+  get (*bytes, pos, &state.input_offset, sizeof (state.input_offset));
+  get (*bytes, pos, &state.output_offset, sizeof (state.output_offset));
+
+  if (state.kind != checkpoint_kind::encode
+      && state.kind != checkpoint_kind::decode)
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+  return state;
+}
+
+[[nodiscard]] std::error_code
+save_checkpoint (const checkpoint &state,
+                 const std::filesystem::path &path) noexcept
+{
+  std::array<std::byte, CHECKPOINT_SIZE> bytes{};
+  std::size_t pos = 0;
+  put (bytes, pos, CHECKPOINT_MAGIC.data (), CHECKPOINT_MAGIC.size ());
+  put (bytes, pos, &state.kind, sizeof (state.kind));
+  put (bytes, pos, &state.source_size, sizeof (state.source_size));
+  put (bytes, pos, state.key_id.data (), state.key_id.size ());
+  put (bytes, pos, &state.parts, sizeof (state.parts));
+  put (bytes, pos, &state.record_index, sizeof (state.record_index));
+  put (bytes, pos, &state.input_offset, sizeof (state.input_offset));
+  put (bytes, pos, &state.output_offset, sizeof (state.output_offset));
+
+  // a crash leaves either the old or the new checkpoint, never half of one
+  auto temp_path = path;
+  temp_path += ".tmp";
+  if (const auto ec = write (bytes, temp_path))
+    {
+      return ec;
+    }
+  if (const auto ec = sync_file (temp_path))
+    {
+      return ec;
+    }
+  std::error_code ec{};
+  std::filesystem::rename (temp_path, path, ec);
+  return ec;
+}
+
+[[nodiscard]] std::array<std::byte, 32>
+checkpoint_key_id (const secure_key &key) noexcept
+{
+  std::array<std::byte, 32> digest{};
+  unsigned int size = 0;
+  EVP_Digest (key.get ().data (), key.get ().size (),
+              reinterpret_cast<unsigned char *> (digest.data ()), &size,
+              EVP_sha256 (), nullptr);
+  return digest;
+}
+
+[[nodiscard]] std::filesystem::path
+part_path (const std::filesystem::path &video, std::uint64_t part)
+{
+  if (part == 0)
+    {
+      return video;
+    }
+  return video.parent_path ()
+         / (video.stem ().string () + ".part" + std::to_string (part)
+            + video.extension ().string ());
+}
+
+std::optional<part_name>
+parse_part_path (const std::filesystem::path &path)
+{
+  const std::string stem = path.stem ().string ();
+  const auto dot = stem.rfind (".part");
+  if (dot == std::string::npos)
+    {
+      return std::nullopt;
+    }
+  const auto digits = std::string_view{ stem }.substr (dot + 5);
+  std::uint64_t part = 0;
+  const auto end = digits.data () + digits.size ();
+  const auto [last, ec] = std::from_chars (digits.data (), end, part);
+  // part_path writes no leading zeros and never part 0
+  if (digits.empty () || digits.front () == '0' || ec != std::errc{}
+      || last != end)
+    {
+      return std::nullopt;
+    }
+  return part_name{ path.parent_path ()
+                        / (stem.substr (0, dot) + path.extension ().string ()),
+                    part };
+}
+
+} // namespace ftv
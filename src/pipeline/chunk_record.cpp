@@ -0,0 +1,45 @@
+#include "pipeline/chunk_record.hpp"
+
+#include <cstring>
+
+namespace ftv
+{
+
+void
+write_chunk_header (const chunk_record_header &header,
+                    std::span<std::byte, CHUNK_RECORD_HEADER> out) noexcept
+{
+  std::byte *dst = out.data ();
+  std::memcpy (dst, &header.size, sizeof (header.size));
+  dst += sizeof (header.size);
+  *dst++ = std::byte{ header.flags };
+  std::memcpy (dst, header.init_vec.data (), header.init_vec.size ());
+  dst += header.init_vec.size ();
+  std::memcpy (dst, header.tag.data (), header.tag.size ());
+}
+
+[[nodiscard]] chunk_record_header
+read_chunk_header (
+    std::span<const std::byte, CHUNK_RECORD_HEADER> in) noexcept
+{
+  chunk_record_header header{};
+  const std::byte *src = in.data ();
+  std::memcpy (&header.size, src, sizeof (header.size));
+  src += sizeof (header.size);
+  header.flags = std::to_integer<std::uint8_t> (*src++);
+  std::memcpy (header.init_vec.data (), src, header.init_vec.size ());
+  src += header.init_vec.size ();
+  std::memcpy (header.tag.data (), src, header.tag.size ());
+  return header;
+}
+
+[[nodiscard]] std::array<std::byte, sizeof (std::uint64_t) + 1>
+chunk_additional_data (std::uint64_t index, std::uint8_t flags) noexcept
+{
+  std::array<std::byte, sizeof (std::uint64_t) + 1> data{};
+  std::memcpy (data.data (), &index, sizeof (index));
+  data.back () = std::byte{ flags };
+  return data;
+}
+
+} // namespace ftv
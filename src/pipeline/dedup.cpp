@@ -0,0 +1,160 @@
+#include "pipeline/dedup.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include <openssl/evp.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+// random values for every byte, from splitmix64 so they are the same on
+// every build and encoders agree on the boundaries
+[[nodiscard]] consteval std::array<std::uint64_t, 256>
+make_gear_table () noexcept
+{
+  std::array<std::uint64_t, 256> table{};
+  std::uint64_t state = 0x6674762d63646331; // "ftv-cdc1"
+  for (auto &value : table)
+    {
+      state += 0x9e3779b97f4a7c15;
+      std::uint64_t z = state;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      value = z ^ (z >> 31);
+    }
+  return table;
+}
+
+inline constexpr std::array<std::uint64_t, 256> GEAR{ make_gear_table () };
+
+// the hash shifts left once per byte, so its top bits depend on the most
+// bytes
+[[nodiscard]] std::uint64_t
+top_bits (unsigned count) noexcept
+{
+  return count == 0 ? 0 : ~std::uint64_t{ 0 } << (64 - count);
+}
+
+} // namespace
+
+[[nodiscard]] std::size_t
+cdc_cut (std::span<const std::byte> data, const cdc_params &params) noexcept
+{
+  if (data.size () <= params.min_size)
+    {
+      return data.size ();
+    }
+
+  const auto bits = static_cast<unsigned> (std::countr_zero (params.avg_size));
+  const std::uint64_t hard_mask = top_bits (bits + 2);
+  const std::uint64_t easy_mask = top_bits (bits > 2 ? bits - 2 : 0);
+  const std::size_t normal = std::min (params.avg_size, data.size ());
+  const std::size_t end = std::min (params.max_size, data.size ());
+
+  std::uint64_t hash = 0;
+  std::size_t i = params.min_size;
+  for (; i < normal; ++i)
+    {
+      hash = (hash << 1) + GEAR[std::to_integer<std::uint8_t> (data[i])];
+      if ((hash & hard_mask) == 0)
+        {
+          return i + 1;
+        }
+    }
+  for (; i < end; ++i)
+    {
+      hash = (hash << 1) + GEAR[std::to_integer<std::uint8_t> (data[i])];
+      if ((hash & easy_mask) == 0)
+        {
+          return i + 1;
+        }
+    }
+  return end;
+}
+
+[[nodiscard]] chunk_digest
+chunk_digest_of (std::span<const std::byte> data) noexcept
+{
+  chunk_digest digest{};
+  unsigned int size = 0;
+  EVP_Digest (data.data (), data.size (),
+              reinterpret_cast<unsigned char *> (digest.data ()), &size,
+              EVP_sha256 (), nullptr);
+  return digest;
+}
+
+void
+write_chunk_reference (const chunk_reference &reference,
+                       std::span<std::byte, CHUNK_REFERENCE_SIZE> out) noexcept
+{
+  std::byte *dst = out.data ();
+  *dst++ = std::byte{ static_cast<std::uint8_t> (reference.source) };
+  std::memcpy (dst, &reference.offset, sizeof (reference.offset));
+  dst += sizeof (reference.offset);
+  std::memcpy (dst, &reference.length, sizeof (reference.length));
+  dst += sizeof (reference.length);
+  std::memcpy (dst, reference.digest.data (), reference.digest.size ());
+}
+
+[[nodiscard]] std::expected<chunk_reference, std::error_code>
+read_chunk_reference (std::span<const std::byte> in) noexcept
+{
+  if (in.size () != CHUNK_REFERENCE_SIZE)
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+
+  chunk_reference reference{};
+  const std::byte *src = in.data ();
+  const auto source = std::to_integer<std::uint8_t> (*src++);
+  if (source > static_cast<std::uint8_t> (chunk_source::base))
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+  reference.source = static_cast<chunk_source> (source);
+  std::memcpy (&reference.offset, src, sizeof (reference.offset));
+  src += sizeof (reference.offset);
+  std::memcpy (&reference.length, src, sizeof (reference.length));
+  src += sizeof (reference.length);
+  std::memcpy (reference.digest.data (), src, reference.digest.size ());
+  return reference;
+}
+
+void
+chunk_index::insert (const chunk_reference &reference)
+{
+  this->chunks_.try_emplace (reference.digest, reference);
+}
+
+[[nodiscard]] std::optional<chunk_reference>
+chunk_index::find (const chunk_digest &digest) const noexcept
+{
+  const auto found = this->chunks_.find (digest);
+  if (found == this->chunks_.end ())
+    {
+      return std::nullopt;
+    }
+  return found->second;
+}
+
+[[nodiscard]] std::size_t
+chunk_index::size () const noexcept
+{
+  return this->chunks_.size ();
+}
+
+[[nodiscard]] std::size_t
+chunk_index::digest_hash::operator() (
+    const chunk_digest &digest) const noexcept
+{
+  std::size_t value = 0;
+  std::memcpy (&value, digest.data (), sizeof (value));
+  return value;
+}
+
+} // namespace ftv
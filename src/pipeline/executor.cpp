@@ -0,0 +1,153 @@
+#include "pipeline/executor.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <ranges>
+#include <utility>
+
+namespace ftv
+{
+
+struct pipeline_executor::job
+{
+  progress_stream steps;
+  completion done;
+  int priority;
+  progress on_progress;
+  std::optional<std::ranges::iterator_t<progress_stream>> position{};
+
+  // advances by one step, false once the job has finished
+  [[nodiscard]] bool
+  step ()
+  {
+    if (!this->position)
+      {
+        this->position.emplace (this->steps.begin ());
+      }
+    else
+      {
+        ++*this->position;
+      }
+    if (*this->position == this->steps.end ())
+      {
+        return false;
+      }
+    if (this->on_progress)
+      {
+        this->on_progress (**this->position);
+      }
+    return true;
+  }
+};
+
+pipeline_executor::pipeline_executor (std::size_t threads)
+{
+  threads = std::max<std::size_t> (threads, 1);
+  this->workers_.reserve (threads);
+  for (std::size_t i = 0; i < threads; ++i)
+    {
+      this->workers_.emplace_back ([this] { work (); });
+    }
+}
+
+pipeline_executor::~pipeline_executor ()
+{
+  wait ();
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->stopping_ = true;
+  }
+  this->ready_.notify_all ();
+}
+
+void
+pipeline_executor::submit (progress_stream steps, completion done,
+                           int priority, progress on_progress)
+{
+  auto next = std::make_unique<job> (std::move (steps), std::move (done),
+                                     priority, std::move (on_progress));
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    this->enqueue (std::move (next));
+    ++this->unfinished_;
+  }
+  this->ready_.notify_one ();
+}
+
+void
+pipeline_executor::wait ()
+{
+  std::unique_lock lock{ this->mutex_ };
+  this->idle_.wait (lock, [this] { return this->unfinished_ == 0; });
+}
+
+void
+pipeline_executor::enqueue (std::unique_ptr<job> next)
+{
+  const auto behind = std::ranges::find_if (
+      this->queue_, [&next] (const std::unique_ptr<job> &queued) {
+        return queued->priority < next->priority;
+      });
+  this->queue_.insert (behind, std::move (next));
+}
+
+void
+pipeline_executor::work () noexcept
+{
+  while (true)
+    {
+      std::unique_ptr<job> current;
+      {
+        std::unique_lock lock{ this->mutex_ };
+        this->ready_.wait (lock, [this] {
+          return this->stopping_ || !this->queue_.empty ();
+        });
+        if (this->queue_.empty ())
+          {
+            return;
+          }
+        current = std::move (this->queue_.front ());
+        this->queue_.pop_front ();
+      }
+
+      std::error_code result{};
+      bool finished = true;
+      try
+        {
+          finished = !current->step ();
+        }
+      catch (...)
+        {
+          result = pipeline_error_code (std::current_exception ());
+        }
+
+      if (!finished)
+        {
+          {
+            const std::lock_guard lock{ this->mutex_ };
+            this->enqueue (std::move (current));
+          }
+          this->ready_.notify_one ();
+          continue;
+        }
+
+      if (current->done)
+        {
+          current->done (result);
+        }
+      // the job's stages close their files before it counts as done
+      current.reset ();
+
+      bool idle = false;
+      {
+        const std::lock_guard lock{ this->mutex_ };
+        idle = --this->unfinished_ == 0;
+      }
+      if (idle)
+        {
+          this->idle_.notify_all ();
+        }
+    }
+}
+
+} // namespace ftv
@@ -0,0 +1,1808 @@
+#include "pipeline/pipeline.hpp"
+#include "crypto/aead_stream.hpp"
+#include "file/async_io.hpp"
+#include "file/file.hpp"
+#include "video/calibration.hpp"
+#include "video/erasure.hpp"
+#include "video/frame_header.hpp"
+#include "video/video.hpp"
+#include "video/video_io.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <zlib.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+[[noreturn]] void
+fail (std::errc error)
+{
+  throw std::system_error (std::make_error_code (error));
+}
+
+void
+check (std::error_code ec)
+{
+  if (ec)
+    {
+      throw std::system_error (ec);
+    }
+}
+
+// seals payload as record index into record, which is resized to fit
+void
+seal_record (std::span<const std::byte> payload, std::uint8_t flags,
+             std::uint64_t index, const secure_key &key, cipher_id cipher,
+             std::vector<std::byte> &record)
+{
+  if (payload.size () > CHUNK_RECORD_MAX)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  chunk_record_header header{};
+  header.size = static_cast<std::uint32_t> (payload.size ());
+  header.flags = flags;
+  record.resize (CHUNK_RECORD_HEADER + payload.size ());
+
+  auto stream = aead_stream::seal (key, header.init_vec, cipher);
+  if (!stream)
+    {
+      throw std::system_error (stream.error ());
+    }
+  const auto aad = chunk_additional_data (index, flags);
+  check (stream->additional_data (aad));
+  check (stream->update (
+      payload, std::span (record).subspan (CHUNK_RECORD_HEADER)));
+  check (stream->finish (header.tag));
+
+  write_chunk_header (header,
+                      std::span (record).first<CHUNK_RECORD_HEADER> ());
+}
+
+// opens the record index with header and ciphertext into plaintext, which
+// is resized to fit. operation_canceled if it does not authenticate
+void
+open_record (const chunk_record_header &header,
+             std::span<const std::byte> ciphertext, std::uint64_t index,
+             const secure_key &key, cipher_id cipher,
+             std::vector<std::byte> &plaintext)
+{
+  plaintext.resize (header.size);
+  auto stream
+      = aead_stream::open (key, header.init_vec, header.tag, cipher);
+  if (!stream)
+    {
+      throw std::system_error (stream.error ());
+    }
+  const auto aad = chunk_additional_data (index, header.flags);
+  if (stream->additional_data (aad) || stream->update (ciphertext, plaintext)
+      || stream->finish ())
+    {
+      fail (std::errc::operation_canceled);
+    }
+}
+
+// fills buffer from offset of file, which has nothing else in flight
+void
+read_exactly (async_file &file, std::span<std::byte> buffer,
+              std::uint64_t offset)
+{
+  check (file.submit_read (buffer, offset, 0));
+  const auto done = file.wait ();
+  if (!done)
+    {
+      throw std::system_error (done.error ());
+    }
+  check (done->error);
+  if (done->bytes != buffer.size ())
+    {
+      fail (std::errc::bad_message);
+    }
+}
+
+// an avi is a riff file: [fourcc 4][size 4] chunks, and lists that are
+// chunks of [LIST][size 4][type 4] followed by more chunks
+inline constexpr std::size_t RIFF_HEADER_SIZE{ 12 };
+
+// the jpeg of a 4096x4096 frame stays far below this, a larger image chunk
+// is damage and is not allocated for
+inline constexpr std::size_t AVI_IMAGE_MAX{ std::size_t{ 64 } << 20 };
+
+[[nodiscard]] bool
+fourcc_is (std::span<const std::byte> bytes, std::size_t at,
+           std::string_view code) noexcept
+{
+  return std::memcmp (bytes.data () + at, code.data (), code.size ()) == 0;
+}
+
+[[nodiscard]] std::uint32_t
+riff_size (std::span<const std::byte> chunk) noexcept
+{
+  std::uint32_t size = 0;
+  std::memcpy (&size, chunk.data () + 4, sizeof (size));
+  return size;
+}
+
+// the compressed image of every frame of the mjpg avi whose bytes read_at
+// hands out. the walk goes front to back, so offsets only grow. read_at
+// returns false where the file ends before the bytes it was asked for
+byte_stream
+walk_avi (std::function<bool (std::uint64_t, std::span<std::byte>)> read_at)
+{
+  const auto need = [&] (std::uint64_t offset, std::span<std::byte> out) {
+    if (!read_at (offset, out))
+      {
+        fail (std::errc::bad_message);
+      }
+  };
+  // a riff written to a pipe has no size and runs to the end of the file
+  const auto end_of = [] (std::uint64_t start,
+                          std::span<const std::byte> riff) {
+    const std::uint32_t size = riff_size (riff);
+    return size == 0 ? std::numeric_limits<std::uint64_t>::max ()
+                     : start + 8 + size;
+  };
+
+  std::array<std::byte, RIFF_HEADER_SIZE> header{};
+  need (0, header);
+  if (!fourcc_is (header, 0, "RIFF") || !fourcc_is (header, 8, "AVI "))
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  std::uint64_t position = header.size ();
+  std::uint64_t riff_end = end_of (0, header);
+  const bool unsized = riff_end == std::numeric_limits<std::uint64_t>::max ();
+  std::vector<std::byte> data;
+  for (;;)
+    {
+      while (position + 8 <= riff_end)
+        {
+          if (!read_at (position, std::span{ header }.first (8)))
+            {
+              if (unsized)
+                {
+                  co_return;
+                }
+              fail (std::errc::bad_message);
+            }
+          const std::uint32_t size = riff_size (header);
+          if (fourcc_is (header, 0, "LIST"))
+            {
+              // frames sit in movi, possibly grouped into rec lists, the
+              // walk steps into those and over every other list
+              need (position + 8, std::span{ header }.subspan (8, 4));
+              if (fourcc_is (header, 8, "movi")
+                  || fourcc_is (header, 8, "rec "))
+                {
+                  position += RIFF_HEADER_SIZE;
+                  continue;
+                }
+            }
+          else if (fourcc_is (header, 2, "dc") || fourcc_is (header, 2, "db"))
+            {
+              // the size is the file's word, it has to fit the riff
+              if (size > AVI_IMAGE_MAX
+                  || position + 8 + std::uint64_t{ size } > riff_end)
+                {
+                  fail (std::errc::bad_message);
+                }
+              data.resize (size);
+              need (position + 8, data);
+              co_yield std::span<const std::byte> (data);
+            }
+          // chunks are padded to an even size
+          position += 8 + std::uint64_t{ size } + (size & 1);
+        }
+
+      // past 1 GiB opendml continues in AVIX lists of their own
+      if (unsized || !read_at (riff_end, header))
+        {
+          break;
+        }
+      if (!fourcc_is (header, 0, "RIFF") || !fourcc_is (header, 8, "AVIX"))
+        {
+          break;
+        }
+      position = riff_end + RIFF_HEADER_SIZE;
+      riff_end = end_of (riff_end, header);
+    }
+}
+
+// the images of the mjpg avi read front to back from fd. a pipe can not
+// seek, the bytes the walk steps over are read and dropped
+byte_stream
+descriptor_images (int fd)
+{
+  std::uint64_t consumed = 0;
+  std::vector<std::byte> dropped;
+  const auto read_fd = [&] (std::span<std::byte> out) {
+    const auto got = read_stream (fd, out);
+    if (!got)
+      {
+        throw std::system_error (got.error ());
+      }
+    consumed += *got;
+    return *got == out.size ();
+  };
+
+  for (const auto image :
+       walk_avi ([&] (std::uint64_t offset, std::span<std::byte> out) {
+         while (consumed < offset)
+           {
+             dropped.resize (static_cast<std::size_t> (
+                 std::min<std::uint64_t> (offset - consumed,
+                                          PIPELINE_CHUNK_SIZE)));
+             if (!read_fd (dropped))
+               {
+                 return false;
+               }
+           }
+         return read_fd (out);
+       }))
+    {
+      co_yield image;
+    }
+}
+
+frame_stream
+decode_images (byte_stream images)
+{
+  cv::Mat frame;
+  for (const auto image : images)
+    {
+      frame = decode_image (image);
+      co_yield frame;
+    }
+}
+
+// appends value to out in the little endian order of riff files
+template <typename T>
+void
+put_riff (std::vector<std::byte> &out, T value)
+{
+  const auto at = out.size ();
+  out.resize (at + sizeof (value));
+  std::memcpy (out.data () + at, &value, sizeof (value));
+}
+
+void
+put_fourcc (std::vector<std::byte> &out, std::string_view code)
+{
+  const auto at = out.size ();
+  out.resize (at + code.size ());
+  std::memcpy (out.data () + at, code.data (), code.size ());
+}
+
+// everything of a mjpg avi before its first frame, with no sizes that
+// depend on the frames: riff and movi list sizes are zero
+std::vector<std::byte>
+avi_stream_header (const metadata &meta)
+{
+  const auto width = static_cast<std::uint32_t> (meta.res ().x);
+  const auto height = static_cast<std::uint32_t> (meta.res ().y);
+  const auto fps = static_cast<std::uint32_t> (meta.fps ());
+  std::vector<std::byte> out;
+
+  put_fourcc (out, "RIFF");
+  put_riff (out, std::uint32_t{ 0 });
+  put_fourcc (out, "AVI ");
+  put_fourcc (out, "LIST");
+  put_riff (out, std::uint32_t{ 192 });
+  put_fourcc (out, "hdrl");
+
+  put_fourcc (out, "avih");
+  put_riff (out, std::uint32_t{ 56 });
+  put_riff (out, std::uint32_t{ 1'000'000 } / std::max (fps, 1U));
+  for (int i = 0; i < 5; ++i)
+    {
+      // data rate, padding, flags (no index), frames, initial frames
+      put_riff (out, std::uint32_t{ 0 });
+    }
+  put_riff (out, std::uint32_t{ 1 }); // streams
+  put_riff (out, std::uint32_t{ 0 }); // suggested buffer size
+  put_riff (out, width);
+  put_riff (out, height);
+  for (int i = 0; i < 4; ++i)
+    {
+      put_riff (out, std::uint32_t{ 0 });
+    }
+
+  put_fourcc (out, "LIST");
+  put_riff (out, std::uint32_t{ 116 });
+  put_fourcc (out, "strl");
+  put_fourcc (out, "strh");
+  put_riff (out, std::uint32_t{ 56 });
+  put_fourcc (out, "vids");
+  put_fourcc (out, "MJPG");
+  put_riff (out, std::uint32_t{ 0 }); // flags
+  put_riff (out, std::uint32_t{ 0 }); // priority and language
+  put_riff (out, std::uint32_t{ 0 }); // initial frames
+  put_riff (out, std::uint32_t{ 1 }); // scale
+  put_riff (out, fps);                // rate
+  for (int i = 0; i < 3; ++i)
+    {
+      // start, length, suggested buffer size
+      put_riff (out, std::uint32_t{ 0 });
+    }
+  put_riff (out, std::numeric_limits<std::uint32_t>::max ()); // quality
+  put_riff (out, std::uint32_t{ 0 });                         // sample size
+  put_riff (out, std::uint16_t{ 0 });
+  put_riff (out, std::uint16_t{ 0 });
+  put_riff (out, static_cast<std::uint16_t> (width));
+  put_riff (out, static_cast<std::uint16_t> (height));
+
+  put_fourcc (out, "strf");
+  put_riff (out, std::uint32_t{ 40 });
+  put_riff (out, std::uint32_t{ 40 });
+  put_riff (out, width);
+  put_riff (out, height);
+  put_riff (out, std::uint16_t{ 1 });  // planes
+  put_riff (out, std::uint16_t{ 24 }); // bits per pixel
+  put_fourcc (out, "MJPG");
+  put_riff (out, width * height * 3);
+  for (int i = 0; i < 4; ++i)
+    {
+      put_riff (out, std::uint32_t{ 0 });
+    }
+
+  put_fourcc (out, "LIST");
+  put_riff (out, std::uint32_t{ 0 });
+  put_fourcc (out, "movi");
+  return out;
+}
+
+// yields prefix and then everything rest yields
+byte_stream
+with_prefix (std::pmr::vector<std::byte> prefix, byte_stream rest)
+{
+  co_yield std::span<const std::byte> (prefix);
+  for (const auto bytes : rest)
+    {
+      co_yield bytes;
+    }
+}
+
+// yields the frames of frames from it on, it being an iterator into them
+frame_stream
+frames_from (frame_stream frames,
+             decltype (std::declval<frame_stream &> ().begin ()) it)
+{
+  for (; it != frames.end (); ++it)
+    {
+      co_yield *it;
+    }
+}
+
+// the payload of the data frames from it on, without the first skip bytes
+// of the stream
+byte_stream
+data_payload (data_frame_stream frames,
+              decltype (std::declval<data_frame_stream &> ().begin ()) it,
+              std::size_t skip)
+{
+  for (; it != frames.end (); ++it)
+    {
+      const std::span<const std::byte> bytes ((*it).payload);
+      const std::size_t skipped = std::min (skip, bytes.size ());
+      skip -= skipped;
+      if (skipped < bytes.size ())
+        {
+          co_yield bytes.subspan (skipped);
+        }
+    }
+}
+
+// fails with bad_message if the stream ends with a part, which continues
+// in a file that is not there
+chunk_stream
+whole_stream (chunk_stream chunks, const stream_cursor &cursor)
+{
+  for (const chunk input : chunks)
+    {
+      co_yield input;
+    }
+  if (!cursor.finished)
+    {
+      fail (std::errc::bad_message);
+    }
+}
+
+// yields frame, which was read from reader already, and the frames after
+// it
+frame_stream
+captured_frames (video_reader &reader, cv::Mat &frame)
+{
+  do
+    {
+      co_yield frame;
+    }
+  while (reader.get ().read (frame) && !frame.empty ());
+}
+
+// the payload of a video written before frames had headers, starting with
+// frame, which was read from reader already. meta's bytes are skipped
+byte_stream
+unframed_bytes (video_reader &reader, cv::Mat &frame, metadata meta)
+{
+  std::vector<std::byte> bytes;
+  std::size_t skip = meta.size () * 8;
+  std::uint8_t value = 0;
+  std::size_t bits = 0;
+
+  do
+    {
+      if (frame.type () != CV_8UC3
+          || static_cast<std::size_t> (frame.rows) <= CALIBRATION_ROWS)
+        {
+          fail (std::errc::bad_message);
+        }
+      const auto threshold = calibrate (frame).threshold;
+
+      bytes.clear ();
+      for (auto row = static_cast<std::int32_t> (CALIBRATION_ROWS);
+           row < frame.rows; ++row)
+        {
+          const auto *pixels = frame.ptr<cv::Vec3b> (row);
+          for (std::int32_t col = 0; col < frame.cols; ++col)
+            {
+              if (skip > 0)
+                {
+                  --skip;
+                  continue;
+                }
+              value = static_cast<std::uint8_t> (
+                  (value << 1) | (is_white (pixels[col], threshold) ? 1 : 0));
+              if (++bits == 8)
+                {
+                  bytes.push_back (std::byte{ value });
+                  value = 0;
+                  bits = 0;
+                }
+            }
+        }
+
+      if (!bytes.empty ())
+        {
+          co_yield std::span<const std::byte> (bytes);
+        }
+    }
+  while (reader.get ().read (frame) && !frame.empty ());
+}
+
+// removes a partially written output unless the write was committed
+class output_guard
+{
+public:
+  explicit output_guard (std::filesystem::path path)
+      : path_{ std::move (path) }
+  {
+  }
+
+  output_guard (const output_guard &) = delete;
+  output_guard &operator= (const output_guard &) = delete;
+
+  ~output_guard ()
+  {
+    if (!this->committed_)
+      {
+        std::error_code ignored;
+        std::filesystem::remove (this->path_, ignored);
+      }
+  }
+
+  void
+  commit () noexcept
+  {
+    this->committed_ = true;
+  }
+
+private:
+  std::filesystem::path path_;
+  bool committed_{ false };
+};
+
+// the checkpoint at path if there is one, a fresh state otherwise. an
+// empty path means the job is not resumable
+[[nodiscard]] checkpoint
+resume_checkpoint (const std::filesystem::path &path, checkpoint_kind kind,
+                   std::uint64_t source_size, const secure_key &key)
+{
+  checkpoint state{ kind, source_size, checkpoint_key_id (key) };
+  if (path.empty ())
+    {
+      return state;
+    }
+
+  const auto saved = load_checkpoint (path);
+  if (!saved)
+    {
+      if (saved.error () != std::errc::no_such_file_or_directory)
+        {
+          throw std::system_error (saved.error ());
+        }
+      return state;
+    }
+  // resuming with another input or key would produce garbage
+  if (saved->kind != kind || saved->source_size != source_size
+      || saved->key_id != state.key_id)
+    {
+      fail (std::errc::invalid_argument);
+    }
+  return *saved;
+}
+
+// adds every content defined chunk of the first length bytes of path to
+// index
+void
+index_file (const std::filesystem::path &path, chunk_source source,
+            std::uint64_t length, chunk_index &index)
+{
+  std::uint64_t offset = 0;
+  for (const chunk input :
+       cdc_chunks (file_chunks (path, PIPELINE_CHUNK_SIZE, 0, length)))
+    {
+      index.insert ({ source, offset,
+                      static_cast<std::uint32_t> (input.bytes.size ()),
+                      chunk_digest_of (input.bytes) });
+      offset += input.bytes.size ();
+    }
+}
+
+// the metadata of every video of a chunk stream. records authenticate
+// themselves and the payload size is not known up front, so the size and
+// checksum fields stay zero
+[[nodiscard]] metadata
+stream_metadata (const metadata &meta)
+{
+  return { meta.filename (),
+           0,
+           {},
+           meta.fps (),
+           meta.res (),
+           payload_format::chunk_stream,
+           meta.cipher () };
+}
+
+byte_stream
+single_record (std::vector<std::byte> record)
+{
+  co_yield std::span<const std::byte> (record);
+}
+
+} // namespace
+
+[[nodiscard]] chunk_stream
+file_chunks (std::filesystem::path path, std::size_t chunk_size,
+             std::uint64_t offset, std::uint64_t length)
+{
+  if (chunk_size == 0)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  const std::uint64_t file_size = std::filesystem::file_size (path);
+  if (offset > file_size)
+    {
+      fail (std::errc::invalid_argument);
+    }
+  const std::uint64_t size = offset + std::min (length, file_size - offset);
+  async_file file{ path, io_mode::read, 2 };
+
+  // one buffer is read into while the other one is downstream
+  const auto buffer_size = static_cast<std::size_t> (
+      std::min<std::uint64_t> (chunk_size, size - offset));
+  std::array<std::vector<std::byte>, 2> buffers{
+    std::vector<std::byte> (buffer_size), std::vector<std::byte> (buffer_size)
+  };
+
+  std::uint64_t next = offset;
+  const auto submit = [&] (std::size_t slot) {
+    const auto count = static_cast<std::size_t> (
+        std::min<std::uint64_t> (buffer_size, size - next));
+    check (file.submit_read (std::span (buffers[slot]).first (count), next,
+                             slot));
+    next += count;
+  };
+
+  if (next < size)
+    {
+      submit (0);
+    }
+  while (file.in_flight () > 0)
+    {
+      const auto done = file.wait ();
+      if (!done)
+        {
+          throw std::system_error (done.error ());
+        }
+      check (done->error);
+
+      const auto slot = static_cast<std::size_t> (done->tag);
+      if (next < size)
+        {
+          submit (1 - slot);
+        }
+      co_yield chunk{ std::span (buffers[slot]).first (done->bytes), false };
+    }
+}
+
+[[nodiscard]] chunk_stream
+descriptor_chunks (int fd, std::size_t chunk_size)
+{
+  if (chunk_size == 0)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  // chunks are filled up however the writer on the other end splits what
+  // it writes
+  std::vector<std::byte> buffer (chunk_size);
+  for (;;)
+    {
+      const auto got = read_stream (fd, buffer);
+      if (!got)
+        {
+          throw std::system_error (got.error ());
+        }
+      if (*got > 0)
+        {
+          co_yield chunk{ std::span (buffer).first (*got), false };
+        }
+      if (*got < buffer.size ())
+        {
+          co_return;
+        }
+    }
+}
+
+[[nodiscard]] chunk_stream
+digest_chunks (chunk_stream chunks, stream_hasher &hasher)
+{
+  for (const chunk input : chunks)
+    {
+      hasher.update (input.bytes);
+      co_yield input;
+    }
+}
+
+[[nodiscard]] chunk_stream
+cdc_chunks (chunk_stream chunks, cdc_params params)
+{
+  if (params.min_size == 0 || params.min_size > params.avg_size
+      || params.avg_size > params.max_size
+      || !std::has_single_bit (params.avg_size)
+      || params.max_size > CHUNK_RECORD_MAX)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  // a chunk is only cut once max_size bytes are pending, so every cut sees
+  // the same bytes no matter how the input was split before
+  std::vector<std::byte> pending;
+  for (const chunk input : chunks)
+    {
+      if (input.compressed || input.reference)
+        {
+          fail (std::errc::invalid_argument);
+        }
+      pending.insert (pending.end (), input.bytes.begin (),
+                      input.bytes.end ());
+
+      std::size_t start = 0;
+      while (pending.size () - start >= params.max_size)
+        {
+          const auto rest
+              = std::span<const std::byte> (pending).subspan (start);
+          const auto length = cdc_cut (rest, params);
+          co_yield chunk{ rest.first (length) };
+          start += length;
+        }
+      pending.erase (pending.begin (),
+                     pending.begin () + static_cast<std::ptrdiff_t> (start));
+    }
+
+  std::size_t start = 0;
+  while (start < pending.size ())
+    {
+      const auto rest = std::span<const std::byte> (pending).subspan (start);
+      const auto length = cdc_cut (rest, params);
+      co_yield chunk{ rest.first (length) };
+      start += length;
+    }
+}
+
+[[nodiscard]] chunk_stream
+dedup_chunks (chunk_stream chunks, chunk_index &index, std::uint64_t offset)
+{
+  std::array<std::byte, CHUNK_REFERENCE_SIZE> record{};
+  for (const chunk input : chunks)
+    {
+      if (input.compressed || input.reference)
+        {
+          fail (std::errc::invalid_argument);
+        }
+
+      // a reference to a tail smaller than itself would not save anything
+      const auto length = input.bytes.size ();
+      if (length <= CHUNK_REFERENCE_SIZE)
+        {
+          offset += length;
+          co_yield input;
+          continue;
+        }
+
+      const auto digest = chunk_digest_of (input.bytes);
+      if (const auto found = index.find (digest))
+        {
+          write_chunk_reference (*found, record);
+          offset += length;
+          co_yield chunk{ record, false, true };
+          continue;
+        }
+
+      index.insert ({ chunk_source::output, offset,
+                      static_cast<std::uint32_t> (length), digest });
+      offset += length;
+      co_yield input;
+    }
+}
+
+[[nodiscard]] chunk_stream
+compress_chunks (chunk_stream chunks)
+{
+  std::vector<std::byte> compressed;
+  for (const chunk input : chunks)
+    {
+      if (input.compressed || input.reference || input.bytes.empty ()
+          || input.bytes.size () > CHUNK_RECORD_MAX)
+        {
+          co_yield input;
+          continue;
+        }
+
+      const auto bound = compressBound (input.bytes.size ());
+      compressed.resize (sizeof (std::uint32_t) + bound);
+      auto *deflated = compressed.data () + sizeof (std::uint32_t);
+      uLongf length = bound;
+      const int result = compress2 (
+          reinterpret_cast<Bytef *> (deflated), &length,
+          reinterpret_cast<const Bytef *> (input.bytes.data ()),
+          input.bytes.size (), Z_BEST_SPEED);
+      if (result != Z_OK)
+        {
+          fail (std::errc::not_enough_memory);
+        }
+
+      // incompressible data, such as media or archives, is kept as is
+      if (sizeof (std::uint32_t) + length >= input.bytes.size ())
+        {
+          co_yield input;
+          continue;
+        }
+
+      const auto original = static_cast<std::uint32_t> (input.bytes.size ());
+      std::memcpy (compressed.data (), &original, sizeof (original));
+      co_yield chunk{
+        std::span (compressed).first (sizeof (std::uint32_t) + length), true
+      };
+    }
+}
+
+[[nodiscard]] byte_stream
+seal_chunks (chunk_stream chunks, secure_key key, cipher_id cipher,
+             stream_cursor *cursor, std::uint8_t final_flags,
+             const stream_hasher *digest)
+{
+  stream_cursor local{};
+  stream_cursor &position = cursor ? *cursor : local;
+
+  std::vector<std::byte> record;
+  // every record is sealed within one resumption, the cipher context of the
+  // thread is never shared between suspended stages
+  for (const chunk input : chunks)
+    {
+      const std::uint8_t flags
+          = (input.compressed ? CHUNK_COMPRESSED : 0)
+            | (input.reference ? CHUNK_REFERENCE : 0);
+      seal_record (input.bytes, flags, position.record_index++, key, cipher,
+                   record);
+      co_yield std::span<const std::byte> (record);
+    }
+  // the hasher is upstream, it has seen everything by now
+  std::array<std::byte, STREAM_DIGEST_SIZE> summary{};
+  std::span<const std::byte> last{};
+  if (digest)
+    {
+      write_stream_digest (digest->digest (), summary);
+      last = summary;
+      final_flags = static_cast<std::uint8_t> (final_flags | CHUNK_DIGEST);
+    }
+  seal_record (last, final_flags, position.record_index++, key, cipher,
+               record);
+  position.finished = (final_flags & CHUNK_LAST) != 0;
+  co_yield std::span<const std::byte> (record);
+}
+
+[[nodiscard]] frame_stream
+render_frames (byte_stream bytes, metadata meta, erasure_params erasure)
+{
+  const auto res = meta.res ();
+  const std::size_t capacity = frame_payload_size (res);
+  if (res.x == 0 || capacity == 0 || !erasure.valid ())
+    {
+      fail (std::errc::invalid_argument);
+    }
+  parity_encoder parity{ erasure, capacity };
+
+  cv::Mat frame (static_cast<std::int32_t> (res.y),
+                 static_cast<std::int32_t> (res.x), CV_8UC3);
+  std::vector<std::byte> payload;
+  payload.reserve (capacity);
+  std::uint32_t sequence = 0;
+  std::uint64_t offset = 0;
+
+  for (auto data : with_prefix (meta.to_vec (), std::move (bytes)))
+    {
+      while (!data.empty ())
+        {
+          const std::size_t take
+              = std::min (capacity - payload.size (), data.size ());
+          payload.insert (payload.end (), data.begin (),
+                          data.begin () + static_cast<std::ptrdiff_t> (take));
+          data = data.subspan (take);
+          if (payload.size () == capacity)
+            {
+              render_frame (frame, sequence, offset, payload);
+              co_yield frame;
+              if (erasure.enabled () && parity.add (sequence, payload))
+                {
+                  for (std::size_t i = 0; i < parity.parity_frames (); ++i)
+                    {
+                      parity.render (frame, i);
+                      co_yield frame;
+                    }
+                }
+              ++sequence;
+              offset += payload.size ();
+              payload.clear ();
+            }
+        }
+    }
+
+  bool due = false;
+  if (!payload.empty ())
+    {
+      render_frame (frame, sequence, offset, payload);
+      co_yield frame;
+      due = erasure.enabled () && parity.add (sequence, payload);
+    }
+  // the last group is short unless it came out even
+  if (erasure.enabled () && (due || parity.finish ()))
+    {
+      for (std::size_t i = 0; i < parity.parity_frames (); ++i)
+        {
+          parity.render (frame, i);
+          co_yield frame;
+        }
+    }
+}
+
+[[nodiscard]] progress_stream
+frame_sink (frame_stream frames, std::filesystem::path path, metadata meta)
+{
+  video_writer writer{ path };
+  writer.initialize (meta.fps (), meta.res ());
+
+  std::size_t written = 0;
+  for (const cv::Mat &frame : frames)
+    {
+      writer.get ().write (frame);
+      co_yield ++written;
+    }
+}
+
+[[nodiscard]] progress_stream
+avi_sink (frame_stream frames, int fd, metadata meta)
+{
+  check (write_stream (fd, avi_stream_header (meta)));
+
+  // the quality the video writer is set to
+  const std::vector<int> quality{ cv::IMWRITE_JPEG_QUALITY, 100 };
+  std::vector<unsigned char> jpeg;
+  std::vector<std::byte> data;
+  std::size_t written = 0;
+  for (const cv::Mat &frame : frames)
+    {
+      if (!cv::imencode (".jpg", frame, jpeg, quality))
+        {
+          fail (std::errc::io_error);
+        }
+      const auto size = static_cast<std::uint32_t> (jpeg.size ());
+      data.clear ();
+      put_fourcc (data, "00dc");
+      put_riff (data, size);
+      data.resize (data.size () + size + (size & 1));
+      std::memcpy (data.data () + 8, jpeg.data (), size);
+      check (write_stream (fd, data));
+      co_yield ++written;
+    }
+}
+
+[[nodiscard]] byte_stream
+video_bytes (std::filesystem::path path, metadata meta)
+{
+  // videos from before the calibration strip only hold serialized
+  // payloads, video::read reads those
+  if (meta.legacy ())
+    {
+      fail (std::errc::invalid_argument);
+    }
+  video_reader reader{ path };
+  cv::Mat frame;
+  if (!reader.get ().read (frame) || frame.empty ())
+    {
+      co_return;
+    }
+
+  auto bytes = has_any_header (frame)
+                   ? frame_payload (captured_frames (reader, frame),
+                                    meta.size ())
+                   : unframed_bytes (reader, frame, meta);
+  for (const auto data : bytes)
+    {
+      co_yield data;
+    }
+}
+
+[[nodiscard]] byte_stream
+avi_images (std::filesystem::path path, const growing_file *growing)
+{
+  // whether the first end bytes of the file are there, waiting for them
+  // while they are on their way
+  const auto available = [&] (std::uint64_t end) {
+    if (growing == nullptr)
+      {
+        return end <= std::filesystem::file_size (path);
+      }
+    const auto ready = growing->wait_for (end);
+    if (!ready)
+      {
+        throw std::system_error (ready.error ());
+      }
+    return *ready;
+  };
+  // the file is created before its first bytes are reported
+  if (!available (RIFF_HEADER_SIZE))
+    {
+      fail (std::errc::bad_message);
+    }
+  async_file file{ path, io_mode::read, 1 };
+
+  for (const auto image :
+       walk_avi ([&] (std::uint64_t offset, std::span<std::byte> out) {
+         if (!available (offset + out.size ()))
+           {
+             return false;
+           }
+         read_exactly (file, out, offset);
+         return true;
+       }))
+    {
+      co_yield image;
+    }
+}
+
+[[nodiscard]] frame_stream
+avi_frames (std::filesystem::path path, const growing_file *growing)
+{
+  return decode_images (avi_images (std::move (path), growing));
+}
+
+[[nodiscard]] frame_stream
+descriptor_frames (int fd)
+{
+  return decode_images (descriptor_images (fd));
+}
+
+[[nodiscard]] cv::Mat
+decode_image (std::span<const std::byte> image)
+{
+  // imdecode only reads the buffer it is given
+  cv::Mat frame = cv::imdecode (
+      cv::Mat (1, static_cast<int> (image.size ()), CV_8UC1,
+               const_cast<std::byte *> (image.data ())),
+      cv::IMREAD_COLOR);
+  if (frame.empty ())
+    {
+      fail (std::errc::bad_message);
+    }
+  return frame;
+}
+
+[[nodiscard]] data_frame_stream
+recovered_frames (frame_stream frames)
+{
+  frame_recovery recovery{};
+  for (const cv::Mat &frame : frames)
+    {
+      check (recovery.add (frame));
+      for (auto next = recovery.next ();; next = recovery.next ())
+        {
+          if (!next)
+            {
+              throw std::system_error (next.error ());
+            }
+          if (*next == nullptr)
+            {
+              break;
+            }
+          co_yield **next;
+        }
+    }
+  check (recovery.finish ());
+}
+
+[[nodiscard]] byte_stream
+frame_payload (frame_stream frames, std::size_t skip)
+{
+  // only the first frame tells an older video from a corrupted one
+  auto first = frames.begin ();
+  if (first != frames.end () && !has_any_header (*first))
+    {
+      fail (std::errc::invalid_argument);
+    }
+  auto data
+      = recovered_frames (frames_from (std::move (frames), std::move (first)));
+  auto next = data.begin ();
+  for (const auto bytes :
+       data_payload (std::move (data), std::move (next), skip))
+    {
+      co_yield bytes;
+    }
+}
+
+[[nodiscard]] chunk_stream
+open_chunks (byte_stream bytes, secure_key key, cipher_id cipher,
+             stream_cursor *cursor)
+{
+  stream_cursor local{};
+  stream_cursor &position = cursor ? *cursor : local;
+
+  std::vector<std::byte> pending;
+  std::vector<std::byte> plaintext;
+
+  for (const auto data : bytes)
+    {
+      pending.insert (pending.end (), data.begin (), data.end ());
+
+      std::size_t start = 0;
+      while (pending.size () - start >= CHUNK_RECORD_HEADER)
+        {
+          const auto header = read_chunk_header (
+              std::span<const std::byte> (pending)
+                  .subspan (start)
+                  .first<CHUNK_RECORD_HEADER> ());
+          if (header.size > CHUNK_RECORD_MAX)
+            {
+              fail (std::errc::bad_message);
+            }
+          if (pending.size () - start < CHUNK_RECORD_HEADER + header.size)
+            {
+              break;
+            }
+
+          if (header.flags & CHUNK_TRAILER)
+            {
+              fail (std::errc::bad_message);
+            }
+
+          open_record (header,
+                       std::span<const std::byte> (pending).subspan (
+                           start + CHUNK_RECORD_HEADER, header.size),
+                       position.record_index, key, cipher, plaintext);
+          start += CHUNK_RECORD_HEADER + header.size;
+          ++position.record_index;
+
+          // a digest describes the stream, it is not part of it
+          if (header.flags & CHUNK_DIGEST)
+            {
+              const auto digest = read_stream_digest (plaintext);
+              if (!(header.flags & CHUNK_LAST) || !digest)
+                {
+                  fail (std::errc::bad_message);
+                }
+              position.digest = *digest;
+              plaintext.clear ();
+            }
+
+          if (!plaintext.empty ())
+            {
+              co_yield chunk{ plaintext,
+                              (header.flags & CHUNK_COMPRESSED) != 0,
+                              (header.flags & CHUNK_REFERENCE) != 0 };
+            }
+          if (header.flags & (CHUNK_LAST | CHUNK_PART_END))
+            {
+              position.finished = (header.flags & CHUNK_LAST) != 0;
+              co_return;
+            }
+        }
+      pending.erase (pending.begin (),
+                     pending.begin () + static_cast<std::ptrdiff_t> (start));
+    }
+
+  // the stream or part ended before its last record
+  fail (std::errc::bad_message);
+}
+
+[[nodiscard]] chunk_stream
+decompress_chunks (chunk_stream chunks)
+{
+  std::vector<std::byte> plain;
+  for (const chunk input : chunks)
+    {
+      if (!input.compressed)
+        {
+          co_yield input;
+          continue;
+        }
+
+      std::uint32_t original = 0;
+      if (input.bytes.size () < sizeof (original))
+        {
+          fail (std::errc::bad_message);
+        }
+      std::memcpy (&original, input.bytes.data (), sizeof (original));
+      if (original > CHUNK_RECORD_MAX)
+        {
+          fail (std::errc::bad_message);
+        }
+
+      plain.resize (original);
+      uLongf length = original;
+      const auto deflated = input.bytes.subspan (sizeof (original));
+      const int result = uncompress (
+          reinterpret_cast<Bytef *> (plain.data ()), &length,
+          reinterpret_cast<const Bytef *> (deflated.data ()),
+          deflated.size ());
+      if (result != Z_OK || length != original)
+        {
+          fail (std::errc::bad_message);
+        }
+      co_yield chunk{ plain, false };
+    }
+}
+
+[[nodiscard]] chunk_stream
+verified_chunks (chunk_stream chunks, const stream_cursor &cursor)
+{
+  stream_hasher hasher{};
+  bool referenced = false;
+  for (const chunk input : chunks)
+    {
+      // the sink resolves references, their bytes are not here
+      referenced = referenced || input.reference;
+      if (!input.reference)
+        {
+          hasher.update (input.bytes);
+        }
+      co_yield input;
+    }
+
+  // streams with a digest are never deduplicated
+  if (cursor.digest && (referenced || hasher.digest () != *cursor.digest))
+    {
+      fail (std::errc::bad_message);
+    }
+}
+
+[[nodiscard]] progress_stream
+descriptor_sink (chunk_stream chunks, int fd)
+{
+  std::size_t written = 0;
+  for (const chunk input : chunks)
+    {
+      if (input.reference)
+        {
+          fail (std::errc::operation_not_supported);
+        }
+      check (write_stream (fd, input.bytes));
+      written += input.bytes.size ();
+      co_yield written;
+    }
+}
+
+[[nodiscard]] progress_stream
+file_sink (chunk_stream chunks, std::filesystem::path path,
+           std::optional<std::uint64_t> resume_at, std::filesystem::path base)
+{
+  if (!resume_at && std::filesystem::exists (path))
+    {
+      fail (std::errc::file_exists);
+    }
+
+  // declared before the file, so in flight writes drain before the removal
+  output_guard guard{ path };
+  async_file file{ path, resume_at ? io_mode::update : io_mode::write, 2 };
+  if (resume_at)
+    {
+      // what a resumed job wrote is kept whatever happens now
+      guard.commit ();
+      check (file.resize (*resume_at));
+    }
+
+  // a chunk is copied out, so the write can be in flight while the next
+  // chunk is produced upstream
+  std::array<std::vector<std::byte>, 2> buffers{};
+  std::array<bool, 2> busy{};
+  const auto reap = [&] {
+    const auto done = file.wait ();
+    if (!done)
+      {
+        throw std::system_error (done.error ());
+      }
+    check (done->error);
+    busy[static_cast<std::size_t> (done->tag)] = false;
+  };
+
+  std::uint64_t offset = resume_at.value_or (0);
+
+  // referenced chunks are read back from what was written so far or from
+  // the base, both opened once the first reference needs them
+  std::optional<async_file> written{};
+  std::optional<async_file> base_file{};
+  std::vector<std::byte> copied;
+  const auto resolve = [&] (std::span<const std::byte> bytes) {
+    const auto reference = read_chunk_reference (bytes);
+    if (!reference)
+      {
+        throw std::system_error (reference.error ());
+      }
+
+    async_file *source = nullptr;
+    if (reference->source == chunk_source::output)
+      {
+        if (reference->offset > offset
+            || reference->length > offset - reference->offset)
+          {
+            fail (std::errc::bad_message);
+          }
+        // the copy may overlap writes that are still in flight
+        while (file.in_flight () > 0)
+          {
+            reap ();
+          }
+        if (!written)
+          {
+            written.emplace (path, io_mode::read, 1);
+          }
+        source = &*written;
+      }
+    else
+      {
+        if (base.empty ())
+          {
+            fail (std::errc::invalid_argument);
+          }
+        if (!base_file)
+          {
+            base_file.emplace (base, io_mode::read, 1);
+          }
+        source = &*base_file;
+      }
+
+    copied.resize (reference->length);
+    read_exactly (*source, copied, reference->offset);
+    // a wrong base or a damaged output shows up here
+    if (chunk_digest_of (copied) != reference->digest)
+      {
+        fail (std::errc::bad_message);
+      }
+    return std::span<const std::byte> (copied);
+  };
+
+  std::size_t slot = 0;
+  for (const chunk input : chunks)
+    {
+      if (input.compressed)
+        {
+          fail (std::errc::invalid_argument);
+        }
+      const auto bytes = input.reference ? resolve (input.bytes) : input.bytes;
+      while (busy[slot])
+        {
+          reap ();
+        }
+
+      buffers[slot].assign (bytes.begin (), bytes.end ());
+      check (file.submit_write (buffers[slot], offset, slot));
+      busy[slot] = true;
+      offset += bytes.size ();
+      slot = 1 - slot;
+      co_yield offset;
+    }
+
+  while (file.in_flight () > 0)
+    {
+      reap ();
+    }
+  check (file.sync ());
+  guard.commit ();
+}
+
+[[nodiscard]] progress_stream
+file_range_sink (chunk_stream chunks, std::filesystem::path path,
+                 std::uint64_t offset, std::uint64_t length)
+{
+  async_file file{ path, io_mode::update, 2 };
+
+  std::array<std::vector<std::byte>, 2> buffers{};
+  std::array<bool, 2> busy{};
+  const auto reap = [&] {
+    const auto done = file.wait ();
+    if (!done)
+      {
+        throw std::system_error (done.error ());
+      }
+    check (done->error);
+    busy[static_cast<std::size_t> (done->tag)] = false;
+  };
+
+  std::uint64_t written = 0;
+  std::size_t slot = 0;
+  for (const chunk input : chunks)
+    {
+      // the sinks of the other ranges own everything past length
+      if (input.compressed || input.reference
+          || input.bytes.size () > length - written)
+        {
+          fail (std::errc::bad_message);
+        }
+      while (busy[slot])
+        {
+          reap ();
+        }
+
+      buffers[slot].assign (input.bytes.begin (), input.bytes.end ());
+      check (file.submit_write (buffers[slot], offset + written, slot));
+      busy[slot] = true;
+      written += input.bytes.size ();
+      slot = 1 - slot;
+      co_yield written;
+    }
+
+  while (file.in_flight () > 0)
+    {
+      reap ();
+    }
+  if (written != length)
+    {
+      fail (std::errc::bad_message);
+    }
+}
+
+[[nodiscard]] progress_stream
+encode_job (std::filesystem::path input, std::filesystem::path output,
+            secure_key key, metadata meta, encode_options options)
+{
+  const auto stream_meta = stream_metadata (meta);
+  const auto &checkpoint_path = options.checkpoint_path;
+  const bool resumable = !checkpoint_path.empty ();
+  if (resumable && options.interval == 0)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  const std::uint64_t size = std::filesystem::file_size (input);
+  auto state = resume_checkpoint (checkpoint_path, checkpoint_kind::encode,
+                                  size, key);
+
+  // the output of earlier parts is the input up to where they ended, so
+  // a resumed job can still reference it
+  const bool dedup = options.dedup || !options.base.empty ();
+  chunk_index index{};
+  if (dedup && !options.base.empty ())
+    {
+      index_file (options.base, chunk_source::base,
+                  std::numeric_limits<std::uint64_t>::max (), index);
+    }
+  if (dedup && state.input_offset > 0)
+    {
+      index_file (input, chunk_source::output, state.input_offset, index);
+    }
+
+  // a part that was being written when the job died is incomplete. a video
+  // written over an appendable one is not appendable
+  std::filesystem::remove (index_path (output));
+  for (auto part = state.parts;
+       std::filesystem::remove (part_path (output, part)); ++part)
+    {
+    }
+
+  std::size_t frames = 0;
+  do
+    {
+      const std::uint64_t length
+          = resumable ? std::min (options.interval, size - state.input_offset)
+                      : size - state.input_offset;
+      const bool last = state.input_offset + length == size;
+      const auto path = part_path (output, state.parts);
+
+      auto chunks = file_chunks (input, PIPELINE_CHUNK_SIZE,
+                                 state.input_offset, length);
+      if (dedup)
+        {
+          chunks = dedup_chunks (cdc_chunks (std::move (chunks)), index,
+                                 state.input_offset);
+        }
+
+      stream_cursor cursor{ state.record_index };
+      auto records = seal_chunks (compress_chunks (std::move (chunks)), key,
+                                  meta.cipher (), &cursor,
+                                  last ? CHUNK_LAST : CHUNK_PART_END);
+
+      std::size_t part_frames = 0;
+      for (const auto written :
+           frame_sink (render_frames (std::move (records), stream_meta,
+                                      options.erasure),
+                       path, stream_meta))
+        {
+          part_frames = written;
+          co_yield frames + written;
+        }
+      frames += part_frames;
+
+      state.parts += 1;
+      state.record_index = cursor.record_index;
+      state.input_offset += length;
+      if (resumable)
+        {
+          check (sync_file (path));
+          if (last)
+            {
+              std::filesystem::remove (checkpoint_path);
+            }
+          else
+            {
+              check (save_checkpoint (state, checkpoint_path));
+            }
+        }
+    }
+  while (state.input_offset < size);
+}
+
+[[nodiscard]] frame_stream
+stream_frames (chunk_stream plaintext, secure_key key, metadata meta,
+               erasure_params erasure)
+{
+  stream_hasher hasher{};
+  for (const cv::Mat &frame :
+       render_frames (seal_chunks (compress_chunks (digest_chunks (
+                                       std::move (plaintext), hasher)),
+                                   key, meta.cipher (), nullptr, CHUNK_LAST,
+                                   &hasher),
+                      stream_metadata (meta), erasure))
+    {
+      co_yield frame;
+    }
+}
+
+[[nodiscard]] segment_index
+read_trailer (const std::filesystem::path &path, const secure_key &key)
+{
+  const video source{ path };
+  const auto meta = source.get_metadata ();
+  if (meta.format () != payload_format::chunk_stream)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  std::vector<std::byte> pending;
+  for (const auto data : video_bytes (path, meta))
+    {
+      pending.insert (pending.end (), data.begin (), data.end ());
+      if (pending.size () < CHUNK_RECORD_HEADER)
+        {
+          continue;
+        }
+
+      const auto header = read_chunk_header (
+          std::span<const std::byte> (pending).first<CHUNK_RECORD_HEADER> ());
+      if (header.flags != (CHUNK_LAST | CHUNK_TRAILER)
+          || header.size > CHUNK_RECORD_MAX)
+        {
+          fail (std::errc::bad_message);
+        }
+      if (pending.size () < CHUNK_RECORD_HEADER + header.size)
+        {
+          continue;
+        }
+
+      std::vector<std::byte> plaintext;
+      open_record (header,
+                   std::span<const std::byte> (pending).subspan (
+                       CHUNK_RECORD_HEADER, header.size),
+                   TRAILER_RECORD_INDEX, key, meta.cipher (), plaintext);
+      auto index = read_segment_index (plaintext);
+      if (!index)
+        {
+          throw std::system_error (index.error ());
+        }
+      if (index->empty ())
+        {
+          fail (std::errc::bad_message);
+        }
+      return std::move (*index);
+    }
+  fail (std::errc::bad_message);
+}
+
+void
+write_trailer (const segment_index &index, const std::filesystem::path &path,
+               const secure_key &key, const metadata &meta,
+               const erasure_params &erasure)
+{
+  std::vector<std::byte> record;
+  seal_record (write_segment_index (index), CHUNK_LAST | CHUNK_TRAILER,
+               TRAILER_RECORD_INDEX, key, meta.cipher (), record);
+
+  // the writer picks the container from the extension, keep it
+  auto temp_path = path;
+  temp_path.replace_filename (path.stem ().string () + ".new"
+                              + path.extension ().string ());
+  output_guard guard{ temp_path };
+  for ([[maybe_unused]] const auto frame :
+       frame_sink (render_frames (single_record (std::move (record)), meta,
+                                  erasure),
+                   temp_path, meta))
+    {
+    }
+  check (sync_file (temp_path));
+  std::filesystem::rename (temp_path, path);
+  guard.commit ();
+}
+
+[[nodiscard]] progress_stream
+append_job (std::filesystem::path input, std::filesystem::path output,
+            secure_key key, metadata meta, erasure_params erasure)
+{
+  const auto stream_meta = stream_metadata (meta);
+  const auto trailer = index_path (output);
+
+  segment_index index{};
+  if (std::filesystem::exists (trailer))
+    {
+      index = read_trailer (trailer, key);
+    }
+  else if (std::filesystem::exists (output))
+    {
+      // a video without a trailer ends with CHUNK_LAST and stays closed
+      fail (std::errc::invalid_argument);
+    }
+
+  const segment_entry previous = index.empty () ? segment_entry{}
+                                                : index.back ();
+  const std::uint64_t size = std::filesystem::file_size (input);
+  if (size < previous.byte_end)
+    {
+      // not the file the video was appended from, or it was truncated
+      fail (std::errc::invalid_argument);
+    }
+  if (size == previous.byte_end && !index.empty ())
+    {
+      co_return;
+    }
+
+  // a segment the last append did not get to index is incomplete
+  const auto segment = part_path (output, index.size ());
+  std::filesystem::remove (segment);
+
+  stream_cursor cursor{ previous.record_end };
+  auto records = seal_chunks (
+      compress_chunks (file_chunks (input, PIPELINE_CHUNK_SIZE,
+                                    previous.byte_end,
+                                    size - previous.byte_end)),
+      key, stream_meta.cipher (), &cursor, CHUNK_PART_END);
+  for (const auto written :
+       frame_sink (render_frames (std::move (records), stream_meta, erasure),
+                   segment, stream_meta))
+    {
+      co_yield written;
+    }
+
+  // the segment is on disk before the trailer that makes it part of the
+  // video
+  check (sync_file (segment));
+  index.push_back ({ cursor.record_index, size });
+  write_trailer (index, trailer, key, stream_meta, erasure);
+}
+
+[[nodiscard]] progress_stream
+decode_job (std::filesystem::path input, std::filesystem::path output,
+            secure_key key, decode_options options)
+{
+  const auto &checkpoint_path = options.checkpoint_path;
+  const bool resumable = !checkpoint_path.empty ();
+  // an output next to its checkpoint is a previous run of this job
+  const bool resumed
+      = resumable && std::filesystem::exists (checkpoint_path);
+  if (!resumed && std::filesystem::exists (output))
+    {
+      fail (std::errc::file_exists);
+    }
+
+  const std::uint64_t size = std::filesystem::file_size (input);
+  auto state = resume_checkpoint (checkpoint_path, checkpoint_kind::decode,
+                                  size, key);
+
+  // without a checkpoint to come back to, partial output is worthless. a
+  // resumable job claims the output before it creates it
+  output_guard guard{ output };
+  if (resumable)
+    {
+      guard.commit ();
+      check (save_checkpoint (state, checkpoint_path));
+    }
+
+  // an appendable video ends where its trailer says, not with CHUNK_LAST
+  std::optional<segment_index> segments{};
+  if (std::filesystem::exists (index_path (input)))
+    {
+      segments = read_trailer (index_path (input), key);
+    }
+  const auto done = [&] (const stream_cursor &position) {
+    return segments ? state.parts == segments->size () : position.finished;
+  };
+
+  stream_cursor cursor{ state.record_index };
+  while (!done (cursor))
+    {
+      const auto path = part_path (input, state.parts);
+      const video source{ path };
+      const auto meta = source.get_metadata ();
+      if (meta.format () != payload_format::chunk_stream)
+        {
+          fail (std::errc::invalid_argument);
+        }
+
+      auto chunks = verified_chunks (
+          decompress_chunks (
+              open_chunks (video_bytes (path, meta), key, meta.cipher (),
+                           &cursor)),
+          cursor);
+      // later parts continue the output the earlier ones started
+      std::optional<std::uint64_t> resume_at{};
+      if (resumable || state.parts > 0)
+        {
+          resume_at = state.output_offset;
+        }
+      for (const auto written :
+           file_sink (std::move (chunks), output, resume_at, options.base))
+        {
+          state.output_offset = written;
+          co_yield written;
+        }
+
+      if (segments)
+        {
+          const auto &entry = (*segments)[state.parts];
+          if (cursor.finished || cursor.record_index != entry.record_end
+              || state.output_offset != entry.byte_end)
+            {
+              fail (std::errc::bad_message);
+            }
+        }
+
+      state.parts += 1;
+      state.record_index = cursor.record_index;
+      if (resumable && !done (cursor))
+        {
+          check (save_checkpoint (state, checkpoint_path));
+        }
+    }
+
+  if (resumable)
+    {
+      std::filesystem::remove (checkpoint_path);
+    }
+  guard.commit ();
+}
+
+[[nodiscard]] progress_stream
+stream_decode_job (frame_stream frames, secure_key key, chunk_sink sink)
+{
+  // the first frame chooses the sink, and is decoded with the others
+  auto first = frames.begin ();
+  if (first == frames.end ())
+    {
+      fail (std::errc::bad_message);
+    }
+  if (!has_any_header (*first))
+    {
+      fail (std::errc::invalid_argument);
+    }
+  // the metadata is in the first data frame, which may have to be rebuilt
+  // from the frames after it
+  auto data
+      = recovered_frames (frames_from (std::move (frames), std::move (first)));
+  auto next = data.begin ();
+  if (next == data.end ())
+    {
+      fail (std::errc::bad_message);
+    }
+  const auto meta = video::parse_metadata ((*next).payload);
+  if (meta.format () != payload_format::chunk_stream)
+    {
+      fail (std::errc::invalid_argument);
+    }
+
+  stream_cursor cursor{};
+  auto chunks = whole_stream (
+      verified_chunks (
+          decompress_chunks (open_chunks (
+              data_payload (std::move (data), std::move (next),
+                            meta.size ()),
+              key, meta.cipher (), &cursor)),
+          cursor),
+      cursor);
+  for (const auto written : sink (std::move (chunks), meta))
+    {
+      co_yield written;
+    }
+}
+
+[[nodiscard]] std::error_code
+run_job (progress_stream job) noexcept
+{
+  try
+    {
+      for ([[maybe_unused]] const auto step : job)
+        {
+        }
+      return {};
+    }
+  catch (...)
+    {
+      return pipeline_error_code (std::current_exception ());
+    }
+}
+
+[[nodiscard]] std::error_code
+pipeline_error_code (std::exception_ptr error) noexcept
+{
+  try
+    {
+      std::rethrow_exception (std::move (error));
+    }
+  catch (const std::system_error &e)
+    {
+      return e.code ();
+    }
+  catch (const std::bad_alloc &)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
+  catch (...)
+    {
+      // video_io and video report failures as runtime_error
+      return std::make_error_code (std::errc::io_error);
+    }
+}
+
+} // namespace ftv
@@ -0,0 +1,77 @@
+#include "pipeline/segment_index.hpp"
+
+#include <cstring>
+#include <string>
+
+namespace ftv
+{
+
+[[nodiscard]] std::vector<std::byte>
+write_segment_index (const segment_index &index)
+{
+  const std::uint64_t count = index.size ();
+  std::vector<std::byte> out (sizeof (count)
+                              + index.size () * sizeof (segment_entry));
+  std::memcpy (out.data (), &count, sizeof (count));
+  std::size_t pos = sizeof (count);
+  for (const auto &entry : index)
+    {
+      std::memcpy (out.data () + pos, &entry.record_end,
+                   sizeof (entry.record_end));
+      pos += sizeof (entry.record_end);
+      std::memcpy (out.data () + pos, &entry.byte_end,
+                   sizeof (entry.byte_end));
+      pos += sizeof (entry.byte_end);
+    }
+  return out;
+}
+
+[[nodiscard]] std::expected<segment_index, std::error_code>
+read_segment_index (std::span<const std::byte> in)
+{
+  const auto malformed = std::unexpected (
+      std::make_error_code (std::errc::bad_message));
+
+  std::uint64_t count = 0;
+  if (in.size () < sizeof (count))
+    {
+      return malformed;
+    }
+  std::memcpy (&count, in.data (), sizeof (count));
+  if (count != (in.size () - sizeof (count)) / sizeof (segment_entry)
+      || (in.size () - sizeof (count)) % sizeof (segment_entry) != 0)
+    {
+      return malformed;
+    }
+
+  segment_index index (count);
+  std::size_t pos = sizeof (count);
+  segment_entry previous{};
+  for (auto &entry : index)
+    {
+      std::memcpy (&entry.record_end, in.data () + pos,
+                   sizeof (entry.record_end));
+      pos += sizeof (entry.record_end);
+      std::memcpy (&entry.byte_end, in.data () + pos,
+                   sizeof (entry.byte_end));
+      pos += sizeof (entry.byte_end);
+
+      // every segment has at least its closing record
+      if (entry.record_end <= previous.record_end
+          || entry.byte_end < previous.byte_end)
+        {
+          return malformed;
+        }
+      previous = entry;
+    }
+  return index;
+}
+
+[[nodiscard]] std::filesystem::path
+index_path (const std::filesystem::path &video)
+{
+  return video.parent_path ()
+         / (video.stem ().string () + ".index" + video.extension ().string ());
+}
+
+} // namespace ftv
@@ -0,0 +1,304 @@
+#include "pipeline/segmented.hpp"
+#include "file/async_io.hpp"
+#include "file/file.hpp"
+#include "pipeline/executor.hpp"
+#include "pipeline/pipeline.hpp"
+#include "video/video.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace ftv
+{
+
+namespace
+{
+
+// keeps the first error any of the jobs reports
+class first_error
+{
+public:
+  [[nodiscard]] pipeline_executor::completion
+  recorder ()
+  {
+    return [this] (std::error_code ec) {
+      const std::lock_guard lock{ this->mutex_ };
+      if (ec && !this->error_)
+        {
+          this->error_ = ec;
+        }
+    };
+  }
+
+  [[nodiscard]] std::error_code
+  get ()
+  {
+    const std::lock_guard lock{ this->mutex_ };
+    return this->error_;
+  }
+
+private:
+  std::mutex mutex_{};
+  std::error_code error_{};
+};
+
+[[nodiscard]] progress_stream
+encode_segment (std::filesystem::path input, std::filesystem::path path,
+                secure_key key, metadata meta, erasure_params erasure,
+                segment_entry begin, segment_entry end)
+{
+  stream_cursor cursor{ begin.record_end };
+  auto records = seal_chunks (
+      compress_chunks (file_chunks (input, PIPELINE_CHUNK_SIZE,
+                                    begin.byte_end,
+                                    end.byte_end - begin.byte_end)),
+      key, meta.cipher (), &cursor, CHUNK_PART_END);
+  for (const auto written :
+       frame_sink (render_frames (std::move (records), meta, erasure), path,
+                   meta))
+    {
+      co_yield written;
+    }
+
+  // the input changed under the job, the planned numbering is off
+  if (cursor.record_index != end.record_end)
+    {
+      throw std::system_error (std::make_error_code (std::errc::io_error));
+    }
+}
+
+// decodes the segment at path, which holds the records and bytes from
+// begin to end, into output starting at offset
+[[nodiscard]] progress_stream
+segment_job (std::filesystem::path path, std::filesystem::path output,
+             secure_key key, segment_entry begin, segment_entry end,
+             std::uint64_t offset)
+{
+  const video source{ path };
+  const auto meta = source.get_metadata ();
+  if (meta.format () != payload_format::chunk_stream)
+    {
+      throw std::system_error (
+          std::make_error_code (std::errc::invalid_argument));
+    }
+
+  stream_cursor cursor{ begin.record_end };
+  for (const auto written :
+       file_range_sink (decompress_chunks (open_chunks (
+                            video_bytes (path, meta), key, meta.cipher (),
+                            &cursor)),
+                        output, offset, end.byte_end - begin.byte_end))
+    {
+      co_yield written;
+    }
+
+  if (cursor.finished || cursor.record_index != end.record_end)
+    {
+      throw std::system_error (std::make_error_code (std::errc::bad_message));
+    }
+}
+
+} // namespace
+
+[[nodiscard]] std::error_code
+encode_segmented (const std::filesystem::path &input,
+                  const std::filesystem::path &output, const secure_key &key,
+                  const metadata &meta, std::size_t segments,
+                  const erasure_params &erasure, std::size_t threads) noexcept
+{
+  std::size_t submitted = 0;
+  try
+    {
+      const metadata stream_meta{ meta.filename (),
+                                  0,
+                                  {},
+                                  meta.fps (),
+                                  meta.res (),
+                                  payload_format::chunk_stream,
+                                  meta.cipher () };
+
+      // whole chunks per segment, and no empty segments past the first
+      const std::uint64_t size = std::filesystem::file_size (input);
+      const std::uint64_t chunks
+          = (size + PIPELINE_CHUNK_SIZE - 1) / PIPELINE_CHUNK_SIZE;
+      const std::uint64_t count = std::clamp<std::uint64_t> (
+          segments, 1, std::max<std::uint64_t> (chunks, 1));
+      const std::uint64_t per_segment
+          = (chunks + count - 1) / count * PIPELINE_CHUNK_SIZE;
+
+      segment_index plan{};
+      segment_entry end{};
+      do
+        {
+          const std::uint64_t length
+              = std::min (per_segment, size - end.byte_end);
+          // one record per chunk and the closing one
+          end.record_end
+              += (length + PIPELINE_CHUNK_SIZE - 1) / PIPELINE_CHUNK_SIZE + 1;
+          end.byte_end += length;
+          plan.push_back (end);
+        }
+      while (end.byte_end < size);
+
+      // the old manifest and segments of an earlier, longer encode go first
+      std::filesystem::remove (index_path (output));
+      for (auto part = plan.size ();
+           std::filesystem::remove (part_path (output, part)); ++part)
+        {
+        }
+
+      first_error error{};
+      {
+        pipeline_executor executor{ std::min (threads, plan.size ()) };
+        segment_entry begin{};
+        for (const auto &entry : plan)
+          {
+            executor.submit (encode_segment (input,
+                                             part_path (output, submitted++),
+                                             key, stream_meta, erasure,
+                                             begin, entry),
+                             error.recorder ());
+            begin = entry;
+          }
+      }
+      if (const auto ec = error.get ())
+        {
+          throw std::system_error (ec);
+        }
+
+      // every segment is on disk before the manifest that lists it
+      for (std::size_t part = 0; part < plan.size (); ++part)
+        {
+          if (const auto ec = sync_file (part_path (output, part)))
+            {
+              throw std::system_error (ec);
+            }
+        }
+      write_trailer (plan, index_path (output), key, stream_meta, erasure);
+      return {};
+    }
+  catch (...)
+    {
+      const auto ec = pipeline_error_code (std::current_exception ());
+      for (std::size_t part = 0; part < submitted; ++part)
+        {
+          std::error_code ignored;
+          std::filesystem::remove (part_path (output, part), ignored);
+        }
+      return ec;
+    }
+}
+
+[[nodiscard]] std::error_code
+decode_segmented (const std::filesystem::path &input,
+                  const std::filesystem::path &output, const secure_key &key,
+                  std::size_t threads) noexcept
+{
+  bool created = false;
+  try
+    {
+      const auto plan = read_trailer (index_path (input), key);
+      if (std::filesystem::exists (output))
+        {
+          return std::make_error_code (std::errc::file_exists);
+        }
+
+      // every segment writes its own range of the full size output
+      {
+        async_file file{ output, io_mode::write, 1 };
+        created = true;
+        if (const auto ec = file.resize (plan.back ().byte_end))
+          {
+            throw std::system_error (ec);
+          }
+      }
+
+      first_error error{};
+      {
+        pipeline_executor executor{ std::min (threads, plan.size ()) };
+        segment_entry begin{};
+        for (std::size_t part = 0; part < plan.size (); ++part)
+          {
+            executor.submit (segment_job (part_path (input, part), output,
+                                          key, begin, plan[part],
+                                          begin.byte_end),
+                             error.recorder ());
+            begin = plan[part];
+          }
+      }
+      if (const auto ec = error.get ())
+        {
+          throw std::system_error (ec);
+        }
+      if (const auto ec = sync_file (output))
+        {
+          throw std::system_error (ec);
+        }
+      return {};
+    }
+  catch (...)
+    {
+      if (created)
+        {
+          std::error_code ignored;
+          std::filesystem::remove (output, ignored);
+        }
+      return pipeline_error_code (std::current_exception ());
+    }
+}
+
+std::expected<std::uint64_t, std::error_code>
+decode_segment (const std::filesystem::path &input, std::size_t part,
+                const std::filesystem::path &output,
+                const secure_key &key) noexcept
+{
+  bool created = false;
+  try
+    {
+      const auto plan = read_trailer (index_path (input), key);
+      if (part >= plan.size ())
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::invalid_argument));
+        }
+      if (std::filesystem::exists (output))
+        {
+          return std::unexpected (
+              std::make_error_code (std::errc::file_exists));
+        }
+
+      const segment_entry begin = part == 0 ? segment_entry{}
+                                            : plan[part - 1];
+      const segment_entry end = plan[part];
+      {
+        async_file file{ output, io_mode::write, 1 };
+        created = true;
+        if (const auto ec = file.resize (end.byte_end - begin.byte_end))
+          {
+            throw std::system_error (ec);
+          }
+      }
+
+      for ([[maybe_unused]] const auto written :
+           segment_job (part_path (input, part), output, key, begin, end, 0))
+        {
+        }
+      if (const auto ec = sync_file (output))
+        {
+          throw std::system_error (ec);
+        }
+      return begin.byte_end;
+    }
+  catch (...)
+    {
+      if (created)
+        {
+          std::error_code ignored;
+          std::filesystem::remove (output, ignored);
+        }
+      return std::unexpected (pipeline_error_code (std::current_exception ()));
+    }
+}
+
+} // namespace ftv
@@ -0,0 +1,75 @@
+#include "pipeline/stream_digest.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace ftv
+{
+
+void
+write_stream_digest (const stream_digest &digest,
+                     std::span<std::byte, STREAM_DIGEST_SIZE> out) noexcept
+{
+  std::memcpy (out.data (), &digest.size, sizeof (digest.size));
+  std::memcpy (out.data () + sizeof (digest.size), digest.sha256.data (),
+               digest.sha256.size ());
+}
+
+[[nodiscard]] std::expected<stream_digest, std::error_code>
+read_stream_digest (std::span<const std::byte> in) noexcept
+{
+  if (in.size () != STREAM_DIGEST_SIZE)
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+
+  stream_digest digest{};
+  std::memcpy (&digest.size, in.data (), sizeof (digest.size));
+  std::memcpy (digest.sha256.data (), in.data () + sizeof (digest.size),
+               digest.sha256.size ());
+  return digest;
+}
+
+stream_hasher::stream_hasher () : ctx_{ EVP_MD_CTX_new () }
+{
+  if (!this->ctx_
+      || EVP_DigestInit_ex (this->ctx_, EVP_sha256 (), nullptr) != 1)
+    {
+      EVP_MD_CTX_free (this->ctx_);
+      throw std::runtime_error ("Failed to create digest context");
+    }
+}
+
+stream_hasher::~stream_hasher ()
+{
+  EVP_MD_CTX_free (this->ctx_);
+}
+
+void
+stream_hasher::update (std::span<const std::byte> data) noexcept
+{
+  EVP_DigestUpdate (this->ctx_, data.data (), data.size ());
+  this->size_ += data.size ();
+}
+
+[[nodiscard]] stream_digest
+stream_hasher::digest () const
+{
+  // finishing a copy leaves this one open for more
+  EVP_MD_CTX *copy = EVP_MD_CTX_new ();
+  if (!copy || EVP_MD_CTX_copy_ex (copy, this->ctx_) != 1)
+    {
+      EVP_MD_CTX_free (copy);
+      throw std::runtime_error ("Failed to copy digest context");
+    }
+
+  stream_digest digest{ this->size_, {} };
+  unsigned int size = 0;
+  EVP_DigestFinal_ex (copy, reinterpret_cast<unsigned char *> (
+                                digest.sha256.data ()),
+                      &size);
+  EVP_MD_CTX_free (copy);
+  return digest;
+}
+
+} // namespace ftv
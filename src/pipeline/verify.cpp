@@ -0,0 +1,579 @@
+#include "pipeline/verify.hpp"
+#include "crypto/checksum.hpp"
+#include "pipeline/checkpoint.hpp"
+#include "pipeline/chunk_record.hpp"
+#include "pipeline/dedup.hpp"
+#include "pipeline/pipeline.hpp"
+#include "pipeline/segment_index.hpp"
+#include "pipeline/stream_digest.hpp"
+#include "video/erasure.hpp"
+#include "video/frame_header.hpp"
+#include "video/video.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace ftv
+{
+
+namespace
+{
+
+[[noreturn]] void
+fail (std::errc error)
+{
+  throw std::system_error (std::make_error_code (error));
+}
+
+void
+check (std::error_code ec)
+{
+  if (ec)
+    {
+      throw std::system_error (ec);
+    }
+}
+
+// how the payload of one file ended
+enum class stream_end
+{
+  last,    // CHUNK_LAST, or a serialized payload
+  part,    // CHUNK_PART_END, the stream continues in the next part
+  trailer, // the trailer record of an appendable or segmented video
+};
+
+struct file_end
+{
+  stream_end kind{};
+  std::uint64_t segments{}; // a trailer lists
+};
+
+// checks the payload of a video after its metadata as it arrives. padded
+// payloads, those of videos without frame headers, may go on after their
+// end
+class payload_check
+{
+public:
+  payload_check (const metadata &meta, bool padded)
+      : meta_{ meta }, padded_{ padded }
+  {
+    if (this->meta_.format () != payload_format::serialized
+        && this->meta_.format () != payload_format::chunk_stream)
+      {
+        fail (std::errc::bad_message);
+      }
+  }
+
+  void
+  feed (std::span<const std::byte> bytes)
+  {
+    if (this->meta_.format () == payload_format::serialized)
+      {
+        // hashed as it arrives, nothing is kept
+        const std::size_t take = std::min (
+            this->meta_.file_size () - this->serialized_, bytes.size ());
+        this->checksum_.update (bytes.first (take));
+        this->serialized_ += take;
+        if (take < bytes.size () && !this->padded_)
+          {
+            fail (std::errc::bad_message);
+          }
+        return;
+      }
+
+    while (!bytes.empty ())
+      {
+        if (this->skip_ > 0)
+          {
+            const auto take = static_cast<std::size_t> (
+                std::min<std::uint64_t> (this->skip_, bytes.size ()));
+            this->skip_ -= take;
+            bytes = bytes.subspan (take);
+            continue;
+          }
+        if (this->end_)
+          {
+            if (!this->padded_)
+              {
+                fail (std::errc::bad_message);
+              }
+            return;
+          }
+
+        const std::size_t take = std::min (
+            CHUNK_RECORD_HEADER - this->header_.size (), bytes.size ());
+        this->header_.insert (this->header_.end (), bytes.begin (),
+                              bytes.begin ()
+                                  + static_cast<std::ptrdiff_t> (take));
+        bytes = bytes.subspan (take);
+        if (this->header_.size () == CHUNK_RECORD_HEADER)
+          {
+            this->next_record ();
+          }
+      }
+  }
+
+  // fails with bad_message if the payload stopped short
+  [[nodiscard]] file_end
+  finish () const
+  {
+    if (this->meta_.format () == payload_format::serialized)
+      {
+        if (this->serialized_ != this->meta_.file_size ()
+            || this->checksum_.digest () != this->meta_.checksum ())
+          {
+            fail (std::errc::bad_message);
+          }
+        return { stream_end::last };
+      }
+
+    if (!this->end_ || this->skip_ > 0 || !this->header_.empty ())
+      {
+        fail (std::errc::bad_message);
+      }
+    return { *this->end_, this->segments_ };
+  }
+
+  [[nodiscard]] std::uint64_t
+  records () const noexcept
+  {
+    return this->records_;
+  }
+
+private:
+  // checks the record header that was just completed, the key would be
+  // needed for anything beyond its size and flags
+  void
+  next_record ()
+  {
+    const auto header = read_chunk_header (
+        std::span<const std::byte> (this->header_)
+            .first<CHUNK_RECORD_HEADER> ());
+    this->header_.clear ();
+    ++this->records_;
+
+    constexpr unsigned known = CHUNK_LAST | CHUNK_COMPRESSED | CHUNK_PART_END
+                               | CHUNK_REFERENCE | CHUNK_TRAILER
+                               | CHUNK_DIGEST;
+    const unsigned flags = header.flags;
+    const bool last = (flags & CHUNK_LAST) != 0;
+    const bool part = (flags & CHUNK_PART_END) != 0;
+    const bool trailer = (flags & CHUNK_TRAILER) != 0;
+    const bool digest = (flags & CHUNK_DIGEST) != 0;
+    const bool ends = last || part;
+
+    const bool valid
+        = header.size <= CHUNK_RECORD_MAX && (flags & ~known) == 0
+          && !(last && part)
+          && (!trailer || flags == (CHUNK_LAST | CHUNK_TRAILER))
+          && (!digest || (last && header.size == STREAM_DIGEST_SIZE))
+          // the record that ends a stream or part carries no data
+          && (!ends || trailer || digest || header.size == 0)
+          && (!ends || (flags & (CHUNK_COMPRESSED | CHUNK_REFERENCE)) == 0)
+          && (!(flags & CHUNK_REFERENCE)
+              || header.size == CHUNK_REFERENCE_SIZE)
+          && (!(flags & CHUNK_COMPRESSED)
+              || header.size >= sizeof (std::uint32_t));
+    if (!valid)
+      {
+        fail (std::errc::bad_message);
+      }
+
+    // the sealed index is as long as its plaintext, a count and the
+    // entries
+    if (trailer)
+      {
+        if (header.size < sizeof (std::uint64_t)
+            || (header.size - sizeof (std::uint64_t))
+                       % sizeof (segment_entry)
+                   != 0)
+          {
+            fail (std::errc::bad_message);
+          }
+        this->segments_ = (header.size - sizeof (std::uint64_t))
+                          / sizeof (segment_entry);
+      }
+
+    this->skip_ = header.size;
+    if (ends)
+      {
+        this->end_ = trailer ? stream_end::trailer
+                     : last  ? stream_end::last
+                             : stream_end::part;
+      }
+  }
+
+  metadata meta_;
+  bool padded_;
+  blake3_hasher checksum_{ std::thread::hardware_concurrency () };
+  std::size_t serialized_{}; // bytes of a serialized payload so far
+  std::vector<std::byte> header_{};
+  std::uint64_t skip_{};
+  std::uint64_t records_{};
+  std::uint64_t segments_{};
+  std::optional<stream_end> end_{};
+};
+
+// an image of a video and what decoding it gave
+struct decoded_frame
+{
+  std::vector<std::byte> image{};
+  std::vector<std::byte> payload{}; // or parity
+  std::expected<frame_header, std::error_code> header{};
+  std::optional<parity_header> parity{}; // of a parity frame
+  bool decoded{};
+  bool framed{}; // has a frame or parity header
+  bool done{};
+};
+
+// decodes images on worker threads, a window of them at once. images are
+// submitted in file order and taken back in the same order
+class frame_workers
+{
+public:
+  frame_workers (std::size_t threads, std::size_t window)
+      : slots_ (window)
+  {
+    for (std::size_t i = 0; i < threads; ++i)
+      {
+        this->workers_.emplace_back ([this] { this->work (); });
+      }
+  }
+
+  frame_workers (const frame_workers &) = delete;
+  frame_workers &operator= (const frame_workers &) = delete;
+
+  ~frame_workers ()
+  {
+    {
+      const std::lock_guard lock{ this->mutex_ };
+      this->stopping_ = true;
+    }
+    this->work_.notify_all ();
+  }
+
+  [[nodiscard]] bool
+  full () const noexcept
+  {
+    return this->submitted_ - this->taken_ == this->slots_.size ();
+  }
+
+  [[nodiscard]] bool
+  empty () const noexcept
+  {
+    return this->submitted_ == this->taken_;
+  }
+
+  // the slot for the next image, unless full ()
+  [[nodiscard]] decoded_frame &
+  next ()
+  {
+    return this->slots_[this->submitted_ % this->slots_.size ()];
+  }
+
+  // hands the image in next () to the workers
+  void
+  submit ()
+  {
+    {
+      const std::lock_guard lock{ this->mutex_ };
+      this->next ().done = false;
+      ++this->submitted_;
+    }
+    this->work_.notify_one ();
+  }
+
+  // waits for the oldest image submitted, unless empty (). it stays valid
+  // until pop
+  [[nodiscard]] decoded_frame &
+  oldest ()
+  {
+    auto &slot = this->slots_[this->taken_ % this->slots_.size ()];
+    std::unique_lock lock{ this->mutex_ };
+    this->done_.wait (lock, [&] { return slot.done; });
+    return slot;
+  }
+
+  void
+  pop () noexcept
+  {
+    ++this->taken_;
+  }
+
+private:
+  void
+  work () noexcept
+  {
+    for (;;)
+      {
+        std::unique_lock lock{ this->mutex_ };
+        this->work_.wait (lock, [this] {
+          return this->stopping_ || this->claimed_ < this->submitted_;
+        });
+        if (this->stopping_)
+          {
+            return;
+          }
+        auto &slot = this->slots_[this->claimed_++ % this->slots_.size ()];
+        lock.unlock ();
+
+        try
+          {
+            slot.decoded = false;
+            slot.parity.reset ();
+            const cv::Mat frame = decode_image (slot.image);
+            slot.decoded = true;
+            // a frame with a magic is framed even if it does not read
+            const auto read = read_any_frame (frame, slot.payload);
+            slot.framed = read || read.error () != std::errc::invalid_argument;
+            if (!read)
+              {
+                slot.header = std::unexpected (read.error ());
+              }
+            else if (const auto *parity = std::get_if<parity_header> (&*read))
+              {
+                slot.parity = *parity;
+              }
+            else
+              {
+                slot.header = std::get<frame_header> (*read);
+              }
+          }
+        catch (const std::system_error &e)
+          {
+            slot.header = std::unexpected (e.code ());
+          }
+        catch (const std::exception &)
+          {
+            slot.header = std::unexpected (
+                std::make_error_code (std::errc::bad_message));
+          }
+
+        lock.lock ();
+        slot.done = true;
+        lock.unlock ();
+        this->done_.notify_all ();
+      }
+  }
+
+  std::vector<decoded_frame> slots_;
+  std::uint64_t submitted_{};
+  std::uint64_t claimed_{};
+  std::uint64_t taken_{};
+  bool stopping_{ false };
+  std::mutex mutex_{};
+  std::condition_variable work_{};
+  std::condition_variable done_{};
+  // declared last, so the workers are joined before the rest goes
+  std::vector<std::jthread> workers_{};
+};
+
+// the metadata that starts the payload of a video's first frame
+[[nodiscard]] metadata
+payload_metadata (std::span<const std::byte> payload)
+{
+  std::size_t filename_size = 0;
+  if (payload.size () < sizeof (filename_size))
+    {
+      fail (std::errc::bad_message);
+    }
+  std::memcpy (&filename_size, payload.data (), sizeof (filename_size));
+  if (filename_size > payload.size ()
+      || metadata_size (filename_size) > payload.size ())
+    {
+      fail (std::errc::bad_message);
+    }
+  return metadata{ payload.first (metadata_size (filename_size)) };
+}
+
+// a video written before frames had headers, read as one bit stream
+[[nodiscard]] file_end
+verify_unframed (const std::filesystem::path &path, bool first,
+                 verify_report &report)
+{
+  video source{ path };
+  const auto meta = source.get_metadata ();
+  if (first)
+    {
+      report.meta = meta;
+    }
+
+  // one from before the calibration strip is checked by the reader of its
+  // layout, against its own kind of checksum
+  if (meta.legacy ())
+    {
+      const auto pixels = source.read ();
+      if (!pixels)
+        {
+          throw std::system_error (pixels.error ());
+        }
+      report.payload_bytes += meta.file_size ();
+      return { stream_end::last };
+    }
+
+  payload_check payload{ meta, true };
+  for (const auto data : video_bytes (path, meta))
+    {
+      payload.feed (data);
+      report.payload_bytes += data.size ();
+    }
+  report.records += payload.records ();
+  return payload.finish ();
+}
+
+// checks one file of a video, first if it is the video itself
+[[nodiscard]] file_end
+verify_file (const std::filesystem::path &path, std::size_t threads,
+             bool first, verify_report &report)
+{
+  report.failed_frame = 0;
+  // the window keeps every worker busy while the oldest frame is checked
+  frame_workers workers{ threads, threads * 4 };
+  auto images = avi_images (path);
+  auto image = images.begin ();
+
+  frame_recovery recovery{ threads };
+  std::optional<payload_check> payload{};
+  const auto take = [&] (std::span<const std::byte> data) {
+    if (!payload)
+      {
+        const auto meta = payload_metadata (data);
+        if (first)
+          {
+            report.meta = meta;
+          }
+        data = data.subspan (meta.size ());
+        payload.emplace (meta, false);
+      }
+    payload->feed (data);
+    report.payload_bytes += data.size ();
+  };
+  for (std::size_t frame = 0;; ++frame)
+    {
+      while (image != images.end () && !workers.full ())
+        {
+          const auto bytes = *image;
+          workers.next ().image.assign (bytes.begin (), bytes.end ());
+          workers.submit ();
+          ++image;
+        }
+      if (workers.empty ())
+        {
+          break;
+        }
+
+      auto &slot = workers.oldest ();
+      if (frame == 0 && slot.decoded && !slot.framed)
+        {
+          return verify_unframed (path, first, report);
+        }
+      // a frame that does not read counts as dropped, its group may
+      // rebuild it. a gap is reported at the first frame missing, which
+      // is found only frames later
+      report.failed_frame = recovery.next_sequence ();
+      if (slot.parity)
+        {
+          ++report.frames;
+          check (recovery.add (*slot.parity, slot.payload));
+        }
+      else if (slot.header)
+        {
+          ++report.frames;
+          check (recovery.add (*slot.header, slot.payload));
+        }
+      workers.pop ();
+
+      for (auto next = recovery.next ();; next = recovery.next ())
+        {
+          if (!next)
+            {
+              report.failed_frame = recovery.next_sequence ();
+              throw std::system_error (next.error ());
+            }
+          if (*next == nullptr)
+            {
+              break;
+            }
+          report.failed_frame = (*next)->header.sequence;
+          take ((*next)->payload);
+        }
+    }
+  report.failed_frame = recovery.next_sequence ();
+  check (recovery.finish ());
+  report.duplicates += recovery.repeats ();
+  report.rebuilt += recovery.rebuilt ();
+
+  // a video without frames
+  if (!payload)
+    {
+      fail (std::errc::bad_message);
+    }
+  report.records += payload->records ();
+  return payload->finish ();
+}
+
+} // namespace
+
+[[nodiscard]] verify_report
+verify_video (const std::filesystem::path &path, std::size_t threads) noexcept
+{
+  verify_report report{};
+  std::filesystem::path current = path;
+  try
+    {
+      threads = std::max<std::size_t> (threads, 1);
+
+      // the trailer of an appendable or segmented video says how many
+      // parts there are, each ends with a part end. otherwise parts
+      // continue the stream until its last record
+      std::optional<std::uint64_t> segments{};
+      if (std::filesystem::exists (index_path (path)))
+        {
+          current = index_path (path);
+          ++report.videos;
+          const auto end = verify_file (current, threads, false, report);
+          if (end.kind != stream_end::trailer || end.segments == 0)
+            {
+              fail (std::errc::bad_message);
+            }
+          segments = end.segments;
+        }
+
+      for (std::uint64_t part = 0;; ++part)
+        {
+          current = part_path (path, part);
+          ++report.videos;
+          const auto end = verify_file (current, threads, part == 0, report);
+          if (end.kind == stream_end::trailer
+              || (segments && end.kind != stream_end::part))
+            {
+              fail (std::errc::bad_message);
+            }
+          if (segments ? part + 1 == *segments : end.kind == stream_end::last)
+            {
+              break;
+            }
+        }
+      report.failed_frame = 0;
+    }
+  catch (const std::system_error &e)
+    {
+      report.error = e.code ();
+      report.failed_path = current;
+    }
+  catch (const std::exception &)
+    {
+      // opencv and metadata parsing throw on what they can not read
+      report.error = std::make_error_code (std::errc::bad_message);
+      report.failed_path = current;
+    }
+  return report;
+}
+
+} // namespace ftv
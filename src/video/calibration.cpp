@@ -0,0 +1,201 @@
+#include "video/calibration.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace ftv
+{
+
+namespace
+{
+
+// cell order inside the strip
+inline constexpr std::array<std::uint8_t, 3> CELL_LEVELS{
+  CALIBRATION_BLACK, CALIBRATION_WHITE, CALIBRATION_GREY
+};
+
+// pixels at the edges of a cell bleed into their neighbours after lossy
+// compression, only the centre is measured
+inline constexpr std::size_t CELL_MARGIN{ CALIBRATION_CELL / 4 };
+
+// below this spread between measured black and white the strip is not
+// trusted and the nominal levels are used
+inline constexpr std::uint8_t MIN_CONTRAST{ 32 };
+
+[[nodiscard]] std::uint8_t
+luma (const cv::Vec3b &px) noexcept
+{
+  return static_cast<std::uint8_t> ((px[0] + px[1] + px[2]) / 3);
+}
+
+[[nodiscard]] std::uint8_t
+otsu (const std::array<std::size_t, 256> &histogram) noexcept
+{
+  std::size_t total = 0;
+  double weighted_total = 0.0;
+  for (std::size_t level = 0; level < histogram.size (); ++level)
+    {
+      total += histogram[level];
+      weighted_total
+          += static_cast<double> (level) * static_cast<double> (histogram[level]);
+    }
+
+  std::size_t background = 0;
+  double weighted_background = 0.0;
+  double best_variance = 0.0;
+  std::size_t best_level = CALIBRATION_GREY;
+  for (std::size_t level = 0; level < histogram.size (); ++level)
+    {
+      background += histogram[level];
+      if (background == 0)
+        {
+          continue;
+        }
+      const std::size_t foreground = total - background;
+      if (foreground == 0)
+        {
+          break;
+        }
+      weighted_background
+          += static_cast<double> (level) * static_cast<double> (histogram[level]);
+
+      const double mean_background
+          = weighted_background / static_cast<double> (background);
+      const double mean_foreground = (weighted_total - weighted_background)
+                                     / static_cast<double> (foreground);
+      const double difference = mean_background - mean_foreground;
+      const double variance = static_cast<double> (background)
+                              * static_cast<double> (foreground) * difference
+                              * difference;
+      if (variance > best_variance)
+        {
+          best_variance = variance;
+          best_level = level;
+        }
+    }
+  return static_cast<std::uint8_t> (best_level);
+}
+
+} // namespace
+
+void
+draw_calibration (cv::Mat &frame) noexcept
+{
+  for (std::int32_t y = 0;
+       y < std::min (frame.rows, static_cast<std::int32_t> (CALIBRATION_ROWS));
+       ++y)
+    {
+      for (std::int32_t x = 0; x < frame.cols; ++x)
+        {
+          const auto cell = static_cast<std::size_t> (x) / CALIBRATION_CELL;
+          const auto level = CELL_LEVELS[cell % CELL_LEVELS.size ()];
+          frame.at<cv::Vec3b> (y, x) = cv::Vec3b (level, level, level);
+        }
+    }
+}
+
+[[nodiscard]] bool
+has_calibration (const cv::Mat &frame) noexcept
+{
+  if (frame.empty () || frame.type () != CV_8UC3)
+    {
+      return false;
+    }
+
+  // lossy compression may blur a few cells, but at least three quarters of
+  // the black, white and grey runs keep their order
+  const auto *row = frame.ptr<cv::Vec3b> (0);
+  const std::size_t run = CALIBRATION_CELL * CELL_LEVELS.size ();
+  const std::size_t runs = static_cast<std::size_t> (frame.cols) / run;
+  std::size_t ordered = 0;
+  for (std::size_t i = 0; i < runs; ++i)
+    {
+      std::array<std::size_t, CELL_LEVELS.size ()> sums{};
+      for (std::size_t cell = 0; cell < CELL_LEVELS.size (); ++cell)
+        {
+          const std::size_t start = i * run + cell * CALIBRATION_CELL;
+          for (std::size_t x = start + CELL_MARGIN;
+               x < start + CALIBRATION_CELL - CELL_MARGIN; ++x)
+            {
+              sums[cell] += luma (row[x]);
+            }
+        }
+      const auto black = sums[0];
+      const auto white = sums[1];
+      const auto grey = sums[2];
+      const std::size_t contrast
+          = MIN_CONTRAST * (CALIBRATION_CELL - 2 * CELL_MARGIN);
+      if (black < grey && grey < white && white >= black + contrast)
+        {
+          ++ordered;
+        }
+    }
+  return runs > 0 && ordered * 4 >= runs * 3;
+}
+
+[[nodiscard]] frame_levels
+calibrate (const cv::Mat &frame) noexcept
+{
+  // sum the centres of every cell per level
+  std::array<std::size_t, CELL_LEVELS.size ()> sums{};
+  std::array<std::size_t, CELL_LEVELS.size ()> counts{};
+  for (std::int32_t y = 0;
+       y < std::min (frame.rows, static_cast<std::int32_t> (CALIBRATION_ROWS));
+       ++y)
+    {
+      for (std::int32_t x = 0; x < frame.cols; ++x)
+        {
+          const auto offset = static_cast<std::size_t> (x) % CALIBRATION_CELL;
+          if (offset < CELL_MARGIN || offset >= CALIBRATION_CELL - CELL_MARGIN)
+            {
+              continue;
+            }
+          const auto cell = (static_cast<std::size_t> (x) / CALIBRATION_CELL)
+                            % CELL_LEVELS.size ();
+          sums[cell] += luma (frame.at<cv::Vec3b> (y, x));
+          counts[cell]++;
+        }
+    }
+
+  frame_levels levels{};
+  if (counts[0] == 0 || counts[1] == 0 || counts[2] == 0)
+    {
+      return levels; // frame too narrow for a full strip
+    }
+
+  const auto black = static_cast<std::uint8_t> (sums[0] / counts[0]);
+  const auto white = static_cast<std::uint8_t> (sums[1] / counts[1]);
+  const auto grey = static_cast<std::uint8_t> (sums[2] / counts[2]);
+  if (white < black + MIN_CONTRAST)
+    {
+      return levels;
+    }
+  levels.black = black;
+  levels.white = white;
+  levels.grey = grey;
+  levels.threshold = grey;
+
+  std::array<std::size_t, 256> histogram{};
+  for (std::int32_t y = static_cast<std::int32_t> (CALIBRATION_ROWS);
+       y < frame.rows; ++y)
+    {
+      const auto *row = frame.ptr<cv::Vec3b> (y);
+      for (std::int32_t x = 0; x < frame.cols; ++x)
+        {
+          histogram[luma (row[x])]++;
+        }
+    }
+
+  // otsu is only trusted if it lands well inside the measured range, a frame
+  // that is mostly padding has no second class to separate
+  const auto threshold = otsu (histogram);
+  const auto quarter = static_cast<std::uint8_t> ((white - black) / 4);
+  if (threshold > black + quarter && threshold < white - quarter)
+    {
+      levels.threshold = threshold;
+    }
+  return levels;
+}
+
+} // namespace ftv
@@ -0,0 +1,498 @@
+#include "video/erasure.hpp"
+
+#include <algorithm>
+#include <array>
+#include <variant>
+
+namespace ftv
+{
+
+namespace
+{
+
+// payload bytes a rebuilding thread gets at least, below that a thread
+// costs more than it saves
+inline constexpr std::size_t RECOVERY_SLICE{ std::size_t{ 16 } << 10 };
+
+// gf(256) with the polynomial x^8 + x^4 + x^3 + x^2 + 1. exp is doubled so
+// a sum of two logarithms needs no reduction
+struct gf_tables
+{
+  std::array<std::uint8_t, 510> exp{};
+  std::array<std::uint8_t, 256> log{};
+};
+
+[[nodiscard]] constexpr gf_tables
+make_gf_tables () noexcept
+{
+  gf_tables tables{};
+  unsigned value = 1;
+  for (unsigned i = 0; i < 255; ++i)
+    {
+      tables.exp[i] = static_cast<std::uint8_t> (value);
+      tables.exp[i + 255] = static_cast<std::uint8_t> (value);
+      tables.log[value] = static_cast<std::uint8_t> (i);
+      value <<= 1;
+      if ((value & 0x100) != 0)
+        {
+          value ^= 0x11d;
+        }
+    }
+  return tables;
+}
+
+inline constexpr gf_tables GF{ make_gf_tables () };
+
+[[nodiscard]] std::uint8_t
+gf_mul (std::uint8_t a, std::uint8_t b) noexcept
+{
+  if (a == 0 || b == 0)
+    {
+      return 0;
+    }
+  return GF.exp[static_cast<std::size_t> (GF.log[a]) + GF.log[b]];
+}
+
+// a has to be non zero
+[[nodiscard]] std::uint8_t
+gf_inv (std::uint8_t a) noexcept
+{
+  return GF.exp[255 - static_cast<std::size_t> (GF.log[a])];
+}
+
+// factor of data frame data in parity frame parity, a cauchy matrix over
+// the points 255 - parity and data, which never meet while a group has at
+// most ERASURE_MAX_FRAMES frames. every square part of it is invertible,
+// so any parity frames can stand in for the same number of data frames
+[[nodiscard]] std::uint8_t
+coefficient (std::size_t parity, std::size_t data) noexcept
+{
+  return gf_inv (static_cast<std::uint8_t> ((255 - parity) ^ data));
+}
+
+// dst ^= factor * src byte by byte, src may be shorter than dst
+void
+mul_add (std::span<std::byte> dst, std::span<const std::byte> src,
+         std::uint8_t factor) noexcept
+{
+  if (factor == 0)
+    {
+      return;
+    }
+  std::array<std::byte, 256> product{};
+  for (unsigned x = 0; x < product.size (); ++x)
+    {
+      product[x]
+          = std::byte{ gf_mul (factor, static_cast<std::uint8_t> (x)) };
+    }
+  for (std::size_t i = 0; i < src.size (); ++i)
+    {
+      dst[i] ^= product[std::to_integer<std::uint8_t> (src[i])];
+    }
+}
+
+// inverts the size by size matrix, row major, false if it is singular
+[[nodiscard]] bool
+invert (std::vector<std::uint8_t> &matrix, std::size_t size)
+{
+  std::vector<std::uint8_t> inverse (size * size);
+  for (std::size_t i = 0; i < size; ++i)
+    {
+      inverse[i * size + i] = 1;
+    }
+
+  const auto row_of = [size] (std::vector<std::uint8_t> &m, std::size_t row) {
+    return std::span (m).subspan (row * size, size);
+  };
+  for (std::size_t col = 0; col < size; ++col)
+    {
+      std::size_t pivot = col;
+      while (pivot < size && matrix[pivot * size + col] == 0)
+        {
+          ++pivot;
+        }
+      if (pivot == size)
+        {
+          return false;
+        }
+      std::ranges::swap_ranges (row_of (matrix, pivot),
+                                row_of (matrix, col));
+      std::ranges::swap_ranges (row_of (inverse, pivot),
+                                row_of (inverse, col));
+
+      const std::uint8_t scale = gf_inv (matrix[col * size + col]);
+      for (std::size_t i = 0; i < size; ++i)
+        {
+          matrix[col * size + i] = gf_mul (matrix[col * size + i], scale);
+          inverse[col * size + i] = gf_mul (inverse[col * size + i], scale);
+        }
+      for (std::size_t row = 0; row < size; ++row)
+        {
+          const std::uint8_t factor = matrix[row * size + col];
+          if (row == col || factor == 0)
+            {
+              continue;
+            }
+          for (std::size_t i = 0; i < size; ++i)
+            {
+              matrix[row * size + i]
+                  ^= gf_mul (factor, matrix[col * size + i]);
+              inverse[row * size + i]
+                  ^= gf_mul (factor, inverse[col * size + i]);
+            }
+        }
+    }
+  matrix = std::move (inverse);
+  return true;
+}
+
+} // namespace
+
+parity_encoder::parity_encoder (erasure_params params, std::size_t stride)
+    : params_{ params }, stride_{ static_cast<std::uint32_t> (stride) },
+      parity_ (params.parity_frames, std::vector<std::byte> (stride))
+{
+}
+
+[[nodiscard]] bool
+parity_encoder::add (std::uint32_t sequence,
+                     std::span<const std::byte> payload) noexcept
+{
+  if (this->complete_)
+    {
+      for (auto &parity : this->parity_)
+        {
+          std::ranges::fill (parity, std::byte{ 0 });
+        }
+      this->count_ = 0;
+      this->bytes_ = 0;
+      this->complete_ = false;
+    }
+  if (this->count_ == 0)
+    {
+      this->first_ = sequence;
+    }
+
+  for (std::size_t i = 0; i < this->parity_.size (); ++i)
+    {
+      mul_add (this->parity_[i], payload, coefficient (i, this->count_));
+    }
+  ++this->count_;
+  this->bytes_ += static_cast<std::uint32_t> (payload.size ());
+  this->complete_ = this->count_ == this->params_.data_frames;
+  return this->complete_;
+}
+
+[[nodiscard]] bool
+parity_encoder::finish () noexcept
+{
+  if (this->complete_ || this->count_ == 0)
+    {
+      return false;
+    }
+  this->complete_ = true;
+  return true;
+}
+
+void
+parity_encoder::render (cv::Mat &frame, std::size_t index) const noexcept
+{
+  parity_header header{};
+  header.first = this->first_;
+  header.group_bytes = this->bytes_;
+  header.stride = this->stride_;
+  header.data_frames = static_cast<std::uint8_t> (this->count_);
+  header.parity_frames = static_cast<std::uint8_t> (this->parity_.size ());
+  header.index = static_cast<std::uint8_t> (index);
+  render_parity_frame (frame, header,
+                       std::span (this->parity_[index])
+                           .first (parity_size (header)));
+}
+
+frame_recovery::frame_recovery (std::size_t threads)
+    : threads_{ std::max<std::size_t> (threads, 1) }
+{
+}
+
+[[nodiscard]] std::error_code
+frame_recovery::add (const cv::Mat &frame)
+{
+  const auto header = read_any_frame (frame, this->scratch_);
+  if (!header)
+    {
+      return {};
+    }
+  return std::visit (
+      [this] (const auto &read) { return this->add (read, this->scratch_); },
+      *header);
+}
+
+[[nodiscard]] std::error_code
+frame_recovery::add (const frame_header &header,
+                     std::span<const std::byte> payload)
+{
+  this->prune ();
+  if (header.sequence < this->next_
+      || this->frames_.contains (header.sequence))
+    {
+      ++this->repeats_;
+      return {};
+    }
+  this->frames_.emplace (
+      header.sequence,
+      data_frame{ header, { payload.begin (), payload.end () } });
+
+  // a late data frame may be what its group needed
+  auto owner = this->groups_.upper_bound (header.sequence);
+  if (owner != this->groups_.begin ())
+    {
+      this->recover ((--owner)->first);
+    }
+  if (this->hopeless ())
+    {
+      return std::make_error_code (std::errc::bad_message);
+    }
+  return {};
+}
+
+[[nodiscard]] std::error_code
+frame_recovery::add (const parity_header &header,
+                     std::span<const std::byte> parity)
+{
+  this->prune ();
+  if (std::size_t{ header.data_frames } + header.parity_frames
+      > ERASURE_MAX_FRAMES)
+    {
+      return std::make_error_code (std::errc::bad_message);
+    }
+  // the group was handed out whole already
+  if (std::uint64_t{ header.first } + header.data_frames <= this->next_)
+    {
+      return {};
+    }
+
+  auto &owner = this->groups_[header.first];
+  if (owner.parity.empty ())
+    {
+      owner.header = header;
+    }
+  else if (owner.header.group_bytes != header.group_bytes
+           || owner.header.stride != header.stride
+           || owner.header.data_frames != header.data_frames
+           || owner.header.parity_frames != header.parity_frames)
+    {
+      return std::make_error_code (std::errc::bad_message);
+    }
+  if (!owner.parity.emplace (header.index,
+                             std::vector<std::byte> (parity.begin (),
+                                                     parity.end ()))
+           .second)
+    {
+      ++this->repeats_;
+      return {};
+    }
+
+  // every group but the last is full
+  this->group_size_ = std::max<std::uint32_t> (this->group_size_.value_or (0),
+                                               header.data_frames);
+  this->recover (header.first);
+  if (this->hopeless ())
+    {
+      return std::make_error_code (std::errc::bad_message);
+    }
+  return {};
+}
+
+[[nodiscard]] std::expected<const data_frame *, std::error_code>
+frame_recovery::next ()
+{
+  const auto found = this->frames_.find (this->next_);
+  if (found == this->frames_.end ())
+    {
+      return nullptr;
+    }
+  const auto accepted = this->sequence_.accept (found->second.header);
+  if (!accepted)
+    {
+      return std::unexpected (accepted.error ());
+    }
+  ++this->next_;
+  return &found->second;
+}
+
+[[nodiscard]] std::error_code
+frame_recovery::finish () const noexcept
+{
+  if (this->frames_.lower_bound (this->next_) != this->frames_.end ())
+    {
+      return std::make_error_code (std::errc::bad_message);
+    }
+  return {};
+}
+
+void
+frame_recovery::recover (std::uint32_t first)
+{
+  const auto found = this->groups_.find (first);
+  if (found == this->groups_.end ()
+      || std::uint64_t{ first } + found->second.header.data_frames
+             <= this->next_)
+    {
+      return;
+    }
+  const auto &header = found->second.header;
+  const auto &parity = found->second.parity;
+
+  std::vector<std::size_t> missing;
+  for (std::size_t data = 0; data < header.data_frames; ++data)
+    {
+      if (!this->frames_.contains (static_cast<std::uint32_t> (first + data)))
+        {
+          missing.push_back (data);
+        }
+    }
+  if (missing.empty () || missing.size () > parity.size ())
+    {
+      return;
+    }
+
+  // the parity frames used, and the inverse of their factors for the
+  // missing data frames
+  const std::size_t count = missing.size ();
+  std::vector<std::uint8_t> rows;
+  for (const auto &[index, bytes] : parity)
+    {
+      if (rows.size () < count)
+        {
+          rows.push_back (index);
+        }
+    }
+  std::vector<std::uint8_t> factors (count * count);
+  for (std::size_t row = 0; row < count; ++row)
+    {
+      for (std::size_t col = 0; col < count; ++col)
+        {
+          factors[row * count + col] = coefficient (rows[row], missing[col]);
+        }
+    }
+  if (!invert (factors, count))
+    {
+      return;
+    }
+
+  // every parity frame minus what the data frames that are there put into
+  // it leaves what the missing ones did, which the inverse turns back into
+  // them. every thread does this for its own slice of the bytes
+  const std::size_t length = parity_size (header);
+  std::vector<std::vector<std::byte>> remainders (count);
+  std::vector<std::vector<std::byte>> rebuilt (
+      count, std::vector<std::byte> (length));
+  for (std::size_t row = 0; row < count; ++row)
+    {
+      remainders[row] = parity.at (rows[row]);
+    }
+  const auto solve = [&] (std::size_t begin, std::size_t end) {
+    for (std::size_t row = 0; row < count; ++row)
+      {
+        const auto remainder
+            = std::span (remainders[row]).subspan (begin, end - begin);
+        for (std::size_t data = 0; data < header.data_frames; ++data)
+          {
+            const auto frame = this->frames_.find (
+                static_cast<std::uint32_t> (first + data));
+            if (frame == this->frames_.end ())
+              {
+                continue;
+              }
+            const std::span<const std::byte> payload (frame->second.payload);
+            if (payload.size () > begin)
+              {
+                mul_add (remainder,
+                         payload.subspan (begin, std::min (payload.size (),
+                                                           end)
+                                                     - begin),
+                         coefficient (rows[row], data));
+              }
+          }
+      }
+    for (std::size_t col = 0; col < count; ++col)
+      {
+        for (std::size_t row = 0; row < count; ++row)
+          {
+            mul_add (std::span (rebuilt[col]).subspan (begin, end - begin),
+                     std::span<const std::byte> (remainders[row])
+                         .subspan (begin, end - begin),
+                     factors[col * count + row]);
+          }
+      }
+  };
+
+  const std::size_t slices = std::clamp<std::size_t> (
+      length / RECOVERY_SLICE, 1, this->threads_);
+  const std::size_t slice = (length + slices - 1) / slices;
+  {
+    std::vector<std::jthread> workers;
+    for (std::size_t begin = slice; begin < length; begin += slice)
+      {
+        workers.emplace_back (solve, begin, std::min (begin + slice, length));
+      }
+    solve (0, std::min (slice, length));
+  }
+
+  for (std::size_t col = 0; col < count; ++col)
+    {
+      const std::size_t data = missing[col];
+      const auto sequence = static_cast<std::uint32_t> (first + data);
+      frame_header rebuilt_header{};
+      rebuilt_header.sequence = sequence;
+      rebuilt_header.offset = std::uint64_t{ sequence } * header.stride;
+      rebuilt_header.length = std::min<std::uint32_t> (
+          header.stride,
+          header.group_bytes
+              - static_cast<std::uint32_t> (data) * header.stride);
+      rebuilt[col].resize (rebuilt_header.length);
+      this->frames_.emplace (sequence, data_frame{ rebuilt_header,
+                                                   std::move (rebuilt[col]) });
+    }
+  this->rebuilt_ += count;
+}
+
+void
+frame_recovery::prune ()
+{
+  // frames before the group of the next one are neither handed out again
+  // nor needed to rebuild one. until the group size is known every group
+  // could still reach that far back
+  const std::uint32_t keep
+      = this->group_size_
+            ? this->next_ - this->next_ % *this->group_size_
+            : this->next_ - std::min<std::uint32_t> (this->next_,
+                                                     ERASURE_MAX_FRAMES);
+  this->frames_.erase (this->frames_.begin (),
+                       this->frames_.lower_bound (keep));
+  std::erase_if (this->groups_, [this] (const auto &entry) {
+    return std::uint64_t{ entry.first } + entry.second.header.data_frames
+           <= this->next_;
+  });
+}
+
+[[nodiscard]] bool
+frame_recovery::hopeless () const noexcept
+{
+  if (this->frames_.empty () || this->frames_.contains (this->next_)
+      || this->frames_.rbegin ()->first < this->next_)
+    {
+      return false;
+    }
+  // parity frames follow the data frames of their group, so once frames
+  // from two groups past the gap arrived none will come for it. until the
+  // group size is known a group can be that long
+  const std::uint64_t reach
+      = this->group_size_
+            ? this->next_ - this->next_ % *this->group_size_
+                  + 2 * std::uint64_t{ *this->group_size_ }
+            : std::uint64_t{ this->next_ } + ERASURE_MAX_FRAMES;
+  return this->frames_.rbegin ()->first >= reach;
+}
+
+} // namespace ftv
@@ -0,0 +1,417 @@
+#include "video/frame_header.hpp"
+#include "video/calibration.hpp"
+#include "video/pixel_layout.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+// headers and payloads of frames are drawn in black and white
+inline constexpr pixel_layout FRAME_LAYOUT{ MONO_LAYOUT };
+
+// the header fields after the magic, in the order the checksum covers them
+using header_fields
+    = std::array<std::byte, FRAME_HEADER_SIZE - FRAME_MAGIC.size ()
+                                - sizeof (std::uint32_t)>;
+
+[[nodiscard]] header_fields
+pack_fields (const frame_header &header) noexcept
+{
+  header_fields fields{};
+  std::byte *dst = fields.data ();
+  std::memcpy (dst, &header.sequence, sizeof (header.sequence));
+  dst += sizeof (header.sequence);
+  std::memcpy (dst, &header.offset, sizeof (header.offset));
+  dst += sizeof (header.offset);
+  std::memcpy (dst, &header.length, sizeof (header.length));
+  return fields;
+}
+
+[[nodiscard]] header_fields
+pack_fields (const parity_header &header) noexcept
+{
+  header_fields fields{};
+  std::byte *dst = fields.data ();
+  std::memcpy (dst, &header.first, sizeof (header.first));
+  dst += sizeof (header.first);
+  std::memcpy (dst, &header.group_bytes, sizeof (header.group_bytes));
+  dst += sizeof (header.group_bytes);
+  std::memcpy (dst, &header.stride, sizeof (header.stride));
+  dst += sizeof (header.stride);
+  dst[0] = std::byte{ header.data_frames };
+  dst[1] = std::byte{ header.parity_frames };
+  dst[2] = std::byte{ header.index };
+  return fields;
+}
+
+[[nodiscard]] std::uint32_t
+frame_checksum (const header_fields &fields,
+                std::span<const std::byte> payload) noexcept
+{
+  uLong crc = crc32 (0, nullptr, 0);
+  crc = crc32 (crc, reinterpret_cast<const Bytef *> (fields.data ()),
+               static_cast<uInt> (fields.size ()));
+  crc = crc32 (crc, reinterpret_cast<const Bytef *> (payload.data ()),
+               static_cast<uInt> (payload.size ()));
+  return static_cast<std::uint32_t> (crc);
+}
+
+// draws one byte as the L.symbols_per_byte () pixels from dst on
+template <pixel_layout L>
+void
+draw_byte (cv::Vec3b *dst, std::byte byte) noexcept
+{
+  const unsigned value = std::to_integer<unsigned> (byte);
+  unrolled<L.symbols_per_byte ()> ([&] (auto symbol) {
+    const std::uint8_t level = L.level (
+        (value >> (8 - (symbol + 1) * L.bits_per_symbol)) & L.symbol_mask ());
+    unrolled<3> ([&] (auto channel) {
+      dst[symbol][channel] = channel < L.channels ? level : 0;
+    });
+  });
+}
+
+// the inverse of draw_byte. the threshold tells two levels apart, more
+// would need one threshold per level from the calibration strip
+template <pixel_layout L>
+[[nodiscard]] std::byte
+read_byte (const cv::Vec3b *src, std::uint8_t threshold) noexcept
+{
+  static_assert (L.bits_per_symbol == 1);
+  unsigned value = 0;
+  unrolled<L.symbols_per_byte ()> ([&] (auto symbol) {
+    unsigned sum = 0;
+    unrolled<L.channels> (
+        [&] (auto channel) { sum += src[symbol][channel]; });
+    value = (value << 1) | unsigned{ sum > L.channels * threshold };
+  });
+  return std::byte{ static_cast<std::uint8_t> (value) };
+}
+
+// draws bytes into the data area of a black frame, from byte position on.
+// a byte that does not fit into the rest of its row continues in the next
+// one
+template <pixel_layout L>
+void
+put_bytes (cv::Mat &frame, std::size_t position,
+           std::span<const std::byte> bytes) noexcept
+{
+  constexpr std::size_t symbols = L.symbols_per_byte ();
+  const auto cols = static_cast<std::size_t> (frame.cols);
+  std::size_t row = CALIBRATION_ROWS + position * symbols / cols;
+  std::size_t col = position * symbols % cols;
+  auto *pixels = frame.ptr<cv::Vec3b> (static_cast<std::int32_t> (row));
+
+  std::array<cv::Vec3b, symbols> split{};
+  for (const std::byte byte : bytes)
+    {
+      if (col == cols)
+        {
+          pixels = frame.ptr<cv::Vec3b> (static_cast<std::int32_t> (++row));
+          col = 0;
+        }
+      if (col + symbols <= cols)
+        {
+          draw_byte<L> (pixels + col, byte);
+          col += symbols;
+          continue;
+        }
+
+      draw_byte<L> (split.data (), byte);
+      for (const cv::Vec3b &px : split)
+        {
+          if (col == cols)
+            {
+              pixels
+                  = frame.ptr<cv::Vec3b> (static_cast<std::int32_t> (++row));
+              col = 0;
+            }
+          pixels[col++] = px;
+        }
+    }
+}
+
+// the inverse of put_bytes, fills bytes
+template <pixel_layout L>
+void
+get_bytes (const cv::Mat &frame, std::size_t position,
+           std::span<std::byte> bytes, std::uint8_t threshold) noexcept
+{
+  constexpr std::size_t symbols = L.symbols_per_byte ();
+  const auto cols = static_cast<std::size_t> (frame.cols);
+  std::size_t row = CALIBRATION_ROWS + position * symbols / cols;
+  std::size_t col = position * symbols % cols;
+  const auto *pixels
+      = frame.ptr<cv::Vec3b> (static_cast<std::int32_t> (row));
+
+  std::array<cv::Vec3b, symbols> split{};
+  for (std::byte &byte : bytes)
+    {
+      if (col == cols)
+        {
+          pixels = frame.ptr<cv::Vec3b> (static_cast<std::int32_t> (++row));
+          col = 0;
+        }
+      if (col + symbols <= cols)
+        {
+          byte = read_byte<L> (pixels + col, threshold);
+          col += symbols;
+          continue;
+        }
+
+      for (cv::Vec3b &px : split)
+        {
+          if (col == cols)
+            {
+              pixels
+                  = frame.ptr<cv::Vec3b> (static_cast<std::int32_t> (++row));
+              col = 0;
+            }
+          px = pixels[col++];
+        }
+      byte = read_byte<L> (split.data (), threshold);
+    }
+}
+
+[[nodiscard]] std::size_t
+frame_capacity (const cv::Mat &frame) noexcept
+{
+  if (frame.type () != CV_8UC3
+      || static_cast<std::size_t> (frame.rows) <= CALIBRATION_ROWS)
+    {
+      return 0;
+    }
+  return static_cast<std::size_t> (frame.cols)
+         * (static_cast<std::size_t> (frame.rows) - CALIBRATION_ROWS)
+         / FRAME_LAYOUT.symbols_per_byte ();
+}
+
+// clears frame and draws the calibration strip, a header of magic, fields
+// and their checksum with payload, and payload
+void
+draw_frame (cv::Mat &frame, const std::array<std::byte, 4> &magic,
+            const header_fields &fields,
+            std::span<const std::byte> payload) noexcept
+{
+  frame.setTo (cv::Scalar (0, 0, 0));
+  draw_calibration (frame);
+
+  const std::uint32_t checksum = frame_checksum (fields, payload);
+  std::size_t position = 0;
+  put_bytes<FRAME_LAYOUT> (frame, position, magic);
+  position += magic.size ();
+  put_bytes<FRAME_LAYOUT> (frame, position, fields);
+  position += fields.size ();
+  put_bytes<FRAME_LAYOUT> (
+      frame, position,
+      std::as_bytes (std::span<const std::uint32_t, 1> (&checksum, 1)));
+  position += sizeof (checksum);
+  put_bytes<FRAME_LAYOUT> (frame, position, payload);
+}
+
+// a header as it was read, before its fields are unpacked
+struct raw_header
+{
+  std::array<std::byte, 4> magic{};
+  header_fields fields{};
+  std::uint32_t checksum{};
+  std::uint8_t threshold{};
+  std::size_t capacity{}; // payload bytes the frame has room for
+};
+
+// the header of frame, calibrating it once for the header and the payload
+// after it. invalid_argument if it starts with neither magic
+[[nodiscard]] std::expected<raw_header, std::error_code>
+read_header (const cv::Mat &frame) noexcept
+{
+  const std::size_t capacity = frame_capacity (frame);
+  if (capacity < FRAME_HEADER_SIZE)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
+    }
+
+  raw_header header{};
+  header.threshold = calibrate (frame).threshold;
+  header.capacity = capacity - FRAME_HEADER_SIZE;
+  std::array<std::byte, FRAME_HEADER_SIZE> raw{};
+  get_bytes<FRAME_LAYOUT> (frame, 0, raw, header.threshold);
+  std::memcpy (header.magic.data (), raw.data (), header.magic.size ());
+  if (header.magic != FRAME_MAGIC && header.magic != PARITY_MAGIC)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
+    }
+
+  std::memcpy (header.fields.data (), raw.data () + header.magic.size (),
+               header.fields.size ());
+  std::memcpy (&header.checksum,
+               raw.data () + header.magic.size () + header.fields.size (),
+               sizeof (header.checksum));
+  return header;
+}
+
+// reads length bytes after header into payload, false if they do not fit
+// or do not match the checksum
+[[nodiscard]] bool
+read_payload (const cv::Mat &frame, const raw_header &header,
+              std::size_t length, std::vector<std::byte> &payload) noexcept
+{
+  if (length > header.capacity)
+    {
+      return false;
+    }
+  payload.resize (length);
+  get_bytes<FRAME_LAYOUT> (frame, FRAME_HEADER_SIZE, payload,
+                           header.threshold);
+  return frame_checksum (header.fields, payload) == header.checksum;
+}
+
+// the data frame behind raw, with its payload
+[[nodiscard]] std::expected<frame_header, std::error_code>
+read_data (const cv::Mat &frame, const raw_header &raw,
+           std::vector<std::byte> &payload) noexcept
+{
+  frame_header header{};
+  const std::byte *src = raw.fields.data ();
+  std::memcpy (&header.sequence, src, sizeof (header.sequence));
+  src += sizeof (header.sequence);
+  std::memcpy (&header.offset, src, sizeof (header.offset));
+  src += sizeof (header.offset);
+  std::memcpy (&header.length, src, sizeof (header.length));
+  header.checksum = raw.checksum;
+
+  if (!read_payload (frame, raw, header.length, payload))
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+  return header;
+}
+
+// the parity frame behind raw, with its parity
+[[nodiscard]] std::expected<parity_header, std::error_code>
+read_parity (const cv::Mat &frame, const raw_header &raw,
+             std::vector<std::byte> &parity) noexcept
+{
+  parity_header header{};
+  const std::byte *src = raw.fields.data ();
+  std::memcpy (&header.first, src, sizeof (header.first));
+  src += sizeof (header.first);
+  std::memcpy (&header.group_bytes, src, sizeof (header.group_bytes));
+  src += sizeof (header.group_bytes);
+  std::memcpy (&header.stride, src, sizeof (header.stride));
+  src += sizeof (header.stride);
+  header.data_frames = std::to_integer<std::uint8_t> (src[0]);
+  header.parity_frames = std::to_integer<std::uint8_t> (src[1]);
+  header.index = std::to_integer<std::uint8_t> (src[2]);
+  header.checksum = raw.checksum;
+
+  // every data frame but the last of the group is full
+  const std::uint64_t full
+      = std::uint64_t{ header.stride } * header.data_frames;
+  const bool valid = header.stride > 0 && header.data_frames > 0
+                     && header.index < header.parity_frames
+                     && src[3] == std::byte{ 0 }
+                     && header.group_bytes <= full
+                     && header.group_bytes + header.stride > full;
+  if (!valid || !read_payload (frame, raw, parity_size (header), parity))
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+  return header;
+}
+
+} // namespace
+
+[[nodiscard]] std::size_t
+frame_payload_size (const resolution &res) noexcept
+{
+  if (res.y <= CALIBRATION_ROWS)
+    {
+      return 0;
+    }
+  const std::size_t capacity = res.x * (res.y - CALIBRATION_ROWS)
+                               / FRAME_LAYOUT.symbols_per_byte ();
+  return capacity > FRAME_HEADER_SIZE ? capacity - FRAME_HEADER_SIZE : 0;
+}
+
+void
+render_frame (cv::Mat &frame, std::uint32_t sequence, std::uint64_t offset,
+              std::span<const std::byte> payload) noexcept
+{
+  frame_header header{};
+  header.sequence = sequence;
+  header.offset = offset;
+  header.length = static_cast<std::uint32_t> (payload.size ());
+  draw_frame (frame, FRAME_MAGIC, pack_fields (header), payload);
+}
+
+[[nodiscard]] std::size_t
+parity_size (const parity_header &header) noexcept
+{
+  return std::min (header.stride, header.group_bytes);
+}
+
+void
+render_parity_frame (cv::Mat &frame, const parity_header &header,
+                     std::span<const std::byte> parity) noexcept
+{
+  draw_frame (frame, PARITY_MAGIC, pack_fields (header), parity);
+}
+
+[[nodiscard]] bool
+has_any_header (const cv::Mat &frame) noexcept
+{
+  return read_header (frame).has_value ();
+}
+
+[[nodiscard]] std::expected<any_header, std::error_code>
+read_any_frame (const cv::Mat &frame,
+                std::vector<std::byte> &payload) noexcept
+{
+  const auto raw = read_header (frame);
+  if (!raw)
+    {
+      return std::unexpected (raw.error ());
+    }
+  if (raw->magic == PARITY_MAGIC)
+    {
+      const auto parity = read_parity (frame, *raw, payload);
+      if (!parity)
+        {
+          return std::unexpected (parity.error ());
+        }
+      return *parity;
+    }
+  const auto data = read_data (frame, *raw, payload);
+  if (!data)
+    {
+      return std::unexpected (data.error ());
+    }
+  return *data;
+}
+
+[[nodiscard]] std::expected<bool, std::error_code>
+frame_sequence::accept (const frame_header &header) noexcept
+{
+  if (header.sequence < this->next_)
+    {
+      return false;
+    }
+  if (header.sequence > this->next_ || header.offset != this->offset_)
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+  ++this->next_;
+  this->offset_ += header.length;
+  return true;
+}
+
+} // namespace ftv
@@ -0,0 +1,58 @@
+#include "video/frame_pool.hpp"
+
+#include <format>
+#include <new>
+#include <stdexcept>
+
+namespace ftv
+{
+
+namespace
+{
+
+inline constexpr std::size_t FRAME_ALIGNMENT{ 64 };
+
+} // namespace
+
+frame_pool::frame_pool (std::size_t rows, std::size_t cols, std::size_t count)
+    : block_{}, frames_{}
+{
+  if (rows == 0 || cols == 0 || count == 0 || count >= FRAME_RING_SIZE)
+    {
+      throw std::invalid_argument (
+          std::format ("invalid frame pool of {} {}x{} frames", count, cols,
+                       rows));
+    }
+
+  // every frame starts on its own cache line
+  const std::size_t frame_bytes = rows * cols * 3;
+  const std::size_t stride = (frame_bytes + FRAME_ALIGNMENT - 1)
+                             / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+  this->block_.reset (static_cast<std::byte *> (::operator new (
+      stride * count, std::align_val_t{ FRAME_ALIGNMENT })));
+
+  this->frames_.reserve (count);
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      this->frames_.emplace_back (static_cast<int> (rows),
+                                  static_cast<int> (cols), CV_8UC3,
+                                  this->block_.get () + i * stride);
+    }
+}
+
+void
+frame_pool::fill (frame_ring &ring) const noexcept
+{
+  for (std::size_t i = 0; i < this->frames_.size (); ++i)
+    {
+      ring.push (static_cast<frame_index> (i));
+    }
+}
+
+void
+frame_pool::aligned_delete::operator() (std::byte *block) const noexcept
+{
+  ::operator delete (block, std::align_val_t{ FRAME_ALIGNMENT });
+}
+
+} // namespace ftv
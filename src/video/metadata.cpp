@@ -28,15 +28,10 @@ metadata::metadata (std::span<const std::byte> bytes)
                sizeof (std::size_t));
   pos += sizeof (std::size_t);
 
-  const std::size_t required_size = sizeof (std::size_t) + // filename_size
-                                    this->filename_size_ + // filename
-                                    sizeof (std::size_t) + // file_size
-                                    sizeof (std::size_t) + // checksum
-                                    sizeof (std::size_t) + // fps
-                                    sizeof (resolution);   // resolution
+  const std::size_t required_size = metadata_size (this->filename_size_);
 
   // check if there is  enough bytes for everything
-  if (bytes.size () < required_size)
+  if (this->filename_size_ > bytes.size () || bytes.size () < required_size)
     {
       throw std::runtime_error (
           std::format ("invalid metadata bytes: expected {} bytes, got {}",
@@ -51,19 +46,33 @@ metadata::metadata (std::span<const std::byte> bytes)
   std::memcpy (&this->file_size_, bytes.data () + pos, sizeof (std::size_t));
   pos += sizeof (std::size_t);
 
-  std::memcpy (&this->checksum_, bytes.data () + pos, sizeof (std::size_t));
-  pos += sizeof (std::size_t);
+  std::memcpy (this->checksum_.data (), bytes.data () + pos,
+               this->checksum_.size ());
+  pos += this->checksum_.size ();
 
   std::memcpy (&this->fps_, bytes.data () + pos, sizeof (std::size_t));
   pos += sizeof (std::size_t);
 
   std::memcpy (&this->res_, bytes.data () + pos, sizeof (resolution));
+  pos += sizeof (resolution);
+
+  // the format takes the low byte of its field, the cipher the one above
+  // and the pixel layout the third. videos from before ciphers or layouts
+  // were selectable have 0 there
+  std::size_t format_field = 0;
+  std::memcpy (&format_field, bytes.data () + pos, sizeof (std::size_t));
+  this->format_ = static_cast<payload_format> (format_field & 0xff);
+  this->cipher_ = static_cast<cipher_id> ((format_field >> 8) & 0xff);
+  this->layout_ = static_cast<layout_id> ((format_field >> 16) & 0xff);
 }
 
-metadata::metadata (std::string fname, std::size_t fsize, std::size_t checksum,
-                    std::size_t fps, const resolution &r)
+metadata::metadata (std::string fname, std::size_t fsize,
+                    const blake3_digest &checksum, std::size_t fps,
+                    const resolution &r,
+                    payload_format format, cipher_id cipher, layout_id layout)
     : filename_size_ (fname.size ()), filename_ (std::move (fname)),
-      file_size_ (fsize), checksum_ (checksum), fps_ (fps), res_ (r)
+      file_size_ (fsize), checksum_ (checksum), fps_ (fps), res_ (r),
+      format_ (format), cipher_ (cipher), layout_ (layout)
 {
   if (this->filename_.empty ())
     {
@@ -78,6 +87,62 @@ metadata::metadata (std::string fname, std::size_t fsize, std::size_t checksum,
       throw std::runtime_error (std::format ("invalid resolution: {}x{}",
                                              this->res_.x, this->res_.y));
     }
+  if (this->format_ != payload_format::serialized
+      && this->format_ != payload_format::chunk_stream)
+    {
+      throw std::runtime_error (
+          std::format ("invalid payload format: {}",
+                       static_cast<std::size_t> (this->format_)));
+    }
+  if (!known_cipher (this->cipher_))
+    {
+      throw std::runtime_error (
+          std::format ("invalid cipher: {}",
+                       static_cast<unsigned> (this->cipher_)));
+    }
+  if (!known_layout (this->layout_))
+    {
+      throw std::runtime_error (
+          std::format ("invalid pixel layout: {}",
+                       static_cast<unsigned> (this->layout_)));
+    }
+}
+
+[[nodiscard]] metadata
+metadata::parse_legacy (std::span<const std::byte> bytes)
+{
+  std::size_t filename_size = 0;
+  if (bytes.size () < sizeof (std::size_t))
+    {
+      throw std::runtime_error (
+          std::format ("invalid metadata bytes: expected at least {} bytes "
+                       "for filename_size",
+                       sizeof (std::size_t)));
+    }
+  std::memcpy (&filename_size, bytes.data (), sizeof (std::size_t));
+  if (filename_size > bytes.size ()
+      || bytes.size () < legacy_metadata_size (filename_size))
+    {
+      throw std::runtime_error (std::format (
+          "invalid metadata bytes: expected {} bytes, got {}",
+          legacy_metadata_size (filename_size), bytes.size ()));
+    }
+
+  // the fields in the order they had then, checked by the constructor
+  std::size_t pos = sizeof (std::size_t);
+  std::string filename (filename_size, '\0');
+  std::memcpy (filename.data (), bytes.data () + pos, filename_size);
+  pos += filename_size;
+  std::size_t fields[3]{}; // file_size, checksum, fps
+  std::memcpy (fields, bytes.data () + pos, sizeof (fields));
+  pos += sizeof (fields);
+  resolution res{};
+  std::memcpy (&res, bytes.data () + pos, sizeof (resolution));
+
+  metadata legacy{ std::move (filename), fields[0], {}, fields[2], res };
+  legacy.legacy_checksum_ = fields[1];
+  legacy.legacy_ = true;
+  return legacy;
 }
 
 [[nodiscard]] std::size_t
@@ -98,12 +163,18 @@ metadata::file_size () const noexcept
   return this->file_size_;
 }
 
-[[nodiscard]] std::size_t
+[[nodiscard]] blake3_digest
 metadata::checksum () const noexcept
 {
   return this->checksum_;
 }
 
+[[nodiscard]] std::size_t
+metadata::legacy_checksum () const noexcept
+{
+  return this->legacy_checksum_;
+}
+
 [[nodiscard]] std::size_t
 metadata::fps () const noexcept
 {
@@ -116,10 +187,34 @@ metadata::res () const noexcept
   return this->res_;
 }
 
-[[nodiscard]] std::vector<std::byte>
-metadata::to_vec () const noexcept
+[[nodiscard]] payload_format
+metadata::format () const noexcept
 {
-  std::vector<std::byte> bytes (this->size ());
+  return this->format_;
+}
+
+[[nodiscard]] cipher_id
+metadata::cipher () const noexcept
+{
+  return this->cipher_;
+}
+
+[[nodiscard]] layout_id
+metadata::layout () const noexcept
+{
+  return this->layout_;
+}
+
+[[nodiscard]] bool
+metadata::legacy () const noexcept
+{
+  return this->legacy_;
+}
+
+[[nodiscard]] std::pmr::vector<std::byte>
+metadata::to_vec (std::pmr::memory_resource *resource) const noexcept
+{
+  std::pmr::vector<std::byte> bytes (this->size (), resource);
 
   std::size_t pos = 0;
 
@@ -134,13 +229,35 @@ metadata::to_vec () const noexcept
   std::memcpy (bytes.data () + pos, &this->file_size_, sizeof (std::size_t));
   pos += sizeof (std::size_t);
 
-  std::memcpy (bytes.data () + pos, &this->checksum_, sizeof (std::size_t));
-  pos += sizeof (std::size_t);
+  // metadata of old videos is written back the way it was read
+  if (this->legacy_)
+    {
+      std::memcpy (bytes.data () + pos, &this->legacy_checksum_,
+                   sizeof (std::size_t));
+      pos += sizeof (std::size_t);
+    }
+  else
+    {
+      std::memcpy (bytes.data () + pos, this->checksum_.data (),
+                   this->checksum_.size ());
+      pos += this->checksum_.size ();
+    }
 
   std::memcpy (bytes.data () + pos, &this->fps_, sizeof (std::size_t));
   pos += sizeof (std::size_t);
 
   std::memcpy (bytes.data () + pos, &this->res_, sizeof (resolution));
+  pos += sizeof (resolution);
+  if (this->legacy_)
+    {
+      return bytes;
+    }
+
+  const std::size_t format_field
+      = static_cast<std::size_t> (this->format_)
+        | static_cast<std::size_t> (this->cipher_) << 8
+        | static_cast<std::size_t> (this->layout_) << 16;
+  std::memcpy (bytes.data () + pos, &format_field, sizeof (std::size_t));
 
   return bytes;
 }
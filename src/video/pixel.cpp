@@ -1,55 +1,128 @@
 #include <video/pixel.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cstdlib>
 
 namespace ftv
 {
 
-[[nodiscard]] std::vector<pixel>
-bytes_to_pixels (std::span<const std::byte> bytes) noexcept
+namespace
 {
-  std::vector<pixel> pixels;
-  pixels.reserve (bytes.size () * 8); // Each byte becomes 8 pixels
-  for (const auto &byte : bytes)
+
+// the pixels of every byte value, built at compile time
+template <pixel_layout L>
+[[nodiscard]] consteval auto
+make_byte_pixels () noexcept
+{
+  constexpr std::size_t symbols = L.symbols_per_byte ();
+  std::array<std::array<pixel, symbols>, 256> table{};
+  for (unsigned value = 0; value < table.size (); ++value)
     {
-      const auto value = std::to_integer<std::uint8_t> (byte);
-      // Convert each bit to a pixel
-      for (int bit = 7; bit >= 0; --bit) // MSB first
+      for (std::size_t symbol = 0; symbol < symbols; ++symbol)
         {
-          uint8_t pixel_val
-              = ((value >> bit) & 1) ? 255 : 0; // White for 1, black for 0
-          pixels.push_back ({
-              pixel_val, // R
-              pixel_val, // G
-              pixel_val  // B
-          });
+          const std::uint8_t level
+              = L.level ((value >> (8 - (symbol + 1) * L.bits_per_symbol))
+                         & L.symbol_mask ());
+          table[value][symbol]
+              = { level, L.channels > 1 ? level : std::uint8_t{},
+                  L.channels > 2 ? level : std::uint8_t{} };
         }
     }
-  return pixels;
+  return table;
+}
+
+template <pixel_layout L>
+inline constexpr auto BYTE_PIXELS{ make_byte_pixels<L> () };
+
+// appends the L.symbols_per_byte () pixels of every byte
+template <pixel_layout L>
+void
+append_kernel (std::span<const std::byte> bytes,
+               std::pmr::vector<pixel> &pixels)
+{
+  pixels.reserve (pixels.size () + bytes.size () * L.symbols_per_byte ());
+  for (const auto &byte : bytes)
+    {
+      const auto &run = BYTE_PIXELS<L>[std::to_integer<std::size_t> (byte)];
+      pixels.insert (pixels.end (), run.begin (), run.end ());
+    }
+}
+
+// the symbol of px, the nearest level of its brightest channel
+template <pixel_layout L>
+[[nodiscard]] unsigned
+symbol_of (const pixel &px) noexcept
+{
+  const unsigned brightest = std::max ({ px.r, px.g, px.b });
+  return (brightest * L.symbol_mask () + 127) / 255;
 }
 
-[[nodiscard]] std::vector<std::byte>
-pixels_to_bytes (std::span<const pixel> pixels) noexcept
+template <pixel_layout L>
+[[nodiscard]] std::pmr::vector<std::byte>
+pack_kernel (std::span<const pixel> pixels,
+             std::pmr::memory_resource *resource)
 {
-  std::vector<std::byte> bytes;
-  bytes.reserve ((pixels.size () + 7) / 8); // Round up division
+  constexpr std::size_t symbols = L.symbols_per_byte ();
+  std::pmr::vector<std::byte> bytes{ resource };
+  bytes.reserve ((pixels.size () + symbols - 1) / symbols);
 
-  for (size_t i = 0; i < pixels.size (); i += 8)
+  std::size_t i = 0;
+  for (; i + symbols <= pixels.size (); i += symbols)
     {
-      uint8_t byte_val = 0;
-      // Reconstruct byte from 8 pixels
-      for (size_t bit = 0; bit < 8 && (i + bit) < pixels.size (); ++bit)
+      unsigned value = 0;
+      unrolled<symbols> ([&] (auto symbol) {
+        value = (value << L.bits_per_symbol)
+                | symbol_of<L> (pixels[i + symbol]);
+      });
+      bytes.push_back (std::byte (value));
+    }
+  // a short last byte is padded with zeros
+  if (i < pixels.size ())
+    {
+      unsigned value = 0;
+      for (std::size_t symbol = 0; symbol < symbols; ++symbol)
         {
-          // Consider pixel white (1) if any channel is closer to 255 than to 0
-          if ((pixels[i + bit].r > 127) || (pixels[i + bit].g > 127)
-              || (pixels[i + bit].b > 127))
+          value <<= L.bits_per_symbol;
+          if (i + symbol < pixels.size ())
             {
-              byte_val |= (1 << (7 - bit)); // MSB first
+              value |= symbol_of<L> (pixels[i + symbol]);
             }
         }
-      bytes.push_back (std::byte (byte_val));
+      bytes.push_back (std::byte (value));
     }
   return bytes;
 }
 
+} // namespace
+
+[[nodiscard]] std::pmr::vector<pixel>
+bytes_to_pixels (std::span<const std::byte> bytes,
+                 std::pmr::memory_resource *resource,
+                 layout_id layout) noexcept
+{
+  std::pmr::vector<pixel> pixels{ resource };
+  append_pixels (bytes, pixels, layout);
+  return pixels;
+}
+
+void
+append_pixels (std::span<const std::byte> bytes,
+               std::pmr::vector<pixel> &pixels, layout_id layout)
+{
+  with_layout (layout, [&]<pixel_layout L> () {
+    append_kernel<L> (bytes, pixels);
+  });
+}
+
+[[nodiscard]] std::pmr::vector<std::byte>
+pixels_to_bytes (std::span<const pixel> pixels,
+                 std::pmr::memory_resource *resource,
+                 layout_id layout) noexcept
+{
+  return with_layout (layout, [&]<pixel_layout L> () {
+    return pack_kernel<L> (pixels, resource);
+  });
+}
+
 } // namespace ftv
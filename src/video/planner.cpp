@@ -0,0 +1,53 @@
+#include "video/planner.hpp"
+#include "video/frame_header.hpp"
+
+namespace ftv
+{
+
+[[nodiscard]] geometry_plan
+evaluate_geometry (std::size_t bytes, const resolution &res,
+                   std::size_t fps) noexcept
+{
+  geometry_plan plan{};
+  plan.res = res;
+  plan.fps = fps;
+  plan.bytes = bytes;
+  // one bit per pixel below the calibration strip and the frame header
+  const std::size_t bytes_per_frame = frame_payload_size (res);
+  if (bytes_per_frame == 0 || fps == 0)
+    {
+      return plan;
+    }
+
+  plan.frames = (bytes + bytes_per_frame - 1) / bytes_per_frame;
+  plan.padding = plan.frames * bytes_per_frame - bytes;
+
+  plan.encode_nanos
+      = plan.frames * (PLAN_FRAME_NANOS + res.x * res.y * PLAN_PIXEL_NANOS);
+  plan.duration_seconds
+      = static_cast<double> (plan.frames) / static_cast<double> (fps);
+  return plan;
+}
+
+[[nodiscard]] geometry_plan
+plan_geometry (std::size_t bytes, std::size_t fps) noexcept
+{
+  geometry_plan best = evaluate_geometry (
+      bytes, { PLAN_MIN_SIDE, PLAN_MIN_SIDE }, fps);
+  for (std::size_t x = PLAN_MIN_SIDE; x <= PLAN_MAX_SIDE; x += PLAN_STEP)
+    {
+      for (std::size_t y = PLAN_MIN_SIDE; y <= PLAN_MAX_SIDE; y += PLAN_STEP)
+        {
+          const auto plan = evaluate_geometry (bytes, { x, y }, fps);
+          if (plan.encode_nanos < best.encode_nanos
+              || (plan.encode_nanos == best.encode_nanos
+                  && plan.padding < best.padding))
+            {
+              best = plan;
+            }
+        }
+    }
+  return best;
+}
+
+} // namespace ftv
@@ -1,41 +1,103 @@
 #include <cstddef>
 
+#include "crypto/checksum.hpp"
+#include "video/calibration.hpp"
+#include "video/erasure.hpp"
+#include "video/frame_header.hpp"
+#include "video/frame_pool.hpp"
 #include "video/pixel.hpp"
 #include "video/video.hpp"
 #include "video/video_io.hpp"
 
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <variant>
+
 #include <opencv2/opencv.hpp>
 
 namespace ftv
 {
 
-video::video (const std::filesystem::path &path, const metadata &meta)
-    : metadata_{ meta }, path_{ path }
+namespace
+{
+
+// the checksum of videos from before the calibration strip
+[[nodiscard]] std::size_t
+legacy_checksum (std::span<const std::byte> data)
+{
+  return std::hash<std::string_view>{}(std::string_view (
+      reinterpret_cast<const char *> (data.data ()), data.size ()));
+}
+
+// count bytes from bit start_pos of a frame from before the calibration
+// strip, where a pixel with any channel above 127 is white
+[[nodiscard]] std::vector<std::byte>
+read_legacy_bytes (const cv::Mat &frame, std::size_t start_pos,
+                   std::size_t count)
+{
+  const std::size_t pixels_per_row = static_cast<std::size_t> (frame.cols);
+  if (count > frame.total () / 8 || start_pos > frame.total () - count * 8)
+    {
+      throw std::runtime_error (
+          std::format ("metadata of {} bytes does not fit in a frame", count));
+    }
+
+  std::vector<std::byte> bytes;
+  bytes.reserve (count);
+  for (std::size_t i = 0; i < count * 8; i += 8)
+    {
+      std::uint8_t byte_val = 0;
+      for (std::size_t bit = 0; bit < 8; ++bit)
+        {
+          const std::size_t pos = start_pos + i + bit;
+          const cv::Vec3b &px = frame.at<cv::Vec3b> (
+              static_cast<int> (pos / pixels_per_row),
+              static_cast<int> (pos % pixels_per_row));
+          if (px[0] > 127 || px[1] > 127 || px[2] > 127)
+            {
+              byte_val |= static_cast<std::uint8_t> (1 << (7 - bit));
+            }
+        }
+      bytes.push_back (std::byte{ byte_val });
+    }
+  return bytes;
+}
+
+} // namespace
+
+video::video (const std::filesystem::path &path, const metadata &meta,
+              std::pmr::memory_resource *resource)
+    : metadata_{ meta }, path_{ path }, resource_{ resource }
 {
 }
 
-video::video (const std::filesystem::path &path) : metadata_{}, path_ (path)
+video::video (const std::filesystem::path &path,
+              std::pmr::memory_resource *resource)
+    : metadata_{}, path_ (path), resource_{ resource }
 {
   init_metadata ();
 }
 
 [[nodiscard]] std::error_code
-video::write (std::span<const pixel> pixels) const noexcept
+video::write_stream (
+    std::span<const std::span<const std::byte>> stream) const noexcept
 {
   if (this->metadata_.size () == 0)
     {
       return std::make_error_code (std::errc::invalid_argument);
     }
 
-  if (this->metadata_.res ().x * this->metadata_.res ().y
-      > this->metadata_.res ().x * this->metadata_.res ().y)
+  // every frame needs room for the calibration strip, its header and some
+  // data
+  const std::size_t payload_size = frame_payload_size (this->metadata_.res ());
+  if (payload_size == 0 || !this->erasure_.valid ())
     {
-      return std::make_error_code (std::errc::value_too_large);
+      return std::make_error_code (std::errc::invalid_argument);
     }
 
-  const std::size_t pixels_per_frame
-      = this->metadata_.res ().x * this->metadata_.res ().y;
-
   video_writer writer{ path_ };
   writer.get ().set (cv::VIDEOWRITER_PROP_QUALITY, 100);
 
@@ -50,138 +112,410 @@ video::write (std::span<const pixel> pixels) const noexcept
       return std::make_error_code (std::errc::io_error);
     }
 
-  for (std::size_t offset = 0; offset < pixels.size ();
-       offset += pixels_per_frame)
+  std::unique_ptr<frame_pool> pool;
+  std::optional<parity_encoder> parity;
+  std::pmr::vector<std::byte> payload{ this->resource_ };
+  try
     {
-      cv::Mat frame (static_cast<std::int32_t> (this->metadata_.res ().y),
-                     static_cast<std::int32_t> (this->metadata_.res ().x),
-                     CV_8UC3);
-
-      const size_t pixels_to_copy
-          = std::min (pixels_per_frame, pixels.size () - offset);
-
-      const std::int32_t last_row = static_cast<std::int32_t> (
-          pixels_to_copy / static_cast<std::size_t> (frame.cols));
-
-      const std::int32_t last_col = static_cast<std::int32_t> (
-          pixels_to_copy % static_cast<std::size_t> (frame.cols));
+      pool = std::make_unique<frame_pool> (this->metadata_.res ().y,
+                                           this->metadata_.res ().x);
+      parity.emplace (this->erasure_, payload_size);
+      payload.resize (payload_size);
+    }
+  catch (const std::exception &)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
 
-      size_t pixel_idx = 0;
-      for (std::int32_t y = 0; y < last_row; ++y)
+  // frames are rendered here while the encoder thread writes the previous
+  // ones, running out of free frames holds the renderer back
+  frame_ring free_frames;
+  frame_ring rendered_frames;
+  pool->fill (free_frames);
+
+  std::jthread encoder{ [&] {
+    for (frame_index index = rendered_frames.pop (); index != FRAME_END;
+         index = rendered_frames.pop ())
+      {
+        writer.get ().write ((*pool)[index]);
+        free_frames.push (index);
+      }
+  } };
+
+  // parity frames go into free frames as well, right after their group
+  const auto render_parity = [&] {
+    for (std::size_t i = 0; i < parity->parity_frames (); ++i)
+      {
+        const frame_index index = free_frames.pop ();
+        parity->render ((*pool)[index], i);
+        rendered_frames.push (index);
+      }
+  };
+
+  // the stream is cut into frames as it is gathered, one frame's payload
+  // at a time, so memory does not grow with the stream
+  std::uint32_t sequence = 0;
+  std::uint64_t offset = 0;
+  std::size_t segment = 0;
+  std::size_t position = 0;
+  for (;;)
+    {
+      std::size_t filled = 0;
+      while (filled < payload_size && segment < stream.size ())
         {
-          for (std::int32_t x = 0; x < frame.cols; ++x)
+          const auto rest = stream[segment].subspan (position);
+          const std::size_t take = std::min (payload_size - filled,
+                                             rest.size ());
+          std::memcpy (payload.data () + filled, rest.data (), take);
+          filled += take;
+          position += take;
+          if (position == stream[segment].size ())
             {
-              const auto &pix = pixels[offset + pixel_idx++];
-              uint8_t pixel_val = (pix.b != 0) ? 255 : 0; // Black or white
-              frame.at<cv::Vec3b> (y, x)
-                  = cv::Vec3b (pixel_val, pixel_val, pixel_val);
+              ++segment;
+              position = 0;
             }
         }
-      // fill partial row if needed
-      for (std::int32_t x = 0; x < last_col; ++x)
+      if (filled == 0)
         {
-          const auto &pix = pixels[offset + pixel_idx++];
-          uint8_t pixel_val = (pix.b != 0) ? 255 : 0;
-          frame.at<cv::Vec3b> (last_row, x)
-              = cv::Vec3b (pixel_val, pixel_val, pixel_val);
+          break;
         }
-      // fill remaining pixels with black (if needed)
-      if (pixels_to_copy < pixels_per_frame)
+
+      const frame_index index = free_frames.pop ();
+      const auto piece = std::span<const std::byte> (payload).first (filled);
+      render_frame ((*pool)[index], sequence, offset, piece);
+      rendered_frames.push (index);
+      if (this->erasure_.enabled () && parity->add (sequence, piece))
         {
-          // fill rest of the last row
-          for (std::int32_t x = last_col; x < frame.cols; ++x)
-            {
-              frame.at<cv::Vec3b> (last_row, x) = cv::Vec3b (0, 0, 0);
-            }
-          // fill remaining rows
-          for (std::int32_t y = last_row + 1; y < frame.rows; ++y)
-            {
-              for (std::int32_t x = 0; x < frame.cols; ++x)
-                {
-                  frame.at<cv::Vec3b> (y, x) = cv::Vec3b (0, 0, 0);
-                }
-            }
+          render_parity ();
         }
-      writer.get ().write (frame);
+      ++sequence;
+      offset += filled;
+    }
+  if (this->erasure_.enabled () && parity->finish ())
+    {
+      render_parity ();
     }
+
+  rendered_frames.push (FRAME_END);
+  encoder.join ();
   return {};
 }
 
 [[nodiscard]] std::error_code
-video::write (std::span<const std::byte> bytes) const noexcept
+video::write (std::span<const pixel> pixels) const noexcept
 {
-  const auto metadata_vec = this->metadata_.to_vec ();
-  const auto metadata_pixels = bytes_to_pixels (metadata_vec);
-
-  std::vector<pixel> all_pixels;
-  all_pixels.reserve (metadata_pixels.size () + bytes.size ());
-  all_pixels.insert (all_pixels.end (), metadata_pixels.begin (),
-                     metadata_pixels.end ());
+  // whole bytes, a short last byte is padded with zeros
+  std::pmr::vector<std::byte> bytes{ this->resource_ };
+  try
+    {
+      bytes = pixels_to_bytes (pixels, this->resource_,
+                               layout_of (this->metadata_));
+    }
+  catch (const std::exception &)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
+  const std::span<const std::byte> stream[]{ bytes };
+  return write_stream (stream);
+}
 
-  const auto data_pixels = bytes_to_pixels (bytes);
-  all_pixels.insert (all_pixels.end (), data_pixels.begin (),
-                     data_pixels.end ());
+[[nodiscard]] std::error_code
+video::write (std::span<const std::byte> bytes) const noexcept
+{
+  const std::span<const std::byte> segments[]{ bytes };
+  return write (segments);
+}
 
-  return write (all_pixels);
+[[nodiscard]] std::error_code
+video::write (
+    std::span<const std::span<const std::byte>> segments) const noexcept
+{
+  // the metadata goes first, the segments follow without being gathered
+  std::pmr::vector<std::byte> metadata_vec{ this->resource_ };
+  std::pmr::vector<std::span<const std::byte>> stream{ this->resource_ };
+  try
+    {
+      metadata_vec = this->metadata_.to_vec (this->resource_);
+      stream.reserve (segments.size () + 1);
+      stream.emplace_back (metadata_vec);
+      stream.insert (stream.end (), segments.begin (), segments.end ());
+    }
+  catch (const std::exception &)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
+  return write_stream (stream);
 }
 
-[[nodiscard]] std::expected<std::vector<pixel>, std::error_code>
+[[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
 video::read () noexcept
 {
+  this->failed_frame_.reset ();
   video_reader reader{ path_.string () };
-  cv::Mat frame{};
-  if (!reader.get ().read (frame) || frame.empty ())
+
+  std::unique_ptr<frame_pool> pool;
+  try
     {
-      return std::expected<std::vector<pixel>, std::error_code>{
-        std::unexpected (std::make_error_code (std::errc::io_error))
-      };
+      pool = std::make_unique<frame_pool> (this->metadata_.res ().y,
+                                           this->metadata_.res ().x);
     }
+  catch (const std::exception &)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory));
+    }
+
+  // the capture thread decodes frames into free pool frames while the
+  // previous ones are extracted here. a frame of another size than the
+  // metadata says is reallocated by opencv and still works
+  frame_ring free_frames;
+  frame_ring captured_frames;
+  pool->fill (free_frames);
+
+  std::jthread capture{ [&] {
+    for (frame_index index = free_frames.pop (); index != FRAME_END;
+         index = free_frames.pop ())
+      {
+        cv::Mat &next = (*pool)[index];
+        if (!reader.get ().read (next) || next.empty ())
+          {
+            captured_frames.push (FRAME_END);
+            return;
+          }
+        captured_frames.push (index);
+      }
+  } };
+
+  auto result = extract_pixels (*pool, free_frames, captured_frames);
+
+  // stops the capture thread, it may be waiting for a free frame
+  free_frames.push (FRAME_END);
+  capture.join ();
+  return result;
+}
 
-  std::vector<pixel> pixel_data;
+[[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
+video::extract_pixels (frame_pool &pool, frame_ring &free_frames,
+                       frame_ring &captured_frames)
+{
+  frame_index index = captured_frames.pop ();
+  if (index == FRAME_END)
+    {
+      return std::unexpected (std::make_error_code (std::errc::io_error));
+    }
+  if (this->metadata_.legacy ())
+    {
+      return extract_legacy (pool, free_frames, captured_frames, index);
+    }
+  const cv::Mat *frame = &pool[index];
+  if (has_any_header (*frame))
+    {
+      return extract_framed (pool, free_frames, captured_frames, index);
+    }
+
+  std::pmr::vector<pixel> pixel_data{ this->resource_ };
   pixel_data.reserve (this->metadata_.file_size () * 8);
   const std::size_t metadata_bits = this->metadata_.size () * 8;
-  std::size_t row = metadata_bits / static_cast<std::size_t> (frame.cols);
-  std::size_t col = metadata_bits % static_cast<std::size_t> (frame.cols);
+  std::size_t row = CALIBRATION_ROWS
+                    + metadata_bits / static_cast<std::size_t> (frame->cols);
+  std::size_t col = metadata_bits % static_cast<std::size_t> (frame->cols);
+  std::uint8_t threshold = calibrate (*frame).threshold;
 
   std::size_t pixels_read = 0;
   const std::size_t expected_pixels = this->metadata_.file_size () * 8;
 
   while (pixels_read < expected_pixels)
     {
-      if (row >= static_cast<std::size_t> (frame.rows))
+      if (row >= static_cast<std::size_t> (frame->rows))
         {
-          if (!reader.get ().read (frame) || frame.empty ())
+          free_frames.push (index);
+          index = captured_frames.pop ();
+          if (index == FRAME_END)
             {
               return std::unexpected (
                   std::make_error_code (std::errc::result_out_of_range));
             }
-          row = 0;
+          frame = &pool[index];
+          threshold = calibrate (*frame).threshold;
+          row = CALIBRATION_ROWS;
           col = 0;
           continue;
         }
 
-      if (col >= static_cast<std::size_t> (frame.cols))
+      if (col >= static_cast<std::size_t> (frame->cols))
         {
           row++;
           col = 0;
           continue;
         }
 
-      const cv::Vec3b &px = frame.at<cv::Vec3b> (static_cast<int> (row),
-                                                 static_cast<int> (col));
-      std::int8_t white_votes = 0;
-      white_votes += (px[0] >= 128); // B channel
-      white_votes += (px[1] >= 128); // G channel
-      white_votes += (px[2] >= 128); // R channel
-      pixel new_px{ static_cast<std::uint8_t> (white_votes >= 2 ? 255u : 0u),
-                    static_cast<std::uint8_t> (white_votes >= 2 ? 255u : 0u),
-                    static_cast<std::uint8_t> (white_votes >= 2 ? 255u : 0u) };
-      pixel_data.push_back (new_px);
+      const cv::Vec3b &px = frame->at<cv::Vec3b> (static_cast<int> (row),
+                                                  static_cast<int> (col));
+      const auto value = static_cast<std::uint8_t> (
+          is_white (px, threshold) ? 255u : 0u);
+      pixel_data.push_back (pixel{ value, value, value });
       pixels_read++;
       col++;
     }
 
-  return std::expected<std::vector<pixel>, std::error_code>{ pixel_data };
+  // videos without frame headers are only read whole, so they are hashed
+  // whole as well. their frames hold a bit per pixel, the pixels handed out
+  // are in the layout of the video
+  const auto bytes = pixels_to_bytes (pixel_data, this->resource_);
+  if (!checksum_matches (bytes, this->metadata_.checksum ()))
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+  if (layout_of (this->metadata_) != layout_id::mono)
+    {
+      pixel_data = bytes_to_pixels (bytes, this->resource_,
+                                    layout_of (this->metadata_));
+    }
+
+  return std::expected<std::pmr::vector<pixel>, std::error_code>{
+    std::move (pixel_data)
+  };
+}
+
+[[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
+video::extract_framed (frame_pool &pool, frame_ring &free_frames,
+                       frame_ring &captured_frames, frame_index index)
+{
+  const auto layout = layout_of (this->metadata_);
+  const std::size_t expected_bytes = this->metadata_.file_size ();
+  std::size_t taken = 0;
+  std::pmr::vector<pixel> pixel_data{ this->resource_ };
+  with_layout (layout, [&]<pixel_layout L> () {
+    pixel_data.reserve (expected_bytes * L.symbols_per_byte ());
+  });
+
+  // repeated frames add nothing, dropped and damaged ones are rebuilt from
+  // their group if it has parity frames
+  frame_recovery recovery{};
+  std::size_t skip = this->metadata_.size ();
+  blake3_hasher checksum{ std::thread::hardware_concurrency () };
+
+  // a frame that fails is named by the gap it leaves, not by the frame
+  // that showed the gap
+  const auto failed = [&] (std::error_code ec) {
+    this->failed_frame_ = recovery.next_sequence ();
+    return std::unexpected (ec);
+  };
+
+  for (;;)
+    {
+      const auto added = recovery.add (pool[index]);
+      free_frames.push (index);
+      if (added)
+        {
+          return failed (added);
+        }
+      for (auto next = recovery.next ();; next = recovery.next ())
+        {
+          if (!next)
+            {
+              return failed (next.error ());
+            }
+          if (*next == nullptr)
+            {
+              break;
+            }
+          const std::span<const std::byte> bytes ((*next)->payload);
+          const std::size_t skipped = std::min (skip, bytes.size ());
+          skip -= skipped;
+          const auto payload = bytes.subspan (
+              skipped, std::min (bytes.size () - skipped,
+                                 expected_bytes - taken));
+          checksum.update (payload);
+          append_pixels (payload, pixel_data, layout);
+          taken += payload.size ();
+        }
+      if (taken >= expected_bytes)
+        {
+          break;
+        }
+
+      index = captured_frames.pop ();
+      if (index == FRAME_END)
+        {
+          // a gap at the end is a lost frame, not a short video. without
+          // one the frames after the last that arrived are missing
+          const auto ended = recovery.finish ();
+          return failed (
+              ended ? ended
+                    : std::make_error_code (std::errc::result_out_of_range));
+        }
+    }
+
+  if (checksum.digest () != this->metadata_.checksum ())
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+
+  return std::expected<std::pmr::vector<pixel>, std::error_code>{
+    std::move (pixel_data)
+  };
+}
+
+[[nodiscard]] std::expected<std::pmr::vector<pixel>, std::error_code>
+video::extract_legacy (frame_pool &pool, frame_ring &free_frames,
+                       frame_ring &captured_frames, frame_index index)
+{
+  const std::size_t expected_pixels = this->metadata_.file_size () * 8;
+  std::pmr::vector<pixel> pixel_data{ this->resource_ };
+  pixel_data.reserve (expected_pixels);
+
+  // the payload follows the metadata from the first pixel of the frame on,
+  // every frame is data
+  const cv::Mat *frame = &pool[index];
+  const std::size_t metadata_bits = this->metadata_.size () * 8;
+  std::size_t row = metadata_bits / static_cast<std::size_t> (frame->cols);
+  std::size_t col = metadata_bits % static_cast<std::size_t> (frame->cols);
+
+  while (pixel_data.size () < expected_pixels)
+    {
+      if (row >= static_cast<std::size_t> (frame->rows))
+        {
+          free_frames.push (index);
+          index = captured_frames.pop ();
+          if (index == FRAME_END)
+            {
+              return std::unexpected (
+                  std::make_error_code (std::errc::result_out_of_range));
+            }
+          frame = &pool[index];
+          row = 0;
+          col = 0;
+          continue;
+        }
+
+      if (col >= static_cast<std::size_t> (frame->cols))
+        {
+          row++;
+          col = 0;
+          continue;
+        }
+
+      // a majority of the channels decides, at a fixed threshold
+      const cv::Vec3b &px = frame->at<cv::Vec3b> (static_cast<int> (row),
+                                                  static_cast<int> (col));
+      const int white_votes = (px[0] >= 128) + (px[1] >= 128) + (px[2] >= 128);
+      const auto value
+          = static_cast<std::uint8_t> (white_votes >= 2 ? 255u : 0u);
+      pixel_data.push_back (pixel{ value, value, value });
+      col++;
+    }
+
+  if (legacy_checksum (pixels_to_bytes (pixel_data, this->resource_,
+                                        layout_of (this->metadata_)))
+      != this->metadata_.legacy_checksum ())
+    {
+      return std::unexpected (std::make_error_code (std::errc::bad_message));
+    }
+
+  return std::expected<std::pmr::vector<pixel>, std::error_code>{
+    std::move (pixel_data)
+  };
 }
 
 void
@@ -189,94 +523,164 @@ video::init_metadata ()
 {
   video_reader reader{ path_ };
   cv::Mat frame;
-  if (!reader.get ().read (frame) || frame.empty ()
-      || frame.type () != CV_8UC3)
+  if (!reader.get ().read (frame))
     {
       throw std::runtime_error (std::format ("failed to read first frame"));
     }
-  std::size_t pos = 0;
-  std::size_t filename_size = read_size_t (frame, pos);
-  pos += sizeof (std::size_t) * 8;
-  std::string filename = read_filename (frame, pos, filename_size);
-  pos += filename_size * 8;
-  std::size_t file_size = read_size_t (frame, pos);
-  pos += sizeof (std::size_t) * 8;
-  std::size_t checksum = read_size_t (frame, pos);
-  pos += sizeof (std::size_t) * 8;
-  std::size_t fps = read_size_t (frame, pos);
-  pos += sizeof (std::size_t) * 8;
-  auto x = read_size_t (frame, pos);
-  pos += sizeof (std::size_t) * 8;
-  auto y = read_size_t (frame, pos);
-  resolution res{ x, y };
-  metadata_ = metadata (filename, file_size, checksum, fps, res);
+  if (frame.empty () || frame.type () != CV_8UC3
+      || !has_any_header (frame))
+    {
+      metadata_ = parse_metadata (frame);
+      return;
+    }
+
+  // a first frame that was lost is rebuilt from the rest of its group
+  frame_recovery recovery{};
+  do
+    {
+      if (recovery.add (frame))
+        {
+          break;
+        }
+      const auto first = recovery.next ();
+      if (!first)
+        {
+          break;
+        }
+      if (*first != nullptr)
+        {
+          metadata_ = parse_metadata ((*first)->payload);
+          return;
+        }
+    }
+  while (reader.get ().read (frame) && !frame.empty ());
+  throw std::runtime_error (std::format ("corrupted first frame"));
 }
 
-[[nodiscard]] std::size_t
-video::read_size_t (const cv::Mat &frame, std::size_t start_pos) const
+[[nodiscard]] metadata
+video::parse_metadata (const cv::Mat &frame)
 {
-  const std::size_t pixels_per_row = static_cast<std::size_t> (frame.cols);
-  std::vector<std::byte> size_bytes (sizeof (std::size_t));
+  if (frame.empty () || frame.type () != CV_8UC3)
+    {
+      throw std::runtime_error (std::format ("failed to read first frame"));
+    }
 
-  for (std::size_t i = 0; i < sizeof (std::size_t) * 8; i += 8)
+  // with a frame header the metadata starts the first frame's payload
+  std::vector<std::byte> payload;
+  const auto read = read_any_frame (frame, payload);
+  if (read && std::holds_alternative<frame_header> (*read))
     {
-      uint8_t byte_val = 0;
-      for (std::size_t bit = 0; bit < 8; ++bit)
+      return parse_metadata (payload);
+    }
+  if (read || read.error () != std::errc::invalid_argument)
+    {
+      throw std::runtime_error (std::format ("corrupted first frame"));
+    }
+
+  // videos from before the calibration strip start their first row with
+  // the metadata, in the layout it had then
+  if (!has_calibration (frame))
+    {
+      const auto size_bytes
+          = read_legacy_bytes (frame, 0, sizeof (std::size_t));
+      std::size_t filename_size = 0;
+      std::memcpy (&filename_size, size_bytes.data (), sizeof (std::size_t));
+      if (filename_size > frame.total ())
         {
-          std::size_t pos = start_pos + i + bit;
-          std::size_t row = pos / pixels_per_row;
-          std::size_t col = pos % pixels_per_row;
+          throw std::runtime_error (
+              std::format ("invalid filename size: {}", filename_size));
+        }
+      return metadata::parse_legacy (read_legacy_bytes (
+          frame, 0, legacy_metadata_size (filename_size)));
+    }
 
-          cv::Vec3b bgr_px = frame.at<cv::Vec3b> (static_cast<int> (row),
-                                                  static_cast<int> (col));
+  // the filename size decides how much of the frame the metadata covers
+  const auto threshold = calibrate (frame).threshold;
+  const auto size_bytes = read_bytes (frame, 0, sizeof (std::size_t),
+                                      threshold);
+  std::size_t filename_size = 0;
+  std::memcpy (&filename_size, size_bytes.data (), sizeof (std::size_t));
+  if (filename_size > frame.total ())
+    {
+      throw std::runtime_error (
+          std::format ("invalid filename size: {}", filename_size));
+    }
 
-          bool is_white
-              = (bgr_px[0] > 127) || (bgr_px[1] > 127) || (bgr_px[2] > 127);
-          if (is_white)
-            {
-              byte_val |= (1 << (7 - bit));
-            }
-        }
-      size_bytes.at (i / 8) = std::byte (byte_val);
+  const metadata parsed{ read_bytes (frame, 0, metadata_size (filename_size),
+                                     threshold) };
+  return metadata (parsed.filename (), parsed.file_size (),
+                   parsed.checksum (), parsed.fps (), parsed.res (),
+                   parsed.format (), parsed.cipher (), parsed.layout ());
+}
+
+[[nodiscard]] metadata
+video::parse_metadata (std::span<const std::byte> payload)
+{
+  std::size_t filename_size = 0;
+  if (payload.size () < sizeof (std::size_t))
+    {
+      throw std::runtime_error (std::format (
+          "metadata of {} bytes does not fit in a frame",
+          sizeof (std::size_t)));
+    }
+  std::memcpy (&filename_size, payload.data (), sizeof (std::size_t));
+  if (filename_size > payload.size ()
+      || metadata_size (filename_size) > payload.size ())
+    {
+      throw std::runtime_error (
+          std::format ("invalid filename size: {}", filename_size));
     }
 
-  std::size_t result = 0;
-  std::memcpy (&result, size_bytes.data (), sizeof (std::size_t));
-  return result;
+  const metadata parsed{ payload.first (metadata_size (filename_size)) };
+  return metadata (parsed.filename (), parsed.file_size (),
+                   parsed.checksum (), parsed.fps (), parsed.res (),
+                   parsed.format (), parsed.cipher (), parsed.layout ());
 }
 
-[[nodiscard]] std::string
-video::read_filename (const cv::Mat &frame, std::size_t start_pos,
-                      std::size_t filename_size) const
+void
+video::set_erasure (const erasure_params &erasure) noexcept
+{
+  this->erasure_ = erasure;
+}
+
+[[nodiscard]] std::vector<std::byte>
+video::read_bytes (const cv::Mat &frame, std::size_t start_pos,
+                   std::size_t count, std::uint8_t threshold)
 {
   const std::size_t pixels_per_row = static_cast<std::size_t> (frame.cols);
-  std::vector<std::byte> filename_bytes;
-  filename_bytes.reserve (filename_size);
+  const std::size_t data_pixels
+      = pixels_per_row
+        * (static_cast<std::size_t> (frame.rows) - CALIBRATION_ROWS);
+  if (count > data_pixels / 8 || start_pos > data_pixels - count * 8)
+    {
+      throw std::runtime_error (
+          std::format ("metadata of {} bytes does not fit in a frame", count));
+    }
 
-  for (std::size_t i = 0; i < filename_size * 8; i += 8)
+  std::vector<std::byte> bytes;
+  bytes.reserve (count);
+
+  for (std::size_t i = 0; i < count * 8; i += 8)
     {
       uint8_t byte_val = 0;
-      for (size_t bit = 0; bit < 8; ++bit)
+      for (std::size_t bit = 0; bit < 8; ++bit)
         {
           std::size_t pos = start_pos + i + bit;
-          std::size_t row = pos / pixels_per_row;
+          std::size_t row = CALIBRATION_ROWS + pos / pixels_per_row;
           std::size_t col = pos % pixels_per_row;
 
           cv::Vec3b bgr_px = frame.at<cv::Vec3b> (static_cast<int> (row),
                                                   static_cast<int> (col));
 
-          bool is_white
-              = (bgr_px[0] > 127) || (bgr_px[1] > 127) || (bgr_px[2] > 127);
-          if (is_white)
+          if (is_white (bgr_px, threshold))
             {
               byte_val |= (1 << (7 - bit));
             }
         }
-      filename_bytes.push_back (std::byte (byte_val));
+      bytes.push_back (std::byte (byte_val));
     }
 
-  return std::string (reinterpret_cast<const char *> (filename_bytes.data ()),
-                      filename_bytes.size ());
+  return bytes;
 }
 
 [[nodiscard]] metadata
@@ -285,6 +689,12 @@ video::get_metadata () const noexcept
   return this->metadata_;
 }
 
+[[nodiscard]] std::optional<std::uint32_t>
+video::failed_frame () const noexcept
+{
+  return this->failed_frame_;
+}
+
 [[nodiscard]] std::filesystem::path
 video::get_path () const noexcept
 {
@@ -0,0 +1,415 @@
+#include "youtube/client.hpp"
+#include "file/async_io.hpp"
+#include "file/file.hpp"
+#include "youtube/http.hpp"
+
+#include <charconv>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace ftv
+{
+
+namespace
+{
+
+// percent encodes value for a form body
+[[nodiscard]] std::string
+form_encode (std::string_view value)
+{
+  constexpr std::string_view hex = "0123456789ABCDEF";
+  std::string encoded;
+  encoded.reserve (value.size ());
+  for (const char c : value)
+    {
+      const auto byte = static_cast<unsigned char> (c);
+      if ((byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')
+          || (byte >= '0' && byte <= '9') || c == '-' || c == '.' || c == '_'
+          || c == '~')
+        {
+          encoded += c;
+          continue;
+        }
+      encoded += '%';
+      encoded += hex[byte >> 4];
+      encoded += hex[byte & 0xf];
+    }
+  return encoded;
+}
+
+// the offset after what a session holds, from its range header
+[[nodiscard]] std::uint64_t
+range_end (std::string_view range) noexcept
+{
+  const auto dash = range.rfind ('-');
+  if (dash == std::string_view::npos)
+    {
+      return 0;
+    }
+  std::uint64_t last = 0;
+  const auto [end, ec]
+      = std::from_chars (range.data () + dash + 1,
+                         range.data () + range.size (), last);
+  return ec == std::errc{} ? last + 1 : 0;
+}
+
+[[nodiscard]] std::expected<std::string, std::error_code>
+video_id (const http_response &response) noexcept
+{
+  try
+    {
+      return nlohmann::json::parse (response.body)
+          .at ("id")
+          .get<std::string> ();
+    }
+  catch (...)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::protocol_error));
+    }
+}
+
+} // namespace
+
+youtube_client::youtube_client (std::string client_id,
+                                std::string client_secret,
+                                youtube_endpoints endpoints)
+    : client_id_{ std::move (client_id) },
+      client_secret_{ std::move (client_secret) },
+      endpoints_{ std::move (endpoints) }, access_token_{}
+{
+}
+
+youtube_client::youtube_client (youtube_client &&) noexcept = default;
+youtube_client &
+youtube_client::operator= (youtube_client &&) noexcept = default;
+
+youtube_client::~youtube_client () = default;
+
+[[nodiscard]] std::error_code
+youtube_client::authorize (std::string_view refresh_token) noexcept
+{
+  try
+    {
+      const std::string form
+          = "client_id=" + form_encode (this->client_id_)
+            + "&client_secret=" + form_encode (this->client_secret_)
+            + "&refresh_token=" + form_encode (refresh_token)
+            + "&grant_type=refresh_token";
+
+      http_request request{};
+      request.method = "POST";
+      request.url = this->endpoints_.token;
+      request.headers = { "Content-Type: application/x-www-form-urlencoded" };
+      request.body = std::as_bytes (std::span{ form });
+
+      const auto response = http_perform (request);
+      if (!response)
+        {
+          return response.error ();
+        }
+      if (response->status != 200)
+        {
+          return http_status_error (response->status);
+        }
+      this->access_token_ = nlohmann::json::parse (response->body)
+                                .at ("access_token")
+                                .get<std::string> ();
+      return {};
+    }
+  catch (const std::bad_alloc &)
+    {
+      return std::make_error_code (std::errc::not_enough_memory);
+    }
+  catch (...)
+    {
+      return std::make_error_code (std::errc::protocol_error);
+    }
+}
+
+[[nodiscard]] std::expected<std::string, std::error_code>
+youtube_client::upload (const std::filesystem::path &path,
+                        std::string_view title, std::string_view description,
+                        std::string_view privacy) const noexcept
+{
+  try
+    {
+      async_file file{ path, io_mode::read, 1 };
+      const upload_source source
+          = [&file] (std::uint64_t offset, std::span<std::byte> buffer)
+          -> std::expected<std::size_t, std::error_code> {
+        if (const auto ec = file.submit_read (buffer, offset, 0))
+          {
+            return std::unexpected (ec);
+          }
+        const auto done = file.wait ();
+        if (!done)
+          {
+            return std::unexpected (done.error ());
+          }
+        if (done->error)
+          {
+            return std::unexpected (done->error);
+          }
+        return done->bytes;
+      };
+      return upload (source, std::filesystem::file_size (path), title,
+                     description, privacy);
+    }
+  catch (const std::system_error &e)
+    {
+      return std::unexpected (e.code ());
+    }
+  catch (...)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory));
+    }
+}
+
+[[nodiscard]] std::expected<std::string, std::error_code>
+youtube_client::upload (const upload_source &source,
+                        std::optional<std::uint64_t> size,
+                        std::string_view title, std::string_view description,
+                        std::string_view privacy) const noexcept
+{
+  try
+    {
+      const std::string authorization = "Authorization: Bearer "
+                                         + this->access_token_;
+      const std::string resource
+          = nlohmann::json{
+              { "snippet",
+                { { "title", title }, { "description", description } } },
+              { "status", { { "privacyStatus", privacy } } }
+            }.dump ();
+
+      // one byte past the chunk tells whether the chunk is the last one
+      std::vector<std::byte> buffer (UPLOAD_CHUNK_SIZE + 1);
+      std::string session{};
+      std::uint64_t offset = 0;
+      bool query = false; // the session's offset is unknown after a failure
+      std::size_t failures = 0;
+
+      const auto back_off = [&failures] (std::error_code ec) {
+        if (++failures > UPLOAD_MAX_RETRIES)
+          {
+            throw std::system_error (ec);
+          }
+        std::this_thread::sleep_for (UPLOAD_RETRY_DELAY
+                                     * (1u << (failures - 1)));
+      };
+      // takes over what the server says it holds, a lack of progress
+      // counts as a failure
+      const auto resume_from = [&] (const http_response &response) {
+        const std::uint64_t next = range_end (response.range);
+        if (next <= offset && !query)
+          {
+            back_off (std::make_error_code (std::errc::protocol_error));
+          }
+        else if (next > offset)
+          {
+            failures = 0;
+          }
+        offset = next;
+        query = false;
+      };
+      const auto total = [&size] {
+        return size ? std::to_string (*size) : std::string{ "*" };
+      };
+
+      for (;;)
+        {
+          http_request request{};
+          request.headers = { authorization };
+
+          if (session.empty ())
+            {
+              request.method = "POST";
+              request.url = this->endpoints_.api
+                            + "/upload/youtube/v3/videos"
+                              "?uploadType=resumable&part=snippet,status";
+              request.headers.emplace_back (
+                  "Content-Type: application/json; charset=UTF-8");
+              request.headers.emplace_back ("X-Upload-Content-Type: video/*");
+              if (size)
+                {
+                  request.headers.push_back ("X-Upload-Content-Length: "
+                                             + total ());
+                }
+              request.body = std::as_bytes (std::span{ resource });
+
+              const auto response = http_perform (request);
+              if (response && response->status == 200
+                  && !response->location.empty ())
+                {
+                  session = response->location;
+                  offset = 0;
+                  query = false;
+                  continue;
+                }
+              if (response && !http_retryable (response->status))
+                {
+                  return std::unexpected (
+                      http_status_error (response->status));
+                }
+              back_off (response ? http_status_error (response->status)
+                                 : response.error ());
+              continue;
+            }
+
+          request.method = "PUT";
+          request.url = session;
+          std::size_t length = 0;
+          if (query)
+            {
+              request.headers.push_back ("Content-Range: bytes */"
+                                         + total ());
+            }
+          else
+            {
+              const auto read = source (offset, buffer);
+              if (!read)
+                {
+                  return std::unexpected (read.error ());
+                }
+              length = std::min (*read, UPLOAD_CHUNK_SIZE);
+              if (*read <= UPLOAD_CHUNK_SIZE)
+                {
+                  size = offset + length;
+                }
+              if (length == 0)
+                {
+                  request.headers.push_back ("Content-Range: bytes */"
+                                             + total ());
+                }
+              else
+                {
+                  request.headers.push_back (
+                      "Content-Range: bytes " + std::to_string (offset) + "-"
+                      + std::to_string (offset + length - 1) + "/"
+                      + total ());
+                }
+              request.body = std::span{ buffer }.first (length);
+            }
+
+          const auto response = http_perform (request);
+          if (response
+              && (response->status == 200 || response->status == 201))
+            {
+              return video_id (*response);
+            }
+          if (response && response->status == 308)
+            {
+              resume_from (*response);
+              continue;
+            }
+          if (response
+              && (response->status == 404 || response->status == 410))
+            {
+              // the session expired, the upload starts over
+              back_off (http_status_error (response->status));
+              session.clear ();
+              continue;
+            }
+          if (response && !http_retryable (response->status))
+            {
+              return std::unexpected (http_status_error (response->status));
+            }
+
+          // the server may hold any part of the chunk, it says which
+          back_off (response ? http_status_error (response->status)
+                             : response.error ());
+          query = true;
+        }
+    }
+  catch (const std::system_error &e)
+    {
+      return std::unexpected (e.code ());
+    }
+  catch (...)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory));
+    }
+}
+
+[[nodiscard]] std::error_code
+youtube_client::download (std::string_view video_id,
+                          const std::filesystem::path &output,
+                          growing_file *progress) const noexcept
+{
+  std::error_code ec{};
+  try
+    {
+      if (this->endpoints_.media.empty ())
+        {
+          ec = std::make_error_code (std::errc::operation_not_supported);
+        }
+      else
+        {
+          const std::string url
+              = this->endpoints_.media + "/" + std::string{ video_id };
+          const std::string headers[]{ "Authorization: Bearer "
+                                       + this->access_token_ };
+          // finishes progress itself
+          return ranged_download (url, headers, output, progress);
+        }
+    }
+  catch (...)
+    {
+      ec = std::make_error_code (std::errc::not_enough_memory);
+    }
+  if (progress != nullptr)
+    {
+      progress->finish (ec);
+    }
+  return ec;
+}
+
+[[nodiscard]] std::expected<youtube_client, std::error_code>
+load_youtube_client (const std::filesystem::path &path) noexcept
+{
+  const auto contents = read (path);
+  if (!contents)
+    {
+      return std::unexpected (contents.error ());
+    }
+
+  try
+    {
+      const auto json = nlohmann::json::parse (
+          reinterpret_cast<const char *> (contents->data ()),
+          reinterpret_cast<const char *> (contents->data ()
+                                          + contents->size ()));
+      youtube_endpoints endpoints{};
+      endpoints.api = json.value ("api_url", endpoints.api);
+      endpoints.token = json.value ("token_url", endpoints.token);
+      endpoints.media = json.value ("media_url", endpoints.media);
+
+      youtube_client client{ json.at ("client_id").get<std::string> (),
+                             json.at ("client_secret").get<std::string> (),
+                             std::move (endpoints) };
+      if (const auto ec = client.authorize (
+              json.at ("refresh_token").get<std::string> ()))
+        {
+          return std::unexpected (ec);
+        }
+      return client;
+    }
+  catch (const std::bad_alloc &)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory));
+    }
+  catch (...)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::invalid_argument));
+    }
+}
+
+} // namespace ftv
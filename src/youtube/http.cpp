@@ -0,0 +1,613 @@
+#include "youtube/http.hpp"
+#include "file/async_io.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <curl/curl.h>
+
+namespace ftv
+{
+
+namespace
+{
+
+struct curl_deleter
+{
+  void
+  operator() (CURL *handle) const noexcept
+  {
+    curl_easy_cleanup (handle);
+  }
+};
+
+struct multi_deleter
+{
+  void
+  operator() (CURLM *multi) const noexcept
+  {
+    curl_multi_cleanup (multi);
+  }
+};
+
+struct slist_deleter
+{
+  void
+  operator() (curl_slist *list) const noexcept
+  {
+    curl_slist_free_all (list);
+  }
+};
+
+using curl_handle = std::unique_ptr<CURL, curl_deleter>;
+using curl_multi = std::unique_ptr<CURLM, multi_deleter>;
+using curl_headers = std::unique_ptr<curl_slist, slist_deleter>;
+
+// curl_global_init is not thread safe, the first request runs it
+[[nodiscard]] bool
+curl_ready () noexcept
+{
+  static const bool ready = curl_global_init (CURL_GLOBAL_DEFAULT) == CURLE_OK;
+  return ready;
+}
+
+// "Expect:" and then headers, nullptr when out of memory
+[[nodiscard]] curl_headers
+header_list (std::span<const std::string> headers) noexcept
+{
+  // a 100-continue round trip per request only costs time
+  curl_headers list{ curl_slist_append (nullptr, "Expect:") };
+  for (const auto &header : headers)
+    {
+      if (!list)
+        {
+          break;
+        }
+      curl_slist *next = curl_slist_append (list.get (), header.c_str ());
+      if (next == nullptr)
+        {
+          list.reset ();
+          break;
+        }
+      static_cast<void> (list.release ());
+      list.reset (next);
+    }
+  return list;
+}
+
+void
+set_timeouts (CURL *curl) noexcept
+{
+  curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, 30L);
+  // a connection that stalls for a minute counts as lost
+  curl_easy_setopt (curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+  curl_easy_setopt (curl, CURLOPT_LOW_SPEED_TIME, 60L);
+}
+
+std::size_t
+append_body (char *data, std::size_t size, std::size_t count,
+             void *user) noexcept
+{
+  try
+    {
+      static_cast<std::string *> (user)->append (data, size * count);
+      return size * count;
+    }
+  catch (...)
+    {
+      return 0; // aborts the transfer
+    }
+}
+
+[[nodiscard]] bool
+header_is (std::string_view name, std::string_view expected) noexcept
+{
+  return name.size () == expected.size ()
+         && std::equal (name.begin (), name.end (), expected.begin (),
+                        [] (char a, char b) {
+                          return (a | 0x20) == (b | 0x20);
+                        });
+}
+
+// the name and the trimmed value of a header line, nothing for the status
+// line and the blank one after the headers
+[[nodiscard]] std::optional<std::pair<std::string_view, std::string_view>>
+split_header (std::string_view line) noexcept
+{
+  const auto colon = line.find (':');
+  if (colon == std::string_view::npos)
+    {
+      return std::nullopt;
+    }
+  auto value = line.substr (colon + 1);
+  const auto begin = value.find_first_not_of (" \t");
+  const auto end = value.find_last_not_of (" \t\r\n");
+  value = begin == std::string_view::npos
+              ? std::string_view{}
+              : value.substr (begin, end - begin + 1);
+  return std::pair{ line.substr (0, colon), value };
+}
+
+std::size_t
+read_header (char *data, std::size_t size, std::size_t count,
+             void *user) noexcept
+{
+  auto &response = *static_cast<http_response *> (user);
+  const auto header = split_header ({ data, size * count });
+  try
+    {
+      if (header && header_is (header->first, "location"))
+        {
+          response.location = header->second;
+        }
+      else if (header && header_is (header->first, "range"))
+        {
+          response.range = header->second;
+        }
+      return size * count;
+    }
+  catch (...)
+    {
+      return 0;
+    }
+}
+
+[[nodiscard]] std::optional<std::uint64_t>
+parse_size (std::string_view text) noexcept
+{
+  std::uint64_t value = 0;
+  const auto [end, ec]
+      = std::from_chars (text.data (), text.data () + text.size (), value);
+  if (ec != std::errc{} || end != text.data () + text.size ())
+    {
+      return std::nullopt;
+    }
+  return value;
+}
+
+// the error of a request that got no http status
+[[nodiscard]] std::error_code
+transport_error (CURLcode code) noexcept
+{
+  switch (code)
+    {
+    case CURLE_OPERATION_TIMEDOUT:
+      return std::make_error_code (std::errc::timed_out);
+    case CURLE_COULDNT_CONNECT:
+      return std::make_error_code (std::errc::connection_refused);
+    case CURLE_COULDNT_RESOLVE_HOST:
+      return std::make_error_code (std::errc::host_unreachable);
+    case CURLE_OUT_OF_MEMORY:
+      return std::make_error_code (std::errc::not_enough_memory);
+    default:
+      return std::make_error_code (std::errc::connection_aborted);
+    }
+}
+
+[[noreturn]] void
+fail (std::error_code ec)
+{
+  throw std::system_error (ec);
+}
+
+struct download;
+
+// one range of a download, fetched by at most one transfer at a time
+struct download_range
+{
+  download *owner{};
+  std::uint64_t begin{};
+  std::uint64_t end{}; // past the range
+  std::uint64_t received{};
+  std::size_t failures{};
+  std::chrono::steady_clock::time_point retry_at{};
+  curl_handle handle{};
+  curl_headers headers{};
+  bool done{};
+};
+
+struct download
+{
+  async_file file;
+  growing_file *progress{};
+  std::optional<std::uint64_t> total{};
+  bool whole{}; // the server ignored the range, the first one is the file
+  std::deque<download_range> ranges{}; // never moved, curl points into it
+  std::size_t complete{};              // done ranges from the front
+  std::error_code error{};             // of a callback
+};
+
+// reports the longest prefix on disk, ranges complete front to back but
+// the first incomplete one counts with what it received
+void
+report_prefix (download &state) noexcept
+{
+  while (state.complete < state.ranges.size ()
+         && state.ranges[state.complete].done)
+    {
+      ++state.complete;
+    }
+  if (state.progress == nullptr)
+    {
+      return;
+    }
+  state.progress->advance (
+      state.complete < state.ranges.size ()
+          ? state.ranges[state.complete].begin
+                + state.ranges[state.complete].received
+          : state.ranges.back ().end);
+}
+
+std::size_t
+write_range (char *data, std::size_t size, std::size_t count,
+             void *user) noexcept
+{
+  auto &range = *static_cast<download_range *> (user);
+  auto &state = *range.owner;
+  const std::size_t bytes = size * count;
+
+  long status = 0;
+  curl_easy_getinfo (range.handle.get (), CURLINFO_RESPONSE_CODE, &status);
+  if (status == 200 && range.begin != 0)
+    {
+      // the whole file in place of a later range
+      state.error = std::make_error_code (std::errc::protocol_error);
+      return 0;
+    }
+  if (status != 206 && status != 200)
+    {
+      return bytes; // an error page, the status decides what happens
+    }
+  if (range.received + bytes > range.end - range.begin)
+    {
+      state.error = std::make_error_code (std::errc::protocol_error);
+      return 0;
+    }
+
+  const std::span<const std::byte> chunk{
+    reinterpret_cast<const std::byte *> (data), bytes
+  };
+  std::error_code ec = state.file.submit_write (
+      chunk, range.begin + range.received, 0);
+  if (!ec)
+    {
+      const auto written = state.file.wait ();
+      ec = !written ? written.error () : written->error;
+    }
+  if (ec)
+    {
+      state.error = ec;
+      return 0;
+    }
+
+  range.received += bytes;
+  report_prefix (state);
+  return bytes;
+}
+
+// learns the size of the file from the first range's response
+std::size_t
+range_header (char *data, std::size_t size, std::size_t count,
+              void *user) noexcept
+{
+  auto &range = *static_cast<download_range *> (user);
+  auto &state = *range.owner;
+  const auto header = split_header ({ data, size * count });
+  if (!header || range.begin != 0 || state.total)
+    {
+      return size * count;
+    }
+
+  long status = 0;
+  curl_easy_getinfo (range.handle.get (), CURLINFO_RESPONSE_CODE, &status);
+  if (header_is (header->first, "content-range"))
+    {
+      // "bytes 0-<last>/<size>", or "bytes */<size>" for an empty file
+      const auto slash = header->second.rfind ('/');
+      if (slash != std::string_view::npos)
+        {
+          state.total = parse_size (header->second.substr (slash + 1));
+        }
+      if (state.total)
+        {
+          range.end = std::min (range.end, *state.total);
+        }
+    }
+  else if (status == 200 && header_is (header->first, "content-length"))
+    {
+      state.total = parse_size (header->second);
+      state.whole = state.total.has_value ();
+      range.end = state.total.value_or (range.end);
+    }
+  return size * count;
+}
+
+void
+start_range (CURLM *multi, download_range &range, const std::string &url,
+             std::span<const std::string> headers)
+{
+  std::vector<std::string> all{ headers.begin (), headers.end () };
+  all.push_back ("Range: bytes="
+                 + std::to_string (range.begin + range.received) + "-"
+                 + std::to_string (range.end - 1));
+  range.headers = header_list (all);
+  range.handle.reset (curl_easy_init ());
+  if (!range.handle || !range.headers)
+    {
+      fail (std::make_error_code (std::errc::not_enough_memory));
+    }
+
+  CURL *curl = range.handle.get ();
+  curl_easy_setopt (curl, CURLOPT_URL, url.c_str ());
+  curl_easy_setopt (curl, CURLOPT_HTTPGET, 1L);
+  curl_easy_setopt (curl, CURLOPT_HTTPHEADER, range.headers.get ());
+  curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, write_range);
+  curl_easy_setopt (curl, CURLOPT_WRITEDATA, &range);
+  curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, range_header);
+  curl_easy_setopt (curl, CURLOPT_HEADERDATA, &range);
+  set_timeouts (curl);
+  if (curl_multi_add_handle (multi, curl) != CURLM_OK)
+    {
+      fail (std::make_error_code (std::errc::not_enough_memory));
+    }
+}
+
+// the ranges after the first once the size is known
+void
+plan_ranges (download &state)
+{
+  if (const auto ec = state.file.resize (*state.total))
+    {
+      fail (ec);
+    }
+  if (state.whole)
+    {
+      return;
+    }
+  for (std::uint64_t begin = state.ranges.front ().end;
+       begin < *state.total; begin += DOWNLOAD_RANGE_SIZE)
+    {
+      download_range range{};
+      range.owner = &state;
+      range.begin = begin;
+      range.end = std::min<std::uint64_t> (begin + DOWNLOAD_RANGE_SIZE,
+                                           *state.total);
+      state.ranges.push_back (std::move (range));
+    }
+}
+
+// handles the end of a range's transfer: done, retried later or fatal
+void
+finish_range (download_range &range, CURLcode result)
+{
+  auto &state = *range.owner;
+  long status = 0;
+  curl_easy_getinfo (range.handle.get (), CURLINFO_RESPONSE_CODE, &status);
+  range.handle.reset ();
+  range.headers.reset ();
+
+  if (state.error)
+    {
+      fail (state.error);
+    }
+  // an empty file has no range to satisfy
+  const bool empty = status == 416 && state.total == 0;
+  if ((result == CURLE_OK && (status == 206 || status == 200)
+       && range.received == range.end - range.begin)
+      || empty)
+    {
+      range.done = true;
+      range.failures = 0;
+      report_prefix (state);
+      return;
+    }
+  if (result == CURLE_OK && status != 206 && status != 200
+      && !http_retryable (status))
+    {
+      fail (http_status_error (status));
+    }
+
+  // a dropped connection or a server error, the range continues where it
+  // stopped
+  if (++range.failures > DOWNLOAD_MAX_RETRIES)
+    {
+      fail (result != CURLE_OK ? transport_error (result)
+                               : http_status_error (status));
+    }
+  range.retry_at = std::chrono::steady_clock::now ()
+                   + DOWNLOAD_RETRY_DELAY * (1u << (range.failures - 1));
+}
+
+} // namespace
+
+[[nodiscard]] std::expected<http_response, std::error_code>
+http_perform (const http_request &request) noexcept
+{
+  if (!curl_ready ())
+    {
+      return std::unexpected (std::make_error_code (std::errc::io_error));
+    }
+  const curl_handle handle{ curl_easy_init () };
+  const auto headers = header_list (request.headers);
+  if (!handle || !headers)
+    {
+      return std::unexpected (
+          std::make_error_code (std::errc::not_enough_memory));
+    }
+
+  http_response response{};
+  CURL *curl = handle.get ();
+  curl_easy_setopt (curl, CURLOPT_URL, request.url.c_str ());
+  curl_easy_setopt (curl, CURLOPT_CUSTOMREQUEST, request.method.c_str ());
+  if (request.method != "GET")
+    {
+      // the body is sent from the caller's buffer, not copied
+      curl_easy_setopt (curl, CURLOPT_POSTFIELDS, request.body.data ());
+      curl_easy_setopt (curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                        static_cast<curl_off_t> (request.body.size ()));
+    }
+  curl_easy_setopt (curl, CURLOPT_HTTPHEADER, headers.get ());
+  curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, append_body);
+  curl_easy_setopt (curl, CURLOPT_WRITEDATA, &response.body);
+  curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, read_header);
+  curl_easy_setopt (curl, CURLOPT_HEADERDATA, &response);
+  set_timeouts (curl);
+
+  if (const CURLcode code = curl_easy_perform (curl); code != CURLE_OK)
+    {
+      return std::unexpected (transport_error (code));
+    }
+  curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &response.status);
+  return response;
+}
+
+[[nodiscard]] std::error_code
+http_status_error (long status) noexcept
+{
+  switch (status)
+    {
+    case 400:
+      return std::make_error_code (std::errc::invalid_argument);
+    case 401:
+    case 403:
+      return std::make_error_code (std::errc::permission_denied);
+    case 404:
+    case 410:
+      return std::make_error_code (std::errc::no_such_file_or_directory);
+    case 429:
+      return std::make_error_code (std::errc::resource_unavailable_try_again);
+    default:
+      return std::make_error_code (std::errc::protocol_error);
+    }
+}
+
+[[nodiscard]] bool
+http_retryable (long status) noexcept
+{
+  return status >= 500 || status == 429;
+}
+
+[[nodiscard]] std::error_code
+ranged_download (const std::string &url,
+                 std::span<const std::string> headers,
+                 const std::filesystem::path &output, growing_file *progress,
+                 std::size_t connections) noexcept
+{
+  std::error_code result{};
+  try
+    {
+      if (!curl_ready ())
+        {
+          fail (std::make_error_code (std::errc::io_error));
+        }
+      // the multi handle goes first, it lets go of the transfers still
+      // running before their easy handles are cleaned up
+      download state{ async_file{ output, io_mode::write, 1 }, progress };
+      const curl_multi multi{ curl_multi_init () };
+      if (!multi)
+        {
+          fail (std::make_error_code (std::errc::not_enough_memory));
+        }
+
+      // the first range tells the size of the file
+      download_range first{};
+      first.owner = &state;
+      first.end = DOWNLOAD_RANGE_SIZE;
+      state.ranges.push_back (std::move (first));
+      bool planned = false;
+      std::size_t active = 0;
+
+      for (;;)
+        {
+          if (progress != nullptr && progress->cancelled ())
+            {
+              fail (std::make_error_code (std::errc::operation_canceled));
+            }
+          if (!planned && state.total)
+            {
+              plan_ranges (state);
+              planned = true;
+            }
+
+          const auto now = std::chrono::steady_clock::now ();
+          auto wake = now + std::chrono::seconds{ 1 };
+          for (auto &range : state.ranges)
+            {
+              if (active == std::max<std::size_t> (connections, 1))
+                {
+                  break;
+                }
+              if (range.done || range.handle)
+                {
+                  continue;
+                }
+              if (range.retry_at > now)
+                {
+                  wake = std::min (wake, range.retry_at);
+                  continue;
+                }
+              start_range (multi.get (), range, url, headers);
+              ++active;
+            }
+          if (state.complete == state.ranges.size ())
+            {
+              break;
+            }
+          if (active == 0)
+            {
+              // every missing range waits for its retry
+              std::this_thread::sleep_until (wake);
+              continue;
+            }
+
+          int running = 0;
+          curl_multi_perform (multi.get (), &running);
+          int queued = 0;
+          while (const CURLMsg *message
+                 = curl_multi_info_read (multi.get (), &queued))
+            {
+              if (message->msg != CURLMSG_DONE)
+                {
+                  continue;
+                }
+              const auto range = std::find_if (
+                  state.ranges.begin (), state.ranges.end (),
+                  [&] (const download_range &candidate) {
+                    return candidate.handle.get () == message->easy_handle;
+                  });
+              const CURLcode code = message->data.result;
+              curl_multi_remove_handle (multi.get (), message->easy_handle);
+              --active;
+              finish_range (*range, code);
+            }
+          if (state.error)
+            {
+              fail (state.error);
+            }
+          curl_multi_poll (multi.get (), nullptr, 0, 100, nullptr);
+        }
+    }
+  catch (const std::system_error &e)
+    {
+      result = e.code ();
+    }
+  catch (...)
+    {
+      result = std::make_error_code (std::errc::not_enough_memory);
+    }
+
+  if (progress != nullptr)
+    {
+      progress->finish (result);
+    }
+  return result;
+}
+
+} // namespace ftv